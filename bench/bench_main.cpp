@@ -0,0 +1,410 @@
+// 核心组件微基准测试
+// 用法: codebackup_bench [--filter 子串] [--out 结果.json] [--presets presets.json] [--min-time 秒] [--repetitions N]
+// 结果以 JSON 写到 --out 指定的文件（未指定时写到标准输出），可读摘要写到标准错误
+#include "backup_handler.h"
+#include "compression_utils.h"
+#include "config_loader.h"
+#include "hash_utils.h"
+#include "task_scheduler.h"
+#include "version_manager.h"
+#include "platform.h"
+#include "synthetic_data.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// 阻止编译器把被测结果优化掉
+template <typename T>
+void doNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+    _ReadWriteBarrier();
+#endif
+}
+
+struct Options {
+    std::string filter;
+    std::string out_path;
+    std::string presets_path = "presets.json";
+    double min_time_seconds = 0.2;
+    int repetitions = 3;
+};
+
+struct Result {
+    std::string name;
+    uint64_t iterations = 0;            // 每轮迭代次数
+    double ns_per_op = 0.0;             // 各轮的中位数
+    double min_ns_per_op = 0.0;
+    double max_ns_per_op = 0.0;
+    uint64_t bytes_per_op = 0;          // 0 表示不计算吞吐量
+    nlohmann::json extra = nlohmann::json::object();
+};
+
+class Runner {
+public:
+    explicit Runner(const Options& options) : options_(options) {}
+
+    bool selected(const std::string& name) const {
+        return options_.filter.empty() || name.find(options_.filter) != std::string::npos;
+    }
+
+    // fn 执行一次被测操作；先按耗时翻倍确定迭代次数，再跑 repetitions 轮取中位数
+    Result& run(const std::string& name, uint64_t bytes_per_op, const std::function<void()>& fn) {
+        using Clock = std::chrono::steady_clock;
+        auto measure = [&](uint64_t iterations) {
+            auto start = Clock::now();
+            for (uint64_t i = 0; i < iterations; ++i) {
+                fn();
+            }
+            return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        };
+
+        double target_ns = options_.min_time_seconds * 1e9;
+        uint64_t iterations = 1;
+        double elapsed = measure(iterations);
+        while (elapsed < target_ns / 10 && iterations < (uint64_t(1) << 40)) {
+            iterations *= 2;
+            elapsed = measure(iterations);
+        }
+        double per_op = elapsed / iterations;
+        iterations = std::max<uint64_t>(1, static_cast<uint64_t>(target_ns / std::max(per_op, 1.0)));
+
+        std::vector<double> samples;
+        for (int r = 0; r < std::max(1, options_.repetitions); ++r) {
+            samples.push_back(measure(iterations) / iterations);
+        }
+        std::sort(samples.begin(), samples.end());
+
+        Result result;
+        result.name = name;
+        result.iterations = iterations;
+        result.ns_per_op = samples[samples.size() / 2];
+        result.min_ns_per_op = samples.front();
+        result.max_ns_per_op = samples.back();
+        result.bytes_per_op = bytes_per_op;
+        results_.push_back(std::move(result));
+
+        const Result& last = results_.back();
+        std::fprintf(stderr, "%-40s %14.1f ns/op", name.c_str(), last.ns_per_op);
+        if (bytes_per_op > 0) {
+            std::fprintf(stderr, "  %10.1f MB/s", bytes_per_op / last.ns_per_op * 1e9 / 1048576.0);
+        }
+        std::fprintf(stderr, "\n");
+        return results_.back();
+    }
+
+    nlohmann::json toJson() const {
+        nlohmann::json benchmarks = nlohmann::json::array();
+        for (const auto& result : results_) {
+            nlohmann::json entry = {
+                {"name", result.name},
+                {"iterations", result.iterations},
+                {"repetitions", options_.repetitions},
+                {"ns_per_op", result.ns_per_op},
+                {"min_ns_per_op", result.min_ns_per_op},
+                {"max_ns_per_op", result.max_ns_per_op}
+            };
+            if (result.bytes_per_op > 0) {
+                entry["bytes_per_op"] = result.bytes_per_op;
+                entry["bytes_per_second"] = result.bytes_per_op / result.ns_per_op * 1e9;
+            }
+            if (!result.extra.empty()) {
+                entry["extra"] = result.extra;
+            }
+            benchmarks.push_back(entry);
+        }
+
+        std::time_t now = std::time(nullptr);
+        std::tm tm;
+        Platform::localTime(now, tm);
+        char date[32];
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", &tm);
+
+        return {
+            {"context", {
+                {"date", date},
+                {"hardware_concurrency", std::thread::hardware_concurrency()},
+                {"min_time_seconds", options_.min_time_seconds},
+#ifdef NDEBUG
+                {"build", "release"}
+#else
+                {"build", "debug"}
+#endif
+            }},
+            {"benchmarks", benchmarks}
+        };
+    }
+
+private:
+    Options options_;
+    std::vector<Result> results_;
+};
+
+using SyntheticData::makeTextData;
+using SyntheticData::makeRandomData;
+using SyntheticData::writeFile;
+
+std::string sizeLabel(size_t size) {
+    if (size >= 1048576) {
+        return std::to_string(size / 1048576) + "MB";
+    }
+    return std::to_string(size / 1024) + "KB";
+}
+
+void benchHashing(Runner& runner, const fs::path& work_dir) {
+    for (size_t size : {size_t(4096), size_t(1048576)}) {
+        std::string name = "hash.data/" + sizeLabel(size);
+        if (!runner.selected(name)) {
+            continue;
+        }
+        auto data = makeRandomData(size, 1);
+        runner.run(name, size, [&]() {
+            doNotOptimize(HashUtils::calculateDataHash(data.data(), data.size()));
+        });
+    }
+
+    // 文件在页缓存中，测的是读取 + 哈希的 CPU 开销
+    for (size_t size : {size_t(65536), size_t(4 * 1048576)}) {
+        std::string name = "hash.file/" + sizeLabel(size);
+        if (!runner.selected(name)) {
+            continue;
+        }
+        fs::path file = work_dir / ("hash_" + sizeLabel(size) + ".bin");
+        writeFile(file, makeRandomData(size, 2));
+        std::string path = file.string();
+        runner.run(name, size, [&]() {
+            doNotOptimize(HashUtils::calculateFileHash(path));
+        });
+    }
+}
+
+void benchCompression(Runner& runner) {
+    const size_t size = 1048576;
+    auto data = makeTextData(size, 3);
+    for (int level = 1; level <= 9; ++level) {
+        std::string compress_name = "compress.level" + std::to_string(level) + "/" + sizeLabel(size);
+        std::string decompress_name = "decompress.level" + std::to_string(level) + "/" + sizeLabel(size);
+        if (!runner.selected(compress_name) && !runner.selected(decompress_name)) {
+            continue;
+        }
+        auto compressed = CompressionUtils::compressData(data, level);
+        if (!compressed) {
+            std::fprintf(stderr, "compressData 失败 (level %d)，跳过\n", level);
+            continue;
+        }
+        double ratio = static_cast<double>(compressed->size()) / size;
+        if (runner.selected(compress_name)) {
+            Result& result = runner.run(compress_name, size, [&]() {
+                doNotOptimize(CompressionUtils::compressData(data, level));
+            });
+            result.extra["compressed_ratio"] = ratio;
+        }
+        if (runner.selected(decompress_name)) {
+            Result& result = runner.run(decompress_name, size, [&]() {
+                doNotOptimize(CompressionUtils::decompressData(*compressed));
+            });
+            result.extra["compressed_ratio"] = ratio;
+        }
+    }
+}
+
+// 典型工程目录下的路径：源代码、构建产物、依赖目录、文档和二进制文件混合
+std::vector<std::string> makeCandidatePaths(const fs::path& source_dir, size_t count) {
+    static const char* const DIRS[] = {
+        "src", "src/core", "include", "tests", "docs", "build", "build/Release", "node_modules/lodash",
+        ".git/objects/ab", "assets/images", "scripts", "third_party/zlib", "out/obj", "dist"
+    };
+    static const char* const EXTENSIONS[] = {
+        ".cpp", ".h", ".py", ".js", ".ts", ".json", ".md", ".txt", ".obj", ".exe", ".dll", ".pdb",
+        ".png", ".jpg", ".zip", ".log", ".tmp", ".min.js", ".lock", ""
+    };
+    std::mt19937 rng(4);
+    std::uniform_int_distribution<size_t> pick_dir(0, sizeof(DIRS) / sizeof(DIRS[0]) - 1);
+    std::uniform_int_distribution<size_t> pick_ext(0, sizeof(EXTENSIONS) / sizeof(EXTENSIONS[0]) - 1);
+    std::vector<std::string> paths;
+    paths.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        fs::path path = source_dir / DIRS[pick_dir(rng)] / ("file_" + std::to_string(i) + EXTENSIONS[pick_ext(rng)]);
+        paths.push_back(path.make_preferred().string());
+    }
+    return paths;
+}
+
+void benchFilter(Runner& runner, const Options& options, const fs::path& work_dir) {
+    const std::string name = "isAllowed/presets";
+    if (!runner.selected(name)) {
+        return;
+    }
+    auto presets = ConfigLoader::loadPresets(options.presets_path);
+    if (!presets) {
+        std::fprintf(stderr, "找不到 %s，跳过 %s（用 --presets 指定）\n", options.presets_path.c_str(), name.c_str());
+        return;
+    }
+
+    std::vector<std::string> preset_names;
+    for (const char* preset : {"code", "documents", "common_blacklist", "build_artifacts"}) {
+        if (presets->contains(preset)) {
+            preset_names.push_back(preset);
+        }
+    }
+    auto filter = ConfigLoader::compileFilters(preset_names, *presets, std::nullopt);
+
+    fs::path source_dir = work_dir / "filter_source";
+    fs::create_directories(source_dir);
+    BackupStrategy strategy;
+    strategy.reconcile_on_startup = false;
+    BackupHandler handler(source_dir.string(), (work_dir / "filter_dest").string(), filter, strategy);
+
+    auto paths = makeCandidatePaths(source_dir, 4096);
+    size_t allowed = 0;
+    for (const auto& path : paths) {
+        allowed += handler.isAllowed(path) ? 1 : 0;
+    }
+
+    size_t next = 0;
+    Result& result = runner.run(name, 0, [&]() {
+        doNotOptimize(handler.isAllowed(paths[next]));
+        next = (next + 1) % paths.size();
+    });
+    result.extra["presets"] = preset_names;
+    result.extra["allowed_fraction"] = static_cast<double>(allowed) / paths.size();
+}
+
+void benchVersionParsing(Runner& runner, const fs::path& work_dir) {
+    const std::string name = "parseVersionFile";
+    if (!runner.selected(name)) {
+        return;
+    }
+    fs::path dest = work_dir / "versions";
+    fs::path day = dest / "2024-05-01" / "src";
+    fs::create_directories(day);
+    std::vector<fs::path> files;
+    for (int i = 0; i < 256; ++i) {
+        std::string base = "module_" + std::to_string(i);
+        fs::path plain = day / (base + ".20240501_1230" + std::to_string(10 + i % 50) + ".cpp");
+        fs::path gz = day / (base + ".20240501_1231" + std::to_string(10 + i % 50) + ".h.gz");
+        std::ofstream(plain) << "x";
+        std::ofstream(gz) << "x";
+        files.push_back(plain);
+        files.push_back(gz);
+    }
+
+    VersionManager manager(dest.string(), BackupStrategy());
+    size_t next = 0;
+    runner.run(name, 0, [&]() {
+        doNotOptimize(manager.parseVersionFile(files[next]));
+        next = (next + 1) % files.size();
+    });
+}
+
+void benchScheduler(Runner& runner) {
+    const std::string name = "scheduler.push_pop/1024";
+    if (!runner.selected(name)) {
+        return;
+    }
+    BackupStrategy strategy;
+    TaskScheduler scheduler(strategy);
+    std::vector<BackupTask> tasks(1024);
+    std::mt19937 rng(5);
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        tasks[i].source_file_path = "C:\\code\\project\\src\\file_" + std::to_string(i) + ".cpp";
+        tasks[i].file_size = rng() % (32 * 1048576);
+        tasks[i].task_class = scheduler.classify(tasks[i].file_size, i % 7 == 0);
+    }
+
+    // 每次操作：整批任务入队再全部出队；单个任务的平均开销见 extra.ns_per_task
+    Result& result = runner.run(name, 0, [&]() {
+        auto now = std::chrono::steady_clock::now();
+        for (const auto& task : tasks) {
+            BackupTask copy = task;
+            copy.enqueue_time = now;
+            scheduler.push(std::move(copy));
+        }
+        while (auto task = scheduler.pop(now)) {
+            scheduler.complete(*task, now);
+            doNotOptimize(task->file_size);
+        }
+    });
+    result.extra["tasks_per_op"] = tasks.size();
+    result.extra["ns_per_task"] = result.ns_per_op / tasks.size();
+}
+
+bool parseArgs(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+        const char* v = nullptr;
+        if (arg == "--filter" && (v = value())) {
+            options.filter = v;
+        } else if (arg == "--out" && (v = value())) {
+            options.out_path = v;
+        } else if (arg == "--presets" && (v = value())) {
+            options.presets_path = v;
+        } else if (arg == "--min-time" && (v = value())) {
+            options.min_time_seconds = std::max(0.001, std::atof(v));
+        } else if (arg == "--repetitions" && (v = value())) {
+            options.repetitions = std::max(1, std::atoi(v));
+        } else {
+            std::cerr << "用法: codebackup_bench [--filter 子串] [--out 结果.json] [--presets presets.json]"
+                         " [--min-time 秒] [--repetitions N]" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        return 2;
+    }
+
+    fs::path work_dir = fs::temp_directory_path() / ("codebackup_bench_" + std::to_string(std::time(nullptr)));
+    fs::create_directories(work_dir);
+
+    Runner runner(options);
+    benchHashing(runner, work_dir);
+    benchCompression(runner);
+    benchFilter(runner, options, work_dir);
+    benchVersionParsing(runner, work_dir);
+    benchScheduler(runner);
+
+    std::error_code ec;
+    fs::remove_all(work_dir, ec);
+
+    std::string json = runner.toJson().dump(2);
+    if (options.out_path.empty()) {
+        std::cout << json << std::endl;
+    } else {
+        std::ofstream out(options.out_path, std::ios::trunc);
+        out << json << std::endl;
+        if (!out) {
+            std::cerr << "无法写入 " << options.out_path << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,418 @@
+// 事件记录回放：把 capture_events 记录的原始事件按原速或加速注入新的 BackupHandler
+// 用法: codebackup_replay 记录.cbtrace [--sandbox 目录] [--speed 倍数] [--config config.json] [--presets presets.json]
+//                         [--workers N] [--max-file-size 字节] [--quiet-ms 毫秒] [--timeout 秒]
+//                         [--log-level 级别] [--out 结果.json] [--keep]
+// 每个备份源映射到沙盒下的 source<N> 目录：回放前先建出记录中已存在的文件，
+// 回放时按记录的动作和大小新建、改写、删除、移动沙盒中的文件，再注入同样的事件
+// --speed 1 按记录的时间间隔回放，0 表示不等待、尽快注入
+#include "backup_handler.h"
+#include "config_loader.h"
+#include "event_trace.h"
+#include "event_ring.h"
+#include "logger.h"
+#include "synthetic_data.h"
+#include "workload_support.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+using namespace WorkloadSupport;
+
+struct Options {
+    std::string trace_path;
+    std::string sandbox;
+    double speed = 1.0;
+    std::string config_path;
+    std::string presets_path = "presets.json";
+    int workers = 0;
+    uint64_t max_file_size = 64ull * 1048576;   // 记录中更大的文件按此大小生成
+    int quiet_ms = 0;                           // 0 表示 storm_settle_ms + 2000
+    int timeout_seconds = 300;
+    std::string log_level = "warn";
+    std::string out_path;
+    bool keep = false;
+};
+
+// 记录中的路径映射到沙盒
+class SandboxMap {
+public:
+    SandboxMap(const std::vector<std::string>& sources, const fs::path& sandbox) {
+        for (size_t i = 0; i < sources.size(); ++i) {
+            prefixes_.push_back(fs::path(sources[i]).lexically_normal().generic_string());
+            roots_.push_back(sandbox / ("source" + std::to_string(i)));
+        }
+    }
+
+    size_t size() const { return roots_.size(); }
+    const fs::path& root(size_t source) const { return roots_[source]; }
+
+    // 不在源路径下的目录（记录损坏或路径被改写）返回空
+    std::optional<fs::path> mapDir(uint32_t source, const std::string& dir) const {
+        if (source >= prefixes_.size()) {
+            return std::nullopt;
+        }
+        std::string normal = fs::path(dir).lexically_normal().generic_string();
+        while (normal.size() > 1 && normal.back() == '/') {
+            normal.pop_back();
+        }
+        const std::string& prefix = prefixes_[source];
+        if (normal.compare(0, prefix.size(), prefix) != 0 ||
+            (normal.size() > prefix.size() && normal[prefix.size()] != '/')) {
+            return std::nullopt;
+        }
+        fs::path mapped = roots_[source];
+        if (normal.size() > prefix.size()) {
+            mapped /= fs::path(normal.substr(prefix.size() + 1));
+        }
+        return mapped.make_preferred();
+    }
+
+private:
+    std::vector<std::string> prefixes_;
+    std::vector<fs::path> roots_;
+};
+
+// 按记录的大小生成文件内容：从合成文本池中随机截取，同一文件每次改写内容不同
+class ContentWriter {
+public:
+    explicit ContentWriter(uint64_t max_file_size)
+        : max_file_size_(max_file_size), text_(SyntheticData::makeTextData(4 * 1048576, 7)), rng_(7) {}
+
+    void write(const fs::path& path, std::optional<uint64_t> size) {
+        uint64_t remaining = std::min<uint64_t>(size.value_or(1024), max_file_size_);
+        std::error_code ec;
+        fs::create_directories(path.parent_path(), ec);
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        while (remaining > 0) {
+            size_t chunk = static_cast<size_t>(std::min<uint64_t>(remaining, text_.size() / 2));
+            std::uniform_int_distribution<size_t> pick_offset(0, text_.size() - chunk);
+            file.write(reinterpret_cast<const char*>(text_.data() + pick_offset(rng_)),
+                       static_cast<std::streamsize>(chunk));
+            remaining -= chunk;
+        }
+    }
+
+private:
+    uint64_t max_file_size_;
+    std::vector<uint8_t> text_;
+    std::mt19937 rng_;
+};
+
+// 回放开始前沙盒中应当已经存在的文件：第一次出现时不是新建（修改、删除、作为移动的原路径）
+void createPreexistingFiles(const std::vector<EventTraceReader::Event>& events, const SandboxMap& map,
+                            ContentWriter& writer, size_t& created) {
+    std::unordered_set<std::string> seen;
+    auto firstTouch = [&](const fs::path& path) { return seen.insert(path.generic_string()).second; };
+
+    for (const auto& event : events) {
+        if (event.action == RESCAN_ACTION) {
+            continue;
+        }
+        auto dir = map.mapDir(event.source, event.dir);
+        if (!dir) {
+            continue;
+        }
+        fs::path target = *dir / event.filename;
+        if (event.action == efsw::Actions::Moved) {
+            fs::path old_path = *dir / event.old_filename;
+            if (firstTouch(old_path)) {
+                std::error_code ec;
+                if (event.is_directory) {
+                    fs::create_directories(old_path, ec);
+                } else {
+                    writer.write(old_path, event.size);
+                }
+                created++;
+            }
+            firstTouch(target);
+            continue;
+        }
+        if (!firstTouch(target) || event.action == efsw::Actions::Add) {
+            continue;
+        }
+        std::error_code ec;
+        if (event.is_directory) {
+            fs::create_directories(target, ec);
+        } else {
+            writer.write(target, event.size);
+        }
+        created++;
+    }
+}
+
+bool parseArgs(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+        const char* v = nullptr;
+        if (arg == "--sandbox" && (v = value())) {
+            options.sandbox = v;
+        } else if (arg == "--speed" && (v = value())) {
+            options.speed = std::max(0.0, std::atof(v));
+        } else if (arg == "--config" && (v = value())) {
+            options.config_path = v;
+        } else if (arg == "--presets" && (v = value())) {
+            options.presets_path = v;
+        } else if (arg == "--workers" && (v = value())) {
+            options.workers = std::max(0, std::atoi(v));
+        } else if (arg == "--max-file-size" && (v = value())) {
+            options.max_file_size = std::max<uint64_t>(1, std::strtoull(v, nullptr, 10));
+        } else if (arg == "--quiet-ms" && (v = value())) {
+            options.quiet_ms = std::max(0, std::atoi(v));
+        } else if (arg == "--timeout" && (v = value())) {
+            options.timeout_seconds = std::max(1, std::atoi(v));
+        } else if (arg == "--log-level" && (v = value())) {
+            options.log_level = v;
+        } else if (arg == "--out" && (v = value())) {
+            options.out_path = v;
+        } else if (arg == "--keep") {
+            options.keep = true;
+        } else if (!arg.empty() && arg[0] != '-' && options.trace_path.empty()) {
+            options.trace_path = arg;
+        } else {
+            options.trace_path.clear();
+            break;
+        }
+    }
+    if (options.trace_path.empty()) {
+        std::cerr << "用法: codebackup_replay 记录.cbtrace [--sandbox 目录] [--speed 倍数] [--config config.json]"
+                     " [--presets presets.json] [--workers N] [--max-file-size 字节] [--quiet-ms 毫秒]"
+                     " [--timeout 秒] [--log-level 级别] [--out 结果.json] [--keep]" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        return 2;
+    }
+
+    EventTraceReader reader;
+    if (!reader.open(options.trace_path)) {
+        std::cerr << reader.error() << std::endl;
+        return 1;
+    }
+    std::vector<EventTraceReader::Event> events;
+    EventTraceReader::Event event;
+    while (reader.next(event)) {
+        events.push_back(event);
+    }
+    // 进程异常退出时最后一批可能不完整，已读出的事件照常回放
+    if (!reader.error().empty()) {
+        std::fprintf(stderr, "记录在第 %zu 个事件后中断: %s\n", events.size(), reader.error().c_str());
+    }
+    const auto& sources = reader.sources();
+    if (events.empty() || sources.empty()) {
+        std::cerr << "记录中没有事件" << std::endl;
+        return 1;
+    }
+    double recorded_seconds = (events.back().time_us - events.front().time_us) / 1e6;
+    std::fprintf(stderr, "%zu 个事件，%zu 个备份源，记录时长 %.1f 秒（记录时丢弃 %llu 个）\n",
+                 events.size(), sources.size(), recorded_seconds,
+                 static_cast<unsigned long long>(reader.lostEvents()));
+
+    bool temporary = options.sandbox.empty();
+    fs::path sandbox = temporary
+        ? fs::temp_directory_path() / ("codebackup_replay_" + std::to_string(std::time(nullptr)))
+        : fs::path(options.sandbox);
+    std::error_code ec;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        fs::remove_all(sandbox / ("source" + std::to_string(i)), ec);
+    }
+    fs::remove_all(sandbox / "dest", ec);
+    fs::create_directories(sandbox / "dest", ec);
+
+    LogOptions log_options;
+    log_options.level = spdlog::level::from_str(options.log_level);
+    Logger::setup((sandbox / "logs").string(), false, log_options);
+
+    // 按配置文件中同一路径的备份源取过滤规则和策略，没有配置时使用默认值
+    std::optional<Config> config;
+    nlohmann::json presets = nlohmann::json::object();
+    if (!options.config_path.empty()) {
+        config = ConfigLoader::loadConfig(options.config_path);
+        if (!config) {
+            std::cerr << "无法加载配置: " << options.config_path << std::endl;
+            return 1;
+        }
+        if (auto loaded = ConfigLoader::loadPresets(options.presets_path)) {
+            presets = *loaded;
+        }
+    }
+    BackupStrategy strategy = config ? config->strategy : BackupStrategy();
+    strategy.reconcile_on_startup = false;
+    strategy.capture_events = false;
+    int quiet_ms = options.quiet_ms > 0 ? options.quiet_ms : strategy.storm_settle_ms + 2000;
+
+    SandboxMap map(sources, sandbox);
+    ContentWriter writer(options.max_file_size);
+    std::vector<std::unique_ptr<BackupHandler>> handlers;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        fs::create_directories(map.root(i), ec);
+        std::shared_ptr<const FilterMatcher> filter;
+        if (config) {
+            for (const auto& source : config->backup_sources) {
+                if (fs::path(source.path).lexically_normal() == fs::path(sources[i]).lexically_normal()) {
+                    filter = ConfigLoader::compileFilters(source.presets, presets, source.custom_filter);
+                    break;
+                }
+            }
+        }
+        handlers.push_back(std::make_unique<BackupHandler>(map.root(i).string(), (sandbox / "dest").string(),
+                                                           filter, strategy));
+    }
+
+    size_t preexisting = 0;
+    createPreexistingFiles(events, map, writer, preexisting);
+    std::fprintf(stderr, "沙盒: %s（预先创建 %zu 个路径）\n", sandbox.string().c_str(), preexisting);
+
+    Replay replay;
+    std::vector<const BackupHandler*> measured;
+    for (auto& handler : handlers) {
+        replay.attach(*handler);
+        handler->startAsyncBackup(strategy.min_workers, options.workers > 0 ? options.workers : strategy.max_workers);
+        measured.push_back(handler.get());
+    }
+    Measurement measurement(measured, {sandbox / "dest"});
+    measurement.start();
+
+    // 按记录的时间间隔注入；落后于计划的最大时间反映沙盒写文件或注入本身的开销
+    size_t unmapped = 0;
+    double max_lag_ms = 0.0;
+    auto started = SteadyClock::now();
+    int64_t first_us = events.front().time_us;
+    for (const auto& recorded : events) {
+        if (options.speed > 0) {
+            auto due = started + std::chrono::microseconds(
+                static_cast<int64_t>((recorded.time_us - first_us) / options.speed));
+            auto now = SteadyClock::now();
+            if (due > now) {
+                std::this_thread::sleep_until(due);
+            } else {
+                max_lag_ms = std::max(max_lag_ms, std::chrono::duration<double, std::milli>(now - due).count());
+            }
+        }
+
+        auto dir = map.mapDir(recorded.source, recorded.dir);
+        if (!dir) {
+            unmapped++;
+            continue;
+        }
+        BackupHandler& handler = *handlers[recorded.source];
+        if (recorded.action == RESCAN_ACTION) {
+            replay.rescan(handler, *dir);
+            continue;
+        }
+
+        fs::path target = *dir / recorded.filename;
+        bool track = !recorded.is_directory && handler.isAllowed(target.string());
+        switch (recorded.action) {
+        case efsw::Actions::Add:
+        case efsw::Actions::Modified:
+            if (recorded.is_directory) {
+                fs::create_directories(target, ec);
+            } else {
+                writer.write(target, recorded.size);
+            }
+            replay.emit(handler, target, recorded.action, nullptr, track);
+            break;
+        case efsw::Actions::Delete:
+            fs::remove_all(target, ec);
+            replay.emit(handler, target, recorded.action);
+            break;
+        case efsw::Actions::Moved: {
+            fs::path old_path = *dir / recorded.old_filename;
+            std::error_code move_ec;
+            fs::create_directories(target.parent_path(), ec);
+            fs::rename(old_path, target, move_ec);
+            if (move_ec && !recorded.is_directory) {
+                writer.write(target, recorded.size);
+            } else if (move_ec) {
+                fs::create_directories(target, ec);
+            }
+            replay.emit(handler, target, recorded.action, &old_path, track);
+            break;
+        }
+        default:
+            unmapped++;
+            break;
+        }
+    }
+    double replay_seconds = std::chrono::duration<double>(SteadyClock::now() - started).count();
+    replay.waitSettled(quiet_ms, options.timeout_seconds);
+    measurement.stop();
+    for (auto& handler : handlers) {
+        handler->stopAsyncBackup();
+    }
+
+    nlohmann::json result = replay.report(measurement.elapsedSeconds());
+    result.update(measurement.report(result["active_seconds"].get<double>()));
+    result["replay_seconds"] = replay_seconds;
+    result["max_lag_ms"] = max_lag_ms;
+    printSummary(fs::path(options.trace_path).filename().string(), result);
+
+    handlers.clear();
+    Logger::shutdown();
+    if (!options.keep) {
+        if (temporary) {
+            fs::remove_all(sandbox, ec);
+        } else {
+            for (size_t i = 0; i < sources.size(); ++i) {
+                fs::remove_all(map.root(i), ec);
+            }
+            fs::remove_all(sandbox / "dest", ec);
+        }
+    }
+
+    nlohmann::json report = {
+        {"context", {
+            {"trace", options.trace_path},
+            {"sources", sources},
+            {"events", events.size()},
+            {"lost_at_capture", reader.lostEvents()},
+            {"unmapped_events", unmapped},
+            {"preexisting_paths", preexisting},
+            {"recorded_seconds", recorded_seconds},
+            {"speed", options.speed},
+            {"hardware_concurrency", std::thread::hardware_concurrency()},
+#ifdef NDEBUG
+            {"build", "release"}
+#else
+            {"build", "debug"}
+#endif
+        }},
+        {"result", result}
+    };
+
+    std::string json = report.dump(2);
+    if (options.out_path.empty()) {
+        std::cout << json << std::endl;
+    } else {
+        std::ofstream out(options.out_path, std::ios::trunc);
+        out << json << std::endl;
+        if (!out) {
+            std::cerr << "无法写入 " << options.out_path << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
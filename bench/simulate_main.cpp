@@ -0,0 +1,612 @@
+// 调度与版本保留的离散事件模拟：模拟时钟 + 内存文件系统，数天的编辑几秒内跑完，同一种子下结果完全相同
+// 用法: codebackup_simulate [--days N] [--files N] [--hot-files N] [--saves-per-hour N] [--workers N]
+//                           [--min-size 字节] [--max-size 字节] [--large-ratio 比例] [--bandwidth MB/s]
+//                           [--compress-ratio 比例] [--lock-rate 概率] [--config config.json] [--seed N] [--out 结果.json]
+// 编辑只发生在工作日 9:00-18:00：每次保存产生 1-3 个修改事件，大部分保存落在少数热点文件上
+// 事件经过与 BackupHandler 相同的防抖、合并和调度规则（SchedulePolicy、TaskScheduler），
+// 备份耗时按文件大小和带宽估算，文件被占用时按同样的退避间隔重试；
+// 每个版本写入内存文件系统，再由真实的 VersionManager 按策略清理
+#include "clock.h"
+#include "config_loader.h"
+#include "file_system.h"
+#include "platform.h"
+#include "task_scheduler.h"
+#include "version_manager.h"
+#include "backup_metrics.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Options {
+    int days = 42;
+    size_t files = 2000;
+    size_t hot_files = 40;
+    double saves_per_hour = 600.0;         // 工作时间内所有文件合计的保存频率
+    int workers = 4;
+    size_t min_size = 512;
+    size_t max_size = 256 * 1024;
+    double large_ratio = 0.01;             // 大文件（进入批量通道）的比例
+    double bandwidth_mbps = 80.0;          // 读源文件 + 写备份的有效带宽
+    double compress_ratio = 0.3;           // 压缩后大小 / 原大小
+    double lock_rate = 0.02;               // 每次尝试时文件仍被占用的概率
+    std::string config_path;
+    uint32_t seed = 1;
+    std::string out_path;
+};
+
+constexpr double HOT_SHARE = 0.8;          // 落在热点文件上的保存比例
+constexpr int WORK_START_HOUR = 9;
+constexpr int WORK_END_HOUR = 18;
+constexpr int64_t PER_FILE_OVERHEAD_US = 2000;    // 每次备份的固定开销（stat、哈希、建目录）
+constexpr double COMPRESS_MBPS = 60.0;            // 压缩吞吐
+
+// ---- 模拟对象 ----
+
+struct SimFile {
+    std::string relative_path;
+    size_t size = 0;
+    int64_t last_backup_ms = 0;
+    PendingState pending = PendingState::NotPending;
+    // 最早一次没有被任何备份覆盖的修改时间（0 表示已全部备份）
+    int64_t unprotected_since_ms = 0;
+};
+
+// 正在执行的备份（任务的路径字段存放文件序号）
+struct InFlight {
+    BackupTask task;
+    int64_t started_ms = 0;
+    int64_t unprotected_since_ms = 0;
+};
+
+enum class EventType { Modify, BackupDone };
+
+struct SimEvent {
+    int64_t time_us;
+    uint64_t seq;                          // 同一时刻按产生顺序处理，保证可复现
+    EventType type;
+    size_t file;
+    int worker;
+    bool success;
+    int retries;
+
+    bool operator>(const SimEvent& other) const {
+        return time_us != other.time_us ? time_us > other.time_us : seq > other.seq;
+    }
+};
+
+struct Stats {
+    uint64_t saves = 0;
+    uint64_t events = 0;
+    uint64_t coalesced = 0;        // 已在队列或正在备份，合并进同一次备份
+    uint64_t debounced = 0;        // 防抖丢弃
+    uint64_t accepted = 0;
+    uint64_t follow_ups = 0;       // 备份期间又被修改，完成后补做
+    uint64_t backups = 0;
+    uint64_t failed = 0;
+    uint64_t retries = 0;
+    uint64_t versions_deleted = 0;
+    uint64_t bytes_written = 0;
+    uint64_t peak_bytes = 0;
+    uint64_t peak_files = 0;
+    int64_t busy_us = 0;
+    LatencyHistogram latency;      // 入队到完成（模拟时间）
+    double max_unprotected_seconds = 0.0;
+    double total_unprotected_seconds = 0.0;
+    uint64_t unprotected_windows = 0;
+};
+
+class Simulation {
+public:
+    Simulation(const Options& options, const BackupStrategy& strategy)
+        : options_(options)
+        , strategy_(strategy)
+        , clock_(startTime())
+        , versions_("dest", strategy, clock_, file_system_)
+        , scheduler_(strategy)
+        , rng_(options.seed)
+        , origin_(clock_.steadyNow()) {
+        makeFiles();
+        in_flight_.resize(options.workers);
+        idle_workers_.reserve(options.workers);
+        for (int i = options.workers - 1; i >= 0; --i) {
+            idle_workers_.push_back(i);
+        }
+    }
+
+    void run() {
+        int64_t end_us = static_cast<int64_t>(options_.days) * 86400 * 1000000LL;
+        scheduleSaves(end_us);
+        int64_t next_sample_us = 0;
+
+        while (!events_.empty()) {
+            SimEvent event = events_.top();
+            events_.pop();
+            while (next_sample_us <= event.time_us) {
+                sample(next_sample_us);
+                next_sample_us += 86400 * 1000000LL;
+            }
+            clock_.advanceTo(origin_ + std::chrono::microseconds(event.time_us));
+            if (event.type == EventType::Modify) {
+                onModify(event.file);
+            } else {
+                onBackupDone(event);
+            }
+            dispatch();
+        }
+        // 未备份的修改一直暴露到模拟结束
+        clock_.advanceTo(origin_ + std::chrono::microseconds(end_us));
+        int64_t end_ms = nowMs();
+        for (auto& file : files_) {
+            if (file.unprotected_since_ms != 0) {
+                noteUnprotected(end_ms - file.unprotected_since_ms);
+                unprotected_at_end_++;
+            }
+        }
+        sample(nowUs());
+    }
+
+    nlohmann::json report() {
+        auto ms = [this](double q) { return stats_.latency.percentile(q) / 1000.0; };
+        double simulated_seconds = clock_.elapsed().count() / 1e9;
+        nlohmann::json classes = nlohmann::json::array();
+        for (const auto& stat : scheduler_.getLatencyStats()) {
+            classes.push_back({
+                {"class", TaskScheduler::className(stat.task_class)},
+                {"completed", stat.completed},
+                {"avg_ms", stat.avg_ms},
+                {"max_ms", stat.max_ms}
+            });
+        }
+
+        // 保留期之外仍在磁盘上的版本：只有再次备份同一文件时才会按天数清理
+        std::vector<fs::path> stored;
+        file_system_.walk("dest", [&](const FileSystemEntry& entry) {
+            if (entry.isRegularFile()) {
+                stored.push_back(entry.path());
+            }
+        });
+        size_t expired_left = 0;
+        uint64_t expired_bytes = 0;
+        auto now = clock_.systemNow();
+        for (const auto& path : stored) {
+            auto info = versions_.parseVersionFile(path);
+            if (info && std::chrono::duration_cast<std::chrono::hours>(now - info->timestamp).count() / 24 >
+                            strategy_.retention_days) {
+                expired_left++;
+                expired_bytes += info->file_size;
+            }
+        }
+
+        return {
+            {"simulated_seconds", simulated_seconds},
+            {"saves", stats_.saves},
+            {"events", stats_.events},
+            {"accepted", stats_.accepted},
+            {"coalesced", stats_.coalesced},
+            {"debounced", stats_.debounced},
+            {"follow_ups", stats_.follow_ups},
+            {"backups", stats_.backups},
+            {"failed", stats_.failed},
+            {"retries", stats_.retries},
+            {"latency_ms", {
+                {"p50", ms(0.50)}, {"p90", ms(0.90)}, {"p99", ms(0.99)},
+                {"max", stats_.latency.maxMicros() / 1000.0}, {"mean", stats_.latency.meanMicros() / 1000.0}
+            }},
+            {"classes", classes},
+            {"worker_utilization", simulated_seconds > 0
+                ? stats_.busy_us / 1e6 / (simulated_seconds * options_.workers) : 0.0},
+            // 防抖丢弃的修改要等到该文件下一次被接受的修改才会备份
+            {"unprotected", {
+                {"windows", stats_.unprotected_windows},
+                {"files_at_end", unprotected_at_end_},
+                {"max_seconds", stats_.max_unprotected_seconds},
+                {"mean_seconds", stats_.unprotected_windows > 0
+                    ? stats_.total_unprotected_seconds / stats_.unprotected_windows : 0.0}
+            }},
+            {"retention", {
+                {"bytes_written", stats_.bytes_written},
+                {"versions_deleted", stats_.versions_deleted},
+                {"peak_bytes", stats_.peak_bytes},
+                {"peak_files", stats_.peak_files},
+                {"final_bytes", file_system_.totalBytes()},
+                {"final_files", file_system_.fileCount()},
+                {"expired_retained_files", expired_left},
+                {"expired_retained_bytes", expired_bytes},
+                {"daily", daily_}
+            }}
+        };
+    }
+
+private:
+    // 从某个周一 0 点开始，前几天正好是工作日
+    static std::chrono::system_clock::time_point startTime() {
+        std::tm tm = {};
+        tm.tm_year = 2025 - 1900;
+        tm.tm_mon = 0;
+        tm.tm_mday = 6;
+        tm.tm_isdst = -1;
+        return std::chrono::system_clock::from_time_t(std::mktime(&tm));
+    }
+
+    int64_t nowMs() const {
+        return clock_.steadyMillis();
+    }
+
+    void makeFiles() {
+        static const char* extensions[] = {".cpp", ".h", ".py", ".md", ".json", ".txt"};
+        std::uniform_real_distribution<double> log_size(std::log(static_cast<double>(options_.min_size)),
+                                                        std::log(static_cast<double>(options_.max_size)));
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        std::uniform_int_distribution<size_t> large_size(strategy_.bulk_file_threshold,
+                                                         strategy_.bulk_file_threshold * 4);
+        files_.resize(options_.files);
+        for (size_t i = 0; i < files_.size(); ++i) {
+            auto& file = files_[i];
+            file.relative_path = "dir" + std::to_string(i % 64) + "/sub" + std::to_string(i % 7) +
+                                 "/file" + std::to_string(i) + extensions[i % 6];
+            file.size = unit(rng_) < options_.large_ratio
+                ? large_size(rng_)
+                : static_cast<size_t>(std::exp(log_size(rng_)));
+        }
+    }
+
+    // 所有保存事件一次生成：工作时间内按泊松过程到达
+    void scheduleSaves(int64_t end_us) {
+        std::exponential_distribution<double> gap_seconds(options_.saves_per_hour / 3600.0);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        std::uniform_int_distribution<size_t> hot(0, std::max<size_t>(1, std::min(options_.hot_files, files_.size())) - 1);
+        std::uniform_int_distribution<size_t> any(0, files_.size() - 1);
+        std::uniform_int_distribution<int> burst(1, 3);
+        std::uniform_int_distribution<int64_t> spacing_us(5000, 50000);
+
+        for (int day = 0; day < options_.days; ++day) {
+            // 1 月 6 日是周一：第 5、6 天是周末
+            if (day % 7 >= 5) {
+                continue;
+            }
+            int64_t day_us = static_cast<int64_t>(day) * 86400 * 1000000LL;
+            int64_t t = day_us + WORK_START_HOUR * 3600LL * 1000000LL;
+            int64_t stop = day_us + WORK_END_HOUR * 3600LL * 1000000LL;
+            while (true) {
+                t += static_cast<int64_t>(gap_seconds(rng_) * 1e6);
+                if (t >= stop || t >= end_us) {
+                    break;
+                }
+                size_t file = unit(rng_) < HOT_SHARE ? hot(rng_) : any(rng_);
+                stats_.saves++;
+                int64_t at = t;
+                for (int i = burst(rng_); i > 0; --i) {
+                    push({at, 0, EventType::Modify, file, -1, false, 0});
+                    at += spacing_us(rng_);
+                }
+            }
+        }
+    }
+
+    void push(SimEvent event) {
+        event.seq = next_seq_++;
+        events_.push(event);
+    }
+
+    // 与 BackupHandler::enqueueBackup 共用 SchedulePolicy::admitModify：已排队或正在备份时只做标记，否则经过防抖后入队
+    void onModify(size_t index) {
+        auto& file = files_[index];
+        int64_t now_ms = nowMs();
+        stats_.events++;
+        if (file.unprotected_since_ms == 0) {
+            file.unprotected_since_ms = now_ms;
+        }
+
+        bool recently_edited = false;
+        switch (SchedulePolicy::admitModify(file.pending, file.last_backup_ms, now_ms,
+                                            strategy_.recent_edit_window_seconds, &recently_edited)) {
+            case SchedulePolicy::ModifyOutcome::Coalesced:
+                stats_.coalesced++;
+                return;
+            case SchedulePolicy::ModifyOutcome::Debounced:
+                stats_.debounced++;
+                return;
+            case SchedulePolicy::ModifyOutcome::Enqueue:
+                break;
+        }
+        stats_.accepted++;
+
+        BackupTask task;
+        task.source_file_path = std::to_string(index);
+        task.enqueue_time = clock_.steadyNow();
+        task.file_size = file.size;
+        task.task_class = scheduler_.classify(file.size, recently_edited);
+        scheduler_.push(std::move(task));
+    }
+
+    void dispatch() {
+        while (!idle_workers_.empty() && scheduler_.hasRunnable()) {
+            auto next = scheduler_.pop(clock_.steadyNow());
+            if (!next) {
+                break;
+            }
+            int worker = idle_workers_.back();
+            idle_workers_.pop_back();
+            size_t index = std::stoul(next->source_file_path);
+            auto& file = files_[index];
+            SchedulePolicy::startBackup(file.pending);
+
+            // 从这一刻起读取的内容包含此前所有修改；备份失败时恢复
+            auto& slot = in_flight_[worker];
+            slot.started_ms = nowMs();
+            slot.unprotected_since_ms = file.unprotected_since_ms;
+            file.unprotected_since_ms = 0;
+
+            // 文件被占用时按 SchedulePolicy 的间隔退避重试
+            std::uniform_real_distribution<double> unit(0.0, 1.0);
+            int64_t duration_us = 0;
+            int retries = 0;
+            bool success = false;
+            for (int attempt = 0; attempt < SchedulePolicy::MAX_RETRIES; ++attempt) {
+                if (unit(rng_) >= options_.lock_rate) {
+                    success = true;
+                    break;
+                }
+                if (attempt < SchedulePolicy::MAX_RETRIES - 1) {
+                    duration_us += SchedulePolicy::retryDelaySeconds(attempt) * 1000000LL;
+                    retries++;
+                }
+            }
+            duration_us += serviceMicros(file);
+            stats_.busy_us += duration_us;
+            slot.task = std::move(*next);
+            push({nowUs() + duration_us, 0, EventType::BackupDone, index, worker, success, retries});
+        }
+    }
+
+    int64_t serviceMicros(const SimFile& file) const {
+        double seconds = file.size / (options_.bandwidth_mbps * 1048576.0);
+        if (compressible(file)) {
+            seconds += file.size / (COMPRESS_MBPS * 1048576.0);
+        }
+        return PER_FILE_OVERHEAD_US + static_cast<int64_t>(seconds * 1e6);
+    }
+
+    bool compressible(const SimFile& file) const {
+        return strategy_.enable_compression && file.size >= strategy_.compression_threshold;
+    }
+
+    int64_t nowUs() const {
+        return std::chrono::duration_cast<std::chrono::microseconds>(clock_.steadyNow() - origin_).count();
+    }
+
+    // 与 BackupHandler::finishPendingTask 共用 SchedulePolicy::finishBackup：备份期间又被修改的文件补做一次
+    void onBackupDone(const SimEvent& event) {
+        auto& file = files_[event.file];
+        auto& slot = in_flight_[event.worker];
+        BackupTask task = std::move(slot.task);
+
+        auto now = clock_.steadyNow();
+        stats_.retries += event.retries;
+        if (event.success) {
+            writeVersion(file);
+            stats_.backups++;
+            if (slot.unprotected_since_ms != 0) {
+                noteUnprotected(slot.started_ms - slot.unprotected_since_ms);
+            }
+        } else {
+            stats_.failed++;
+            if (slot.unprotected_since_ms != 0) {
+                file.unprotected_since_ms = slot.unprotected_since_ms;
+            }
+        }
+        stats_.latency.record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(now - task.enqueue_time).count()));
+        scheduler_.complete(task, now);
+        idle_workers_.push_back(event.worker);
+
+        if (SchedulePolicy::finishBackup(file.pending)) {
+            stats_.follow_ups++;
+            BackupTask follow_up;
+            follow_up.source_file_path = std::move(task.source_file_path);
+            follow_up.enqueue_time = now;
+            follow_up.file_size = file.size;
+            follow_up.task_class = scheduler_.classify(file.size, true);
+            scheduler_.push(std::move(follow_up));
+        }
+    }
+
+    // 与 BackupHandler::backupFile 相同的版本路径：<日期>/<相对目录>/<名称>.<时间戳><扩展名>[.gz]
+    void writeVersion(const SimFile& file) {
+        auto time_t = std::chrono::system_clock::to_time_t(clock_.systemNow());
+        std::tm tm;
+        Platform::localTime(time_t, tm);
+        char timestamp[32];
+        char today_str[32];
+        std::strftime(timestamp, sizeof(timestamp), "%Y%m%d_%H%M%S", &tm);
+        std::strftime(today_str, sizeof(today_str), "%Y-%m-%d", &tm);
+
+        fs::path relative(file.relative_path);
+        bool compressed = compressible(file);
+        uint64_t stored_size = compressed
+            ? static_cast<uint64_t>(file.size * options_.compress_ratio) : file.size;
+        std::string name = relative.stem().string() + "." + timestamp + relative.extension().string() +
+                           (compressed ? ".gz" : "");
+        file_system_.writeFile(fs::path("dest") / today_str / relative.parent_path() / name, stored_size);
+        stats_.bytes_written += stored_size;
+        stats_.versions_deleted += versions_.cleanupOldVersions(file.relative_path);
+
+        stats_.peak_bytes = std::max(stats_.peak_bytes, file_system_.totalBytes());
+        stats_.peak_files = std::max<uint64_t>(stats_.peak_files, file_system_.fileCount());
+    }
+
+    void noteUnprotected(int64_t duration_ms) {
+        double seconds = duration_ms / 1000.0;
+        stats_.unprotected_windows++;
+        stats_.total_unprotected_seconds += seconds;
+        stats_.max_unprotected_seconds = std::max(stats_.max_unprotected_seconds, seconds);
+    }
+
+    // 每天 0 点记录一次备份目录占用
+    void sample(int64_t time_us) {
+        daily_.push_back({
+            {"day", time_us / (86400 * 1000000LL)},
+            {"bytes", file_system_.totalBytes()},
+            {"files", file_system_.fileCount()},
+            {"backups", stats_.backups}
+        });
+    }
+
+    Options options_;
+    BackupStrategy strategy_;
+    SimulatedClock clock_;
+    MemoryFileSystem file_system_;
+    VersionManager versions_;
+    TaskScheduler scheduler_;
+    std::mt19937 rng_;
+    std::chrono::steady_clock::time_point origin_;
+
+    std::vector<SimFile> files_;
+    std::priority_queue<SimEvent, std::vector<SimEvent>, std::greater<SimEvent>> events_;
+    uint64_t next_seq_ = 0;
+    std::vector<int> idle_workers_;
+    std::vector<InFlight> in_flight_;               // 按工作线程编号
+    Stats stats_;
+    size_t unprotected_at_end_ = 0;
+    nlohmann::json daily_ = nlohmann::json::array();
+};
+
+bool parseArgs(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+        const char* v = nullptr;
+        if (arg == "--days" && (v = value())) {
+            options.days = std::clamp(std::atoi(v), 1, 3650);
+        } else if (arg == "--files" && (v = value())) {
+            options.files = std::max<size_t>(1, std::strtoull(v, nullptr, 10));
+        } else if (arg == "--hot-files" && (v = value())) {
+            options.hot_files = std::max<size_t>(1, std::strtoull(v, nullptr, 10));
+        } else if (arg == "--saves-per-hour" && (v = value())) {
+            options.saves_per_hour = std::max(0.01, std::atof(v));
+        } else if (arg == "--workers" && (v = value())) {
+            options.workers = std::max(1, std::atoi(v));
+        } else if (arg == "--min-size" && (v = value())) {
+            options.min_size = std::max<size_t>(1, std::strtoull(v, nullptr, 10));
+        } else if (arg == "--max-size" && (v = value())) {
+            options.max_size = std::max<size_t>(1, std::strtoull(v, nullptr, 10));
+        } else if (arg == "--large-ratio" && (v = value())) {
+            options.large_ratio = std::clamp(std::atof(v), 0.0, 1.0);
+        } else if (arg == "--bandwidth" && (v = value())) {
+            options.bandwidth_mbps = std::max(0.1, std::atof(v));
+        } else if (arg == "--compress-ratio" && (v = value())) {
+            options.compress_ratio = std::clamp(std::atof(v), 0.0, 1.0);
+        } else if (arg == "--lock-rate" && (v = value())) {
+            options.lock_rate = std::clamp(std::atof(v), 0.0, 1.0);
+        } else if (arg == "--config" && (v = value())) {
+            options.config_path = v;
+        } else if (arg == "--seed" && (v = value())) {
+            options.seed = static_cast<uint32_t>(std::strtoul(v, nullptr, 10));
+        } else if (arg == "--out" && (v = value())) {
+            options.out_path = v;
+        } else {
+            std::cerr << "用法: codebackup_simulate [--days N] [--files N] [--hot-files N] [--saves-per-hour N]"
+                         " [--workers N] [--min-size 字节] [--max-size 字节] [--large-ratio 比例] [--bandwidth MB/s]"
+                         " [--compress-ratio 比例] [--lock-rate 概率] [--config config.json] [--seed N]"
+                         " [--out 结果.json]" << std::endl;
+            return false;
+        }
+    }
+    options.max_size = std::max(options.max_size, options.min_size);
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        return 2;
+    }
+
+    BackupStrategy strategy;
+    if (!options.config_path.empty()) {
+        auto config = ConfigLoader::loadConfig(options.config_path);
+        if (!config) {
+            std::cerr << "无法读取配置: " << options.config_path << std::endl;
+            return 1;
+        }
+        strategy = config->strategy;
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    Simulation simulation(options, strategy);
+    simulation.run();
+    double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    nlohmann::json result = simulation.report();
+    result["wall_seconds"] = wall_seconds;
+    result["speedup"] = wall_seconds > 0 ? result["simulated_seconds"].get<double>() / wall_seconds : 0.0;
+
+    const auto& latency = result["latency_ms"];
+    const auto& retention = result["retention"];
+    std::fprintf(stderr, "模拟 %d 天（耗时 %.2f 秒）| %llu 次保存，%llu 次备份，防抖丢弃 %llu | p50 %.1f ms p99 %.1f ms | "
+                 "备份目录峰值 %.1f MB，最终 %.1f MB（%llu 个版本）\n",
+                 options.days, wall_seconds,
+                 static_cast<unsigned long long>(result["saves"].get<uint64_t>()),
+                 static_cast<unsigned long long>(result["backups"].get<uint64_t>()),
+                 static_cast<unsigned long long>(result["debounced"].get<uint64_t>()),
+                 latency["p50"].get<double>(), latency["p99"].get<double>(),
+                 retention["peak_bytes"].get<uint64_t>() / 1048576.0,
+                 retention["final_bytes"].get<uint64_t>() / 1048576.0,
+                 static_cast<unsigned long long>(retention["final_files"].get<uint64_t>()));
+
+    nlohmann::json report = {
+        {"context", {
+            {"days", options.days},
+            {"files", options.files},
+            {"hot_files", options.hot_files},
+            {"saves_per_hour", options.saves_per_hour},
+            {"workers", options.workers},
+            {"size_range", {options.min_size, options.max_size}},
+            {"large_ratio", options.large_ratio},
+            {"bandwidth_mbps", options.bandwidth_mbps},
+            {"compress_ratio", options.compress_ratio},
+            {"lock_rate", options.lock_rate},
+            {"seed", options.seed},
+            {"strategy", {
+                {"debounce_seconds", SchedulePolicy::DEBOUNCE_SECONDS},
+                {"retention_days", strategy.retention_days},
+                {"max_versions_per_file", strategy.max_versions_per_file},
+                {"recent_edit_window_seconds", strategy.recent_edit_window_seconds},
+                {"bulk_max_workers", strategy.bulk_max_workers}
+            }},
+#ifdef NDEBUG
+            {"build", "release"}
+#else
+            {"build", "debug"}
+#endif
+        }},
+        {"result", result}
+    };
+
+    std::string json = report.dump(2);
+    if (options.out_path.empty()) {
+        std::cout << json << std::endl;
+    } else {
+        std::ofstream out(options.out_path, std::ios::trunc);
+        out << json << std::endl;
+        if (!out) {
+            std::cerr << "无法写入 " << options.out_path << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
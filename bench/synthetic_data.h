@@ -0,0 +1,49 @@
+#pragma once
+
+// 基准测试共用的合成数据
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace SyntheticData {
+
+// 类似源代码的可压缩数据：随机挑选的标识符和符号拼成的行
+inline std::vector<uint8_t> makeTextData(size_t size, uint32_t seed) {
+    static const char* const TOKENS[] = {
+        "int ", "return ", "const ", "std::string ", "auto ", "if (", ") {\n", "}\n", "for (", "; ",
+        "value", "index", "buffer", "path", "size_t ", "->", "(", ")", " = ", "0", "1", "nullptr",
+        "    ", "// comment\n", "#include <vector>\n", "logger->info(\"{}\", ", "true", "false"
+    };
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<size_t> pick(0, sizeof(TOKENS) / sizeof(TOKENS[0]) - 1);
+    std::vector<uint8_t> data;
+    data.reserve(size + 64);
+    while (data.size() < size) {
+        const char* token = TOKENS[pick(rng)];
+        data.insert(data.end(), token, token + std::char_traits<char>::length(token));
+    }
+    data.resize(size);
+    return data;
+}
+
+inline std::vector<uint8_t> makeRandomData(size_t size, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> data(size);
+    for (auto& byte : data) {
+        byte = static_cast<uint8_t>(rng());
+    }
+    return data;
+}
+
+inline bool writeFile(const std::filesystem::path& path, const std::vector<uint8_t>& data) {
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    return static_cast<bool>(file);
+}
+
+} // namespace SyntheticData
@@ -0,0 +1,506 @@
+// 端到端合成负载：生成可配置的合成源代码树，按典型编辑模式回放文件事件，经 BackupHandler 完整处理
+// 用法: codebackup_workload [--scenarios 名称,...] [--files N] [--depth N] [--fanout N]
+//                           [--min-size 字节] [--max-size 字节] [--workers N] [--work-dir 目录]
+//                           [--quiet-ms 毫秒] [--timeout 秒] [--seed N] [--log-level 级别] [--out 结果.json] [--keep]
+// 事件直接注入 handleFileAction（不经过文件监控），同一种子下每次运行的编辑序列相同
+// 每个场景使用独立的备份目录和 BackupHandler，报告端到端延迟分位数、吞吐量、CPU 时间、峰值内存和写入字节数
+#include "backup_handler.h"
+#include "logger.h"
+#include "synthetic_data.h"
+#include "platform.h"
+#include "workload_support.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+using namespace WorkloadSupport;
+
+struct Options {
+    std::vector<std::string> scenarios;    // 空表示全部
+    size_t files = 2000;
+    int depth = 3;
+    int fanout = 6;
+    size_t min_size = 512;
+    size_t max_size = 64 * 1024;
+    int workers = 0;                       // 最大工作线程数，0 表示 CPU 核心数
+    std::string work_dir;
+    std::string out_path;
+    int quiet_ms = 0;                      // 0 表示 storm_settle_ms + 2000
+    int timeout_seconds = 300;
+    uint32_t seed = 1;
+    std::string log_level = "warn";        // 逐文件的 info 日志会干扰测量，默认只记录警告
+    bool keep = false;
+};
+
+// ---- 合成源代码树 ----
+
+struct SyntheticTree {
+    fs::path root;
+    std::vector<fs::path> files;
+    std::vector<fs::path> directories;
+    std::vector<uint8_t> text;             // 文件内容从这里截取，避免为每个文件生成数据
+
+    // 用池中随机一段覆盖文件，大小在 [min_size, max_size] 内按对数均匀分布
+    size_t rewrite(const fs::path& path, std::mt19937& rng, size_t min_size, size_t max_size) {
+        std::uniform_real_distribution<double> log_size(std::log(static_cast<double>(min_size)),
+                                                        std::log(static_cast<double>(max_size)));
+        size_t size = std::clamp<size_t>(static_cast<size_t>(std::exp(log_size(rng))), min_size, max_size);
+        std::uniform_int_distribution<size_t> pick_offset(0, text.size() - size);
+        size_t offset = pick_offset(rng);
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(text.data() + offset), static_cast<std::streamsize>(size));
+        return size;
+    }
+
+    void append(const fs::path& path, std::mt19937& rng, size_t bytes) {
+        std::uniform_int_distribution<size_t> pick_offset(0, text.size() - bytes);
+        std::ofstream file(path, std::ios::binary | std::ios::app);
+        file.write(reinterpret_cast<const char*>(text.data() + pick_offset(rng)), static_cast<std::streamsize>(bytes));
+        file << '\n';
+    }
+};
+
+nlohmann::json treeParameters(const Options& options) {
+    return {
+        {"files", options.files}, {"depth", options.depth}, {"fanout", options.fanout},
+        {"min_size", options.min_size}, {"max_size", options.max_size}, {"seed", options.seed}
+    };
+}
+
+// 参数与上次相同时直接复用已生成的树（百万文件的树生成本身就要几分钟）
+SyntheticTree prepareTree(const Options& options, const fs::path& work_dir) {
+    SyntheticTree tree;
+    tree.root = work_dir / "tree";
+    tree.text = SyntheticData::makeTextData(std::max<size_t>(options.max_size * 4, 1048576), options.seed);
+
+    fs::path manifest_path = work_dir / "tree.json";
+    nlohmann::json parameters = treeParameters(options);
+    std::error_code ec;
+    bool reuse = false;
+    if (fs::is_directory(tree.root, ec)) {
+        std::ifstream manifest(manifest_path);
+        if (manifest && nlohmann::json::parse(manifest, nullptr, false) == parameters) {
+            reuse = true;
+        }
+    }
+
+    auto started = SteadyClock::now();
+    if (reuse) {
+        for (fs::recursive_directory_iterator it(tree.root, ec), end; !ec && it != end; it.increment(ec)) {
+            std::error_code entry_ec;
+            if (it->is_directory(entry_ec)) {
+                tree.directories.push_back(it->path());
+            } else if (it->is_regular_file(entry_ec)) {
+                tree.files.push_back(it->path());
+            }
+        }
+        tree.directories.push_back(tree.root);
+        std::sort(tree.files.begin(), tree.files.end());
+        std::sort(tree.directories.begin(), tree.directories.end());
+    } else {
+        fs::remove_all(tree.root, ec);
+        fs::remove(manifest_path, ec);
+
+        // 目录：每层 fanout 个子目录，共 depth 层
+        tree.directories.push_back(tree.root);
+        size_t level_begin = 0;
+        for (int level = 0; level < options.depth; ++level) {
+            size_t level_end = tree.directories.size();
+            for (size_t i = level_begin; i < level_end; ++i) {
+                for (int child = 0; child < options.fanout; ++child) {
+                    tree.directories.push_back(tree.directories[i] / ("dir" + std::to_string(child)));
+                }
+            }
+            level_begin = level_end;
+        }
+        for (const auto& dir : tree.directories) {
+            fs::create_directories(dir, ec);
+        }
+
+        static const char* const EXTENSIONS[] = { ".cpp", ".h", ".py", ".ts", ".json", ".md" };
+        std::mt19937 rng(options.seed);
+        std::uniform_int_distribution<size_t> pick_dir(0, tree.directories.size() - 1);
+        std::uniform_int_distribution<size_t> pick_ext(0, sizeof(EXTENSIONS) / sizeof(EXTENSIONS[0]) - 1);
+        tree.files.reserve(options.files);
+        for (size_t i = 0; i < options.files; ++i) {
+            fs::path path = tree.directories[pick_dir(rng)] / ("module_" + std::to_string(i) + EXTENSIONS[pick_ext(rng)]);
+            tree.rewrite(path, rng, options.min_size, options.max_size);
+            tree.files.push_back(path);
+            if ((i + 1) % 100000 == 0) {
+                std::fprintf(stderr, "生成合成树: %zu / %zu\n", i + 1, options.files);
+            }
+        }
+        std::ofstream(manifest_path) << parameters.dump();
+    }
+
+    std::fprintf(stderr, "合成树%s: %zu 个文件，%zu 个目录，%.1f 秒\n", reuse ? "（复用）" : "",
+                 tree.files.size(), tree.directories.size(),
+                 std::chrono::duration<double>(SteadyClock::now() - started).count());
+    return tree;
+}
+
+// ---- 场景 ----
+
+struct ScenarioContext {
+    const Options& options;
+    SyntheticTree& tree;
+    BackupHandler& handler;
+    Replay& replay;
+    std::mt19937 rng;
+    int quiet_ms;
+    std::vector<size_t> selected;          // 准备阶段选出的文件，测量阶段沿用
+
+    void emit(const fs::path& file, efsw::Action action, const fs::path* old_file = nullptr) {
+        replay.emit(handler, file, action, old_file);
+    }
+
+    std::vector<size_t> sample(size_t count) {
+        std::vector<size_t> indices(tree.files.size());
+        for (size_t i = 0; i < indices.size(); ++i) {
+            indices[i] = i;
+        }
+        std::shuffle(indices.begin(), indices.end(), rng);
+        indices.resize(std::min(count, indices.size()));
+        return indices;
+    }
+
+    // 基线：把整棵树（或部分文件）备份一遍，并等过防抖时间，测量阶段的修改不会被防抖跳过
+    void backupBaseline(const std::vector<size_t>& indices) {
+        for (size_t index : indices) {
+            emit(tree.files[index], efsw::Actions::Add);
+        }
+        replay.waitSettled(quiet_ms, options.timeout_seconds);
+        std::this_thread::sleep_for(std::chrono::seconds(BackupHandler::DEBOUNCE_SECONDS + 1));
+    }
+
+    std::vector<size_t> allFiles() {
+        std::vector<size_t> indices(tree.files.size());
+        for (size_t i = 0; i < indices.size(); ++i) {
+            indices[i] = i;
+        }
+        return indices;
+    }
+};
+
+struct Scenario {
+    const char* name;
+    const char* description;
+    std::function<void(ScenarioContext&)> prepare;   // 不计入结果，可为空
+    std::function<void(ScenarioContext&)> run;
+};
+
+const std::vector<Scenario>& scenarios() {
+    static const std::vector<Scenario> all = {
+        {
+            "initial_import",
+            "整棵树的每个文件各产生一个新建事件（首次备份、克隆仓库）",
+            nullptr,
+            [](ScenarioContext& ctx) {
+                for (const auto& file : ctx.tree.files) {
+                    ctx.emit(file, efsw::Actions::Add);
+                }
+            }
+        },
+        {
+            "bursty_saves",
+            "32 个热点文件，每秒一轮保存，每次保存产生 3 个修改事件，共 5 轮（编辑器反复保存）",
+            nullptr,
+            [](ScenarioContext& ctx) {
+                auto hot = ctx.sample(32);
+                for (int round = 0; round < 5; ++round) {
+                    auto round_start = SteadyClock::now();
+                    for (size_t index : hot) {
+                        const fs::path& file = ctx.tree.files[index];
+                        ctx.tree.rewrite(file, ctx.rng, ctx.options.min_size, ctx.options.max_size);
+                        for (int i = 0; i < 3; ++i) {
+                            ctx.emit(file, efsw::Actions::Modified);
+                        }
+                    }
+                    std::this_thread::sleep_until(round_start + std::chrono::seconds(1));
+                }
+            }
+        },
+        {
+            "appends",
+            "16 个日志文件，12 秒内每 100 毫秒向其中 4 个各追加一行（持续增长的文件）",
+            [](ScenarioContext& ctx) {
+                fs::path log_dir = ctx.tree.root / "logs";
+                std::error_code ec;
+                fs::create_directories(log_dir, ec);
+                for (int i = 0; i < 16; ++i) {
+                    std::ofstream(log_dir / ("build_" + std::to_string(i) + ".log"), std::ios::trunc);
+                }
+            },
+            [](ScenarioContext& ctx) {
+                fs::path log_dir = ctx.tree.root / "logs";
+                std::uniform_int_distribution<int> pick(0, 15);
+                for (int tick = 0; tick < 120; ++tick) {
+                    auto tick_start = SteadyClock::now();
+                    for (int i = 0; i < 4; ++i) {
+                        fs::path file = log_dir / ("build_" + std::to_string(pick(ctx.rng)) + ".log");
+                        ctx.tree.append(file, ctx.rng, 256);
+                        ctx.emit(file, efsw::Actions::Modified);
+                    }
+                    std::this_thread::sleep_until(tick_start + std::chrono::milliseconds(100));
+                }
+            }
+        },
+        {
+            "renames",
+            "256 个已备份且内容未变的文件改名（重构、移动文件）",
+            [](ScenarioContext& ctx) {
+                ctx.selected = ctx.sample(256);
+                ctx.backupBaseline(ctx.selected);
+            },
+            [](ScenarioContext& ctx) {
+                for (size_t index : ctx.selected) {
+                    fs::path old_file = ctx.tree.files[index];
+                    fs::path new_file = old_file.parent_path() /
+                        (old_file.stem().string() + "_renamed" + old_file.extension().string());
+                    std::error_code ec;
+                    fs::rename(old_file, new_file, ec);
+                    if (ec) {
+                        continue;
+                    }
+                    ctx.tree.files[index] = new_file;
+                    ctx.emit(new_file, efsw::Actions::Moved, &old_file);
+                }
+            }
+        },
+        {
+            "mass_rewrite",
+            "一次性重写一半文件、删除 5%、新建 5%（切换分支、批量格式化）",
+            [](ScenarioContext& ctx) {
+                ctx.backupBaseline(ctx.allFiles());
+            },
+            [](ScenarioContext& ctx) {
+                size_t total = ctx.tree.files.size();
+                auto targets = ctx.sample(total / 2 + total / 20);
+                size_t rewrites = std::min(total / 2, targets.size());
+                for (size_t i = 0; i < targets.size(); ++i) {
+                    const fs::path& file = ctx.tree.files[targets[i]];
+                    if (i < rewrites) {
+                        ctx.tree.rewrite(file, ctx.rng, ctx.options.min_size, ctx.options.max_size);
+                        ctx.emit(file, efsw::Actions::Modified);
+                    } else {
+                        std::error_code ec;
+                        fs::remove(file, ec);
+                        ctx.emit(file, efsw::Actions::Delete);
+                    }
+                }
+                // 删除的路径换成新文件，保持树的规模
+                std::uniform_int_distribution<size_t> pick_dir(0, ctx.tree.directories.size() - 1);
+                for (size_t i = rewrites; i < targets.size(); ++i) {
+                    fs::path file = ctx.tree.directories[pick_dir(ctx.rng)] /
+                        ("branch_" + std::to_string(ctx.rng()) + ".cpp");
+                    ctx.tree.rewrite(file, ctx.rng, ctx.options.min_size, ctx.options.max_size);
+                    ctx.tree.files[targets[i]] = file;
+                    ctx.emit(file, efsw::Actions::Add);
+                }
+            }
+        }
+    };
+    return all;
+}
+
+nlohmann::json runScenario(const Scenario& scenario, const Options& options, SyntheticTree& tree,
+                           const fs::path& work_dir) {
+    fs::path dest = work_dir / "dest" / scenario.name;
+    std::error_code ec;
+    fs::remove_all(dest, ec);
+    fs::create_directories(dest, ec);
+
+    BackupStrategy strategy;
+    strategy.reconcile_on_startup = false;
+    int quiet_ms = options.quiet_ms > 0 ? options.quiet_ms : strategy.storm_settle_ms + 2000;
+
+    BackupHandler handler(tree.root.string(), dest.string(), nullptr, strategy);
+    Replay replay;
+    replay.attach(handler);
+    handler.startAsyncBackup(1, options.workers);
+
+    ScenarioContext ctx{options, tree, handler, replay,
+                        std::mt19937(options.seed ^ static_cast<uint32_t>(std::hash<std::string>()(scenario.name))),
+                        quiet_ms, {}};
+    if (scenario.prepare) {
+        std::fprintf(stderr, "[%s] 准备基线...\n", scenario.name);
+        scenario.prepare(ctx);
+    }
+
+    // 测量阶段
+    replay.reset();
+    Measurement measurement({&handler}, {dest});
+    measurement.start();
+
+    std::fprintf(stderr, "[%s] 回放中...\n", scenario.name);
+    auto started = SteadyClock::now();
+    scenario.run(ctx);
+    double replay_seconds = std::chrono::duration<double>(SteadyClock::now() - started).count();
+    replay.waitSettled(quiet_ms, options.timeout_seconds);
+    measurement.stop();
+    handler.stopAsyncBackup();
+
+    nlohmann::json result = replay.report(measurement.elapsedSeconds());
+    result.update(measurement.report(result["active_seconds"].get<double>()));
+    result["name"] = scenario.name;
+    result["description"] = scenario.description;
+    result["replay_seconds"] = replay_seconds;
+    printSummary(scenario.name, result);
+    return result;
+}
+
+std::vector<std::string> splitList(const std::string& value) {
+    std::vector<std::string> items;
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+bool parseArgs(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+        const char* v = nullptr;
+        if (arg == "--scenarios" && (v = value())) {
+            options.scenarios = splitList(v);
+        } else if (arg == "--files" && (v = value())) {
+            options.files = std::max<size_t>(1, std::strtoull(v, nullptr, 10));
+        } else if (arg == "--depth" && (v = value())) {
+            options.depth = std::clamp(std::atoi(v), 0, 16);
+        } else if (arg == "--fanout" && (v = value())) {
+            options.fanout = std::clamp(std::atoi(v), 1, 64);
+        } else if (arg == "--min-size" && (v = value())) {
+            options.min_size = std::max<size_t>(1, std::strtoull(v, nullptr, 10));
+        } else if (arg == "--max-size" && (v = value())) {
+            options.max_size = std::max<size_t>(1, std::strtoull(v, nullptr, 10));
+        } else if (arg == "--workers" && (v = value())) {
+            options.workers = std::max(0, std::atoi(v));
+        } else if (arg == "--work-dir" && (v = value())) {
+            options.work_dir = v;
+        } else if (arg == "--quiet-ms" && (v = value())) {
+            options.quiet_ms = std::max(0, std::atoi(v));
+        } else if (arg == "--timeout" && (v = value())) {
+            options.timeout_seconds = std::max(1, std::atoi(v));
+        } else if (arg == "--seed" && (v = value())) {
+            options.seed = static_cast<uint32_t>(std::strtoul(v, nullptr, 10));
+        } else if (arg == "--log-level" && (v = value())) {
+            options.log_level = v;
+        } else if (arg == "--out" && (v = value())) {
+            options.out_path = v;
+        } else if (arg == "--keep") {
+            options.keep = true;
+        } else {
+            std::cerr << "用法: codebackup_workload [--scenarios 名称,...] [--files N] [--depth N] [--fanout N]"
+                         " [--min-size 字节] [--max-size 字节] [--workers N] [--work-dir 目录]"
+                         " [--quiet-ms 毫秒] [--timeout 秒] [--seed N] [--log-level 级别] [--out 结果.json] [--keep]\n场景:";
+            for (const auto& scenario : scenarios()) {
+                std::cerr << "\n  " << scenario.name << "  " << scenario.description;
+            }
+            std::cerr << std::endl;
+            return false;
+        }
+    }
+    options.max_size = std::max(options.max_size, options.min_size);
+    for (const auto& name : options.scenarios) {
+        bool known = std::any_of(scenarios().begin(), scenarios().end(),
+                                 [&](const Scenario& scenario) { return name == scenario.name; });
+        if (!known) {
+            std::cerr << "未知场景: " << name << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        return 2;
+    }
+
+    // 指定了 --work-dir 时保留合成树供下次复用，否则用临时目录并在结束后删除
+    bool temporary = options.work_dir.empty();
+    fs::path work_dir = temporary
+        ? fs::temp_directory_path() / ("codebackup_workload_" + std::to_string(std::time(nullptr)))
+        : fs::path(options.work_dir);
+    std::error_code ec;
+    fs::create_directories(work_dir, ec);
+
+    // 日志写到工作目录（不在合成树内）
+    LogOptions log_options;
+    log_options.level = spdlog::level::from_str(options.log_level);
+    Logger::setup((work_dir / "logs").string(), false, log_options);
+
+    SyntheticTree tree = prepareTree(options, work_dir);
+
+    nlohmann::json results = nlohmann::json::array();
+    for (const auto& scenario : scenarios()) {
+        if (!options.scenarios.empty() &&
+            std::find(options.scenarios.begin(), options.scenarios.end(), scenario.name) == options.scenarios.end()) {
+            continue;
+        }
+        results.push_back(runScenario(scenario, options, tree, work_dir));
+    }
+
+    Logger::shutdown();
+    if (!options.keep) {
+        fs::remove_all(temporary ? work_dir : work_dir / "dest", ec);
+    }
+
+    std::time_t now = std::time(nullptr);
+    std::tm tm;
+    Platform::localTime(now, tm);
+    char date[32];
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", &tm);
+
+    nlohmann::json report = {
+        {"context", {
+            {"date", date},
+            {"hardware_concurrency", std::thread::hardware_concurrency()},
+            {"max_workers", options.workers},
+            {"tree", treeParameters(options)},
+#ifdef NDEBUG
+            {"build", "release"}
+#else
+            {"build", "debug"}
+#endif
+        }},
+        {"scenarios", results}
+    };
+
+    std::string json = report.dump(2);
+    if (options.out_path.empty()) {
+        std::cout << json << std::endl;
+    } else {
+        std::ofstream out(options.out_path, std::ios::trunc);
+        out << json << std::endl;
+        if (!out) {
+            std::cerr << "无法写入 " << options.out_path << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
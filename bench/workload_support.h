@@ -0,0 +1,412 @@
+#pragma once
+
+// 端到端负载回放共用的部分：事件注入与端到端延迟、进程资源统计（codebackup_workload、codebackup_replay）
+#include "backup_handler.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+namespace WorkloadSupport {
+
+namespace fs = std::filesystem;
+using SteadyClock = std::chrono::steady_clock;
+
+// ---- 进程资源统计 ----
+
+struct ResourceUsage {
+    double user_seconds = 0.0;
+    double system_seconds = 0.0;
+    double thread_seconds = 0.0;           // 调用线程（回放线程）自身的 CPU 时间
+    uint64_t peak_rss_bytes = 0;
+};
+
+#ifdef _WIN32
+inline double fileTimeSeconds(const FILETIME& time) {
+    ULARGE_INTEGER value;
+    value.LowPart = time.dwLowDateTime;
+    value.HighPart = time.dwHighDateTime;
+    return value.QuadPart / 1e7;
+}
+#endif
+
+inline ResourceUsage readUsage() {
+    ResourceUsage usage;
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+        usage.user_seconds = fileTimeSeconds(user);
+        usage.system_seconds = fileTimeSeconds(kernel);
+    }
+    if (GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+        usage.thread_seconds = fileTimeSeconds(user) + fileTimeSeconds(kernel);
+    }
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        usage.peak_rss_bytes = counters.PeakWorkingSetSize;
+    }
+#else
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+        usage.user_seconds = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6;
+        usage.system_seconds = ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+#ifdef __APPLE__
+        usage.peak_rss_bytes = static_cast<uint64_t>(ru.ru_maxrss);
+#else
+        usage.peak_rss_bytes = static_cast<uint64_t>(ru.ru_maxrss) * 1024;
+#endif
+    }
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+        usage.thread_seconds = ts.tv_sec + ts.tv_nsec / 1e9;
+    }
+#ifdef __linux__
+    // VmHWM 可以按场景清零，优先使用
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            usage.peak_rss_bytes = std::strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+            break;
+        }
+    }
+#endif
+#endif
+    return usage;
+}
+
+// 把峰值内存清零为当前值（只有 Linux 支持），不支持时峰值是进程启动以来的值
+inline bool resetPeakRss() {
+#ifdef __linux__
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5";
+    clear_refs.flush();
+    return static_cast<bool>(clear_refs);
+#else
+    return false;
+#endif
+}
+
+// 目录下所有文件的大小；硬链接按链接数均摊，同一份内容只计一次
+inline uint64_t directoryBytes(const fs::path& dir) {
+    double total = 0.0;
+    std::error_code ec;
+    for (fs::recursive_directory_iterator it(dir, fs::directory_options::skip_permission_denied, ec), end;
+         !ec && it != end; it.increment(ec)) {
+        std::error_code entry_ec;
+        if (!it->is_regular_file(entry_ec)) {
+            continue;
+        }
+        uint64_t size = it->file_size(entry_ec);
+        if (entry_ec) {
+            continue;
+        }
+        uintmax_t links = fs::hard_link_count(it->path(), entry_ec);
+        total += entry_ec || links <= 1 ? size : static_cast<double>(size) / links;
+    }
+    return static_cast<uint64_t>(std::llround(total));
+}
+
+// ---- 事件回放与端到端延迟 ----
+
+// 端到端延迟：事件注入到第一个覆盖它的备份完成（开始读取源文件晚于事件）为止
+// 防抖或风暴吸收后始终没有被备份覆盖的事件计为未完成
+class Replay {
+public:
+    // 多个备份源可以共用一个回放统计（路径不重叠）
+    void attach(BackupHandler& handler) {
+        handler.setBackupObserver([this](const std::string& path, bool written, SteadyClock::time_point started) {
+            onBackup(path, written, started);
+        });
+    }
+
+    // 删除事件只清除该路径上未完成的事件，不等待备份；track 为 false 时（目录、被过滤的文件）也不等待
+    void emit(BackupHandler& handler, const fs::path& file, efsw::Action action,
+              const fs::path* old_file = nullptr, bool track = true) {
+        std::string dir = file.parent_path().string();
+        dir.push_back(static_cast<char>(fs::path::preferred_separator));
+        std::string old_name = old_file ? old_file->filename().string() : std::string();
+        auto now = SteadyClock::now();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            noteEvent(now);
+            if (old_file) {
+                dropPending(key(*old_file));
+            }
+            if (action == efsw::Actions::Delete) {
+                dropPending(key(file));
+            } else if (track) {
+                pending_[key(file)].push_back(now);
+                pending_events_++;
+            }
+        }
+        handler.handleFileAction(1, dir, file.filename().string(), action, old_name);
+    }
+
+    // 监控后端要求重新扫描（不跟踪延迟）
+    void rescan(BackupHandler& handler, const fs::path& dir) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            noteEvent(SteadyClock::now());
+        }
+        handler.handleRescan(dir.string());
+    }
+
+    // 所有事件都完成，或 quiet_ms 内既没有新事件也没有备份完成，或超时
+    void waitSettled(int quiet_ms, int timeout_seconds) {
+        auto deadline = SteadyClock::now() + std::chrono::seconds(timeout_seconds);
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (pending_events_ > 0) {
+            auto now = SteadyClock::now();
+            if (now >= deadline || now - last_activity_ >= std::chrono::milliseconds(quiet_ms)) {
+                break;
+            }
+            cv_.wait_for(lock, std::chrono::milliseconds(100));
+        }
+    }
+
+    // 基线阶段结束后清空，只统计测量阶段
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.clear();
+        pending_events_ = 0;
+        latency_ = LatencyHistogram();
+        events_ = 0;
+        served_events_ = 0;
+        completions_ = 0;
+        written_ = 0;
+        untracked_completions_ = 0;
+        last_completion_ = SteadyClock::time_point();
+    }
+
+    nlohmann::json report(double seconds) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto ms = [this](double q) { return latency_.percentile(q) / 1000.0; };
+        double busy = last_completion_ > first_event_ && served_events_ > 0
+            ? std::chrono::duration<double>(last_completion_ - first_event_).count() : seconds;
+        return {
+            {"events", events_},
+            {"served_events", served_events_},
+            {"unserved_events", pending_events_},
+            {"unserved_files", pending_.size()},
+            {"backups_completed", completions_},
+            {"backups_written", written_},
+            {"untracked_backups", untracked_completions_},
+            {"latency_ms", {
+                {"p50", ms(0.50)}, {"p90", ms(0.90)}, {"p99", ms(0.99)},
+                {"max", latency_.maxMicros() / 1000.0}, {"mean", latency_.meanMicros() / 1000.0}
+            }},
+            {"active_seconds", busy},
+            {"events_per_second", busy > 0 ? served_events_ / busy : 0.0},
+            {"backups_per_second", busy > 0 ? completions_ / busy : 0.0}
+        };
+    }
+
+private:
+    void noteEvent(SteadyClock::time_point now) {
+        if (events_ == 0) {
+            first_event_ = now;
+        }
+        events_++;
+        last_activity_ = now;
+    }
+
+    static std::string key(const fs::path& path) {
+        return path.lexically_normal().generic_string();
+    }
+
+    void dropPending(const std::string& path_key) {
+        auto it = pending_.find(path_key);
+        if (it != pending_.end()) {
+            pending_events_ -= it->second.size();
+            pending_.erase(it);
+        }
+    }
+
+    void onBackup(const std::string& path, bool written, SteadyClock::time_point started) {
+        auto now = SteadyClock::now();
+        std::lock_guard<std::mutex> lock(mutex_);
+        completions_++;
+        written_ += written ? 1 : 0;
+        last_completion_ = now;
+        last_activity_ = now;
+
+        auto it = pending_.find(key(fs::path(path)));
+        if (it == pending_.end()) {
+            untracked_completions_++;
+            return;
+        }
+        // 开始读取源文件之前发生的事件都已被这次备份覆盖
+        auto& times = it->second;
+        auto covered_end = std::upper_bound(times.begin(), times.end(), started);
+        if (covered_end == times.begin()) {
+            untracked_completions_++;
+            return;
+        }
+        for (auto t = times.begin(); t != covered_end; ++t) {
+            latency_.record(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(now - *t).count()));
+        }
+        size_t covered = static_cast<size_t>(covered_end - times.begin());
+        served_events_ += covered;
+        pending_events_ -= covered;
+        times.erase(times.begin(), covered_end);
+        if (times.empty()) {
+            pending_.erase(it);
+        }
+        cv_.notify_all();
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::unordered_map<std::string, std::vector<SteadyClock::time_point>> pending_;
+    size_t pending_events_ = 0;
+    LatencyHistogram latency_;
+    uint64_t events_ = 0;
+    uint64_t served_events_ = 0;
+    uint64_t completions_ = 0;
+    uint64_t written_ = 0;
+    uint64_t untracked_completions_ = 0;     // 与注入事件无关的备份（如风暴后的对账扫描）
+    SteadyClock::time_point first_event_;
+    SteadyClock::time_point last_completion_;
+    SteadyClock::time_point last_activity_;
+};
+
+
+// 测量区间内的进程资源、处理器计数和备份目录增量（多个备份源时合计）
+class Measurement {
+public:
+    Measurement(std::vector<const BackupHandler*> handlers, std::vector<fs::path> dest_dirs)
+        : handlers_(std::move(handlers)), dest_dirs_(std::move(dest_dirs)) {}
+
+    // 峰值内存清零（只有 Linux 支持），记录起点
+    void start() {
+        peak_reset_ = resetPeakRss();
+        dest_before_ = destBytes();
+        before_ = readCounters();
+        usage_before_ = readUsage();
+        started_ = SteadyClock::now();
+    }
+
+    // 事件处理完、停止处理器之前调用
+    void stop() {
+        elapsed_ = std::chrono::duration<double>(SteadyClock::now() - started_).count();
+        usage_after_ = readUsage();
+        after_ = readCounters();
+    }
+
+    double elapsedSeconds() const { return elapsed_; }
+
+    // 处理器停止后调用（备份目录已写完）；active_seconds 为第一个事件到最后一次备份完成的时间
+    nlohmann::json report(double active_seconds) const {
+        uint64_t dest_after = destBytes();
+        double user = usage_after_.user_seconds - usage_before_.user_seconds;
+        double system = usage_after_.system_seconds - usage_before_.system_seconds;
+        double replay_thread = usage_after_.thread_seconds - usage_before_.thread_seconds;
+        uint64_t source_bytes = after_.source_bytes - before_.source_bytes;
+        return {
+            {"elapsed_seconds", elapsed_},
+            {"files_written", after_.files - before_.files},
+            {"source_bytes_backed_up", source_bytes},
+            {"source_bytes_per_second", active_seconds > 0 ? source_bytes / active_seconds : 0.0},
+            {"bytes_written", dest_after > dest_before_ ? dest_after - dest_before_ : 0},
+            {"cpu_seconds", {
+                {"user", user},
+                {"system", system},
+                {"total", user + system},
+                {"replay_thread", replay_thread},
+                {"backup", std::max(0.0, user + system - replay_thread)}
+            }},
+            {"peak_rss_bytes", usage_after_.peak_rss_bytes},
+            {"peak_rss_scope", peak_reset_ ? "scenario" : "process"},
+            {"handler", {
+                {"backups", after_.backups - before_.backups},
+                {"skipped", after_.skipped - before_.skipped},
+                {"failed", after_.failed - before_.failed},
+                {"aliased", after_.aliased - before_.aliased},
+                {"compressed", after_.compressed - before_.compressed}
+            }}
+        };
+    }
+
+private:
+    struct Counters {
+        uint64_t files = 0;
+        uint64_t source_bytes = 0;
+        size_t backups = 0;
+        size_t skipped = 0;
+        size_t failed = 0;
+        size_t aliased = 0;
+        size_t compressed = 0;
+    };
+
+    Counters readCounters() const {
+        Counters counters;
+        for (const BackupHandler* handler : handlers_) {
+            MetricsSnapshot metrics = handler->getMetrics();
+            counters.files += metrics.files;
+            counters.source_bytes += metrics.bytes;
+            counters.backups += handler->getTotalBackups();
+            counters.skipped += handler->getSkippedBackups();
+            counters.failed += handler->getFailedBackups();
+            counters.aliased += handler->getAliasedBackups();
+            counters.compressed += handler->getCompressedBackups();
+        }
+        return counters;
+    }
+
+    uint64_t destBytes() const {
+        uint64_t total = 0;
+        for (const auto& dir : dest_dirs_) {
+            total += directoryBytes(dir);
+        }
+        return total;
+    }
+
+    std::vector<const BackupHandler*> handlers_;
+    std::vector<fs::path> dest_dirs_;
+    bool peak_reset_ = false;
+    uint64_t dest_before_ = 0;
+    Counters before_;
+    Counters after_;
+    ResourceUsage usage_before_;
+    ResourceUsage usage_after_;
+    SteadyClock::time_point started_;
+    double elapsed_ = 0.0;
+};
+
+// 控制台摘要：事件完成数、延迟分位数、吞吐量、CPU、峰值内存和写入量
+inline void printSummary(const std::string& label, const nlohmann::json& result) {
+    const auto& latency = result["latency_ms"];
+    std::fprintf(stderr, "[%s] %llu/%llu 个事件完成 | p50 %.1f ms p99 %.1f ms max %.1f ms | %.1f 事件/秒 | "
+                 "CPU %.2f s | 峰值内存 %.1f MB | 写入 %.2f MB\n",
+                 label.c_str(),
+                 static_cast<unsigned long long>(result["served_events"].get<uint64_t>()),
+                 static_cast<unsigned long long>(result["events"].get<uint64_t>()),
+                 latency["p50"].get<double>(), latency["p99"].get<double>(), latency["max"].get<double>(),
+                 result["events_per_second"].get<double>(), result["cpu_seconds"]["total"].get<double>(),
+                 result["peak_rss_bytes"].get<uint64_t>() / 1048576.0,
+                 result["bytes_written"].get<uint64_t>() / 1048576.0);
+}
+
+} // namespace WorkloadSupport
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+// 堆分配计数（调试用）
+// 以 CODEBACKUP_COUNT_ALLOCATIONS 编译时替换全局 operator new，按线程累计分配次数；
+// 未启用时不替换任何东西，计数恒为 0
+namespace AllocCounter {
+
+bool enabled();
+
+// 当前线程累计的分配次数（取两次之差得到一段代码的分配次数）
+uint64_t threadAllocations();
+
+// 所有线程累计的分配次数
+uint64_t totalAllocations();
+
+} // namespace AllocCounter
@@ -1,18 +1,35 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 #include <unordered_map>
 #include <chrono>
 #include <mutex>
-#include <queue>
 #include <thread>
 #include <condition_variable>
 #include <atomic>
+#include <functional>
 #include <efsw/efsw.hpp>
 #include "backup_strategy.h"
 #include "version_manager.h"
+#include "version_catalog.h"
+#include "task_scheduler.h"
+#include "clock.h"
+#include "worker_budget.h"
+#include "event_ring.h"
+#include "storm_detector.h"
+#include "filter_matcher.h"
+#include "ignore_rules.h"
+#include "watch_backend.h"
+#include "file_state_table.h"
+#include "parallel_scanner.h"
+#include "path_buffer.h"
+#include "backup_metrics.h"
+#include <filesystem>
+
+class EventTraceWriter;
 
 struct FilterConfig {
     enum class Mode { None, Whitelist, Blacklist };
@@ -23,24 +40,24 @@ struct FilterConfig {
     std::vector<std::string> whitelist_extensions;  // 白名单扩展名
     std::vector<std::string> blacklist_extensions;  // 黑名单扩展名
     
+    // 排除规则（glob）：以 / 结尾表示目录，如 node_modules/、.git/、*.min.js、docs/**/*.tmp
+    std::vector<std::string> exclude_patterns;
+    
     // 判断是否使用新的双列表模式
     bool useDualMode() const {
         return !whitelist_extensions.empty() || !blacklist_extensions.empty();
     }
 };
 
-// 备份任务结构
-struct BackupTask {
-    std::string source_file_path;
-    std::chrono::steady_clock::time_point enqueue_time;
-};
-
-class BackupHandler : public efsw::FileWatchListener {
+class BackupHandler : public efsw::FileWatchListener, public RescanListener {
 public:
+    // filter_matcher 由 ConfigLoader::compileFilters 编译，与预览和扫描共用同一份规则；为空时不过滤
+    // clock 用于防抖、调度延迟、阶段计时、重试等待和版本保留（默认真实时钟）
     BackupHandler(const std::string& source_path, 
                   const std::string& dest_base_path,
-                  const FilterConfig& filter_config = FilterConfig(),
-                  const BackupStrategy& strategy = BackupStrategy());
+                  std::shared_ptr<const FilterMatcher> filter_matcher = nullptr,
+                  const BackupStrategy& strategy = BackupStrategy(),
+                  Clock& clock = Clock::system());
     
     ~BackupHandler();
 
@@ -48,10 +65,29 @@ public:
                          const std::string& filename, efsw::Action action,
                          std::string oldFilename) override;
     
+    // 注册监控：没有目录排除规则时递归监控整个源；
+    // 否则只为未被排除的目录逐个注册非递归监控，新建目录出现时自动补上
+    bool attachWatcher(WatchBackend& watcher);
+    
+    // 监控后端丢失事件时调用：对 dir 所在子树做一次快照扫描
+    void handleRescan(const std::string& dir) override;
+    
+    // 把收到的原始事件（含重新扫描请求）写入事件记录，须在 attachWatcher 之前设置
+    void setEventRecorder(EventTraceWriter* recorder);
+    
+    // 当前注册的监控数量
+    size_t getWatchCount();
+    
     // 启动和停止异步备份队列
-    void startAsyncBackup(int num_threads = 2);
+    // 工作线程数在 [min_threads, max_threads] 之间根据负载自动伸缩（max_threads 为 0 表示 CPU 核心数）
+    void startAsyncBackup(int min_threads = 1, int max_threads = 0);
     void stopAsyncBackup();
     
+    // 当前工作线程数
+    int getWorkerCount();
+    
+    const std::string& getSourcePath() const { return source_path_; }
+    
     // 获取统计信息
     size_t getTotalBackups() const { return total_backups_.load(); }
     size_t getTotalBytes() const { return total_bytes_.load(); }
@@ -59,42 +95,180 @@ public:
     size_t getSkippedBackups() const { return skipped_backups_.load(); }
     size_t getCompressedBackups() const { return compressed_backups_.load(); }
     size_t getIncrementalBackups() const { return incremental_backups_.load(); }
+    size_t getAliasedBackups() const { return aliased_backups_.load(); }
+    
+    // 堆分配统计（仅以 CODEBACKUP_COUNT_ALLOCATIONS 编译时有数据）
+    struct AllocationStats {
+        uint64_t events = 0;               // 摄取的原始事件数
+        uint64_t event_allocations = 0;    // 摄取线程处理这些事件时的分配次数
+        uint64_t tasks = 0;                // 执行的备份任务数
+        uint64_t task_allocations = 0;
+        uint64_t written = 0;              // 写入了新版本（复制、压缩或链接）的任务数
+        uint64_t written_allocations = 0;
+    };
+    AllocationStats getAllocationStats() const;
+    
+    // 各阶段（排队、哈希、压缩、写入、清理）的延迟直方图和吞吐量
+    MetricsSnapshot getMetrics() const { return metrics_.snapshot(); }
+    
+    // 任务完成回调（在工作线程上调用，基准测试和外部工具用来测量端到端延迟）
+    // started 为开始读取源文件的时刻，此前对该文件的修改都已包含在这次备份中；
+    // written 表示写入了新版本（内容未变或失败时为 false）。移动只记录别名时也会调用（written 为 true）
+    // 须在 startAsyncBackup 之前设置
+    using BackupObserver = std::function<void(const std::string& source_file_path, bool written,
+                                              std::chrono::steady_clock::time_point started)>;
+    void setBackupObserver(BackupObserver observer) { backup_observer_ = std::move(observer); }
+    
+    // 获取各调度类别的延迟统计（入队到完成）
+    std::array<ClassLatencyStats, TaskScheduler::NUM_CLASSES> getSchedulerStats();
     
     // 清理过期版本
     size_t cleanupOldVersions();
+    
+    // 文件是否通过扩展名过滤、排除规则和 .backupignore（不访问文件系统）
+    bool isAllowed(const std::string& file_path) const;
+    
+    // 按策略该文件的备份是否压缩（大小阈值和已压缩格式的扩展名），容量估算与备份共用
+    static bool shouldUseCompression(const BackupStrategy& strategy, const std::string& file_path, size_t file_size);
+    
+    static constexpr int DEBOUNCE_SECONDS = SchedulePolicy::DEBOUNCE_SECONDS; // 防抖动时间：5秒内同一文件只备份一次
+    
+    // 与其他处理器共享的工作线程配额（默认 WorkerBudget::shared()），须在 startAsyncBackup 之前设置
+    void setWorkerBudget(WorkerBudget& budget) { worker_budget_ = &budget; }
 
 private:
-    bool isAllowed(const std::string& file_path) const;
-    void backupFile(const std::string& source_file_path);
+    // 写入了新版本（复制、压缩或链接已有内容）时返回 true
+    bool backupFile(const std::string& source_file_path);
     bool isDriveAvailable(const std::string& path) const;
-    bool shouldBackup(const std::string& file_path);
+    
+    // 工作线程槽位：线程退出时置 finished，由伸缩线程回收
+    struct WorkerSlot {
+        std::thread thread;
+        std::atomic<bool> finished{false};
+    };
+    
+    // 事件摄取：批量取出原始事件，去重、按扩展名过滤后只 stat 剩余路径
+    void ingestLoop();
+    void ingestBatch(std::vector<RawFileEvent>& batch, size_t count);
+    
+    // 逐目录监控：遍历未被排除的目录，加载 .backupignore 并按需注册监控
+    // moved_from 非空时 dir_path 是从该路径移动过来的目录，内容未变的文件只记录别名
+    size_t discoverDirectoryTree(const std::string& dir_path, bool enqueue_files,
+                                 const std::string* moved_from = nullptr);
+    bool ensureDirectoryWatch(const std::string& dir_path);
+    void removeDirectoryWatches(const std::string& dir_path);
+    
+    // 保留策略删除的版本文件从版本目录中移除（relative_path 为空表示整个备份目录的清理）
+    void forgetPrunedVersions(const std::vector<fs::path>& removed, const std::string& relative_path);
+    
+    // 文件被删除后清除其缓存的哈希和时间戳（同内容重新创建时需要重新记录）
+    void forgetPath(const std::string& relative_path, bool may_be_directory);
+    
+    // 移动/重命名：大小和修改时间与原路径上次备份一致时只记录别名
+    bool tryRecordMove(const std::string& old_path, const std::string& new_path, const FileStamp& stamp);
+    
+    // 硬链接已有的备份内容作为新路径的版本（不复制数据）
+    bool linkExistingContent(const fs::path& relative_path, const CatalogRecord& content,
+                             const std::string& source_file_path, const FileStamp& stamp);
+    
+    // 配置排除规则或 .backupignore 是否排除该目录
+    bool isDirectoryExcluded(const std::string& relative_dir) const;
+    void reloadIgnoreFile(const std::string& ignore_file_path);
+    
+    // 事件风暴：计算事件所属子树，平息后对子树做一次对账扫描
+    void subtreeKey(const std::string& dir, const std::string& filename, std::string& key);
+    void snapshotSubtree(const std::string& subtree_key, size_t absorbed_events);
+    
+    // 对账扫描：并行遍历子树，与文件状态表比对大小、修改时间和文件标识，只把真正变化的文件入队
+    // enqueue_changes 为 false 时只记录基线（首次运行没有持久化的状态表）
+    struct ReconcileResult {
+        size_t scanned = 0;
+        size_t changed = 0;
+        size_t deleted = 0;
+        ParallelScanner::Progress progress;
+    };
+    ReconcileResult reconcileSubtree(const std::string& subtree_key, bool enqueue_changes,
+                                     const ParallelScanner::ProgressCallback& on_progress = nullptr);
+    
+    // 启动对账：加载状态表并扫描整个源，补上停止期间的修改和删除
+    void reconcileOnStartup();
+    
+    // 相对源路径，文件状态表的键（指向 file_path 内部，不复制）
+    std::string_view relativeKey(const std::string& file_path) const;
     
     // 异步备份队列处理
-    void processBackupQueue();
-    void enqueueBackup(const std::string& file_path);
+    void processBackupQueue(WorkerSlot* slot);
+    void spawnWorkers(int count);
+    void reapFinishedWorkers();
+    void autoscaleLoop();
+    void enqueueBackup(const std::string& file_path, size_t file_size);
+    // 任务的路径缓冲归还给池（或移交给补做的任务）
+    void finishPendingTask(BackupTask& task);
     
     // 新增：智能备份决策
-    bool shouldUseCompression(const std::string& file_path, size_t file_size);
     bool shouldUseIncremental(const std::string& file_path, size_t file_size);
-    std::optional<std::string> getLastBackupHash(const std::string& relative_path);
+    std::optional<std::string> getLastBackupHash(std::string_view relative_path);
 
     std::string source_path_;
     std::string dest_base_path_;
-    FilterConfig filter_config_;
+    std::shared_ptr<const FilterMatcher> filter_matcher_;  // 只读，与其他扫描共享
     BackupStrategy strategy_;
+    Clock* clock_;
     std::unique_ptr<VersionManager> version_manager_;
+    std::unique_ptr<VersionCatalog> catalog_;
+    
+    // 每个文件的状态（文件戳与哈希缓存、防抖时间、排队状态），分片加锁
+    // 持久化部分保存在版本目录旁，供启动对账和跳过哈希使用
+    std::unique_ptr<FileStateTable> state_table_;
+    
+    // 事件摄取
+    EventRing event_ring_;
+    std::thread ingest_thread_;
+    std::thread reconcile_thread_;
+    std::string ingest_path_;                       // 仅摄取线程使用，复用的事件路径缓冲
+    StormDetector storm_detector_;                  // 仅摄取线程使用
+    std::string storm_key_;                         // 复用的子树键缓冲
+    std::string storm_scratch_;                     // 复用的相对路径缓冲
+    
+    // 各级目录的 .backupignore 规则缓存
+    IgnoreTree ignore_tree_;
     
-    // 防抖动机制：记录每个文件的最后备份时间
-    std::unordered_map<std::string, std::chrono::steady_clock::time_point> last_backup_time_;
-    std::mutex debounce_mutex_;
+    // 原始事件记录（未启用时为空）
+    EventTraceWriter* event_recorder_ = nullptr;
+    uint32_t event_source_id_ = 0;
     
-    // 异步备份队列
-    std::queue<BackupTask> backup_queue_;
+    // 逐目录监控（相对源路径 -> WatchID）
+    WatchBackend* watcher_ = nullptr;    // 受 watch_mutex_ 保护
+    std::atomic<bool> per_directory_watches_{false};
+    std::unordered_map<std::string, efsw::WatchID> dir_watches_;
+    std::mutex watch_mutex_;
+    
+    // 异步备份队列（按类别优先级调度）
+    TaskScheduler scheduler_;
+    PathBufferPool task_path_pool_;       // 任务路径缓冲，受 queue_mutex_ 保护
     std::mutex queue_mutex_;
     std::condition_variable queue_cv_;
-    std::vector<std::thread> worker_threads_;
     std::atomic<bool> should_stop_{false};
     
+    // 工作线程与弹性伸缩
+    std::vector<std::unique_ptr<WorkerSlot>> worker_threads_;
+    std::mutex workers_mutex_;            // 保护 worker_threads_，先于 queue_mutex_ 加锁
+    int live_workers_ = 0;                // 受 queue_mutex_ 保护
+    int target_workers_ = 0;              // 受 queue_mutex_ 保护
+    int min_workers_ = 1;
+    int max_workers_ = 1;
+    WorkerBudget* worker_budget_ = &WorkerBudget::shared();   // 每个存活的工作线程占用一份
+    int64_t timestamp_granularity_ = 0;   // 源路径所在文件系统的时间戳精度（Platform::timestampGranularity）
+    std::thread autoscale_thread_;
+    std::mutex autoscale_mutex_;
+    std::condition_variable autoscale_cv_;
+    
+    // 负载采样（纳秒累计，供伸缩决策使用）
+    std::atomic<uint64_t> queue_wait_ns_{0};
+    std::atomic<uint64_t> dequeued_tasks_{0};
+    std::atomic<uint64_t> cpu_busy_ns_{0};   // 哈希与压缩耗时
+    std::atomic<uint64_t> disk_busy_ns_{0};  // 建目录、复制与清理耗时
+    
     // 统计信息
     std::atomic<size_t> total_backups_{0};
     std::atomic<size_t> total_bytes_{0};
@@ -102,12 +276,26 @@ private:
     std::atomic<size_t> skipped_backups_{0};
     std::atomic<size_t> compressed_backups_{0};
     std::atomic<size_t> incremental_backups_{0};
+    std::atomic<size_t> aliased_backups_{0};
+    
+    // 阶段延迟直方图与吞吐量（按线程分片）
+    BackupMetrics metrics_;
+    BackupObserver backup_observer_;
     
-    // 文件哈希缓存（用于增量备份判断）
-    std::unordered_map<std::string, std::string> file_hash_cache_;
-    std::mutex hash_cache_mutex_;
+    // 堆分配计数（AllocCounter 未启用时恒为 0）
+    std::atomic<uint64_t> ingested_events_{0};
+    std::atomic<uint64_t> event_allocations_{0};
+    std::atomic<uint64_t> executed_tasks_{0};
+    std::atomic<uint64_t> task_allocations_{0};
+    std::atomic<uint64_t> written_tasks_{0};
+    std::atomic<uint64_t> written_allocations_{0};
     
-    static constexpr int MAX_RETRIES = 5;
-    static constexpr int RETRY_DELAY_SECONDS = 3;
-    static constexpr int DEBOUNCE_SECONDS = 5; // 防抖动时间：5秒内同一文件只备份一次
+    static constexpr int MAX_RETRIES = SchedulePolicy::MAX_RETRIES;
+    static constexpr int AUTOSCALE_INTERVAL_MS = 1000;  // 伸缩决策周期
+    static constexpr int INGEST_INTERVAL_MS = 50;       // 摄取线程最长等待时间
+    static constexpr size_t INGEST_BATCH_SIZE = 4096;   // 每批最多处理的事件数
+    static constexpr double CPU_SATURATION = 0.9;       // CPU 利用率高于此值时不再扩容
+    static constexpr double DISK_SATURATION = 0.85;     // 线程大部分时间在等磁盘时不再扩容
+    static constexpr int STATE_COMPACT_INTERVAL_SECONDS = 60;  // 状态表压缩与淘汰检查周期
+    static constexpr int STATE_EVICT_IDLE_SECONDS = 600;       // 超过此时间未访问的记录视为冷记录
 };
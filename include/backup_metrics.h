@@ -0,0 +1,153 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <cstdint>
+
+// 备份流水线的各个阶段
+enum class BackupStage {
+    QueueWait = 0,   // 入队到出队
+    Hash = 1,        // 计算内容哈希
+    Compress = 2,    // 压缩并写出 .gz
+    Write = 3,       // 建目录、复制或硬链接
+    Cleanup = 4      // 清理过期版本
+};
+
+// 对数-线性分桶的延迟直方图（HDR 风格，单位微秒）
+// 每个 2 的幂区间再等分 SUB_BUCKETS 份，分位数的相对误差不超过 1/SUB_BUCKETS
+class LatencyHistogram {
+public:
+    static constexpr unsigned SUB_BUCKET_BITS = 4;
+    static constexpr size_t SUB_BUCKETS = size_t(1) << SUB_BUCKET_BITS;
+    static constexpr unsigned MAX_MAGNITUDE = 28;                          // 上限约 2^33 微秒（2.4 小时），超出的计入最后一个桶
+    static constexpr size_t NUM_BUCKETS = (MAX_MAGNITUDE + 2) * SUB_BUCKETS;
+    static constexpr uint64_t MAX_TRACKABLE = (uint64_t(1) << (MAX_MAGNITUDE + SUB_BUCKET_BITS + 1)) - 1;
+
+    static size_t bucketFor(uint64_t micros);
+    // 桶内最大值（微秒）
+    static uint64_t bucketUpperBound(size_t index);
+
+    void record(uint64_t micros);
+    void merge(const LatencyHistogram& other);
+
+    uint64_t count() const { return count_; }
+    uint64_t sumMicros() const { return sum_; }
+    uint64_t maxMicros() const { return max_; }
+    double meanMicros() const { return count_ > 0 ? static_cast<double>(sum_) / count_ : 0.0; }
+
+    // q 取 [0, 1]；没有样本时返回 0
+    uint64_t percentile(double q) const;
+
+    // 分片合并时直接写入各桶
+    void addBucket(size_t index, uint64_t n) { counts_[index] += n; count_ += n; }
+    void addSummary(uint64_t sum, uint64_t max);
+
+private:
+    std::array<uint64_t, NUM_BUCKETS> counts_{};
+    uint64_t count_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t max_ = 0;
+};
+
+// 某一时刻的指标快照（由各线程分片合并而来）
+struct MetricsSnapshot {
+    static constexpr size_t NUM_STAGES = 5;
+
+    std::array<LatencyHistogram, NUM_STAGES> stages;
+    uint64_t files = 0;              // 写入了新版本的文件数
+    uint64_t bytes = 0;              // 这些文件的源文件大小之和
+    double uptime_seconds = 0.0;
+
+    const LatencyHistogram& stage(BackupStage s) const { return stages[static_cast<size_t>(s)]; }
+
+    // 启动以来的平均速率
+    double filesPerSecond() const { return uptime_seconds > 0 ? files / uptime_seconds : 0.0; }
+    double bytesPerSecond() const { return uptime_seconds > 0 ? bytes / uptime_seconds : 0.0; }
+
+    void merge(const MetricsSnapshot& other);
+};
+
+// 单个备份源的阶段耗时与吞吐量计数
+// 计数按线程分片：每个线程固定写一个缓存行对齐的分片，热路径上只有无竞争的原子加；
+// 读取时把所有分片合并成快照
+class BackupMetrics {
+public:
+    static constexpr size_t NUM_SHARDS = 8;
+
+    BackupMetrics();
+
+    void record(BackupStage stage, std::chrono::nanoseconds elapsed);
+    void recordWritten(uint64_t bytes);
+
+    MetricsSnapshot snapshot() const;
+
+    static const char* stageName(BackupStage stage);
+
+private:
+    struct alignas(64) Shard {
+        std::array<std::array<std::atomic<uint64_t>, LatencyHistogram::NUM_BUCKETS>, MetricsSnapshot::NUM_STAGES> buckets;
+        std::array<std::atomic<uint64_t>, MetricsSnapshot::NUM_STAGES> sum;
+        std::array<std::atomic<uint64_t>, MetricsSnapshot::NUM_STAGES> max;
+        std::atomic<uint64_t> files;
+        std::atomic<uint64_t> bytes;
+    };
+
+    Shard& localShard();
+
+    std::unique_ptr<Shard[]> shards_;
+    std::chrono::steady_clock::time_point started_;
+};
+
+// 定期把各备份源的指标写成 JSON 和 Prometheus 文本（先写临时文件再替换，读取方不会看到半个文件）
+// 速率按两次导出之间的增量计算，另附启动以来的平均值
+class MetricsExporter {
+public:
+    using Source = std::function<MetricsSnapshot()>;
+
+    // 输出 <output_dir>/metrics.json 和 <output_dir>/metrics.prom
+    MetricsExporter(std::string output_dir, std::chrono::seconds interval);
+    ~MetricsExporter();
+
+    void addSource(std::string label, Source source);
+
+    void start();
+    // 停止后台线程并写出最后一次
+    void stop();
+
+    // 立即采集并写出，返回是否成功
+    bool exportNow();
+
+    const std::string& jsonPath() const { return json_path_; }
+    const std::string& prometheusPath() const { return prom_path_; }
+
+private:
+    struct SourceState {
+        std::string label;
+        Source source;
+        MetricsSnapshot last;
+        std::chrono::steady_clock::time_point last_time;
+        bool has_last = false;
+    };
+
+    void run();
+
+    std::string json_path_;
+    std::string prom_path_;
+    std::chrono::seconds interval_;
+
+    std::vector<SourceState> sources_;
+    std::mutex mutex_;                  // 保护 sources_
+
+    std::thread thread_;
+    std::mutex wait_mutex_;
+    std::condition_variable wait_cv_;
+    bool stopping_ = false;
+};
@@ -23,6 +23,54 @@ struct BackupStrategy {
     
     // 文件大小限制
     size_t max_file_size = 104857600;     // 最大备份文件大小（100MB）
+    
+    // 任务调度配置
+    size_t small_file_threshold = 65536;  // 小于此大小视为小文件，优先备份（64KB）
+    size_t bulk_file_threshold = 10485760; // 大于此大小进入批量通道（10MB）
+    int bulk_max_workers = 1;             // 批量通道最多同时占用的工作线程数
+    int recent_edit_window_seconds = 60;  // N 秒内再次修改的文件视为最近编辑，最优先
+    int aging_seconds = 10;               // 任务每等待 N 秒提升一级优先级，防止饿死
+    
+    // 工作线程弹性伸缩
+    int min_workers = 1;                  // 空闲时保留的最少工作线程数
+    int max_workers = 0;                  // 所有备份源合计的最多工作线程数（0 表示 CPU 核心数）
+    int scale_up_wait_ms = 500;           // 排队等待超过此时间（毫秒）时扩容
+    int scale_down_idle_seconds = 30;     // 队列空闲超过 N 秒后缩容
+    
+    // 事件摄取
+    size_t event_buffer_capacity = 65536; // 每个监控源的事件缓冲区容量，溢出的事件会被丢弃
+    
+    // 事件风暴检测（切换分支、npm install、编译输出等）
+    size_t storm_event_threshold = 500;   // 子树在窗口内事件数达到此值视为风暴
+    int storm_window_ms = 2000;           // 事件速率统计窗口（毫秒）
+    int storm_settle_ms = 3000;           // 风暴子树持续 N 毫秒无事件后视为平息，执行快照扫描
+    int storm_root_depth = 1;             // 按源路径下第几级目录划分子树
+    
+    // 监控后端
+    std::string watcher_backend = "efsw"; // efsw（默认）、inotify、fanotify（后两者仅 Linux）
+    
+    // 启动对账
+    bool reconcile_on_startup = true;     // 启动时扫描源路径，补上停止期间的修改和删除
+    int scan_threads = 0;                 // 对账/快照扫描线程数（0 表示 CPU 核心数）
+    size_t state_max_entries = 0;         // 内存中最多保留的文件状态数（0 表示不限制），超出时淘汰冷记录
+    
+    // 日志
+    bool async_logging = true;            // 异步日志：调用线程只入队，由独立线程写控制台和文件
+    size_t log_queue_size = 8192;         // 异步日志队列容量（条），启动时一次性分配
+    std::string log_overflow_policy = "block"; // 队列满时：block（等待）、drop_oldest（丢弃最旧）、drop_new（丢弃新消息）
+    int log_flush_interval_seconds = 1;   // 定时批量刷新间隔；warning 及以上立即刷新
+    std::string log_level = "info";       // 最低输出级别：trace、debug、info、warn、error
+    
+    // 指标导出
+    int metrics_interval_seconds = 10;    // 每隔 N 秒重写 metrics.json / metrics.prom（0 表示不导出）
+    std::string metrics_directory;        // 指标、跟踪与事件记录文件目录（空表示 <备份根目录>/.catalog）
+    
+    // 时间线跟踪（Chrome trace-event 格式）
+    bool trace_enabled = false;           // 记录流水线各阶段的区间，退出时、收到导出请求时或从托盘菜单导出
+    size_t trace_buffer_events = 16384;   // 每个线程保留的最近事件数（每个事件 64 字节）
+    
+    // 原始事件记录（供 codebackup_replay 离线回放）
+    bool capture_events = false;          // 把监控收到的每个事件写入 events_YYYYMMDD_HHMMSS.cbtrace
 };
 
 // 备份元数据
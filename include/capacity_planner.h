@@ -0,0 +1,102 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+#include <nlohmann/json.hpp>
+#include "config_loader.h"
+
+// 容量规划（只读演练）：并行扫描配置的备份源，按编译后的过滤规则、.backupignore 和 BackupStrategy
+// 统计会被备份的文件，抽样读取部分文件测量压缩率和哈希/压缩吞吐，估算首次全量备份的大小与耗时、
+// 给定编辑频率下每天的增长，以及版本保留稳定后的占用。不写入备份目录，也不创建日志或状态文件
+struct CapacityPlanOptions {
+    double saves_per_hour = 600;          // 所有备份源合计的保存次数（工作时间内）
+    double active_hours_per_day = 9;      // 每个工作日的编辑时长
+    int active_days_per_week = 5;
+    int working_set_days = 14;            // 最近 N 天修改过的文件视为工作集，编辑均匀落在工作集上（0 表示全部文件）
+    size_t sample_files = 256;            // 每个备份源按大小加权抽样的文件数
+    size_t sample_bytes = 1048576;        // 每个样本最多读取的字节数
+    double bandwidth_mbps = 100;          // 备份目录写入带宽（MB/s），演练不写入，只能给定
+    int workers = 0;                      // 备份工作线程数（0 表示按策略的 max_workers，再为 0 时取 CPU 核心数）
+};
+
+class CapacityPlanner {
+public:
+    // 各扩展名（小写，含点）的统计
+    struct ExtensionStats {
+        uint64_t files = 0;
+        uint64_t bytes = 0;
+        uint64_t compressed_bytes = 0;    // 其中按策略会压缩的字节数
+        uint64_t working_files = 0;       // 属于工作集的部分
+        uint64_t working_bytes = 0;
+        uint64_t working_compressed_bytes = 0;
+        // 样本压缩率的加权和与权重：按大小加权抽样时每个样本权重为 1（直接平均即为按字节加权的估计），
+        // 候选文件不超过样本数（全部读取）时权重为文件大小
+        double ratio_sum = 0;
+        double ratio_weight = 0;
+        uint64_t samples = 0;
+
+        double ratio(double fallback) const { return ratio_weight > 0 ? ratio_sum / ratio_weight : fallback; }
+    };
+
+    struct SourcePlan {
+        std::string path;
+        std::string skipped;              // 非空时为跳过原因
+        size_t directories = 0;
+        size_t pruned_directories = 0;    // 被排除规则或 .backupignore 剪掉的目录
+        size_t filtered_files = 0;        // 未通过过滤的文件
+        size_t oversized_files = 0;       // 超过 max_file_size 的文件
+        double scan_seconds = 0;
+        std::unordered_map<std::string, ExtensionStats> extensions;
+        uint64_t bulk_bytes = 0;          // 不小于 bulk_file_threshold 的文件字节数（批量通道）
+
+        // 汇总（estimate 之后有效）
+        ExtensionStats total;
+        double compress_ratio = 1.0;      // 压缩字节的平均压缩率（无样本时为 1）
+        uint64_t stored_bytes = 0;        // 全量备份写入备份目录的字节数
+        uint64_t working_stored_bytes = 0;
+    };
+
+    CapacityPlanner(const Config& config, const nlohmann::json& presets, CapacityPlanOptions options);
+
+    // 扫描、抽样并计算估算结果，返回 JSON 报告
+    nlohmann::json run();
+
+    // 报告的简短文字摘要（每个备份源一行加合计）
+    static std::string summarize(const nlohmann::json& report);
+
+private:
+    struct Sample {
+        double key = 0;                   // 加权水库抽样的键（越大越优先）
+        uint64_t size = 0;
+        std::string path;
+        std::string extension;
+    };
+
+    // 抽样测得的吞吐（单线程，字节/秒）
+    struct Throughput {
+        uint64_t bytes = 0;
+        uint64_t compressed_input = 0;
+        double read_seconds = 0;
+        double hash_seconds = 0;
+        double compress_seconds = 0;
+
+        double readRate() const { return read_seconds > 0 ? bytes / read_seconds : 0; }
+        double hashRate() const { return hash_seconds > 0 ? bytes / hash_seconds : 0; }
+        double compressRate() const { return compress_seconds > 0 ? compressed_input / compress_seconds : 0; }
+    };
+
+    // 返回参与抽样的候选文件数
+    size_t scanSource(const BackupSource& source, SourcePlan& plan, std::vector<Sample>& samples);
+    // census 为 true 表示样本包含了全部候选文件
+    void measureSamples(SourcePlan& plan, const std::vector<Sample>& samples, bool census);
+    void estimate(SourcePlan& plan) const;
+    int workerCount() const;
+
+    Config config_;
+    nlohmann::json presets_;
+    CapacityPlanOptions options_;
+    Throughput throughput_;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+
+// 时间来源：防抖、调度延迟、重试退避和版本保留都通过它取时间和等待，
+// 基准测试可换成模拟时钟，在几秒内跑完数天的编辑而且结果可复现
+class Clock {
+public:
+    virtual ~Clock() = default;
+
+    // 单调时间，用于间隔和延迟
+    virtual std::chrono::steady_clock::time_point steadyNow() const = 0;
+    // 墙上时间，用于版本文件名和保留期限
+    virtual std::chrono::system_clock::time_point systemNow() const = 0;
+    // 阻塞当前线程（模拟时钟直接把时间向前推）
+    virtual void sleepFor(std::chrono::milliseconds duration) = 0;
+
+    int64_t steadyMillis() const {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(steadyNow().time_since_epoch()).count();
+    }
+    int64_t systemMillis() const {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(systemNow().time_since_epoch()).count();
+    }
+
+    // 进程共享的真实时钟（默认值）
+    static Clock& system();
+};
+
+// 真实时钟：直接转发到 std::chrono 和 std::this_thread
+class SystemClock : public Clock {
+public:
+    std::chrono::steady_clock::time_point steadyNow() const override;
+    std::chrono::system_clock::time_point systemNow() const override;
+    void sleepFor(std::chrono::milliseconds duration) override;
+};
+
+// 模拟时钟：只在 advance / sleepFor 时前进，两种时间同步推进
+// 可从多个线程读取；多个线程同时 sleepFor 时各自的等待会叠加，需要精确时序的模拟应只由一个线程推进
+class SimulatedClock : public Clock {
+public:
+    // start 为模拟开始时的墙上时间
+    explicit SimulatedClock(std::chrono::system_clock::time_point start = std::chrono::system_clock::time_point());
+
+    std::chrono::steady_clock::time_point steadyNow() const override;
+    std::chrono::system_clock::time_point systemNow() const override;
+    void sleepFor(std::chrono::milliseconds duration) override;
+
+    void advance(std::chrono::nanoseconds duration);
+    // 前进到指定的单调时间（早于当前时间时不动）
+    void advanceTo(std::chrono::steady_clock::time_point target);
+
+    // 模拟开始以来经过的时间
+    std::chrono::nanoseconds elapsed() const { return std::chrono::nanoseconds(elapsed_ns_.load()); }
+
+private:
+    std::chrono::system_clock::time_point system_start_;
+    // 单调时间从一个正的基准开始，避免与表示“从未”的 0 值混淆
+    std::chrono::steady_clock::time_point steady_start_;
+    std::atomic<int64_t> elapsed_ns_{0};
+};
@@ -3,9 +3,12 @@
 #include <string>
 #include <vector>
 #include <optional>
+#include <memory>
 #include <nlohmann/json.hpp>
 #include "backup_handler.h"
 #include "backup_strategy.h"
+#include "filter_matcher.h"
+#include "logger.h"
 
 struct BackupSource {
     std::string path;
@@ -28,10 +31,21 @@ public:
                                      const nlohmann::json& presets);
     static BackupStrategy loadStrategy(const nlohmann::json& json);
     
+    // 策略中的日志设置转换为 Logger::setup 的参数
+    static LogOptions logOptions(const BackupStrategy& strategy);
+    
+    // 指标、跟踪和事件记录文件所在目录（未配置时为 <备份根目录>/.catalog）
+    static std::string diagnosticsDirectory(const Config& config);
+    
     // 新增：合并预设和自定义过滤器
     static FilterConfig mergeFilters(const std::vector<std::string>& preset_names,
                                      const nlohmann::json& presets,
                                      const std::optional<FilterConfig>& custom_filter);
+    
+    // 合并后编译为只读匹配器，供工作线程和预览扫描共享
+    static std::shared_ptr<const FilterMatcher> compileFilters(const std::vector<std::string>& preset_names,
+                                                               const nlohmann::json& presets,
+                                                               const std::optional<FilterConfig>& custom_filter);
 
 private:
     static std::optional<nlohmann::json> loadJsonFile(const std::string& file_path,
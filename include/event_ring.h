@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include <efsw/efsw.hpp>
+
+// 监控后端丢失事件后请求重新扫描 dir（不是 efsw 的事件类型）
+constexpr efsw::Action RESCAN_ACTION = static_cast<efsw::Action>(0);
+
+// 监控线程上报的原始事件（不做任何路径解析或 stat）
+struct RawFileEvent {
+    std::string dir;
+    std::string filename;
+    std::string old_filename;
+    efsw::Action action = efsw::Actions::Modified;
+};
+
+// 每个监控器一个的有界环形缓冲区
+// 槽位字符串预先分配并在取出时与批次缓冲交换，稳态下入队不分配内存
+class EventRing {
+public:
+    explicit EventRing(size_t capacity);
+
+    // 写入一个事件；缓冲区已满时丢弃并计数，绝不阻塞监控线程
+    void push(const std::string& dir, const std::string& filename,
+              efsw::Action action, const std::string& old_filename);
+
+    // 等待直到有事件、超时或被唤醒
+    void waitForEvents(std::chrono::milliseconds timeout);
+    void wakeAll();
+
+    // 批量取出最多 max_events 个事件到 batch（batch 的字符串缓冲会被复用）
+    size_t drain(std::vector<RawFileEvent>& batch, size_t max_events);
+
+    // 取出并清零溢出丢弃计数
+    size_t takeDropped();
+
+private:
+    std::vector<RawFileEvent> slots_;
+    size_t head_ = 0;    // 下一个读取位置
+    size_t count_ = 0;
+    size_t dropped_ = 0;
+    bool wake_ = false;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <optional>
+#include <fstream>
+#include <unordered_map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+#include <efsw/efsw.hpp>
+
+// 原始文件事件的二进制记录（.cbtrace），用于离线复现和回放
+// 文件头为 8 字节魔数和版本号、记录开始时的系统时间，之后是一串记录：
+//   'S' 备份源定义（编号、路径）
+//   'D' 目录定义（编号、路径），同一目录只写一次，事件中以编号引用
+//   'E' 事件（与上一事件的微秒间隔、源编号、目录编号、动作、标志、文件大小、文件名、移动前的文件名）
+//   'L' 写入线程来不及处理而丢弃的事件数
+// 整数一律为 LEB128 变长编码，字符串为长度 + 字节
+namespace EventTrace {
+constexpr char MAGIC[8] = {'C', 'B', 'E', 'V', 'T', 'R', 'C', '1'};
+constexpr uint32_t VERSION = 1;
+constexpr uint8_t FLAG_DIRECTORY = 1;     // 记录时该路径是目录
+constexpr uint8_t FLAG_SIZE_KNOWN = 2;    // 记录时能读取到大小（删除事件和已消失的文件没有）
+}
+
+// 记录端：监控线程读取文件大小（一次 stat，不持锁）后入队，由写入线程批量编码写出
+class EventTraceWriter {
+public:
+    using Clock = std::chrono::steady_clock;
+    static constexpr size_t MAX_PENDING = size_t(1) << 20;   // 积压超过此数的事件被丢弃并计数
+
+    EventTraceWriter() = default;
+    ~EventTraceWriter();
+
+    EventTraceWriter(const EventTraceWriter&) = delete;
+    EventTraceWriter& operator=(const EventTraceWriter&) = delete;
+
+    bool open(const std::string& path);
+    // 写出剩余事件并关闭文件
+    void close();
+
+    // 每个备份源注册一次，返回记录事件时使用的编号
+    uint32_t addSource(const std::string& source_path);
+
+    // 可从多个监控线程同时调用
+    void record(uint32_t source, const std::string& dir, const std::string& filename,
+                efsw::Action action, const std::string& old_filename);
+
+    uint64_t recordedEvents() const { return recorded_.load(); }
+    uint64_t droppedEvents() const { return dropped_.load(); }
+    const std::string& path() const { return path_; }
+
+    // 按当前时间生成的文件名：events_YYYYMMDD_HHMMSS.cbtrace
+    static std::string captureFileName();
+
+private:
+    struct PendingEvent {
+        Clock::time_point time;
+        uint32_t source = 0;
+        efsw::Action action = efsw::Actions::Modified;
+        uint8_t flags = 0;
+        uint64_t size = 0;
+        std::string dir;
+        std::string filename;
+        std::string old_filename;
+    };
+
+    void writerLoop();
+    void encode(const PendingEvent& event);
+
+    std::string path_;
+    std::ofstream out_;
+    std::string buffer_;                                // 仅写入线程使用
+    std::unordered_map<std::string, uint32_t> dir_ids_; // 仅写入线程使用
+    Clock::time_point last_time_;                       // 仅写入线程使用
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<PendingEvent> pending_;
+    std::vector<std::pair<uint32_t, std::string>> pending_sources_;
+    uint32_t next_source_ = 0;
+    uint64_t pending_dropped_ = 0;
+    bool stopping_ = false;
+    std::thread writer_thread_;
+
+    std::atomic<uint64_t> recorded_{0};
+    std::atomic<uint64_t> dropped_{0};
+};
+
+// 读取端：按顺序逐个返回事件，源和目录定义在读取过程中累积
+class EventTraceReader {
+public:
+    struct Event {
+        int64_t time_us = 0;                 // 距记录开始的微秒数
+        uint32_t source = 0;
+        efsw::Action action = efsw::Actions::Modified;   // RESCAN_ACTION 表示监控后端要求重新扫描 dir
+        bool is_directory = false;
+        std::optional<uint64_t> size;
+        std::string dir;
+        std::string filename;
+        std::string old_filename;
+    };
+
+    bool open(const std::string& path);
+
+    // 读到末尾或数据损坏时返回 false（损坏时 error() 非空）
+    bool next(Event& event);
+
+    const std::vector<std::string>& sources() const { return sources_; }
+    int64_t startUnixMs() const { return start_unix_ms_; }
+    uint64_t lostEvents() const { return lost_events_; }
+    const std::string& error() const { return error_; }
+
+private:
+    bool readVarint(uint64_t& value);
+    bool readString(std::string& value);
+    bool fail(const std::string& message);
+
+    std::ifstream in_;
+    std::vector<std::string> sources_;
+    std::vector<std::string> dirs_;
+    int64_t start_unix_ms_ = 0;
+    int64_t time_us_ = 0;
+    uint64_t lost_events_ = 0;
+    std::string error_;
+};
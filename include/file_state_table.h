@@ -0,0 +1,175 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <deque>
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <optional>
+#include <filesystem>
+#include <cstdint>
+#include "platform.h"
+#include "task_scheduler.h"
+
+// 文件戳：大小、修改时间（平台原生精度）和文件标识（inode / Windows 文件索引，未知时为 0）
+// hash 为该文件戳对应内容的哈希（十六进制，未计算过时为空），文件戳不变时可直接复用
+// hash_time 为开始读取内容计算哈希的时刻（与 mtime 单位相同，0 表示未知）
+struct FileStamp {
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    uint64_t file_id = 0;
+    std::string hash;
+    int64_t hash_time = 0;
+
+    // 任一方文件标识未知时只比较大小和修改时间
+    bool matches(const FileStamp& other) const {
+        return size == other.size && mtime == other.mtime &&
+               (file_id == 0 || other.file_id == 0 || file_id == other.file_id);
+    }
+};
+
+// 读取文件戳（一次系统调用）；目录项版本在 Windows 上直接使用枚举时带回的数据
+// 既不是普通文件也不是目录时返回 false；is_directory 非空时返回是否为目录
+bool readFileStamp(const std::string& path, FileStamp& stamp, bool* is_directory = nullptr);
+bool readFileStamp(const std::filesystem::directory_entry& entry, FileStamp& stamp);
+
+// 单个文件的全部运行状态，紧凑存放（哈希保存为 32 字节摘要而不是十六进制字符串）
+struct FileRecord {
+    enum : uint8_t { HAS_STAMP = 1, HAS_DIGEST = 2 };
+
+    // 持久化部分：最近一次备份（或基线扫描）时的文件戳和内容摘要
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    uint64_t file_id = 0;
+    std::array<uint8_t, 32> digest{};
+    int64_t hash_time = 0;
+
+    // 运行时部分，不持久化
+    int64_t last_backup_ms = 0;   // 最近一次入队备份（steady 时钟毫秒，防抖用），0 表示没有
+    uint32_t last_access = 0;     // 最近访问（表创建后的秒数），淘汰冷记录用
+    uint8_t flags = 0;
+    PendingState pending = PendingState::NotPending;   // 排队 / 备份中状态（SchedulePolicy）；非空闲时不会被淘汰
+
+    bool hasStamp() const { return (flags & HAS_STAMP) != 0; }
+    bool hasDigest() const { return (flags & HAS_DIGEST) != 0; }
+    // 修改时间距哈希时刻不足时间戳精度 window 时，哈希之后的修改可能没有改变 mtime，
+    // 这样的摘要不能凭文件戳复用，需要重新计算（重新计算结果相同时哈希时刻随之更新，记录即稳定）
+    bool hasSettledDigest(int64_t window) const {
+        return hasDigest() && hash_time - mtime > window;
+    }
+    bool matches(const FileStamp& stamp) const {
+        return hasStamp() && size == stamp.size && mtime == stamp.mtime &&
+               (file_id == 0 || stamp.file_id == 0 || file_id == stamp.file_id);
+    }
+};
+
+// 按相对路径保存的文件状态表：文件戳、哈希缓存、防抖时间和排队状态都在这里
+// - 路径按分片驻留：每个路径只存一份，分片内以槽位编号引用记录
+// - 按路径哈希分成 NUM_STRIPES 个分片，各有一把锁，不同文件的操作互不阻塞
+// - 长期未访问的临时记录（只有防抖时间）定期淘汰；设置了 max_entries 时超出部分按冷热淘汰
+// 持久化部分在磁盘上是一个快照文件加一个追加写入的更新日志：
+// - 每次更新追加一条记录并立即刷新，崩溃最多丢失最后一条（不完整的尾部在加载时丢弃）
+// - 日志过长时压缩：先把日志改名，再写临时快照并原子替换，任一步骤中断都能从剩余文件恢复
+class FileStateTable {
+public:
+    // max_entries 为 0 表示不限制带文件戳的记录数
+    explicit FileStateTable(std::string persist_path, size_t max_entries = 0);
+
+    // 源文件所在文件系统的时间戳精度（Platform::timestampGranularity），默认按最粗的 2 秒
+    void setTimestampGranularity(int64_t ticks) { racy_window_ = ticks; }
+
+    // 读取快照并重放更新日志；快照和日志都不存在或快照损坏时返回 false
+    bool load();
+
+    // journal 为 false 时只更新内存，由下一次压缩写入（批量记录基线时使用）
+    // 路径参数只用于查找，已有记录时不复制、不分配内存
+    void put(std::string_view relative_path, const FileStamp& stamp, bool journal = true);
+    std::optional<FileStamp> get(std::string_view relative_path) const;
+    bool matches(std::string_view relative_path, const FileStamp& stamp) const;
+
+    // 文件戳与记录一致且哈希计算时修改时间已经稳定时返回缓存的内容哈希
+    std::optional<std::string> cachedHash(std::string_view relative_path, const FileStamp& stamp) const;
+    bool hasCachedHash(std::string_view relative_path, const FileStamp& stamp) const;
+
+    // 在分片锁内读写记录的运行时部分（不存在时创建），返回 fn 的返回值
+    // fn 不能修改持久化部分，也不能再访问本表
+    template <typename Fn>
+    auto update(std::string_view relative_path, Fn&& fn) {
+        Stripe& stripe = stripeFor(relative_path);
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        return fn(acquireLocked(stripe, relative_path));
+    }
+
+    // 清除文件戳和防抖时间（文件已删除）；排队中的记录保留排队状态
+    bool erase(std::string_view relative_path);
+
+    // 移除目录下的所有记录
+    size_t eraseUnder(const std::string& relative_dir);
+
+    // 目录下（空表示全部）有文件戳的路径
+    std::vector<std::string> keysUnder(const std::string& relative_dir) const;
+
+    // 淘汰 idle 时间内未访问的临时记录；超出 max_entries 时也淘汰冷的持久记录
+    size_t evictCold(std::chrono::seconds idle);
+
+    // 写出新快照并清空更新日志
+    bool compact();
+
+    // 有未写入的基线或更新日志过长时压缩
+    bool maybeCompact();
+
+    size_t size() const { return entries_.load(); }
+    bool isDirty() const { return dirty_.load(); }
+    const std::string& persistPath() const { return persist_path_; }
+
+private:
+    enum : uint8_t { OP_PUT = 1, OP_ERASE = 2 };
+
+    struct Slot {
+        std::string path;
+        FileRecord record;
+        bool used = false;
+    };
+
+    // deque 保证槽位地址稳定，索引可以直接引用槽位里的路径
+    struct Stripe {
+        mutable std::mutex mutex;
+        std::deque<Slot> slots;
+        std::vector<uint32_t> free_slots;
+        std::unordered_map<std::string_view, uint32_t> index;
+    };
+
+    static constexpr size_t STRIPE_BITS = 6;
+    static constexpr size_t NUM_STRIPES = size_t(1) << STRIPE_BITS;
+
+    Stripe& stripeFor(std::string_view relative_path) const;
+    FileRecord* findLocked(Stripe& stripe, std::string_view relative_path) const;
+    FileRecord& acquireLocked(Stripe& stripe, std::string_view relative_path);
+    void releaseLocked(Stripe& stripe, uint32_t slot);
+    void appendLog(uint8_t op, std::string_view relative_path, const FileStamp* stamp);
+    uint32_t nowSeconds() const;
+
+    std::string persist_path_;
+    std::string log_path_;
+    size_t max_entries_;
+    std::chrono::steady_clock::time_point created_;
+    std::atomic<int64_t> racy_window_{2 * Platform::FILE_TIME_TICKS_PER_SECOND};
+
+    mutable std::array<Stripe, NUM_STRIPES> stripes_;
+    std::atomic<size_t> entries_{0};
+    std::atomic<bool> dirty_{false};
+
+    std::mutex compact_mutex_;     // 同一时刻只有一个压缩
+    std::mutex log_mutex_;         // 保护 log_ 和 log_records_，在分片锁之后加锁
+    std::ofstream log_;
+    size_t log_records_ = 0;
+
+    static constexpr uint32_t FILE_MAGIC = 0x54534243;   // "CBST"
+    static constexpr uint32_t FILE_VERSION = 4;          // 2：记录内容哈希；3：哈希改存 32 字节摘要；4：摘要附带哈希时刻
+    static constexpr size_t COMPACT_MIN_RECORDS = 8192;  // 日志记录数超过 max(此值, 表大小 / 2) 时压缩
+};
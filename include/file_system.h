@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <optional>
+#include <functional>
+#include <mutex>
+#include <filesystem>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+// 目录项：大小按需读取（真实文件系统在 Windows 上直接取目录枚举时缓存的大小）
+class FileSystemEntry {
+public:
+    virtual ~FileSystemEntry() = default;
+    virtual const fs::path& path() const = 0;
+    virtual bool isDirectory() const = 0;
+    virtual bool isRegularFile() const = 0;
+    virtual std::optional<uint64_t> fileSize() const = 0;
+};
+
+// 版本保留用到的文件系统操作，基准测试可换成内存实现
+class FileSystem {
+public:
+    using Visitor = std::function<void(const FileSystemEntry& entry)>;
+
+    virtual ~FileSystem() = default;
+
+    // 枚举目录的直接子项，目录无法打开时返回 false
+    virtual bool listDirectory(const fs::path& dir, const Visitor& visit) const = 0;
+    // 递归枚举目录下的所有子项
+    virtual bool walk(const fs::path& root, const Visitor& visit) const = 0;
+    virtual std::optional<uint64_t> fileSize(const fs::path& path) const = 0;
+    // 删除文件，成功时返回 true
+    virtual bool remove(const fs::path& path) = 0;
+
+    // 进程共享的真实文件系统（默认值）
+    static FileSystem& real();
+};
+
+// 真实文件系统：转发到 std::filesystem，错误一律按不存在处理
+class RealFileSystem : public FileSystem {
+public:
+    bool listDirectory(const fs::path& dir, const Visitor& visit) const override;
+    bool walk(const fs::path& root, const Visitor& visit) const override;
+    std::optional<uint64_t> fileSize(const fs::path& path) const override;
+    bool remove(const fs::path& path) override;
+};
+
+// 内存文件系统：只记录目录结构和文件大小，不保存内容
+// 路径按 generic 形式规范化后比较；所有操作加锁，可从多个线程调用，
+// 但枚举回调中不能再修改同一个文件系统
+class MemoryFileSystem : public FileSystem {
+public:
+    bool listDirectory(const fs::path& dir, const Visitor& visit) const override;
+    bool walk(const fs::path& root, const Visitor& visit) const override;
+    std::optional<uint64_t> fileSize(const fs::path& path) const override;
+    bool remove(const fs::path& path) override;
+
+    // 创建（或覆盖）文件，自动补齐上级目录
+    void writeFile(const fs::path& path, uint64_t size);
+    void createDirectories(const fs::path& path);
+
+    size_t fileCount() const;
+    uint64_t totalBytes() const;
+
+private:
+    struct Directory {
+        std::map<std::string, uint64_t> files;   // 文件名 -> 大小
+        std::set<std::string> subdirs;
+    };
+
+    static std::string normalize(const fs::path& path);
+    static std::pair<std::string, std::string> splitParent(const std::string& path);
+    Directory& ensureDirectory(const std::string& path);
+    bool walkLocked(const std::string& dir, const Visitor& visit) const;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Directory> dirs_;
+    size_t file_count_ = 0;
+    uint64_t total_bytes_ = 0;
+};
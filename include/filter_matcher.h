@@ -0,0 +1,77 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+struct FilterConfig;
+
+// 编译后的只读过滤器
+// - 扩展名/文件名通过完美哈希表一次查找
+// - 排除规则（glob）预先分类：目录名、目录路径、文件名、文件路径
+// 所有查询都是 const 且不分配内存（超长路径除外），可被多个线程共享
+class FilterMatcher {
+public:
+    static std::shared_ptr<const FilterMatcher> compile(const FilterConfig& config);
+
+    // 文件是否应被备份；path 为相对源路径（绝对路径时只有文件名和扩展名规则有效）
+    bool allowsFile(const std::string& path) const;
+
+    // 目录是否应被整体排除（不再向下遍历/监控）；relative_dir 为相对源路径
+    bool prunesDirectory(const std::string& relative_dir) const;
+
+    // 路径上是否有任一级目录被排除
+    bool isUnderPrunedDirectory(const std::string& relative_path) const;
+
+    // 只按扩展名/文件名规则判断
+    bool allowsName(const std::string& file_name) const;
+
+    // 是否配置了目录排除规则
+    bool hasDirectoryRules() const;
+
+    // 通用 glob 匹配：* 和 ? 不跨越目录分隔符，** 可跨越；忽略大小写，/ 与 \ 等价
+    static bool globMatch(const char* pattern, size_t pattern_len, const char* text, size_t text_len);
+
+private:
+    FilterMatcher() = default;
+
+    enum : uint8_t {
+        FLAG_WHITELIST = 1,   // 双列表模式白名单
+        FLAG_BLACKLIST = 2,   // 双列表模式黑名单
+        FLAG_LEGACY = 4       // 旧单模式扩展名列表
+    };
+
+    struct Slot {
+        std::string key;      // 小写扩展名或文件名，空表示空槽
+        uint8_t flags = 0;
+    };
+
+    enum class Mode { None, Whitelist, Blacklist, Dual };
+
+    void addName(const std::string& name, uint8_t flag);
+    void buildTable();
+    uint8_t lookup(const char* lower, size_t len) const;
+    static uint32_t hashKey(const char* data, size_t len, uint32_t seed);
+
+    bool matchesName(const char* name, size_t len) const;
+    bool matchesDirectoryName(const char* name, size_t len) const;
+
+    Mode mode_ = Mode::None;
+    bool has_whitelist_ = false;
+
+    // 完美哈希表：构建时搜索种子，使所有键落入不同槽位
+    std::vector<std::pair<std::string, uint8_t>> pending_names_;
+    std::vector<Slot> table_;
+    uint32_t seed_ = 0;
+    uint32_t mask_ = 0;
+
+    // 排除规则（均为小写）
+    std::vector<std::string> dir_names_;          // 无通配符的目录名，如 node_modules
+    std::vector<std::string> dir_name_globs_;     // 目录名通配符，如 cmake-build-*
+    std::vector<std::string> dir_path_globs_;     // 目录路径，如 docs/build
+    std::vector<std::string> file_name_globs_;    // 文件名通配符，如 *.min.js
+    std::vector<std::string> file_path_globs_;    // 文件路径通配符，如 docs/**/*.tmp
+
+    static constexpr size_t MAX_NAME_LEN = 255;
+};
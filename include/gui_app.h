@@ -9,6 +9,7 @@
 #include <efsw/efsw.hpp>
 #include "backup_handler.h"  // 假设这些头文件存在
 #include "config_loader.h"   // 假设这些头文件存在
+#include "event_trace.h"
 #include <nlohmann/json.hpp> // 假设你已正确包含 nlohmann/json
 
 // 托盘图标消息
@@ -23,6 +24,7 @@
 #define ID_TRAY_SETTINGS 1006
 #define ID_TRAY_PREVIEW 1008
 #define ID_TRAY_EXIT 1007
+#define ID_TRAY_TRACE 1009
 
 // 设置对话框控件ID
 #define IDC_LIST_SOURCES 2001
@@ -117,6 +119,7 @@ private:
     void showConfigDialog();
     void showSettingsDialog();
     void showPreviewDialog();
+    void exportTrace();
     
     // 配置
     bool loadConfiguration();
@@ -140,7 +143,9 @@ private:
     nlohmann::json presets_;
     
     std::vector<std::unique_ptr<BackupHandler>> handlers_;
-    std::unique_ptr<efsw::FileWatcher> file_watcher_;
+    std::unique_ptr<MetricsExporter> metrics_exporter_;
+    std::unique_ptr<WatchBackend> file_watcher_;
+    std::unique_ptr<EventTraceWriter> event_recorder_;   // 未启用 capture_events 时为空
 };
 
 } // 结束命名空间
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <shared_mutex>
+#include <atomic>
+#include <system_error>
+
+// 单个 .backupignore 文件编译后的规则（gitignore 语法）
+// - 空行和 # 开头的行忽略，\# 和 \! 转义
+// - ! 开头表示取反（重新包含）
+// - 以 / 结尾只匹配目录
+// - 含 / 的规则相对忽略文件所在目录匹配，否则匹配任意层级的名称
+class IgnoreFile {
+public:
+    // 读取并编译忽略文件；文件不存在时返回 nullptr 且 ec 为空
+    static std::shared_ptr<const IgnoreFile> load(const std::string& file_path, std::error_code& ec);
+    static std::shared_ptr<const IgnoreFile> parse(const std::string& content);
+
+    // 返回 1 表示排除，-1 表示被 ! 规则重新包含，0 表示没有规则匹配
+    // relative 为相对忽略文件所在目录的路径
+    int match(const char* relative, size_t len, bool is_dir) const;
+
+    size_t ruleCount() const { return rules_.size(); }
+
+private:
+    IgnoreFile() = default;
+
+    struct Rule {
+        std::string pattern;   // 小写，分隔符统一为 /
+        bool negate = false;
+        bool dir_only = false;
+        bool anchored = false; // 相对忽略文件所在目录匹配
+    };
+
+    std::vector<Rule> rules_;
+};
+
+// 按目录缓存的 .backupignore 规则树
+// 规则只在目录遍历或忽略文件变动时加载，查询只做 O(路径深度) 次哈希查找，不读文件
+class IgnoreTree {
+public:
+    static constexpr const char* FILE_NAME = ".backupignore";
+
+    // 重新加载 relative_dir 下的忽略文件（不存在时移除缓存），返回该目录是否有规则
+    bool reload(const std::string& relative_dir, const std::string& absolute_dir);
+
+    // 移除 relative_dir 及其子目录的缓存规则
+    void removeSubtree(const std::string& relative_dir);
+
+    // 相对源路径的文件或目录是否被忽略（任一级上级目录被忽略时同样视为忽略）
+    bool ignores(const std::string& relative_path, bool is_dir) const;
+
+    // 文件名是否为忽略文件
+    static bool isIgnoreFileName(const std::string& file_name);
+
+    size_t size() const { return count_.load(std::memory_order_relaxed); }
+
+private:
+    static std::string normalizeKey(const std::string& relative_dir);
+    static void normalizeKey(const std::string& relative_dir, std::string& key);
+
+    // 对 [0, end) 这一级做判定：从最深的忽略文件开始，第一个给出结论的规则生效
+    bool levelIgnored(const std::string& path, size_t end, bool is_dir,
+                      const std::vector<std::pair<size_t, const IgnoreFile*>>& files) const;
+
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<std::string, std::shared_ptr<const IgnoreFile>> files_;
+    std::atomic<size_t> count_{0};
+};
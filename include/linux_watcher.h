@@ -0,0 +1,128 @@
+#pragma once
+
+#ifdef __linux__
+
+#include "watch_backend.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Linux 原生监控后端
+// - inotify：每个目录一个 watch，wd -> 目录表为按 wd 下标的紧凑数组
+// - fanotify：对整个文件系统加一个标记（FAN_MARK_FILESYSTEM），按路径前缀分发给各监控根
+// 两种模式都一次读取大批事件并在批内合并重复事件；队列溢出时只重新扫描最近有活动的目录
+// inotify 的 IN_MOVED_FROM / IN_MOVED_TO 按 cookie 配对（可跨目录、跨多次读取），短时间内配不上的按移出处理
+class LinuxWatcher : public WatchBackend {
+public:
+    enum class Mode { Inotify, Fanotify };
+
+    explicit LinuxWatcher(Mode mode);
+    ~LinuxWatcher() override;
+
+    LinuxWatcher(const LinuxWatcher&) = delete;
+    LinuxWatcher& operator=(const LinuxWatcher&) = delete;
+
+    // 内核接口是否初始化成功
+    bool valid() const { return fd_ >= 0; }
+
+    efsw::WatchID addWatch(const std::string& directory, efsw::FileWatchListener* listener,
+                           bool recursive) override;
+    void removeWatch(efsw::WatchID watch_id) override;
+    void watch() override;
+    const char* name() const override;
+
+    size_t getOverflowCount() const { return overflow_count_.load(); }
+
+private:
+    struct Root {
+        std::string path;
+        efsw::FileWatchListener* listener = nullptr;
+        bool recursive = false;
+    };
+
+    // inotify wd 表项；root 为 0 表示空槽
+    struct DirEntry {
+        std::string path;
+        efsw::WatchID root = 0;
+    };
+
+    // 等待配对的 IN_MOVED_FROM
+    struct MoveFrom {
+        uint32_t cookie = 0;
+        efsw::WatchID root = 0;
+        std::string dir;
+        std::string name;
+        bool is_dir = false;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    // 一批读取中待分发的事件（在锁外分发）
+    struct Pending {
+        efsw::FileWatchListener* listener = nullptr;
+        efsw::WatchID watch_id = 0;
+        std::string dir;
+        std::string filename;
+        std::string old_filename;
+        efsw::Action action = efsw::Actions::Modified;
+    };
+
+    void run();
+
+    // inotify
+    size_t addDirectoryTree(const std::string& path, efsw::WatchID root, bool synthesize);
+    void removeDirectoryTree(const std::string& path);
+    void processInotify(const char* data, size_t len);
+    // 未配对的移出按删除分发：超时的全部处理，或只处理 dir/name 上的一条（同名路径又出现时先于新事件）
+    void expireMoves(std::chrono::steady_clock::time_point now);
+    void settleMove(const std::string& dir, const std::string& name);
+    void queueMovedAway(const MoveFrom& move);
+
+    // fanotify
+    bool resolveDirectory(const void* fsid, const void* handle, std::string& path);
+    void processFanotify(const char* data, size_t len);
+    efsw::WatchID findRoot(const std::string& dir);
+
+    void queueEvent(efsw::WatchID root, const std::string& dir, const std::string& filename,
+                    efsw::Action action, const std::string& old_filename = std::string());
+    void handleOverflow();
+    void flushPending();
+
+    Mode mode_;
+    int fd_ = -1;
+    int wake_fd_ = -1;
+
+    std::mutex mutex_;     // 保护 roots_、dirs_、handle_paths_、hot_dirs_、unmatched_moves_
+    std::unordered_map<efsw::WatchID, Root> roots_;
+    std::vector<DirEntry> dirs_;
+    std::unordered_map<std::string, efsw::WatchID> root_paths_;
+    std::unordered_map<std::string, std::string> handle_paths_;   // fanotify 目录句柄 -> 路径
+    std::unordered_map<uint64_t, int> mount_fds_;                 // st_dev -> 用于 open_by_handle_at 的目录
+    efsw::WatchID next_id_ = 1;
+
+    // 最近有事件的目录（溢出时定向重新扫描）
+    std::unordered_map<std::string, std::pair<efsw::WatchID, std::chrono::steady_clock::time_point>> hot_dirs_;
+
+    std::vector<MoveFrom> unmatched_moves_;
+
+    std::vector<Pending> pending_;
+    size_t pending_count_ = 0;
+    std::vector<std::pair<RescanListener*, std::string>> rescans_;
+    std::vector<char> buffer_;
+
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    std::atomic<size_t> overflow_count_{0};
+
+    static constexpr size_t READ_BUFFER_SIZE = 256 * 1024;
+    static constexpr size_t MAX_HANDLE_CACHE = 65536;
+    static constexpr size_t MAX_TARGETED_RESCANS = 64;
+    static constexpr int HOT_DIR_SECONDS = 10;
+    static constexpr int MOVE_PAIR_GRACE_MS = 100;   // 移出事件等待配对的时间
+};
+
+#endif // __linux__
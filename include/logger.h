@@ -2,13 +2,43 @@
 
 #include <string>
 #include <memory>
+#include <chrono>
 #include <spdlog/spdlog.h>
 
+namespace spdlog { namespace details { class thread_pool; } }
+
+// 日志输出方式
+struct LogOptions {
+    // 异步队列已满时的处理方式
+    enum class Overflow {
+        Block,        // 等待写入线程腾出空间（不丢日志）
+        DropOldest,   // 覆盖队列中最旧的消息
+        DropNew       // 丢弃新消息
+    };
+
+    bool async = true;                                // 调用线程只入队，由独立的写入线程格式化输出
+    size_t queue_size = 8192;                         // 异步队列容量（条），启动时一次性分配
+    Overflow overflow = Overflow::Block;
+    std::chrono::seconds flush_interval{1};           // 定时批量刷新；warning 及以上立即刷新
+    spdlog::level::level_enum level = spdlog::level::info;   // 低于此级别的日志不格式化也不入队
+};
+
 class Logger {
 public:
-    static void setup(const std::string& log_dir, bool use_daily_folder = false);
+    static void setup(const std::string& log_dir, bool use_daily_folder = false,
+                      const LogOptions& options = LogOptions());
     static std::shared_ptr<spdlog::logger> get();
 
+    // 该级别是否会输出；参数需要额外计算（构造路径字符串、stat 等）时先检查
+    static bool shouldLog(spdlog::level::level_enum level);
+
+    // 异步队列溢出丢弃的消息数
+    static size_t droppedMessages();
+
+    // 写出队列中剩余的消息并停止写入线程（程序退出前调用）
+    static void shutdown();
+
 private:
     static std::shared_ptr<spdlog::logger> logger_;
+    static std::shared_ptr<spdlog::details::thread_pool> thread_pool_;
 };
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+
+// 多线程目录扫描器
+// 每个工作线程维护自己的目录队列：从自己队列尾部取（深度优先，局部性好），
+// 空闲时从其他线程队列头部窃取（取走的是较浅、子树较大的目录），大小不均的目录树也能均衡负载
+class ParallelScanner {
+public:
+    struct Progress {
+        size_t directories = 0;
+        size_t files = 0;
+        std::chrono::milliseconds elapsed{0};
+        bool cancelled = false;
+    };
+
+    // 返回 false 时跳过该目录（不进入也不枚举）；根目录不经过过滤
+    using DirectoryFilter = std::function<bool(size_t worker, const std::filesystem::path& dir)>;
+    // 每个普通文件调用一次，worker 为工作线程编号 [0, threadCount())
+    using FileVisitor = std::function<void(size_t worker, const std::filesystem::directory_entry& entry)>;
+    using ProgressCallback = std::function<void(const Progress& progress)>;
+
+    // thread_count 为 0 时使用 CPU 核心数
+    explicit ParallelScanner(size_t thread_count = 0);
+
+    size_t threadCount() const { return thread_count_; }
+
+    // 每隔 interval 在调用线程上报告一次进度
+    void setProgressCallback(ProgressCallback callback,
+                             std::chrono::milliseconds interval = std::chrono::seconds(2));
+
+    // cancel 置位后尽快停止，此时结果不完整
+    void setCancelFlag(const std::atomic<bool>* cancel) { cancel_ = cancel; }
+
+    // 扫描 root 下的整棵目录树，阻塞直到完成；符号链接目录不进入
+    Progress scan(const std::filesystem::path& root, const DirectoryFilter& filter,
+                  const FileVisitor& visitor);
+
+private:
+    size_t thread_count_;
+    ProgressCallback progress_callback_;
+    std::chrono::milliseconds progress_interval_{2000};
+    const std::atomic<bool>* cancel_ = nullptr;
+};
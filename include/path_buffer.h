@@ -0,0 +1,93 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <memory_resource>
+#include <cstddef>
+
+// 事件到备份路径上的临时内存复用：稳定状态下处理一个事件不再向系统申请堆内存
+
+// 路径缓冲池：取出的缓冲至少预留 PATH_BUFFER_CAPACITY 字节，归还时只清空内容、保留容量
+// 非线程安全：线程私有的池用 local()，跨线程共享的池由调用方加锁
+class PathBufferPool {
+public:
+    static constexpr size_t PATH_BUFFER_CAPACITY = 512;
+    static constexpr size_t MAX_RETAINED_CAPACITY = 64 * 1024;  // 超长路径用过的缓冲不回收
+
+    explicit PathBufferPool(size_t max_buffers = 64);
+
+    std::string acquire();
+    void release(std::string&& buffer);
+
+    size_t size() const { return free_.size(); }
+
+    // 当前线程的池
+    static PathBufferPool& local();
+
+private:
+    std::vector<std::string> free_;
+    size_t max_buffers_;
+};
+
+// 从当前线程的池借用一个路径缓冲，离开作用域时归还
+class ScratchPath {
+public:
+    ScratchPath() : buffer_(PathBufferPool::local().acquire()) {}
+    ~ScratchPath() { PathBufferPool::local().release(std::move(buffer_)); }
+
+    ScratchPath(const ScratchPath&) = delete;
+    ScratchPath& operator=(const ScratchPath&) = delete;
+
+    std::string& str() { return buffer_; }
+    const std::string& str() const { return buffer_; }
+
+private:
+    std::string buffer_;
+};
+
+// 线程私有的线性分配区：一批处理期间只向后分配、不单独释放，整批结束后 reset
+// 内存块在 reset 后保留复用，批大小稳定后不再向系统申请
+class ThreadArena : public std::pmr::memory_resource {
+public:
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 256 * 1024;
+
+    explicit ThreadArena(size_t block_size = DEFAULT_BLOCK_SIZE);
+
+    ThreadArena(const ThreadArena&) = delete;
+    ThreadArena& operator=(const ThreadArena&) = delete;
+
+    // 复制字符串到分配区，返回的视图在 reset 之前有效
+    std::string_view copy(std::string_view text);
+
+    // 拼接目录与文件名（目录不以分隔符结尾时补上本地分隔符）
+    std::string_view joinPath(std::string_view dir, std::string_view filename);
+
+    // 丢弃本批所有分配（之前返回的指针和视图全部失效）
+    void reset();
+
+    size_t bytesUsed() const;
+    size_t capacity() const;
+
+    // 当前线程的分配区
+    static ThreadArena& local();
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+private:
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        size_t size = 0;
+    };
+
+    std::vector<Block> blocks_;
+    size_t current_ = 0;   // 正在分配的块
+    size_t offset_ = 0;    // 当前块内已用字节
+    size_t block_size_;
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <string>
+#include <ctime>
+#include <cstdint>
+#include <cstddef>
+
+// 平台相关的系统调用集中在这里，其余代码只使用标准库和这些接口
+// Windows 使用 Win32 / CryptoAPI，其他平台使用 POSIX 和内置的 SHA-256 实现
+namespace Platform {
+
+// ---- 时间 ----
+
+// 线程安全的本地时间转换（localtime_s / localtime_r）
+bool localTime(std::time_t time, std::tm& out);
+
+// ---- 文件标识 ----
+
+// FileInfo::mtime 每秒的刻度数
+#ifdef _WIN32
+constexpr int64_t FILE_TIME_TICKS_PER_SECOND = 10000000;
+#else
+constexpr int64_t FILE_TIME_TICKS_PER_SECOND = 1000000000;
+#endif
+
+struct FileInfo {
+    uint64_t size = 0;
+    int64_t mtime = 0;          // 平台原生精度：Windows 为 FILETIME（100ns），POSIX 为纳秒
+    uint64_t file_id = 0;       // Windows 文件索引 / inode
+    bool is_directory = false;
+};
+
+// 一次系统调用读取大小、修改时间和文件标识；既不是普通文件也不是目录时返回 false
+bool readFileInfo(const std::string& path, FileInfo& info);
+
+// 当前墙上时间，与 FileInfo::mtime 的单位和起点相同，可直接比较
+int64_t fileTimeNow();
+
+// path 所在文件系统写入修改时间的精度（FileInfo::mtime 的刻度数）：
+// FAT / exFAT（以及无法判断的 FUSE 挂载）为 2 秒；其余文件系统的时间戳虽然精确到纳秒或 100ns，
+// 取值来自系统的粗粒度时钟（Linux 的 jiffy、Windows 约 15.6 ms 的时钟中断），按 20 ms 计
+// 无法读取文件系统信息时保守地返回 2 秒
+int64_t timestampGranularity(const std::string& path);
+
+// ---- SHA-256 ----
+
+class Sha256 {
+public:
+    static constexpr size_t DIGEST_SIZE = 32;
+
+    Sha256();
+    ~Sha256();
+
+    Sha256(const Sha256&) = delete;
+    Sha256& operator=(const Sha256&) = delete;
+
+    // 任一步失败后 finish 返回 false
+    void update(const void* data, size_t size);
+    bool finish(uint8_t (&digest)[DIGEST_SIZE]);
+
+private:
+#ifdef _WIN32
+    uintptr_t provider_ = 0;
+    uintptr_t hash_ = 0;
+#else
+    void compress(const uint8_t* block);
+
+    uint32_t state_[8];
+    uint8_t buffer_[64];
+    size_t buffered_ = 0;
+    uint64_t total_bytes_ = 0;
+#endif
+    bool ok_ = true;
+};
+
+// ---- 文件读取提示 ----
+
+// 顺序读取整个文件：提示系统加大预读（FILE_FLAG_SEQUENTIAL_SCAN / POSIX_FADV_SEQUENTIAL / F_RDAHEAD）
+// 不丢弃页面缓存：刚保存的文件通常马上还要被编译器读取
+// 共享读写删除打开，备份读取期间不阻塞编辑器保存或改名
+class SequentialFile {
+public:
+    SequentialFile() = default;
+    ~SequentialFile();
+
+    SequentialFile(const SequentialFile&) = delete;
+    SequentialFile& operator=(const SequentialFile&) = delete;
+
+    bool open(const std::string& path);
+    // 返回读取的字节数，0 表示到达末尾，-1 表示出错
+    int64_t read(void* buffer, size_t size);
+    // 打开时的文件大小
+    uint64_t size() const { return size_; }
+    void close();
+
+private:
+#ifdef _WIN32
+    void* handle_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+    uint64_t size_ = 0;
+};
+
+// ---- 进程生命周期 ----
+
+// 主线程等到的控制请求：终止，或运行中导出跟踪
+struct ControlSignal {
+    bool dump_trace = false;   // true 表示导出请求（POSIX 上为 SIGUSR1，Windows 上为命名事件）
+    int signal = 0;            // 终止时的信号编号
+};
+
+// 在创建任何线程之前调用：POSIX 上屏蔽 SIGINT / SIGTERM / SIGHUP / SIGUSR1，由 waitForControlSignal 同步等待
+// （不在异步信号处理函数中加锁）；Windows 上安装控制台信号处理函数，并创建本进程的导出请求事件
+void prepareControlSignals();
+
+// 阻塞直到收到终止信号或导出请求
+ControlSignal waitForControlSignal();
+
+// 请求进程 pid 导出跟踪：Windows 上置位该进程的导出事件（不是本程序的进程没有这个事件），
+// POSIX 上等同于 kill -USR1 <pid>；失败时返回 false
+bool requestTraceDump(long pid);
+
+} // namespace Platform
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#ifdef CODEBACKUP_PROFILE
+#include <chrono>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CODEBACKUP_PROFILE_TSC 1
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define CODEBACKUP_PROFILE_TSC 1
+#endif
+#endif
+
+// 热路径插桩（性能分析用）
+// 以 CODEBACKUP_PROFILE 编译时 PROFILE_SCOPE 用 TSC 计时、PROFILE_COUNT 累加计数，按线程累计，退出时汇总到日志；
+// 未启用时两个宏展开为空语句，参数不会被求值
+namespace Profiler {
+
+struct Entry {
+    const char* name = nullptr;
+    uint64_t calls = 0;        // 计时次数（计数点为累加值）
+    uint64_t cycles = 0;       // 计数点为 0
+    double total_ms = 0.0;     // 按运行期间校准的 TSC 频率换算
+    double avg_ns = 0.0;
+};
+
+bool enabled();
+
+// 所有线程（含已退出线程）的累计值，按注册顺序
+std::vector<Entry> report();
+
+// 在日志中输出汇总（未启用或没有数据时不输出）
+void logReport();
+
+#ifdef CODEBACKUP_PROFILE
+
+constexpr size_t MAX_POINTS = 64;
+
+// 注册插桩点，返回编号；同名插桩点共用编号，超过 MAX_POINTS 后的插桩点计入最后一个
+uint32_t registerPoint(const char* name);
+
+// 当前线程的累计值加上一次记录
+void add(uint32_t point, uint64_t calls, uint64_t cycles);
+
+inline uint64_t readTimestamp() {
+#ifdef CODEBACKUP_PROFILE_TSC
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+class Scope {
+public:
+    explicit Scope(uint32_t point) : point_(point), start_(readTimestamp()) {}
+    ~Scope() { add(point_, 1, readTimestamp() - start_); }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    uint32_t point_;
+    uint64_t start_;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name)                                                                  \
+    static const uint32_t PROFILE_CONCAT(profile_point_, __LINE__) = ::Profiler::registerPoint(name); \
+    ::Profiler::Scope PROFILE_CONCAT(profile_scope_, __LINE__)(PROFILE_CONCAT(profile_point_, __LINE__))
+#define PROFILE_COUNT(name, n)                                                               \
+    do {                                                                                     \
+        static const uint32_t profile_point = ::Profiler::registerPoint(name);               \
+        ::Profiler::add(profile_point, static_cast<uint64_t>(n), 0);                         \
+    } while (0)
+
+#else
+
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_COUNT(name, n) ((void)0)
+
+#endif
+
+} // namespace Profiler
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <unordered_map>
+#include "backup_strategy.h"
+
+// 事件风暴检测：按子树统计事件速率，超过阈值后吸收该子树的后续事件，
+// 待子树平息后由调用方做一次快照扫描
+// 非线程安全，仅由摄取线程使用
+class StormDetector {
+public:
+    enum class Verdict {
+        Normal,        // 正常处理该事件
+        StormStarted,  // 该事件触发了风暴（事件本身也被吸收）
+        Absorbed       // 子树处于风暴中，事件被吸收
+    };
+
+    explicit StormDetector(const BackupStrategy& strategy);
+
+    // 记录一个事件；subtree_key 为事件所属子树（相对源路径，空字符串表示整个源）
+    Verdict observe(const std::string& subtree_key, std::chrono::steady_clock::time_point now);
+
+    // 强制将子树置为风暴状态（例如事件缓冲区溢出后需要整体重扫）
+    void forceStorm(const std::string& subtree_key, std::chrono::steady_clock::time_point now);
+
+    // 取出已平息（超过 settle 时间没有新事件）的风暴子树及其吸收的事件数
+    std::vector<std::pair<std::string, size_t>> takeSettled(std::chrono::steady_clock::time_point now);
+
+    size_t activeStorms() const;
+
+private:
+    struct SubtreeState {
+        std::chrono::steady_clock::time_point window_start;
+        std::chrono::steady_clock::time_point last_event;
+        size_t window_events = 0;
+        size_t absorbed = 0;
+        bool storming = false;
+    };
+
+    std::chrono::milliseconds window_;
+    std::chrono::milliseconds settle_;
+    size_t threshold_;
+    std::unordered_map<std::string, SubtreeState> subtrees_;
+    size_t active_storms_ = 0;
+};
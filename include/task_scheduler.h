@@ -0,0 +1,114 @@
+#pragma once
+
+#include <string>
+#include <array>
+#include <deque>
+#include <chrono>
+#include <optional>
+#include <cstdint>
+#include "backup_strategy.h"
+
+// 任务调度类别（数值越小优先级越高）
+enum class TaskClass {
+    Recent = 0,   // 最近频繁编辑的文件
+    Small = 1,    // 小文件
+    Normal = 2,   // 普通文件
+    Bulk = 3      // 大文件（批量通道，限制并发）
+};
+
+// 备份任务结构
+struct BackupTask {
+    std::string source_file_path;
+    std::chrono::steady_clock::time_point enqueue_time;
+    size_t file_size = 0;
+    TaskClass task_class = TaskClass::Normal;
+};
+
+// 每个类别的延迟统计（从入队到完成）
+struct ClassLatencyStats {
+    TaskClass task_class = TaskClass::Normal;
+    size_t completed = 0;
+    double avg_ms = 0.0;
+    double max_ms = 0.0;
+};
+
+// 单个文件的待处理状态：已在队列中 / 正在备份 / 备份中又被修改
+enum class PendingState : uint8_t { NotPending = 0, Queued, InFlight, InFlightDirty };
+
+// 防抖、合并、补做与重试退避规则（BackupHandler 与调度模拟共用同一份实现）
+namespace SchedulePolicy {
+constexpr int DEBOUNCE_SECONDS = 5;   // 同一文件 5 秒内只备份一次
+constexpr int MAX_RETRIES = 5;        // 文件被占用时最多尝试次数
+
+// 第 attempt 次（从 0 起）尝试失败后等待的秒数：1, 2, 4, 8
+constexpr int retryDelaySeconds(int attempt) {
+    return 1 << attempt;
+}
+
+// 防抖判定：last_backup_ms 为 0 表示从未备份；接受时 recently_edited 表示仍在最近编辑窗口内
+bool debounceAccepts(int64_t last_backup_ms, int64_t now_ms, int recent_edit_window_seconds,
+                     bool* recently_edited = nullptr);
+
+// 文件修改事件的处理结果
+enum class ModifyOutcome {
+    Coalesced,   // 已排队（排队的任务会读取最新内容）或正在备份（标记为脏，完成后补做一次）
+    Debounced,   // 防抖窗口内，跳过
+    Enqueue      // 已置为 Queued 并更新防抖时间，调用方应入队
+};
+
+// 修改事件：先看待处理状态，再做防抖判定
+ModifyOutcome admitModify(PendingState& pending, int64_t& last_backup_ms, int64_t now_ms,
+                          int recent_edit_window_seconds, bool* recently_edited = nullptr);
+
+// 任务出队、开始备份
+inline void startBackup(PendingState& pending) {
+    pending = PendingState::InFlight;
+}
+
+// 备份结束（无论成败）：备份期间又被修改时改回 Queued 并返回 true，调用方补做一次（且只做一次）
+bool finishBackup(PendingState& pending);
+}
+
+// 按大小和编辑热度分级的优先级调度器
+// 非线程安全，调用方需持有队列锁
+class TaskScheduler {
+public:
+    static constexpr size_t NUM_CLASSES = 4;
+
+    explicit TaskScheduler(const BackupStrategy& strategy);
+
+    // 根据文件大小和是否最近编辑过确定调度类别
+    TaskClass classify(size_t file_size, bool recently_edited) const;
+
+    void push(const BackupTask& task);
+    void push(BackupTask&& task);
+
+    // 取出下一个可执行任务；批量通道达到并发上限时跳过大文件
+    std::optional<BackupTask> pop(std::chrono::steady_clock::time_point now);
+
+    // 任务完成：释放批量通道名额并记录延迟
+    void complete(const BackupTask& task, std::chrono::steady_clock::time_point now);
+
+    bool hasRunnable() const;
+    bool empty() const;
+    size_t size() const;
+    
+    // 等待最久的任务的入队时间（用于弹性伸缩判断）
+    std::optional<std::chrono::steady_clock::time_point> oldestEnqueueTime() const;
+
+    std::array<ClassLatencyStats, NUM_CLASSES> getLatencyStats() const;
+
+    static const char* className(TaskClass task_class);
+
+private:
+    struct LatencyAccumulator {
+        size_t count = 0;
+        double total_ms = 0.0;
+        double max_ms = 0.0;
+    };
+
+    BackupStrategy strategy_;
+    std::array<std::deque<BackupTask>, NUM_CLASSES> lanes_;
+    std::array<LatencyAccumulator, NUM_CLASSES> latency_;
+    int bulk_in_flight_ = 0;
+};
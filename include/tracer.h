@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// 可选的流水线时间线跟踪，导出为 Chrome trace-event JSON（chrome://tracing、Perfetto 可直接打开）
+// - 每个线程写自己的环形缓冲区，只保留最近的事件；写入无锁，只有线程首次记录时注册一次
+// - 导出时逐条校验序号，正在被覆盖的槽位直接跳过，不阻塞写入线程
+// - 未启用时每个跟踪点只有一次原子读
+class Tracer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // events_per_thread 为每个线程保留的最近事件数
+    static void enable(size_t events_per_thread);
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    // 为当前线程命名（导出为 thread_name 元数据）
+    static void nameThread(const char* name);
+
+    // 完整的区间事件；category 和 name 必须是静态字符串，arg 非 0 时作为参数导出
+    static void complete(const char* category, const char* name,
+                         Clock::time_point start, Clock::time_point end, uint64_t arg = 0);
+
+    // 跨度不在同一调用栈内的区间（如排队等待），以 id 配对
+    static void asyncSpan(const char* category, const char* name, uint64_t id,
+                          Clock::time_point start, Clock::time_point end);
+
+    // 进程内唯一的异步区间 id
+    static uint64_t nextId();
+
+    // 写出所有线程缓冲区中的事件，返回写出的事件数（失败返回 0）
+    static size_t dump(const std::string& path);
+
+    // 按当前时间生成的导出文件名：trace_YYYYMMDD_HHMMSS.json
+    static std::string dumpFileName();
+
+    // 因缓冲区写满而被覆盖的事件数
+    static uint64_t overwrittenEvents();
+
+private:
+    static std::atomic<bool> enabled_;
+};
+
+// 作用域内的区间事件：未启用跟踪时不读时钟
+class TraceSpan {
+public:
+    TraceSpan(const char* category, const char* name, uint64_t arg = 0)
+        : category_(category), name_(name), arg_(arg), active_(Tracer::enabled()) {
+        if (active_) {
+            start_ = Tracer::Clock::now();
+        }
+    }
+    ~TraceSpan() {
+        if (active_) {
+            Tracer::complete(category_, name_, start_, Tracer::Clock::now(), arg_);
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* category_;
+    const char* name_;
+    uint64_t arg_;
+    bool active_;
+    Tracer::Clock::time_point start_;
+};
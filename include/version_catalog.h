@@ -0,0 +1,109 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <fstream>
+#include <optional>
+#include <vector>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+#include "clock.h"
+
+enum class CatalogOp { Backup, Alias, Delete };
+
+// 版本目录中的一条记录
+struct CatalogRecord {
+    CatalogOp op = CatalogOp::Backup;
+    std::string path;         // 相对源路径
+    std::string hash;         // 内容哈希
+    std::string stored_file;  // 备份文件，相对备份根目录
+    size_t size = 0;
+    int64_t time_ms = 0;      // 记录时间（Unix 毫秒）
+    bool missing = false;     // treeAt 校验时备份文件已不存在（保留策略之外被删除），无法还原
+};
+
+// 每个备份源一个的版本目录
+// 以追加写入、按时间排序的 JSON Lines 日志保存在 <备份根目录>/.catalog/ 下，启动时重放到内存索引
+// - backup：路径的新版本已写入 stored_file
+// - alias：移动/重命名或内容相同，新路径指向已有内容（from 为原路径）
+// - delete：墓碑，路径（或目录下的所有路径）在此时被删除
+// - prune：stored_file 已被保留策略删除，指向它的记录从历史中移除
+// 每个路径保留按时间排序的历史，任意时刻的目录树查询只需对每个路径二分查找，不扫描日期目录
+// 日志过长时把内存中的全部记录写成快照（首行记录快照时刻）并清空日志：
+// 记录时间严格递增，加载时日志中不晚于快照时刻的记录已包含在快照里，直接跳过，
+// 所以快照替换之后、日志删除之前中断也不会重复记录
+class VersionCatalog {
+public:
+    VersionCatalog(const std::string& backup_base_path, const std::string& source_path,
+                   Clock& clock = Clock::system());
+
+    void recordBackup(const std::string& relative_path, const std::string& hash,
+                      const std::string& stored_file, size_t size);
+    void recordAlias(const std::string& relative_path, const std::string& from_path,
+                     const std::string& hash, const std::string& stored_file, size_t size);
+
+    // 记录删除；relative_path 为目录时其下所有仍存在的路径一并记录，返回记录的路径数
+    size_t recordDelete(const std::string& relative_path);
+
+    // 路径的最新版本（已删除时返回空）
+    std::optional<CatalogRecord> findPath(const std::string& relative_path) const;
+
+    // 路径最后一次备份的内容，即使之后已被删除或移走
+    std::optional<CatalogRecord> findLastVersion(const std::string& relative_path) const;
+
+    // time_ms 时刻 prefix 目录下（空表示整个源）存在的所有文件及其当时的版本
+    // 保留策略删除的版本已随 prune 移除；verify_files 为 true 时再逐个检查备份文件，
+    // 其他原因丢失的标记 missing 并移出内容索引（用于还原前的查询，后台对账不检查）
+    std::vector<CatalogRecord> treeAt(int64_t time_ms, const std::string& prefix = std::string(),
+                                      bool verify_files = false);
+
+    // 持有该内容的最新备份文件
+    std::optional<CatalogRecord> findContent(const std::string& hash) const;
+
+    // 备份文件已不存在（被清理）时移除内容索引
+    void forgetContent(const std::string& hash);
+
+    // 版本文件已被保留策略删除（相对备份根目录）：记录 prune 并移除指向它们的记录
+    // relative_path 非空时只在该路径的历史中查找，否则查找所有路径；返回移除的记录数
+    size_t recordPruned(const std::vector<std::string>& stored_files,
+                        const std::string& relative_path = std::string());
+
+    // 写出快照并清空日志
+    bool compact();
+
+    // 日志记录数超过 max(COMPACT_MIN_RECORDS, 记录数 / 2) 时压缩
+    bool maybeCompact();
+
+    const std::string& journalPath() const { return journal_path_; }
+
+private:
+    void load();
+    // 重放一个 JSON Lines 文件，跳过不晚于 after_ms 的记录；返回应用的记录数
+    size_t replay(const std::string& path, int64_t after_ms, size_t& corrupt);
+    void apply(const nlohmann::json& entry);
+    void append(nlohmann::json& entry);
+    int64_t nextTimestamp();
+    size_t pruneLocked(const std::string& relative_path, const std::string& stored_file);
+    bool compactLocked();
+
+    // 遍历 relative_path 本身及其子路径的历史
+    template <typename Fn>
+    void forEachUnder(const std::string& relative_path, Fn&& fn);
+
+    std::string backup_base_path_;
+    std::string journal_path_;
+    std::string snapshot_path_;
+    std::ofstream journal_;
+    Clock* clock_;
+    size_t log_records_ = 0;      // 日志中（快照之后）的记录数
+    size_t record_count_ = 0;     // 内存中各路径历史的记录总数
+
+    mutable std::mutex mutex_;
+    std::map<std::string, std::vector<CatalogRecord>> history_;   // 路径 -> 按时间排序的记录
+    std::unordered_map<std::string, CatalogRecord> contents_;
+    int64_t last_time_ms_ = 0;
+
+    static constexpr size_t COMPACT_MIN_RECORDS = 4096;
+};
@@ -4,7 +4,11 @@
 #include <vector>
 #include <filesystem>
 #include <chrono>
+#include <ctime>
+#include <optional>
 #include "backup_strategy.h"
+#include "clock.h"
+#include "file_system.h"
 
 namespace fs = std::filesystem;
 
@@ -20,10 +24,12 @@ struct VersionInfo {
 
 class VersionManager {
 public:
-    VersionManager(const std::string& backup_base_path, const BackupStrategy& strategy);
+    // 过期判断和目录遍历通过 clock / file_system 进行，基准测试可传入模拟实现（须比本对象活得久）
+    VersionManager(const std::string& backup_base_path, const BackupStrategy& strategy,
+                   Clock& clock = Clock::system(), FileSystem& file_system = FileSystem::real());
     
-    // 清理过期版本
-    size_t cleanupOldVersions(const std::string& relative_path);
+    // 清理过期版本；removed 非空时追加被删除的版本文件
+    size_t cleanupOldVersions(const std::string& relative_path, std::vector<fs::path>* removed = nullptr);
     
     // 获取文件的所有版本
     std::vector<VersionInfo> getFileVersions(const std::string& relative_path);
@@ -35,17 +41,21 @@ public:
     int getNextVersionNumber(const std::string& relative_path);
     
     // 清理整个备份目录的过期版本
-    size_t cleanupAllOldVersions();
+    size_t cleanupAllOldVersions(std::vector<fs::path>* removed = nullptr);
     
     // 获取备份目录总大小
     size_t getTotalBackupSize();
+    
+    // 解析版本文件名，提取时间戳和版本号（读取文件大小，文件不存在时返回空）
+    std::optional<VersionInfo> parseVersionFile(const fs::path& file_path);
 
 private:
     std::string backup_base_path_;
     BackupStrategy strategy_;
+    Clock* clock_;
+    FileSystem* file_system_;
     
-    // 解析版本文件名，提取时间戳和版本号
-    std::optional<VersionInfo> parseVersionFile(const fs::path& file_path);
+    static VersionInfo makeVersionInfo(const fs::path& file_path, std::tm& tm, size_t file_size);
     
     // 检查版本是否过期
     bool isVersionExpired(const VersionInfo& version);
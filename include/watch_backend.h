@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <efsw/efsw.hpp>
+
+// 后端丢失事件（如 inotify 队列溢出）时通知监听者重新扫描目录
+// 监听者可选择实现，后端通过 dynamic_cast 检测
+class RescanListener {
+public:
+    virtual ~RescanListener() = default;
+    virtual void handleRescan(const std::string& dir) = 0;
+};
+
+// 文件监控后端：与 efsw::FileWatcher 相同的接口，事件通过 handleFileAction 上报
+class WatchBackend {
+public:
+    virtual ~WatchBackend() = default;
+
+    // 返回值 > 0 表示成功
+    virtual efsw::WatchID addWatch(const std::string& directory, efsw::FileWatchListener* listener,
+                                   bool recursive) = 0;
+    virtual void removeWatch(efsw::WatchID watch_id) = 0;
+
+    // 启动后台监控线程（不阻塞）
+    virtual void watch() = 0;
+
+    virtual const char* name() const = 0;
+};
+
+// efsw 通用后端
+class EfswWatchBackend : public WatchBackend {
+public:
+    efsw::WatchID addWatch(const std::string& directory, efsw::FileWatchListener* listener,
+                           bool recursive) override;
+    void removeWatch(efsw::WatchID watch_id) override;
+    void watch() override;
+    const char* name() const override { return "efsw"; }
+
+private:
+    efsw::FileWatcher watcher_;
+};
+
+// 按名称创建后端："efsw"（默认）、"inotify"、"fanotify"（仅 Linux）
+// 原生后端不可用时依次回退到 inotify、efsw
+std::unique_ptr<WatchBackend> createWatchBackend(const std::string& name);
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <mutex>
+
+// 进程内所有备份处理器共享的工作线程配额
+// 每个处理器的最少工作线程总能占用（可以超出容量），弹性扩容的线程只能在配额内申请，
+// 多个备份源同时繁忙时合计不超过容量，而不是每个源各自扩到 CPU 核心数
+class WorkerBudget {
+public:
+    // capacity 不大于 0 时取 CPU 核心数
+    explicit WorkerBudget(int capacity = 0);
+
+    // 无条件占用（处理器的最少工作线程）
+    void reserve(int count);
+    // 最多占用 count 个，返回实际得到的数量
+    int tryAcquire(int count);
+    void release(int count);
+
+    void setCapacity(int capacity);
+    int capacity() const;
+    int inUse() const;
+
+    // 进程共享的配额（默认容量为 CPU 核心数）
+    static WorkerBudget& shared();
+
+private:
+    mutable std::mutex mutex_;
+    int capacity_;
+    int in_use_ = 0;
+};
@@ -0,0 +1,60 @@
+#include "alloc_counter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+#ifdef CODEBACKUP_COUNT_ALLOCATIONS
+thread_local uint64_t t_allocations = 0;
+std::atomic<uint64_t> g_allocations{0};
+
+void* countedAlloc(std::size_t size) {
+    t_allocations++;
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = std::malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+#endif
+
+} // namespace
+
+#ifdef CODEBACKUP_COUNT_ALLOCATIONS
+void* operator new(std::size_t size) { return countedAlloc(size); }
+void* operator new[](std::size_t size) { return countedAlloc(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+#endif
+
+namespace AllocCounter {
+
+bool enabled() {
+#ifdef CODEBACKUP_COUNT_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+uint64_t threadAllocations() {
+#ifdef CODEBACKUP_COUNT_ALLOCATIONS
+    return t_allocations;
+#else
+    return 0;
+#endif
+}
+
+uint64_t totalAllocations() {
+#ifdef CODEBACKUP_COUNT_ALLOCATIONS
+    return g_allocations.load(std::memory_order_relaxed);
+#else
+    return 0;
+#endif
+}
+
+} // namespace AllocCounter
@@ -2,35 +2,119 @@
 #include "logger.h"
 #include "hash_utils.h"
 #include "compression_utils.h"
+#include "alloc_counter.h"
+#include "path_buffer.h"
+#include "tracer.h"
+#include "profiler.h"
+#include "event_trace.h"
+#include "platform.h"
 #include <filesystem>
 #include <chrono>
 #include <thread>
 #include <algorithm>
+#include <memory_resource>
+#include <unordered_set>
 
 namespace fs = std::filesystem;
 
+namespace {
+
+// 将作用域耗时（按处理器的时钟）累加到指定计数器（纳秒）；给出 metrics 时同时计入该阶段的延迟直方图，
+// 启用跟踪时再记录一个名为 trace_name 的区间
+class StageTimer {
+public:
+    StageTimer(const Clock& clock, std::atomic<uint64_t>& sink, const char* trace_name,
+               BackupMetrics* metrics = nullptr, BackupStage stage = BackupStage::Write)
+        : clock_(clock), sink_(sink), trace_name_(trace_name), metrics_(metrics), stage_(stage),
+          start_(clock.steadyNow()) {}
+    ~StageTimer() {
+        auto end = clock_.steadyNow();
+        auto elapsed = end - start_;
+        sink_ += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        if (metrics_) {
+            metrics_->record(stage_, elapsed);
+        }
+        if (Tracer::enabled()) {
+            Tracer::complete("backup", trace_name_, start_, end);
+        }
+    }
+
+private:
+    const Clock& clock_;
+    std::atomic<uint64_t>& sink_;
+    const char* trace_name_;
+    BackupMetrics* metrics_;
+    BackupStage stage_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// 拼接监控目录与文件名（efsw 给出的目录通常已带分隔符），写入调用方提供的缓冲
+void joinPath(const std::string& dir, const std::string& filename, std::string& path) {
+    path.clear();
+    path.reserve(dir.size() + filename.size() + 1);
+    path.append(dir);
+    if (!path.empty() && path.back() != '/' && path.back() != '\\') {
+        path.push_back(static_cast<char>(fs::path::preferred_separator));
+    }
+    path.append(filename);
+}
+
+std::string joinPath(const std::string& dir, const std::string& filename) {
+    std::string path;
+    joinPath(dir, filename, path);
+    return path;
+}
+
+// 按 std::filesystem 的规则拆分文件名的主干和扩展名（"." 开头的隐藏文件没有扩展名）
+void splitFileName(std::string_view relative_path, std::string_view& stem, std::string_view& ext) {
+    size_t name_pos = relative_path.find_last_of("/\\");
+    std::string_view name = name_pos == std::string_view::npos ? relative_path : relative_path.substr(name_pos + 1);
+    size_t dot = name.rfind('.');
+    if (dot == std::string_view::npos || dot == 0 || name == "..") {
+        stem = name;
+        ext = std::string_view();
+    } else {
+        stem = name.substr(0, dot);
+        ext = name.substr(dot);
+    }
+}
+
+} // namespace
+
 BackupHandler::BackupHandler(const std::string& source_path,
                              const std::string& dest_base_path,
-                             const FilterConfig& filter_config,
-                             const BackupStrategy& strategy)
+                             std::shared_ptr<const FilterMatcher> filter_matcher,
+                             const BackupStrategy& strategy,
+                             Clock& clock)
     : source_path_(source_path)
     , dest_base_path_(dest_base_path)
-    , filter_config_(filter_config)
+    , filter_matcher_(filter_matcher ? std::move(filter_matcher) : FilterMatcher::compile(FilterConfig()))
     , strategy_(strategy)
-    , version_manager_(std::make_unique<VersionManager>(dest_base_path, strategy)) {
+    , clock_(&clock)
+    , version_manager_(std::make_unique<VersionManager>(dest_base_path, strategy, clock))
+    , catalog_(std::make_unique<VersionCatalog>(dest_base_path, source_path, clock))
+      // 状态表与版本目录日志放在一起，每个备份源一个
+    , state_table_(std::make_unique<FileStateTable>(
+          fs::path(catalog_->journalPath()).replace_extension(".state").string(), strategy.state_max_entries))
+    , event_ring_(strategy.event_buffer_capacity)
+    , storm_detector_(strategy)
+    , scheduler_(strategy) {
+    timestamp_granularity_ = Platform::timestampGranularity(source_path);
+    state_table_->setTimestampGranularity(timestamp_granularity_);
 }
 
 BackupHandler::~BackupHandler() {
     stopAsyncBackup();
 }
 
-bool BackupHandler::shouldUseCompression(const std::string& file_path, size_t file_size) {
-    if (!strategy_.enable_compression) {
+bool BackupHandler::shouldUseCompression(const BackupStrategy& strategy, const std::string& file_path,
+                                         size_t file_size) {
+    if (!strategy.enable_compression) {
         return false;
     }
     
     // 小文件不压缩
-    if (file_size < strategy_.compression_threshold) {
+    if (file_size < strategy.compression_threshold) {
         return false;
     }
     
@@ -57,98 +141,703 @@ bool BackupHandler::shouldUseIncremental(const std::string& file_path, size_t fi
     return file_size >= strategy_.incremental_threshold;
 }
 
-std::optional<std::string> BackupHandler::getLastBackupHash(const std::string& relative_path) {
-    std::lock_guard<std::mutex> lock(hash_cache_mutex_);
+std::optional<std::string> BackupHandler::getLastBackupHash(std::string_view relative_path) {
+    auto stamp = state_table_->get(relative_path);
+    if (stamp && !stamp->hash.empty()) {
+        return stamp->hash;
+    }
     
-    auto it = file_hash_cache_.find(relative_path);
-    if (it != file_hash_cache_.end()) {
-        return it->second;
+    // 只记录过基线的文件，从版本目录取上次备份的哈希
+    auto record = catalog_->findPath(std::string(relative_path));
+    if (record) {
+        return record->hash;
     }
     
     return std::nullopt;
 }
 
+std::array<ClassLatencyStats, TaskScheduler::NUM_CLASSES> BackupHandler::getSchedulerStats() {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    return scheduler_.getLatencyStats();
+}
+
 size_t BackupHandler::cleanupOldVersions() {
     if (!version_manager_) {
         return 0;
     }
-    return version_manager_->cleanupAllOldVersions();
+    std::vector<fs::path> removed;
+    size_t deleted = version_manager_->cleanupAllOldVersions(&removed);
+    forgetPrunedVersions(removed, std::string());
+    return deleted;
+}
+
+void BackupHandler::forgetPrunedVersions(const std::vector<fs::path>& removed, const std::string& relative_path) {
+    if (removed.empty()) {
+        return;
+    }
+    std::vector<std::string> stored_files;
+    stored_files.reserve(removed.size());
+    for (const auto& file_path : removed) {
+        stored_files.push_back(file_path.lexically_relative(dest_base_path_).generic_string());
+    }
+    catalog_->recordPruned(stored_files, relative_path);
 }
 
 void BackupHandler::handleFileAction(efsw::WatchID watchid, const std::string& dir,
                                     const std::string& filename, efsw::Action action,
                                     std::string oldFilename) {
-    // 只处理修改和创建事件
-    if (action != efsw::Actions::Modified && action != efsw::Actions::Add) {
-        return;
+    // 监控线程上只写入原始事件，路径解析、过滤和 stat 都交给摄取线程
+    // 删除/移动事件也需要转交，用于维护目录监控和忽略规则缓存
+    if (event_recorder_) {
+        event_recorder_->record(event_source_id_, dir, filename, action, oldFilename);
     }
+    event_ring_.push(dir, filename, action, oldFilename);
+}
+
+void BackupHandler::handleRescan(const std::string& dir) {
+    if (event_recorder_) {
+        event_recorder_->record(event_source_id_, dir, std::string(), RESCAN_ACTION, std::string());
+    }
+    event_ring_.push(dir, std::string(), RESCAN_ACTION, std::string());
+}
+
+void BackupHandler::setEventRecorder(EventTraceWriter* recorder) {
+    event_recorder_ = recorder;
+    if (recorder) {
+        event_source_id_ = recorder->addSource(source_path_);
+    }
+}
 
-    std::string source_file_path = (fs::path(dir) / filename).string();
+bool BackupHandler::attachWatcher(WatchBackend& watcher) {
+    // 启动对账线程可能已在 ensureDirectoryWatch 中读取 watcher_
+    {
+        std::lock_guard<std::mutex> lock(watch_mutex_);
+        watcher_ = &watcher;
+    }
     
-    // 检查是否是目录（使用 error_code 避免异常）
     std::error_code ec;
-    if (fs::is_directory(source_file_path, ec) || ec) {
-        return;
+    if (!fs::is_directory(source_path_, ec)) {
+        per_directory_watches_ = false;
+        return watcher.addWatch(source_path_, this, false) > 0;
     }
+    
+    if (!filter_matcher_->hasDirectoryRules()) {
+        per_directory_watches_ = false;
+        efsw::WatchID watch_id = watcher.addWatch(source_path_, this, true);
+        if (watch_id > 0) {
+            std::lock_guard<std::mutex> lock(watch_mutex_);
+            dir_watches_[std::string()] = watch_id;
+        }
+        // 只遍历一次以加载各级 .backupignore
+        discoverDirectoryTree(source_path_, false);
+        return watch_id > 0;
+    }
+    
+    per_directory_watches_ = true;
+    discoverDirectoryTree(source_path_, false);
+    return getWatchCount() > 0;
+}
 
-    // 使用异步队列处理备份
-    enqueueBackup(source_file_path);
+size_t BackupHandler::getWatchCount() {
+    std::lock_guard<std::mutex> lock(watch_mutex_);
+    return dir_watches_.size();
 }
 
-bool BackupHandler::isAllowed(const std::string& file_path) const {
-    fs::path path(file_path);
-    std::string ext = path.extension().string();
-    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+bool BackupHandler::ensureDirectoryWatch(const std::string& dir_path) {
+    if (!per_directory_watches_) {
+        return false;
+    }
+    std::string key(relativeKey(dir_path));
+    
+    std::lock_guard<std::mutex> lock(watch_mutex_);
+    if (!watcher_ || dir_watches_.count(key)) {
+        return false;
+    }
+    
+    efsw::WatchID watch_id = watcher_->addWatch(dir_path, this, false);
+    if (watch_id <= 0) {
+        return false;
+    }
+    dir_watches_[key] = watch_id;
+    return true;
+}
+
+size_t BackupHandler::discoverDirectoryTree(const std::string& dir_path, bool enqueue_files,
+                                            const std::string* moved_from) {
+    size_t added = 0;
+    std::vector<fs::path> pending{fs::path(dir_path)};
     
-    // 优先使用双列表模式
-    if (filter_config_.useDualMode()) {
-        bool in_whitelist = false;
-        bool in_blacklist = false;
+    // 深度优先遍历，被排除的目录既不监控也不进入
+    // 先加载本目录的忽略文件再列出子目录，子目录判定时上级规则已就绪
+    while (!pending.empty()) {
+        fs::path dir = std::move(pending.back());
+        pending.pop_back();
         
-        // 检查白名单
-        if (!filter_config_.whitelist_extensions.empty()) {
-            in_whitelist = std::find(filter_config_.whitelist_extensions.begin(), 
-                                     filter_config_.whitelist_extensions.end(), 
-                                     ext) != filter_config_.whitelist_extensions.end();
+        std::string key(relativeKey(dir.string()));
+        if (!key.empty() && isDirectoryExcluded(key)) {
+            continue;
+        }
+        ignore_tree_.reload(key, dir.string());
+        if (ensureDirectoryWatch(dir.string())) {
+            added++;
         }
         
-        // 检查黑名单
-        if (!filter_config_.blacklist_extensions.empty()) {
-            in_blacklist = std::find(filter_config_.blacklist_extensions.begin(), 
-                                     filter_config_.blacklist_extensions.end(), 
-                                     ext) != filter_config_.blacklist_extensions.end();
+        std::error_code ec;
+        for (const auto& entry : fs::directory_iterator(dir, fs::directory_options::skip_permission_denied, ec)) {
+            std::error_code entry_ec;
+            if (entry.is_directory(entry_ec)) {
+                pending.push_back(entry.path());
+            } else if (enqueue_files && entry.is_regular_file(entry_ec)) {
+                // 新目录在注册监控前写入的文件不会产生事件，这里补上
+                std::string file_path = entry.path().string();
+                if (isAllowed(file_path)) {
+                    size_t file_size = static_cast<size_t>(entry.file_size(entry_ec));
+                    if (entry_ec) {
+                        continue;
+                    }
+                    // 目录整体移动：未改动的文件只记录别名，不重新复制
+                    if (moved_from) {
+                        std::string old_path = *moved_from + file_path.substr(dir_path.size());
+                        FileStamp stamp;
+                        if (readFileStamp(file_path, stamp) && tryRecordMove(old_path, file_path, stamp)) {
+                            continue;
+                        }
+                    }
+                    enqueueBackup(file_path, file_size);
+                }
+            }
+        }
+    }
+    
+    return added;
+}
+
+void BackupHandler::forgetPath(const std::string& relative_path, bool may_be_directory) {
+    if (state_table_->erase(relative_path) || !may_be_directory) {
+        return;
+    }
+    
+    // 被删除的是目录：清除其下所有文件（少见，线性扫描即可）
+    state_table_->eraseUnder(relative_path);
+}
+
+bool BackupHandler::tryRecordMove(const std::string& old_path, const std::string& new_path,
+                                  const FileStamp& stamp) {
+    std::string old_key(relativeKey(old_path));
+    std::string new_key(relativeKey(new_path));
+    
+    // 移动不会改变大小、修改时间和文件标识；与原路径上次备份时记录的一致才视为同一内容
+    auto hash = state_table_->cachedHash(old_key, stamp);
+    if (!hash) {
+        return false;
+    }
+    
+    // 原路径此时已记录墓碑，取它最后一次备份的内容
+    auto content = catalog_->findLastVersion(old_key);
+    if (!content || content->hash != *hash) {
+        return false;
+    }
+    
+    if (!linkExistingContent(fs::path(new_key), *content, new_path, stamp)) {
+        return false;
+    }
+    
+    state_table_->erase(old_key);
+    if (backup_observer_) {
+        backup_observer_(new_path, true, clock_->steadyNow());
+    }
+    return true;
+}
+
+bool BackupHandler::linkExistingContent(const fs::path& relative_path, const CatalogRecord& content,
+                                        const std::string& source_file_path, const FileStamp& stamp) {
+    fs::path stored = fs::path(dest_base_path_) / fs::path(content.stored_file);
+    std::error_code ec;
+    if (!fs::is_regular_file(stored, ec)) {
+        // 原备份已被清理
+        catalog_->forgetContent(content.hash);
+        return false;
+    }
+    
+    auto now = clock_->systemNow();
+    auto time_t = std::chrono::system_clock::to_time_t(now);
+    std::tm tm;
+    Platform::localTime(time_t, tm);
+    
+    char timestamp[32];
+    char today_str[32];
+    std::strftime(timestamp, sizeof(timestamp), "%Y%m%d_%H%M%S", &tm);
+    std::strftime(today_str, sizeof(today_str), "%Y-%m-%d", &tm);
+    
+    // 沿用原备份的压缩格式
+    bool compressed = stored.extension() == ".gz";
+    std::string versioned_filename = relative_path.stem().string() + "." + timestamp +
+                                     relative_path.extension().string() + (compressed ? ".gz" : "");
+    fs::path dest_directory = fs::path(dest_base_path_) / today_str / relative_path.parent_path();
+    fs::path dest_file_path = dest_directory / versioned_filename;
+    
+    {
+        StageTimer timer(*clock_, disk_busy_ns_, "link", &metrics_, BackupStage::Write);
+        fs::create_directories(dest_directory, ec);
+        if (!ec && fs::exists(dest_file_path, ec)) {
+            // 同一秒内的重复版本
+            if (fs::equivalent(stored, dest_file_path, ec)) {
+                ec.clear();
+            } else {
+                fs::remove(dest_file_path, ec);
+            }
         }
+        if (!ec && !fs::exists(dest_file_path, ec) && !ec) {
+            fs::create_hard_link(stored, dest_file_path, ec);
+        }
+    }
+    if (ec) {
+        // 目标文件系统不支持硬链接，交给常规备份
+        return false;
+    }
+    
+    std::string stored_file = dest_file_path.lexically_relative(dest_base_path_).generic_string();
+    catalog_->recordAlias(relative_path.string(), content.path, content.hash, stored_file,
+                          static_cast<size_t>(stamp.size));
+    
+    FileStamp linked = stamp;
+    linked.hash = content.hash;
+    std::string_view key = relativeKey(source_file_path);
+    state_table_->put(key, linked);
+    // 别名也算一次备份：随后到达的修改事件按防抖窗口处理，不会立即重新复制
+    int64_t now_ms = std::max<int64_t>(1, std::chrono::duration_cast<std::chrono::milliseconds>(
+        clock_->steadyNow().time_since_epoch()).count());
+    state_table_->update(key, [now_ms](FileRecord& record) {
+        record.last_backup_ms = now_ms;
+    });
+    aliased_backups_++;
+    
+    auto logger = Logger::get();
+    if (logger) {
+        logger->info("[{}] 内容未变，记录路径别名: {} -> {}", source_path_, content.path, relative_path.string());
+    }
+    return true;
+}
+
+bool BackupHandler::isDirectoryExcluded(const std::string& relative_dir) const {
+    return filter_matcher_->prunesDirectory(relative_dir) || ignore_tree_.ignores(relative_dir, true);
+}
+
+void BackupHandler::reloadIgnoreFile(const std::string& ignore_file_path) {
+    std::string dir = fs::path(ignore_file_path).parent_path().string();
+    bool has_rules = ignore_tree_.reload(std::string(relativeKey(dir)), dir);
+    
+    auto logger = Logger::get();
+    if (logger) {
+        logger->info("[{}] {} 忽略规则: {}", source_path_, has_rules ? "已重新加载" : "已移除", ignore_file_path);
+    }
+}
+
+void BackupHandler::removeDirectoryWatches(const std::string& dir_path) {
+    std::string key(relativeKey(dir_path));
+    
+    std::lock_guard<std::mutex> lock(watch_mutex_);
+    if (!watcher_ || key.empty()) {
+        return;
+    }
+    
+    for (auto it = dir_watches_.begin(); it != dir_watches_.end();) {
+        const std::string& watched = it->first;
+        bool under = watched.compare(0, key.size(), key) == 0 &&
+                     (watched.size() == key.size() || watched[key.size()] == '/' || watched[key.size()] == '\\');
+        if (under) {
+            watcher_->removeWatch(it->second);
+            it = dir_watches_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void BackupHandler::ingestLoop() {
+    Tracer::nameThread("ingest");
+    std::vector<RawFileEvent> batch;
+    auto last_state_compact = clock_->steadyNow();
+    
+    while (!should_stop_) {
+        event_ring_.waitForEvents(std::chrono::milliseconds(INGEST_INTERVAL_MS));
         
-        // 规则：
-        // 1. 如果在黑名单中，直接拒绝
-        // 2. 如果有白名单且不在白名单中，拒绝
-        // 3. 如果没有白名单，或在白名单中，允许
-        if (in_blacklist) {
-            return false;
+        size_t count = 0;
+        while (!should_stop_ && (count = event_ring_.drain(batch, INGEST_BATCH_SIZE)) > 0) {
+            ingestBatch(batch, count);
         }
         
-        if (!filter_config_.whitelist_extensions.empty()) {
-            return in_whitelist;
+        auto now = clock_->steadyNow();
+        
+        size_t dropped = event_ring_.takeDropped();
+        if (dropped > 0) {
+            // 丢失的事件无法追回，待事件平息后重新扫描整个源
+            storm_detector_.forceStorm(std::string(), now);
+            auto logger = Logger::get();
+            if (logger) {
+                logger->warn("[{}] 事件缓冲区溢出，丢弃了 {} 个事件，平息后将重新扫描", source_path_, dropped);
+            }
         }
         
-        return true;
+        if (storm_detector_.activeStorms() > 0) {
+            for (const auto& settled : storm_detector_.takeSettled(now)) {
+                if (should_stop_) {
+                    break;
+                }
+                snapshotSubtree(settled.first, settled.second);
+            }
+        }
+        
+        // 定期淘汰冷记录并压缩状态表的更新日志
+        if (now - last_state_compact >= std::chrono::seconds(STATE_COMPACT_INTERVAL_SECONDS)) {
+            last_state_compact = now;
+            state_table_->evictCold(std::chrono::seconds(STATE_EVICT_IDLE_SECONDS));
+            state_table_->maybeCompact();
+            catalog_->maybeCompact();
+        }
     }
+}
+
+void BackupHandler::subtreeKey(const std::string& dir, const std::string& filename, std::string& key) {
+    key.clear();
+    
+    // 相对源路径的部分（efsw 的文件名可能带有子目录）
+    size_t prefix = dir.compare(0, source_path_.size(), source_path_) == 0 ? source_path_.size() : 0;
+    auto& rel = storm_scratch_;
+    rel.assign(dir, prefix, std::string::npos);
+    rel.push_back('/');
+    rel.append(filename);
     
-    // 兼容旧的单模式
-    if (filter_config_.mode == FilterConfig::Mode::None) {
+    size_t start = rel.find_first_not_of("/\\");
+    if (start == std::string::npos) {
+        return;
+    }
+    
+    // 取前 storm_root_depth 级目录，最后一级（文件名本身）不计入
+    size_t key_end = start;
+    size_t next = start;
+    for (int depth = 0; depth < strategy_.storm_root_depth; ++depth) {
+        size_t sep = rel.find_first_of("/\\", next);
+        if (sep == std::string::npos) {
+            break;
+        }
+        key_end = sep;
+        next = rel.find_first_not_of("/\\", sep);
+        if (next == std::string::npos) {
+            break;
+        }
+    }
+    
+    key.assign(rel, start, key_end - start);
+    if (fs::path::preferred_separator != '/') {
+        std::replace(key.begin(), key.end(), '/', static_cast<char>(fs::path::preferred_separator));
+    }
+}
+
+std::string_view BackupHandler::relativeKey(const std::string& file_path) const {
+    size_t pos = file_path.compare(0, source_path_.size(), source_path_) == 0 ? source_path_.size() : 0;
+    while (pos < file_path.size() && (file_path[pos] == '/' || file_path[pos] == '\\')) {
+        pos++;
+    }
+    return std::string_view(file_path).substr(pos);
+}
+
+BackupHandler::ReconcileResult BackupHandler::reconcileSubtree(const std::string& subtree_key, bool enqueue_changes,
+                                                               const ParallelScanner::ProgressCallback& on_progress) {
+    TraceSpan span("reconcile", "reconcileSubtree");
+    ReconcileResult result;
+    fs::path root = subtree_key.empty() ? fs::path(source_path_) : fs::path(source_path_) / subtree_key;
+    
+    ParallelScanner scanner(static_cast<size_t>(std::max(0, strategy_.scan_threads)));
+    scanner.setCancelFlag(&should_stop_);
+    if (on_progress) {
+        scanner.setProgressCallback(on_progress);
+    }
+    
+    // 每个工作线程各自收集，结束后合并，扫描期间不争用锁
+    using ChangedList = std::vector<std::pair<std::string, size_t>>;
+    std::vector<ChangedList> changed(scanner.threadCount());
+    std::vector<std::vector<std::string>> seen(scanner.threadCount());
+    
+    ignore_tree_.reload(subtree_key, root.string());
+    ensureDirectoryWatch(root.string());
+    
+    // 先加载子目录的忽略文件再把它交给工作线程，其下文件判定时规则已就绪
+    // 扫描期间新建的目录在这里补上监控
+    auto filter = [this](size_t, const fs::path& dir) {
+        std::string dir_path = dir.string();
+        std::string key(relativeKey(dir_path));
+        if (isDirectoryExcluded(key)) {
+            return false;
+        }
+        ignore_tree_.reload(key, dir_path);
+        ensureDirectoryWatch(dir_path);
         return true;
+    };
+    
+    auto visitor = [&](size_t worker, const fs::directory_entry& entry) {
+        std::string file_path = entry.path().string();
+        if (!isAllowed(file_path)) {
+            return;
+        }
+        FileStamp stamp;
+        if (!readFileStamp(entry, stamp)) {
+            return;
+        }
+        std::string key(relativeKey(file_path));
+        if (!state_table_->matches(key, stamp)) {
+            if (enqueue_changes) {
+                changed[worker].emplace_back(std::move(file_path), static_cast<size_t>(stamp.size));
+            } else {
+                state_table_->put(key, stamp, false);
+            }
+        }
+        seen[worker].push_back(std::move(key));
+    };
+    
+    result.progress = scanner.scan(root, filter, visitor);
+    if (result.progress.cancelled) {
+        return result;   // 扫描不完整，不能据此判断删除
+    }
+    
+    std::unordered_set<std::string> present;
+    for (auto& keys : seen) {
+        result.scanned += keys.size();
+        for (auto& key : keys) {
+            present.insert(std::move(key));
+        }
+        keys.clear();
+    }
+    
+    for (const auto& list : changed) {
+        result.changed += list.size();
+        for (const auto& item : list) {
+            enqueueBackup(item.first, item.second);
+        }
     }
+    
+    // 扫描中没见到的已备份路径：磁盘上已不存在的补记墓碑（仅被新规则排除的保留）
+    auto vanished = [&](const std::string& key) {
+        if (present.count(key)) {
+            return false;
+        }
+        std::error_code exists_ec;
+        return !fs::exists(fs::path(source_path_) / key, exists_ec) && !exists_ec;
+    };
+    for (const auto& record : catalog_->treeAt(clock_->systemMillis(), subtree_key)) {
+        if (vanished(record.path)) {
+            result.deleted += catalog_->recordDelete(record.path);
+            forgetPath(record.path, false);
+        }
+    }
+    for (const auto& key : state_table_->keysUnder(subtree_key)) {
+        if (vanished(key)) {
+            state_table_->erase(key);
+        }
+    }
+    
+    return result;
+}
 
-    auto& exts = filter_config_.extensions;
-    bool found = std::find(exts.begin(), exts.end(), ext) != exts.end();
+void BackupHandler::reconcileOnStartup() {
+    Tracer::nameThread("reconcile");
+    auto logger = Logger::get();
+    
+    // 没有持久化的状态表（首次运行或状态表损坏）时无从比较，只记录基线
+    bool has_state = state_table_->load();
+    
+    std::error_code ec;
+    if (!strategy_.reconcile_on_startup || !fs::is_directory(source_path_, ec)) {
+        return;
+    }
+    
+    if (logger) {
+        logger->info("[{}] 启动对账扫描开始（已记录 {} 个文件状态{}）", source_path_, state_table_->size(),
+                    has_state ? "" : "，首次运行只记录基线");
+    }
+    
+    auto report = [this, &logger](const ParallelScanner::Progress& progress) {
+        if (logger) {
+            double seconds = std::max(0.001, progress.elapsed.count() / 1000.0);
+            logger->info("[{}] 对账扫描中: {} 个目录，{} 个文件（{:.0f} 文件/秒）",
+                        source_path_, progress.directories, progress.files, progress.files / seconds);
+        }
+    };
+    
+    ReconcileResult result = reconcileSubtree(std::string(), has_state, report);
+    if (result.progress.cancelled) {
+        return;
+    }
+    state_table_->maybeCompact();
+    catalog_->maybeCompact();
+    
+    if (logger) {
+        double seconds = std::max(0.001, result.progress.elapsed.count() / 1000.0);
+        logger->info("[{}] 启动对账扫描完成: {} 个目录，{} 个文件，{} 个有变化，{} 个已删除，耗时 {} ms（{:.0f} 文件/秒）",
+                    source_path_, result.progress.directories, result.scanned, result.changed, result.deleted,
+                    result.progress.elapsed.count(), result.progress.files / seconds);
+    }
+}
 
-    if (filter_config_.mode == FilterConfig::Mode::Whitelist) {
-        return found;
-    } else if (filter_config_.mode == FilterConfig::Mode::Blacklist) {
-        return !found;
+void BackupHandler::snapshotSubtree(const std::string& subtree_key, size_t absorbed_events) {
+    auto logger = Logger::get();
+    
+    fs::path root = subtree_key.empty() ? fs::path(source_path_) : fs::path(source_path_) / subtree_key;
+    std::error_code ec;
+    if (!fs::is_directory(root, ec)) {
+        return; // 子树已被删除或本身是文件
+    }
+    
+    // 被排除的目录（如 node_modules）里的风暴无需扫描
+    if (!subtree_key.empty() && (filter_matcher_->isUnderPrunedDirectory(subtree_key + "/") ||
+                                 ignore_tree_.ignores(subtree_key, true))) {
+        return;
     }
+    
+    ReconcileResult result = reconcileSubtree(subtree_key, true);
+    
+    if (logger) {
+        logger->info("[{}] 事件风暴已平息: {} (吸收 {} 个事件)，快照扫描 {} 个文件，{} 个有变化，{} 个已删除，耗时 {} ms",
+                    source_path_, root.string(), absorbed_events, result.scanned, result.changed, result.deleted,
+                    result.progress.elapsed.count());
+    }
+}
 
-    return true;
+void BackupHandler::ingestBatch(std::vector<RawFileEvent>& batch, size_t count) {
+    TraceSpan span("ingest", "ingestBatch", count);
+    uint64_t allocations_before = AllocCounter::threadAllocations();
+    auto now = clock_->steadyNow();
+    
+    // 批内去重集合及其中的路径都放在摄取线程的分配区里，整批处理完一起丢弃
+    ThreadArena& arena = ThreadArena::local();
+    arena.reset();
+    std::pmr::unordered_set<std::string_view> seen(&arena);
+    seen.reserve(count);
+    
+    for (size_t i = 0; i < count; ++i) {
+        const auto& event = batch[i];
+        
+        // 后端丢失了事件：把所在子树按风暴处理，平息后做快照扫描
+        if (event.action == RESCAN_ACTION) {
+            subtreeKey(event.dir, ".", storm_key_);
+            storm_detector_.forceStorm(storm_key_, now);
+            continue;
+        }
+        
+        // 风暴检测放在最前：风暴中的子树每个事件只做一次计数
+        subtreeKey(event.dir, event.filename, storm_key_);
+        auto verdict = storm_detector_.observe(storm_key_, now);
+        if (verdict == StormDetector::Verdict::StormStarted) {
+            auto logger = Logger::get();
+            if (logger) {
+                logger->info("[{}] 检测到事件风暴，暂停逐文件处理: {}", source_path_,
+                            storm_key_.empty() ? source_path_ : storm_key_);
+            }
+            continue;
+        }
+        if (verdict == StormDetector::Verdict::Absorbed) {
+            continue;
+        }
+        
+        // 忽略文件本身变动：重新编译所在目录的规则
+        if (IgnoreTree::isIgnoreFileName(event.filename)) {
+            reloadIgnoreFile(joinPath(event.dir, event.filename));
+        }
+        if (event.action == efsw::Actions::Moved && IgnoreTree::isIgnoreFileName(event.old_filename)) {
+            reloadIgnoreFile(joinPath(event.dir, event.old_filename));
+        }
+        
+        // 目录被删除或移走时注销其监控和缓存规则，移入的新目录按新建处理
+        if (event.action == efsw::Actions::Delete || event.action == efsw::Actions::Moved) {
+            ScratchPath gone_buffer;
+            ScratchPath gone_key_buffer;
+            std::string& gone = gone_buffer.str();
+            std::string& gone_key = gone_key_buffer.str();
+            joinPath(event.dir, event.action == efsw::Actions::Delete ? event.filename : event.old_filename, gone);
+            gone_key.assign(relativeKey(gone));
+            if (ignore_tree_.size() > 0) {
+                ignore_tree_.removeSubtree(gone_key);
+            }
+            if (per_directory_watches_) {
+                removeDirectoryWatches(gone);
+            }
+            // 原路径记录墓碑；移动时缓存的哈希和时间戳留给别名判断
+            size_t tombstoned = catalog_->recordDelete(gone_key);
+            if (event.action == efsw::Actions::Delete) {
+                // 同时清除防抖时间：删除后重新创建的文件不受防抖限制
+                forgetPath(gone_key, tombstoned > 0);
+                continue;
+            }
+        }
+        bool maybe_new_directory = event.action == efsw::Actions::Moved ||
+                                   (per_directory_watches_ && event.action == efsw::Actions::Add);
+        
+        // 批内去重：同一路径只处理一次
+        std::string_view joined = arena.joinPath(event.dir, event.filename);
+        if (!seen.insert(joined).second) {
+            continue;
+        }
+        std::string& source_file_path = ingest_path_;
+        source_file_path.assign(joined);
+        
+        FileStamp stamp;
+        bool is_directory = false;
+        bool has_stamp = false;
+        if (maybe_new_directory) {
+            // 新建项可能是目录（没有扩展名），需要先 stat
+            has_stamp = readFileStamp(source_file_path, stamp, &is_directory);
+            if (has_stamp && is_directory) {
+                if (!isDirectoryExcluded(std::string(relativeKey(source_file_path)))) {
+                    if (event.action == efsw::Actions::Moved) {
+                        std::string old_path = joinPath(event.dir, event.old_filename);
+                        discoverDirectoryTree(source_file_path, true, &old_path);
+                    } else {
+                        discoverDirectoryTree(source_file_path, true);
+                    }
+                }
+                continue;
+            }
+        }
+        
+        // 先按扩展名过滤，被过滤的路径不产生任何系统调用
+        if (!isAllowed(source_file_path)) {
+            continue;
+        }
+        
+        // 只对剩余路径 stat 一次，同时取得大小（用于调度分级）和移动判断需要的文件戳
+        if (!maybe_new_directory) {
+            has_stamp = readFileStamp(source_file_path, stamp, &is_directory);
+        }
+        if (!has_stamp || is_directory) {
+            continue;
+        }
+        size_t file_size = static_cast<size_t>(stamp.size);
+        
+        // 文件移动/重命名且内容未变：只记录别名
+        if (event.action == efsw::Actions::Moved &&
+            tryRecordMove(joinPath(event.dir, event.old_filename), source_file_path, stamp)) {
+            continue;
+        }
+        
+        // 使用异步队列处理备份
+        enqueueBackup(source_file_path, file_size);
+    }
+    
+    ingested_events_ += count;
+    event_allocations_ += AllocCounter::threadAllocations() - allocations_before;
+}
+
+bool BackupHandler::isAllowed(const std::string& file_path) const {
+    PROFILE_SCOPE("isAllowed");
+    // 相对源路径匹配，目录排除规则不会误伤源路径本身的上级目录
+    ScratchPath relative_buffer;
+    std::string& relative = relative_buffer.str();
+    relative.assign(relativeKey(file_path));
+    if (relative.empty()) {
+        // 源路径本身是单个文件
+        relative = fs::path(file_path).filename().string();
+    }
+    return filter_matcher_->allowsFile(relative) && !ignore_tree_.ignores(relative, false);
 }
 
 bool BackupHandler::isDriveAvailable(const std::string& path) const {
@@ -159,159 +848,473 @@ bool BackupHandler::isDriveAvailable(const std::string& path) const {
     return fs::exists(root, ec) && !ec;
 }
 
-bool BackupHandler::shouldBackup(const std::string& file_path) {
-    std::lock_guard<std::mutex> lock(debounce_mutex_);
+void BackupHandler::finishPendingTask(BackupTask& task) {
+    auto now = clock_->steadyNow();
     
-    auto now = std::chrono::steady_clock::now();
-    auto it = last_backup_time_.find(file_path);
+    // 备份期间文件又被修改：改回排队状态，补做一次（且只做一次）
+    bool requeued = state_table_->update(relativeKey(task.source_file_path), [](FileRecord& record) {
+        return SchedulePolicy::finishBackup(record.pending);
+    });
     
-    if (it != last_backup_time_.end()) {
-        auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
-            now - it->second).count();
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        scheduler_.complete(task, now);
         
-        if (elapsed < DEBOUNCE_SECONDS) {
-            skipped_backups_++;
-            return false; // 跳过重复备份
+        if (requeued) {
+            // 路径缓冲直接移交给补做的任务
+            BackupTask follow_up;
+            follow_up.source_file_path = std::move(task.source_file_path);
+            follow_up.enqueue_time = now;
+            follow_up.file_size = task.file_size;
+            follow_up.task_class = scheduler_.classify(task.file_size, true);
+            scheduler_.push(std::move(follow_up));
+        } else {
+            task_path_pool_.release(std::move(task.source_file_path));
         }
     }
     
-    last_backup_time_[file_path] = now;
-    return true;
+    // 批量通道释放名额后，可能有等待中的大文件可以执行
+    if (task.task_class == TaskClass::Bulk) {
+        queue_cv_.notify_all();
+    } else if (requeued) {
+        queue_cv_.notify_one();
+    }
 }
 
-void BackupHandler::enqueueBackup(const std::string& file_path) {
-    // 防抖动检查
-    if (!shouldBackup(file_path)) {
+void BackupHandler::enqueueBackup(const std::string& file_path, size_t file_size) {
+    PROFILE_SCOPE("enqueueBackup");
+    auto now = clock_->steadyNow();
+    int64_t now_ms = std::max<int64_t>(1, std::chrono::duration_cast<std::chrono::milliseconds>(
+        now.time_since_epoch()).count());
+    
+    // 排队状态和防抖时间在同一把分片锁内检查并更新，不同文件互不阻塞
+    // 已排队或正在备份的路径只做标记，不重复入队；其余按防抖规则判定
+    bool recently_edited = false;
+    bool accepted = state_table_->update(relativeKey(file_path), [&](FileRecord& record) {
+        return SchedulePolicy::admitModify(record.pending, record.last_backup_ms, now_ms,
+                                           strategy_.recent_edit_window_seconds, &recently_edited)
+            == SchedulePolicy::ModifyOutcome::Enqueue;
+    });
+    if (!accepted) {
+        skipped_backups_++;
         return;
     }
     
     BackupTask task;
-    task.source_file_path = file_path;
-    task.enqueue_time = std::chrono::steady_clock::now();
+    task.enqueue_time = now;
+    task.file_size = file_size;
+    task.task_class = scheduler_.classify(file_size, recently_edited);
     
     {
         std::lock_guard<std::mutex> lock(queue_mutex_);
-        backup_queue_.push(task);
+        // 任务路径使用池中回收的缓冲，任务完成时归还
+        task.source_file_path = task_path_pool_.acquire();
+        task.source_file_path.assign(file_path);
+        scheduler_.push(std::move(task));
     }
     queue_cv_.notify_one();
 }
 
-void BackupHandler::startAsyncBackup(int num_threads) {
+void BackupHandler::startAsyncBackup(int min_threads, int max_threads) {
     should_stop_ = false;
-    for (int i = 0; i < num_threads; ++i) {
-        worker_threads_.emplace_back([this] { processBackupQueue(); });
+    
+    int cores = static_cast<int>(std::thread::hardware_concurrency());
+    min_workers_ = std::max(1, min_threads);
+    max_workers_ = max_threads > 0 ? max_threads : std::max(1, cores);
+    max_workers_ = std::max(max_workers_, min_workers_);
+    
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        target_workers_ = min_workers_;
     }
+    // 最少工作线程不受配额限制，保证每个备份源都能推进
+    worker_budget_->reserve(min_workers_);
+    spawnWorkers(min_workers_);
+    
+    if (max_workers_ > min_workers_) {
+        autoscale_thread_ = std::thread([this] { autoscaleLoop(); });
+    }
+    
+    ingest_thread_ = std::thread([this] { ingestLoop(); });
+    reconcile_thread_ = std::thread([this] { reconcileOnStartup(); });
 }
 
 void BackupHandler::stopAsyncBackup() {
     should_stop_ = true;
+    event_ring_.wakeAll();
+    autoscale_cv_.notify_all();
     queue_cv_.notify_all();
     
-    for (auto& thread : worker_threads_) {
-        if (thread.joinable()) {
-            thread.join();
+    if (reconcile_thread_.joinable()) {
+        reconcile_thread_.join();
+    }
+    if (ingest_thread_.joinable()) {
+        ingest_thread_.join();
+    }
+    if (autoscale_thread_.joinable()) {
+        autoscale_thread_.join();
+    }
+    
+    std::lock_guard<std::mutex> workers_lock(workers_mutex_);
+    for (auto& slot : worker_threads_) {
+        if (slot->thread.joinable()) {
+            slot->thread.join();
         }
     }
     worker_threads_.clear();
+    
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        worker_budget_->release(live_workers_);
+        live_workers_ = 0;
+        target_workers_ = 0;
+    }
+    state_table_->compact();
+    
+    // 以 CODEBACKUP_COUNT_ALLOCATIONS 编译时报告事件到备份路径上的堆分配次数
+    auto logger = Logger::get();
+    if (logger && AllocCounter::enabled()) {
+        AllocationStats stats = getAllocationStats();
+        auto perItem = [](uint64_t allocations, uint64_t items) {
+            return items > 0 ? static_cast<double>(allocations) / items : 0.0;
+        };
+        logger->info("[{}] 堆分配统计: 每个事件 {:.2f} 次（{} 个事件），每个备份任务 {:.2f} 次（{} 个任务），"
+                    "每个写入新版本的文件 {:.2f} 次（{} 个文件）",
+                    source_path_, perItem(stats.event_allocations, stats.events), stats.events,
+                    perItem(stats.task_allocations, stats.tasks), stats.tasks,
+                    perItem(stats.written_allocations, stats.written), stats.written);
+    }
+}
+
+BackupHandler::AllocationStats BackupHandler::getAllocationStats() const {
+    AllocationStats stats;
+    stats.events = ingested_events_.load();
+    stats.event_allocations = event_allocations_.load();
+    stats.tasks = executed_tasks_.load();
+    stats.task_allocations = task_allocations_.load();
+    stats.written = written_tasks_.load();
+    stats.written_allocations = written_allocations_.load();
+    return stats;
+}
+
+int BackupHandler::getWorkerCount() {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    return live_workers_;
+}
+
+void BackupHandler::spawnWorkers(int count) {
+    std::lock_guard<std::mutex> workers_lock(workers_mutex_);
+    for (int i = 0; i < count; ++i) {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            live_workers_++;
+        }
+        auto slot = std::make_unique<WorkerSlot>();
+        WorkerSlot* raw = slot.get();
+        slot->thread = std::thread([this, raw] { processBackupQueue(raw); });
+        worker_threads_.push_back(std::move(slot));
+    }
+}
+
+void BackupHandler::reapFinishedWorkers() {
+    std::lock_guard<std::mutex> workers_lock(workers_mutex_);
+    auto it = std::remove_if(worker_threads_.begin(), worker_threads_.end(),
+        [](std::unique_ptr<WorkerSlot>& slot) {
+            if (!slot->finished) {
+                return false;
+            }
+            if (slot->thread.joinable()) {
+                slot->thread.join();
+            }
+            return true;
+        });
+    worker_threads_.erase(it, worker_threads_.end());
 }
 
-void BackupHandler::processBackupQueue() {
+void BackupHandler::autoscaleLoop() {
+    int cores = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    auto last_tick = clock_->steadyNow();
+    auto last_active = last_tick;
+    uint64_t last_wait_ns = queue_wait_ns_.load();
+    uint64_t last_dequeued = dequeued_tasks_.load();
+    uint64_t last_cpu_ns = cpu_busy_ns_.load();
+    uint64_t last_disk_ns = disk_busy_ns_.load();
+    
+    std::unique_lock<std::mutex> autoscale_lock(autoscale_mutex_);
+    while (!should_stop_) {
+        autoscale_cv_.wait_for(autoscale_lock, std::chrono::milliseconds(AUTOSCALE_INTERVAL_MS),
+                               [this] { return should_stop_.load(); });
+        if (should_stop_) {
+            break;
+        }
+        
+        auto now = clock_->steadyNow();
+        double interval_ns = static_cast<double>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_tick).count());
+        if (interval_ns <= 0) {
+            continue;
+        }
+        
+        uint64_t wait_ns = queue_wait_ns_.load();
+        uint64_t dequeued = dequeued_tasks_.load();
+        uint64_t cpu_ns = cpu_busy_ns_.load();
+        uint64_t disk_ns = disk_busy_ns_.load();
+        
+        int live = 0;
+        int target = 0;
+        size_t queued = 0;
+        std::optional<std::chrono::steady_clock::time_point> oldest;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            live = live_workers_;
+            target = target_workers_;
+            queued = scheduler_.size();
+            oldest = scheduler_.oldestEnqueueTime();
+        }
+        
+        // 排队等待：本周期出队任务的平均等待与当前最老任务的等待取较大者
+        uint64_t dequeued_delta = dequeued - last_dequeued;
+        double avg_wait_ms = dequeued_delta > 0 ? (wait_ns - last_wait_ns) / 1e6 / dequeued_delta : 0.0;
+        double oldest_wait_ms = oldest ? std::chrono::duration<double, std::milli>(now - *oldest).count() : 0.0;
+        double wait_ms = std::max(avg_wait_ms, oldest_wait_ms);
+        
+        // CPU 利用率按全部核心计算；磁盘繁忙度按每个工作线程在 I/O 上花费的时间比例计算
+        double cpu_util = (cpu_ns - last_cpu_ns) / (interval_ns * cores);
+        double disk_busy = (disk_ns - last_disk_ns) / (interval_ns * std::max(1, live));
+        
+        if (queued > 0 || dequeued_delta > 0) {
+            last_active = now;
+        }
+        
+        int new_target = target;
+        if (wait_ms > strategy_.scale_up_wait_ms && cpu_util < CPU_SATURATION && disk_busy < DISK_SATURATION) {
+            // 突发负载：按倍数扩容，尽快用满核心
+            new_target = std::min(max_workers_, std::max(target * 2, target + 1));
+        } else if (queued == 0 &&
+                   now - last_active > std::chrono::seconds(strategy_.scale_down_idle_seconds)) {
+            // 空闲：逐步减半，最终回落到 min_workers
+            new_target = std::max(min_workers_, target / 2);
+            last_active = now;
+        }
+        
+        if (new_target != target) {
+            int to_spawn = 0;
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex_);
+                to_spawn = std::max(0, new_target - live_workers_);
+                // 新增的线程向共享配额申请：其他备份源已占满时少扩或不扩
+                int granted = to_spawn > 0 ? worker_budget_->tryAcquire(to_spawn) : 0;
+                new_target -= to_spawn - granted;
+                to_spawn = granted;
+                target_workers_ = new_target;
+            }
+            if (to_spawn > 0) {
+                spawnWorkers(to_spawn);
+            } else {
+                queue_cv_.notify_all(); // 唤醒多余的线程退出
+            }
+            
+            auto logger = Logger::get();
+            if (logger && new_target != target) {
+                logger->debug("[{}] 工作线程 {} -> {} (等待 {:.0f} ms | CPU {:.0f}% | 磁盘 {:.0f}%)",
+                             source_path_, target, new_target, wait_ms, cpu_util * 100, disk_busy * 100);
+            }
+        }
+        
+        reapFinishedWorkers();
+        
+        last_tick = now;
+        last_wait_ns = wait_ns;
+        last_dequeued = dequeued;
+        last_cpu_ns = cpu_ns;
+        last_disk_ns = disk_ns;
+    }
+}
+
+void BackupHandler::processBackupQueue(WorkerSlot* slot) {
+    Tracer::nameThread("backup worker");
     while (!should_stop_) {
         BackupTask task;
         
         {
             std::unique_lock<std::mutex> lock(queue_mutex_);
             queue_cv_.wait(lock, [this] { 
-                return !backup_queue_.empty() || should_stop_; 
+                return scheduler_.hasRunnable() || should_stop_ || live_workers_ > target_workers_; 
             });
             
-            if (should_stop_ && backup_queue_.empty()) {
+            if (should_stop_ && scheduler_.empty()) {
                 break;
             }
             
-            if (!backup_queue_.empty()) {
-                task = backup_queue_.front();
-                backup_queue_.pop();
-            } else {
+            // 缩容：多余的线程直接退出，归还配额
+            if (!should_stop_ && live_workers_ > target_workers_) {
+                live_workers_--;
+                worker_budget_->release(1);
+                break;
+            }
+            
+            auto next = scheduler_.pop(clock_->steadyNow());
+            if (!next) {
                 continue;
             }
+            task = std::move(*next);
+        }
+        
+        // 出队到标记为备份中之间的修改只会被合并进这次备份，读取的仍是最新内容
+        state_table_->update(relativeKey(task.source_file_path), [](FileRecord& record) {
+            SchedulePolicy::startBackup(record.pending);
+        });
+        
+        auto started = clock_->steadyNow();
+        auto queue_wait = started - task.enqueue_time;
+        queue_wait_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(queue_wait).count();
+        dequeued_tasks_++;
+        metrics_.record(BackupStage::QueueWait, queue_wait);
+        if (Tracer::enabled()) {
+            Tracer::asyncSpan("queue", TaskScheduler::className(task.task_class), Tracer::nextId(),
+                              task.enqueue_time, task.enqueue_time + queue_wait);
         }
         
         // 处理备份任务
-        backupFile(task.source_file_path);
+        uint64_t allocations_before = AllocCounter::threadAllocations();
+        bool written = backupFile(task.source_file_path);
+        if (backup_observer_) {
+            backup_observer_(task.source_file_path, written, started);
+        }
+        finishPendingTask(task);
+        uint64_t allocations = AllocCounter::threadAllocations() - allocations_before;
+        executed_tasks_++;
+        task_allocations_ += allocations;
+        if (written) {
+            written_tasks_++;
+            written_allocations_ += allocations;
+        }
     }
+    
+    slot->finished = true;
 }
 
-void BackupHandler::backupFile(const std::string& source_file_path) {
-    // 检查源文件是否存在（使用 error_code 避免异常）
-    std::error_code ec;
-    if (!fs::exists(source_file_path, ec) || ec) {
-        return; // 文件可能已被删除或不可访问
-    }
-
+bool BackupHandler::backupFile(const std::string& source_file_path) {
+    TraceSpan backup_span("backup", "backupFile");
     if (!isAllowed(source_file_path)) {
-        return;
+        return false;
+    }
+    
+    // 一次 stat 取得大小、修改时间和文件标识（失败说明文件已被删除或不可访问）
+    // 在计算哈希之前读取：哈希期间文件再被修改时修改时间会变，缓存的哈希不会被误用
+    FileStamp stamp;
+    bool stat_ok;
+    {
+        TraceSpan stat_span("backup", "stat");
+        stat_ok = readFileStamp(source_file_path, stamp);
+    }
+    if (!stat_ok) {
+        return false;
     }
     
     // 检查文件大小限制
-    size_t file_size = fs::file_size(source_file_path, ec);
-    if (ec || file_size > strategy_.max_file_size) {
+    size_t file_size = static_cast<size_t>(stamp.size);
+    if (file_size > strategy_.max_file_size) {
         auto logger = Logger::get();
-        if (logger && file_size > strategy_.max_file_size) {
+        if (logger) {
             logger->warn("文件 {} 超过大小限制 ({} MB)，跳过备份", 
                         source_file_path, strategy_.max_file_size / 1048576);
         }
-        return;
+        return false;
+    }
+    
+    // 文件戳与上次备份时一致：内容未变，连哈希都不用算
+    std::string_view state_key = relativeKey(source_file_path);
+    if (state_table_->hasCachedHash(state_key, stamp)) {
+        auto logger = Logger::get();
+        if (logger) {
+            logger->debug("[{}] 文件戳未变化，跳过备份: {}", source_path_, source_file_path);
+        }
+        skipped_backups_++;
+        return false;
     }
 
     // 检查目标驱动器是否可用
     if (!isDriveAvailable(dest_base_path_)) {
         auto logger = Logger::get();
-        fs::path dest_path(dest_base_path_);
-        logger->warn("目标驱动器 {} 不可用，跳过此次备份: {}", 
-                    dest_path.root_path().string(), source_file_path);
-        return;
+        if (logger) {
+            fs::path dest_path(dest_base_path_);
+            logger->warn("目标驱动器 {} 不可用，跳过此次备份: {}", 
+                        dest_path.root_path().string(), source_file_path);
+        }
+        return false;
     }
 
     auto logger = Logger::get();
-    std::string log_prefix = "[" + source_path_ + "]";
-    logger->info("{} 检测到变动: {} ({:.2f} KB)", log_prefix, source_file_path, file_size / 1024.0);
+    if (logger) {
+        logger->info("[{}] 检测到变动: {} ({:.2f} KB)", source_path_, source_file_path, file_size / 1024.0);
+    }
 
     try {
-        fs::path source_path(source_file_path);
-        fs::path relative_path = fs::relative(source_path, source_path_);
+        // 相对路径直接取自源路径前缀之后的部分（源路径本身是单个文件时取文件名）
+        fs::path relative_path = state_key.empty() ? fs::path(source_file_path).filename() : fs::path(state_key);
         
         // 计算文件哈希（用于去重和增量备份）
-        auto current_hash = HashUtils::calculateFileHash(source_file_path);
+        std::optional<std::string> current_hash;
+        // 刚保存的文件：时间戳精度细的文件系统上先等过精度窗口（至多约 20 ms）再读取，
+        // 之后的任何修改都会得到更新的 mtime，这次的摘要可以直接凭文件戳复用；
+        // FAT 的 2 秒窗口不等待，摘要在下一次重新计算确认内容相同后才被信任
+        int64_t racy_wait = stamp.mtime + timestamp_granularity_ - Platform::fileTimeNow();
+        if (racy_wait >= 0 && timestamp_granularity_ < Platform::FILE_TIME_TICKS_PER_SECOND) {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(
+                (std::min(racy_wait, timestamp_granularity_) + 1) *
+                (1000000000LL / Platform::FILE_TIME_TICKS_PER_SECOND)));
+        }
+        // 在读取内容之前取哈希时刻：之后的修改若没有改变 mtime，也会因为落在精度窗口内而不被信任
+        stamp.hash_time = Platform::fileTimeNow();
+        {
+            StageTimer timer(*clock_, cpu_busy_ns_, "hash", &metrics_, BackupStage::Hash);
+            current_hash = HashUtils::calculateFileHash(source_file_path);
+        }
         if (!current_hash) {
-            logger->error("{} 无法计算文件哈希: {}", log_prefix, source_file_path);
+            if (logger) {
+                logger->error("[{}] 无法计算文件哈希: {}", source_path_, source_file_path);
+            }
             failed_backups_++;
-            return;
+            return false;
         }
+        stamp.hash = *current_hash;
         
         // 检查是否与上次备份相同
-        auto last_hash = getLastBackupHash(relative_path.string());
+        auto last_hash = getLastBackupHash(state_key);
         if (last_hash && *last_hash == *current_hash) {
-            logger->debug("{} 文件内容未变化，跳过备份: {}", log_prefix, source_file_path);
+            if (logger) {
+                logger->debug("[{}] 文件内容未变化，跳过备份: {}", source_path_, source_file_path);
+            }
+            state_table_->put(state_key, stamp);
             skipped_backups_++;
-            return;
+            return false;
+        }
+        
+        // 与已备份的其他路径内容相同（移动、复制或还原）：链接已有内容而不再复制
+        auto existing = catalog_->findContent(*current_hash);
+        if (existing && linkExistingContent(relative_path, *existing, source_file_path, stamp)) {
+            return true;
         }
         
-        std::string file_name = relative_path.stem().string();
-        std::string file_ext = relative_path.extension().string();
+        std::string_view file_name;
+        std::string_view file_ext;
+        splitFileName(state_key.empty() ? std::string_view(source_file_path) : state_key, file_name, file_ext);
 
         // 生成时间戳
-        auto now = std::chrono::system_clock::now();
+        auto now = clock_->systemNow();
         auto time_t = std::chrono::system_clock::to_time_t(now);
         std::tm tm;
-        localtime_s(&tm, &time_t);
+        Platform::localTime(time_t, tm);
         
         char timestamp[32];
         std::strftime(timestamp, sizeof(timestamp), "%Y%m%d_%H%M%S", &tm);
         
         // 决定是否使用压缩
-        bool use_compression = shouldUseCompression(source_file_path, file_size);
-        std::string versioned_filename = file_name + "." + timestamp + file_ext;
+        bool use_compression = shouldUseCompression(strategy_, source_file_path, file_size);
+        ScratchPath versioned_buffer;
+        std::string& versioned_filename = versioned_buffer.str();
+        versioned_filename.append(file_name).append(".").append(timestamp).append(file_ext);
         if (use_compression) {
             versioned_filename += ".gz";
         }
@@ -320,84 +1323,125 @@ void BackupHandler::backupFile(const std::string& source_file_path) {
         char today_str[32];
         std::strftime(today_str, sizeof(today_str), "%Y-%m-%d", &tm);
         
-        fs::path dest_directory = fs::path(dest_base_path_) / today_str / relative_path.parent_path();
-        fs::create_directories(dest_directory);
+        fs::path dest_directory = fs::path(dest_base_path_) / today_str;
+        dest_directory /= relative_path.parent_path();
+        {
+            StageTimer timer(*clock_, disk_busy_ns_, "mkdir");
+            fs::create_directories(dest_directory);
+        }
         
         fs::path dest_file_path = dest_directory / versioned_filename;
+        
+        // 目标可能是同一秒内记录的别名，与旧备份共用硬链接：先断开链接再写入，
+        // 否则截断写入会改掉其他版本的内容
+        auto unlinkDestination = [](const fs::path& path) {
+            std::error_code unlink_ec;
+            fs::remove(path, unlink_ec);
+        };
 
-        // 指数退避重试机制
-        int delay = 1;
+        // 指数退避重试机制（等待 1, 2, 4, 8 秒）
         bool backup_success = false;
         
         for (int attempt = 0; attempt < MAX_RETRIES; ++attempt) {
             try {
                 if (use_compression) {
                     // 压缩备份
-                    auto result = CompressionUtils::compressFile(
-                        source_file_path, 
-                        dest_file_path.string(),
-                        strategy_.compression_level
-                    );
+                    std::optional<std::string> result;
+                    unlinkDestination(dest_file_path);
+                    {
+                        StageTimer timer(*clock_, cpu_busy_ns_, "compress", &metrics_, BackupStage::Compress);
+                        result = CompressionUtils::compressFile(
+                            source_file_path, 
+                            dest_file_path.string(),
+                            strategy_.compression_level
+                        );
+                    }
                     
                     if (result) {
                         compressed_backups_++;
                         backup_success = true;
-                        logger->info("{} 压缩备份成功 -> {} (压缩率: {:.1f}%)", 
-                                   log_prefix, dest_file_path.string(),
-                                   (1.0 - fs::file_size(dest_file_path) / (double)file_size) * 100);
+                        // 压缩率需要再 stat 一次，级别关闭时不计算
+                        if (logger && Logger::shouldLog(spdlog::level::info)) {
+                            logger->info("[{}] 压缩备份成功 -> {} (压缩率: {:.1f}%)", 
+                                       source_path_, dest_file_path.string(),
+                                       (1.0 - fs::file_size(dest_file_path) / (double)file_size) * 100);
+                        }
                     } else {
-                        logger->warn("{} 压缩失败，使用普通备份", log_prefix);
+                        if (logger) {
+                            logger->warn("[{}] 压缩失败，使用普通备份", source_path_);
+                        }
                         // 降级到普通备份
-                        dest_file_path = dest_directory / (file_name + "." + timestamp + file_ext);
+                        versioned_filename.resize(versioned_filename.size() - 3);   // 去掉 .gz
+                        dest_file_path = dest_directory / versioned_filename;
+                        unlinkDestination(dest_file_path);
+                        StageTimer timer(*clock_, disk_busy_ns_, "copy", &metrics_, BackupStage::Write);
                         fs::copy_file(source_file_path, dest_file_path, 
                                     fs::copy_options::overwrite_existing);
                         backup_success = true;
                     }
                 } else {
                     // 普通备份
-                    fs::copy_file(source_file_path, dest_file_path, 
-                                fs::copy_options::overwrite_existing);
+                    unlinkDestination(dest_file_path);
+                    {
+                        StageTimer timer(*clock_, disk_busy_ns_, "copy", &metrics_, BackupStage::Write);
+                        fs::copy_file(source_file_path, dest_file_path, 
+                                    fs::copy_options::overwrite_existing);
+                    }
                     backup_success = true;
-                    logger->info("{} 版本备份成功 -> {}", log_prefix, dest_file_path.string());
+                    if (logger && Logger::shouldLog(spdlog::level::info)) {
+                        logger->info("[{}] 版本备份成功 -> {}", source_path_, dest_file_path.string());
+                    }
                 }
                 
                 if (backup_success) {
                     // 更新统计信息
                     total_backups_++;
                     total_bytes_ += file_size;
+                    metrics_.recordWritten(file_size);
                     
-                    // 更新哈希缓存
-                    {
-                        std::lock_guard<std::mutex> lock(hash_cache_mutex_);
-                        file_hash_cache_[relative_path.string()] = *current_hash;
-                    }
+                    // 更新文件状态表（哈希缓存）和版本目录
+                    state_table_->put(state_key, stamp);
+                    catalog_->recordBackup(relative_path.string(), *current_hash,
+                                           dest_file_path.lexically_relative(dest_base_path_).generic_string(),
+                                           file_size);
                     
                     // 清理旧版本
                     if (version_manager_) {
-                        size_t deleted = version_manager_->cleanupOldVersions(relative_path.string());
-                        if (deleted > 0) {
-                            logger->debug("{} 清理了 {} 个旧版本", log_prefix, deleted);
+                        StageTimer timer(*clock_, disk_busy_ns_, "cleanup", &metrics_, BackupStage::Cleanup);
+                        std::vector<fs::path> removed;
+                        size_t deleted = version_manager_->cleanupOldVersions(relative_path.string(), &removed);
+                        // 版本目录同步移除指向已删除文件的记录
+                        forgetPrunedVersions(removed, relative_path.string());
+                        if (deleted > 0 && logger) {
+                            logger->debug("[{}] 清理了 {} 个旧版本", source_path_, deleted);
                         }
                     }
                     
-                    return;
+                    return true;
                 }
             } catch (const fs::filesystem_error& e) {
                 if (attempt < MAX_RETRIES - 1) {
-                    logger->warn("{} 文件被占用，将在 {} 秒后重试... (尝试 {}/{})",
-                               log_prefix, delay, attempt + 2, MAX_RETRIES);
-                    std::this_thread::sleep_for(std::chrono::seconds(delay));
-                    delay *= 2; // 指数增长: 1, 2, 4, 8, 16 秒
+                    int delay = SchedulePolicy::retryDelaySeconds(attempt);
+                    if (logger) {
+                        logger->warn("[{}] 文件被占用，将在 {} 秒后重试... (尝试 {}/{})",
+                                   source_path_, delay, attempt + 2, MAX_RETRIES);
+                    }
+                    clock_->sleepFor(std::chrono::seconds(delay));
                 } else {
                     failed_backups_++;
-                    logger->error("{} 备份文件 {} 失败，文件持续被占用: {}",
-                                log_prefix, source_file_path, e.what());
+                    if (logger) {
+                        logger->error("[{}] 备份文件 {} 失败，文件持续被占用: {}",
+                                    source_path_, source_file_path, e.what());
+                    }
                 }
             }
         }
     } catch (const std::exception& e) {
         failed_backups_++;
-        logger->error("{} 处理事件 {} 时发生严重错误: {}",
-                     log_prefix, source_file_path, e.what());
+        if (logger) {
+            logger->error("[{}] 处理事件 {} 时发生严重错误: {}",
+                         source_path_, source_file_path, e.what());
+        }
     }
+    return false;
 }
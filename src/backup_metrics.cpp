@@ -0,0 +1,399 @@
+#include "backup_metrics.h"
+#include "logger.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char* const STAGE_NAMES[MetricsSnapshot::NUM_STAGES] = {
+    "queue_wait", "hash", "compress", "write", "cleanup"
+};
+
+// 最高有效位的位置（v > 0）
+unsigned highestBit(uint64_t v) {
+    unsigned bit = 0;
+    for (unsigned step = 32; step > 0; step >>= 1) {
+        if (v >> step) {
+            v >>= step;
+            bit += step;
+        }
+    }
+    return bit;
+}
+
+void atomicMax(std::atomic<uint64_t>& target, uint64_t value) {
+    uint64_t current = target.load(std::memory_order_relaxed);
+    while (current < value &&
+           !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+// 各线程固定使用的分片编号，按线程创建顺序轮流分配
+size_t threadShardIndex() {
+    static std::atomic<size_t> next_index{0};
+    thread_local size_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+    return index % BackupMetrics::NUM_SHARDS;
+}
+
+double toMillis(uint64_t micros) {
+    return micros / 1000.0;
+}
+
+nlohmann::json stageJson(const LatencyHistogram& histogram) {
+    return {
+        {"count", histogram.count()},
+        {"mean_ms", histogram.meanMicros() / 1000.0},
+        {"p50_ms", toMillis(histogram.percentile(0.50))},
+        {"p90_ms", toMillis(histogram.percentile(0.90))},
+        {"p99_ms", toMillis(histogram.percentile(0.99))},
+        {"p999_ms", toMillis(histogram.percentile(0.999))},
+        {"max_ms", toMillis(histogram.maxMicros())}
+    };
+}
+
+// Prometheus 标签值需要转义反斜杠、双引号和换行（Windows 路径里有反斜杠）
+std::string escapeLabel(const std::string& value) {
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            escaped.push_back('\\');
+            escaped.push_back(c);
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else {
+            escaped.push_back(c);
+        }
+    }
+    return escaped;
+}
+
+struct SourceReport {
+    std::string label;
+    MetricsSnapshot snapshot;
+    double files_per_second = 0.0;   // 最近一个导出周期
+    double bytes_per_second = 0.0;
+};
+
+nlohmann::json reportJson(const SourceReport& report) {
+    nlohmann::json stages = nlohmann::json::object();
+    for (size_t i = 0; i < MetricsSnapshot::NUM_STAGES; ++i) {
+        stages[STAGE_NAMES[i]] = stageJson(report.snapshot.stages[i]);
+    }
+    return {
+        {"source", report.label},
+        {"uptime_seconds", report.snapshot.uptime_seconds},
+        {"files", report.snapshot.files},
+        {"bytes", report.snapshot.bytes},
+        {"files_per_second", report.files_per_second},
+        {"bytes_per_second", report.bytes_per_second},
+        {"avg_files_per_second", report.snapshot.filesPerSecond()},
+        {"avg_bytes_per_second", report.snapshot.bytesPerSecond()},
+        {"stages", stages}
+    };
+}
+
+void appendPrometheus(std::ostringstream& out, const std::vector<SourceReport>& reports) {
+    static const double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+
+    out << "# HELP codebackup_stage_latency_seconds Backup pipeline stage latency.\n";
+    out << "# TYPE codebackup_stage_latency_seconds summary\n";
+    for (const auto& report : reports) {
+        std::string source = escapeLabel(report.label);
+        for (size_t i = 0; i < MetricsSnapshot::NUM_STAGES; ++i) {
+            const LatencyHistogram& histogram = report.snapshot.stages[i];
+            std::string labels = "source=\"" + source + "\",stage=\"" + STAGE_NAMES[i] + "\"";
+            for (double q : QUANTILES) {
+                out << "codebackup_stage_latency_seconds{" << labels << ",quantile=\"" << q << "\"} "
+                    << histogram.percentile(q) / 1e6 << "\n";
+            }
+            out << "codebackup_stage_latency_seconds_sum{" << labels << "} " << histogram.sumMicros() / 1e6 << "\n";
+            out << "codebackup_stage_latency_seconds_count{" << labels << "} " << histogram.count() << "\n";
+        }
+    }
+
+    auto series = [&](const char* name, const char* type, const char* help, auto value) {
+        out << "# HELP " << name << " " << help << "\n";
+        out << "# TYPE " << name << " " << type << "\n";
+        for (const auto& report : reports) {
+            out << name << "{source=\"" << escapeLabel(report.label) << "\"} " << value(report) << "\n";
+        }
+    };
+    series("codebackup_backed_up_files_total", "counter", "Files written as new versions.",
+           [](const SourceReport& r) { return r.snapshot.files; });
+    series("codebackup_backed_up_bytes_total", "counter", "Source bytes written as new versions.",
+           [](const SourceReport& r) { return r.snapshot.bytes; });
+    series("codebackup_files_per_second", "gauge", "Files per second over the last export interval.",
+           [](const SourceReport& r) { return r.files_per_second; });
+    series("codebackup_bytes_per_second", "gauge", "Bytes per second over the last export interval.",
+           [](const SourceReport& r) { return r.bytes_per_second; });
+}
+
+bool writeFileAtomically(const std::string& path, const std::string& content) {
+    std::error_code ec;
+    fs::create_directories(fs::path(path).parent_path(), ec);
+    std::string temp_path = path + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        file.write(content.data(), static_cast<std::streamsize>(content.size()));
+        file.flush();
+        if (!file) {
+            return false;
+        }
+    }
+    fs::rename(temp_path, path, ec);
+    return !ec;
+}
+
+} // namespace
+
+// ---- LatencyHistogram ----
+
+size_t LatencyHistogram::bucketFor(uint64_t micros) {
+    micros = std::min(micros, MAX_TRACKABLE);
+    if (micros < 2 * SUB_BUCKETS) {
+        return static_cast<size_t>(micros);
+    }
+    unsigned magnitude = highestBit(micros) - SUB_BUCKET_BITS;
+    return magnitude * SUB_BUCKETS + static_cast<size_t>(micros >> magnitude);
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t index) {
+    if (index < 2 * SUB_BUCKETS) {
+        return index;
+    }
+    unsigned magnitude = static_cast<unsigned>(index / SUB_BUCKETS) - 1;
+    uint64_t base = index - magnitude * SUB_BUCKETS;
+    return ((base + 1) << magnitude) - 1;
+}
+
+void LatencyHistogram::record(uint64_t micros) {
+    counts_[bucketFor(micros)]++;
+    count_++;
+    sum_ += micros;
+    max_ = std::max(max_, micros);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        counts_[i] += other.counts_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    max_ = std::max(max_, other.max_);
+}
+
+void LatencyHistogram::addSummary(uint64_t sum, uint64_t max) {
+    sum_ += sum;
+    max_ = std::max(max_, max);
+}
+
+uint64_t LatencyHistogram::percentile(double q) const {
+    if (count_ == 0) {
+        return 0;
+    }
+    q = std::clamp(q, 0.0, 1.0);
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * count_ + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        seen += counts_[i];
+        if (seen >= rank) {
+            // 桶上界可能超过实际最大值
+            return std::min(bucketUpperBound(i), max_);
+        }
+    }
+    return max_;
+}
+
+// ---- MetricsSnapshot ----
+
+void MetricsSnapshot::merge(const MetricsSnapshot& other) {
+    for (size_t i = 0; i < NUM_STAGES; ++i) {
+        stages[i].merge(other.stages[i]);
+    }
+    files += other.files;
+    bytes += other.bytes;
+    uptime_seconds = std::max(uptime_seconds, other.uptime_seconds);
+}
+
+// ---- BackupMetrics ----
+
+BackupMetrics::BackupMetrics()
+    : shards_(std::make_unique<Shard[]>(NUM_SHARDS))
+    , started_(std::chrono::steady_clock::now()) {
+    for (size_t s = 0; s < NUM_SHARDS; ++s) {
+        Shard& shard = shards_[s];
+        for (auto& stage : shard.buckets) {
+            for (auto& bucket : stage) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+        }
+        for (size_t i = 0; i < MetricsSnapshot::NUM_STAGES; ++i) {
+            shard.sum[i].store(0, std::memory_order_relaxed);
+            shard.max[i].store(0, std::memory_order_relaxed);
+        }
+        shard.files.store(0, std::memory_order_relaxed);
+        shard.bytes.store(0, std::memory_order_relaxed);
+    }
+}
+
+BackupMetrics::Shard& BackupMetrics::localShard() {
+    return shards_[threadShardIndex()];
+}
+
+void BackupMetrics::record(BackupStage stage, std::chrono::nanoseconds elapsed) {
+    uint64_t micros = static_cast<uint64_t>(std::max<int64_t>(0,
+        std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+    size_t s = static_cast<size_t>(stage);
+    Shard& shard = localShard();
+    shard.buckets[s][LatencyHistogram::bucketFor(micros)].fetch_add(1, std::memory_order_relaxed);
+    shard.sum[s].fetch_add(micros, std::memory_order_relaxed);
+    atomicMax(shard.max[s], micros);
+}
+
+void BackupMetrics::recordWritten(uint64_t bytes) {
+    Shard& shard = localShard();
+    shard.files.fetch_add(1, std::memory_order_relaxed);
+    shard.bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+MetricsSnapshot BackupMetrics::snapshot() const {
+    MetricsSnapshot snapshot;
+    for (size_t s = 0; s < NUM_SHARDS; ++s) {
+        const Shard& shard = shards_[s];
+        for (size_t i = 0; i < MetricsSnapshot::NUM_STAGES; ++i) {
+            LatencyHistogram& histogram = snapshot.stages[i];
+            for (size_t b = 0; b < LatencyHistogram::NUM_BUCKETS; ++b) {
+                uint64_t n = shard.buckets[i][b].load(std::memory_order_relaxed);
+                if (n > 0) {
+                    histogram.addBucket(b, n);
+                }
+            }
+            histogram.addSummary(shard.sum[i].load(std::memory_order_relaxed),
+                                 shard.max[i].load(std::memory_order_relaxed));
+        }
+        snapshot.files += shard.files.load(std::memory_order_relaxed);
+        snapshot.bytes += shard.bytes.load(std::memory_order_relaxed);
+    }
+    snapshot.uptime_seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - started_).count();
+    return snapshot;
+}
+
+const char* BackupMetrics::stageName(BackupStage stage) {
+    return STAGE_NAMES[static_cast<size_t>(stage)];
+}
+
+// ---- MetricsExporter ----
+
+MetricsExporter::MetricsExporter(std::string output_dir, std::chrono::seconds interval)
+    : json_path_((fs::path(output_dir) / "metrics.json").string())
+    , prom_path_((fs::path(output_dir) / "metrics.prom").string())
+    , interval_(std::max(interval, std::chrono::seconds(1))) {
+}
+
+MetricsExporter::~MetricsExporter() {
+    stop();
+}
+
+void MetricsExporter::addSource(std::string label, Source source) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    SourceState state;
+    state.label = std::move(label);
+    state.source = std::move(source);
+    sources_.push_back(std::move(state));
+}
+
+void MetricsExporter::start() {
+    if (thread_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(wait_mutex_);
+        stopping_ = false;
+    }
+    thread_ = std::thread(&MetricsExporter::run, this);
+}
+
+void MetricsExporter::stop() {
+    if (!thread_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(wait_mutex_);
+        stopping_ = true;
+    }
+    wait_cv_.notify_all();
+    thread_.join();
+    exportNow();
+}
+
+void MetricsExporter::run() {
+    std::unique_lock<std::mutex> lock(wait_mutex_);
+    while (!wait_cv_.wait_for(lock, interval_, [this] { return stopping_; })) {
+        lock.unlock();
+        exportNow();
+        lock.lock();
+    }
+}
+
+bool MetricsExporter::exportNow() {
+    std::vector<SourceReport> reports;
+    SourceReport total;
+    total.label = "total";
+    std::string json_text;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = std::chrono::steady_clock::now();
+        for (auto& state : sources_) {
+            SourceReport report;
+            report.label = state.label;
+            report.snapshot = state.source();
+            if (state.has_last) {
+                double seconds = std::chrono::duration<double>(now - state.last_time).count();
+                if (seconds > 0) {
+                    report.files_per_second = (report.snapshot.files - state.last.files) / seconds;
+                    report.bytes_per_second = (report.snapshot.bytes - state.last.bytes) / seconds;
+                }
+            }
+            state.last = report.snapshot;
+            state.last_time = now;
+            state.has_last = true;
+
+            total.snapshot.merge(report.snapshot);
+            total.files_per_second += report.files_per_second;
+            total.bytes_per_second += report.bytes_per_second;
+            reports.push_back(std::move(report));
+        }
+
+        nlohmann::json root;
+        root["timestamp_ms"] = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        root["sources"] = nlohmann::json::array();
+        for (const auto& report : reports) {
+            root["sources"].push_back(reportJson(report));
+        }
+        root["total"] = reportJson(total);
+        json_text = root.dump(2);
+    }
+
+    // 合计只放在 JSON 里：Prometheus 侧由查询自行 sum()，多一条合计序列会被重复计入
+    std::ostringstream prom;
+    prom << std::setprecision(9);
+    appendPrometheus(prom, reports);
+
+    bool ok = writeFileAtomically(json_path_, json_text) && writeFileAtomically(prom_path_, prom.str());
+    if (!ok) {
+        auto logger = Logger::get();
+        if (logger) {
+            logger->warn("无法写出指标文件: {}", json_path_);
+        }
+    }
+    return ok;
+}
@@ -0,0 +1,562 @@
+#include "capacity_planner.h"
+#include "backup_handler.h"
+#include "compression_utils.h"
+#include "filter_matcher.h"
+#include "ignore_rules.h"
+#include "parallel_scanner.h"
+#include "platform.h"
+#include "task_scheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <sstream>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// 扩展名样本少于此数时使用整个备份源的平均压缩率
+constexpr uint64_t MIN_EXTENSION_SAMPLES = 3;
+// 报告中按字节数列出的扩展名个数
+constexpr size_t REPORTED_EXTENSIONS = 15;
+constexpr int MAX_WORKING_SET_DAYS = 3650;
+
+double seconds(std::chrono::steady_clock::duration duration) {
+    return std::chrono::duration<double>(duration).count();
+}
+
+double inverse(double rate) {
+    return rate > 0 ? 1.0 / rate : 0.0;
+}
+
+double megabytes(uint64_t bytes) {
+    return bytes / 1048576.0;
+}
+
+// 相对源路径的键（与 BackupHandler::relativeKey 相同：去掉源路径前缀和其后的分隔符）
+std::string relativeTo(const std::string& root, const std::string& path) {
+    size_t pos = path.compare(0, root.size(), root) == 0 ? root.size() : 0;
+    while (pos < path.size() && (path[pos] == '/' || path[pos] == '\\')) {
+        pos++;
+    }
+    return path.substr(pos);
+}
+
+std::string lowerExtension(const fs::path& path) {
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(::tolower(c)); });
+    return ext;
+}
+
+void accumulate(CapacityPlanner::ExtensionStats& total, const CapacityPlanner::ExtensionStats& stats) {
+    total.files += stats.files;
+    total.bytes += stats.bytes;
+    total.compressed_bytes += stats.compressed_bytes;
+    total.working_files += stats.working_files;
+    total.working_bytes += stats.working_bytes;
+    total.working_compressed_bytes += stats.working_compressed_bytes;
+    total.ratio_sum += stats.ratio_sum;
+    total.ratio_weight += stats.ratio_weight;
+    total.samples += stats.samples;
+}
+
+} // namespace
+
+CapacityPlanner::CapacityPlanner(const Config& config, const nlohmann::json& presets, CapacityPlanOptions options)
+    : config_(config)
+    , presets_(presets)
+    , options_(options) {
+}
+
+int CapacityPlanner::workerCount() const {
+    if (options_.workers > 0) {
+        return options_.workers;
+    }
+    if (config_.strategy.max_workers > 0) {
+        return config_.strategy.max_workers;
+    }
+    return static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+size_t CapacityPlanner::scanSource(const BackupSource& source, SourcePlan& plan, std::vector<Sample>& samples) {
+    // 与备份处理器和图形界面预览相同的过滤规则
+    auto matcher = ConfigLoader::compileFilters(source.presets, presets_, source.custom_filter);
+    IgnoreTree ignore_tree;
+
+    const BackupStrategy& strategy = config_.strategy;
+    ParallelScanner scanner(static_cast<size_t>(std::max(0, strategy.scan_threads)));
+
+    // 每个工作线程各自累计并维护自己的抽样水库，结束后合并
+    struct WorkerState {
+        std::unordered_map<std::string, ExtensionStats> extensions;
+        size_t pruned = 0;
+        size_t filtered = 0;
+        size_t oversized = 0;
+        size_t candidates = 0;
+        uint64_t bulk_bytes = 0;
+        std::vector<Sample> reservoir;   // 按键的小顶堆
+        std::mt19937_64 rng;
+    };
+    std::vector<WorkerState> workers(scanner.threadCount());
+    for (size_t i = 0; i < workers.size(); ++i) {
+        workers[i].rng.seed(0x9e3779b97f4a7c15ULL + i);
+    }
+    auto heap_order = [](const Sample& a, const Sample& b) { return a.key > b.key; };
+
+    const std::string& root = source.path;
+    // working_set_days <= 0 表示全部文件都算工作集；天数过大时限制在 10 年内，避免文件时钟下溢
+    bool all_working = options_.working_set_days <= 0;
+    auto working_since = fs::file_time_type::clock::now() -
+                         std::chrono::hours(24) * std::min(options_.working_set_days, MAX_WORKING_SET_DAYS);
+
+    ignore_tree.reload("", root);
+    auto filter = [&](size_t worker, const fs::path& dir) {
+        std::string dir_path = dir.string();
+        std::string key = relativeTo(root, dir_path);
+        if (matcher->prunesDirectory(key) || ignore_tree.ignores(key, true)) {
+            workers[worker].pruned++;
+            return false;
+        }
+        ignore_tree.reload(key, dir_path);
+        return true;
+    };
+
+    auto visitor = [&](size_t worker, const fs::directory_entry& entry) {
+        WorkerState& state = workers[worker];
+        std::string file_path = entry.path().string();
+        std::string key = relativeTo(root, file_path);
+        if (!matcher->allowsFile(key) || ignore_tree.ignores(key, false)) {
+            state.filtered++;
+            return;
+        }
+        std::error_code ec;
+        uint64_t size = entry.file_size(ec);
+        if (ec) {
+            return;
+        }
+        if (size > strategy.max_file_size) {
+            state.oversized++;
+            return;
+        }
+        auto mtime = entry.last_write_time(ec);
+        bool working = all_working || (!ec && mtime >= working_since);
+        bool compressed = BackupHandler::shouldUseCompression(strategy, file_path, static_cast<size_t>(size));
+
+        std::string extension = lowerExtension(entry.path());
+        ExtensionStats& stats = state.extensions[extension];
+        stats.files++;
+        stats.bytes += size;
+        if (compressed) {
+            stats.compressed_bytes += size;
+        }
+        if (working) {
+            stats.working_files++;
+            stats.working_bytes += size;
+            if (compressed) {
+                stats.working_compressed_bytes += size;
+            }
+        }
+        if (size >= strategy.bulk_file_threshold) {
+            state.bulk_bytes += size;
+        }
+
+        // 按大小加权的水库抽样（A-Res）：键为 ln(u)/大小，保留键最大的若干个
+        if (!compressed || size == 0 || options_.sample_files == 0) {
+            return;
+        }
+        state.candidates++;
+        double u = std::uniform_real_distribution<double>(std::nextafter(0.0, 1.0), 1.0)(state.rng);
+        double sample_key = std::log(u) / static_cast<double>(size);
+        if (state.reservoir.size() < options_.sample_files) {
+            state.reservoir.push_back({sample_key, size, std::move(file_path), std::move(extension)});
+            std::push_heap(state.reservoir.begin(), state.reservoir.end(), heap_order);
+        } else if (sample_key > state.reservoir.front().key) {
+            std::pop_heap(state.reservoir.begin(), state.reservoir.end(), heap_order);
+            state.reservoir.back() = {sample_key, size, std::move(file_path), std::move(extension)};
+            std::push_heap(state.reservoir.begin(), state.reservoir.end(), heap_order);
+        }
+    };
+
+    auto progress = scanner.scan(root, filter, visitor);
+    plan.directories = progress.directories;
+    plan.scan_seconds = progress.elapsed.count() / 1000.0;
+
+    size_t candidates = 0;
+    for (auto& state : workers) {
+        candidates += state.candidates;
+        plan.pruned_directories += state.pruned;
+        plan.filtered_files += state.filtered;
+        plan.oversized_files += state.oversized;
+        plan.bulk_bytes += state.bulk_bytes;
+        for (const auto& [extension, stats] : state.extensions) {
+            accumulate(plan.extensions[extension], stats);
+        }
+        for (auto& sample : state.reservoir) {
+            samples.push_back(std::move(sample));
+        }
+    }
+    if (samples.size() > options_.sample_files) {
+        std::nth_element(samples.begin(), samples.begin() + options_.sample_files, samples.end(),
+                         [](const Sample& a, const Sample& b) { return a.key > b.key; });
+        samples.resize(options_.sample_files);
+    }
+    return candidates;
+}
+
+void CapacityPlanner::measureSamples(SourcePlan& plan, const std::vector<Sample>& samples, bool census) {
+    if (samples.empty()) {
+        return;
+    }
+    // 每个线程读取样本文件的前 sample_bytes 字节，分别计时读取、哈希和压缩（与备份相同的压缩级别）
+    struct WorkerResult {
+        Throughput throughput;
+        std::vector<std::pair<const Sample*, double>> ratios;   // 样本 -> 压缩率
+    };
+    size_t thread_count = std::min<size_t>(samples.size(), std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<WorkerResult> results(thread_count);
+    std::atomic<size_t> next{0};
+
+    auto work = [&](WorkerResult& result) {
+        std::vector<uint8_t> buffer;
+        for (size_t i = next++; i < samples.size(); i = next++) {
+            const Sample& sample = samples[i];
+            Platform::SequentialFile file;
+            if (!file.open(sample.path)) {
+                continue;
+            }
+            buffer.resize(static_cast<size_t>(std::min<uint64_t>(file.size(), options_.sample_bytes)));
+
+            auto started = std::chrono::steady_clock::now();
+            size_t filled = 0;
+            while (filled < buffer.size()) {
+                int64_t read_bytes = file.read(buffer.data() + filled, buffer.size() - filled);
+                if (read_bytes <= 0) {
+                    break;
+                }
+                filled += static_cast<size_t>(read_bytes);
+            }
+            file.close();
+            buffer.resize(filled);
+            if (buffer.empty()) {
+                continue;
+            }
+            auto read_done = std::chrono::steady_clock::now();
+
+            Platform::Sha256 sha;
+            sha.update(buffer.data(), buffer.size());
+            uint8_t digest[Platform::Sha256::DIGEST_SIZE];
+            sha.finish(digest);
+            auto hash_done = std::chrono::steady_clock::now();
+
+            auto compressed = CompressionUtils::compressData(buffer, config_.strategy.compression_level);
+            auto compress_done = std::chrono::steady_clock::now();
+            if (!compressed) {
+                continue;
+            }
+
+            result.throughput.bytes += buffer.size();
+            result.throughput.compressed_input += buffer.size();
+            result.throughput.read_seconds += seconds(read_done - started);
+            result.throughput.hash_seconds += seconds(hash_done - read_done);
+            result.throughput.compress_seconds += seconds(compress_done - hash_done);
+            // 备份文件另有 8 字节的原始大小头；压缩反而变大时仍按压缩后的大小写入
+            double ratio = static_cast<double>(compressed->size() + sizeof(uint64_t)) / buffer.size();
+            result.ratios.emplace_back(&sample, ratio);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < thread_count; ++i) {
+        threads.emplace_back(work, std::ref(results[i]));
+    }
+    work(results[0]);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (const auto& result : results) {
+        throughput_.bytes += result.throughput.bytes;
+        throughput_.compressed_input += result.throughput.compressed_input;
+        throughput_.read_seconds += result.throughput.read_seconds;
+        throughput_.hash_seconds += result.throughput.hash_seconds;
+        throughput_.compress_seconds += result.throughput.compress_seconds;
+        for (const auto& [sample, ratio] : result.ratios) {
+            ExtensionStats& stats = plan.extensions[sample->extension];
+            double weight = census ? static_cast<double>(sample->size) : 1.0;
+            stats.ratio_sum += ratio * weight;
+            stats.ratio_weight += weight;
+            stats.samples++;
+        }
+    }
+}
+
+void CapacityPlanner::estimate(SourcePlan& plan) const {
+    plan.total = ExtensionStats{};
+    for (const auto& [extension, stats] : plan.extensions) {
+        accumulate(plan.total, stats);
+    }
+    plan.compress_ratio = plan.total.ratio(1.0);
+
+    plan.stored_bytes = 0;
+    plan.working_stored_bytes = 0;
+    for (const auto& [extension, stats] : plan.extensions) {
+        double ratio = stats.samples >= MIN_EXTENSION_SAMPLES ? stats.ratio(plan.compress_ratio) : plan.compress_ratio;
+        plan.stored_bytes += (stats.bytes - stats.compressed_bytes) +
+                             static_cast<uint64_t>(stats.compressed_bytes * ratio);
+        plan.working_stored_bytes += (stats.working_bytes - stats.working_compressed_bytes) +
+                                     static_cast<uint64_t>(stats.working_compressed_bytes * ratio);
+    }
+}
+
+nlohmann::json CapacityPlanner::run() {
+    std::vector<SourcePlan> plans;
+    for (const auto& source : config_.backup_sources) {
+        if (!source.enabled) {
+            continue;
+        }
+        SourcePlan plan;
+        plan.path = source.path;
+        std::error_code ec;
+        if (!fs::is_directory(source.path, ec)) {
+            plan.skipped = "路径不存在或不是目录";
+        } else {
+            std::vector<Sample> samples;
+            size_t candidates = scanSource(source, plan, samples);
+            measureSamples(plan, samples, candidates <= samples.size());
+        }
+        estimate(plan);
+        plans.push_back(std::move(plan));
+    }
+
+    // 吞吐按所有备份源的样本合计（单线程速率）
+    double read_rate = throughput_.readRate();
+    double hash_rate = throughput_.hashRate();
+    double compress_rate = throughput_.compressRate();
+    double write_rate = options_.bandwidth_mbps * 1048576.0;
+    const BackupStrategy& strategy = config_.strategy;
+    int workers = workerCount();
+    int bulk_workers = std::max(1, std::min(strategy.bulk_max_workers, workers));
+
+    // 编辑按工作集文件数分摊到各备份源；没有任何工作集时退化为全部文件
+    uint64_t total_working_files = 0;
+    for (const auto& plan : plans) {
+        total_working_files += plan.total.working_files;
+    }
+    bool working_set_fallback = total_working_files == 0;
+    uint64_t planned_files = 0;
+    for (const auto& plan : plans) {
+        planned_files += working_set_fallback ? plan.total.files : plan.total.working_files;
+    }
+
+    // 合计耗时取各备份源之和（各源的工作线程独立，但共用 CPU 和备份目录，按串行保守估计）
+    nlohmann::json sources = nlohmann::json::array();
+    nlohmann::json total = {
+        {"files", 0}, {"source_bytes", 0}, {"stored_bytes", 0}, {"initial_seconds", 0.0},
+        {"cpu_seconds", 0.0}, {"bytes_per_active_day", 0.0}, {"footprint_bytes", 0.0}
+    };
+    for (const auto& plan : plans) {
+        nlohmann::json item = {{"path", plan.path}};
+        if (!plan.skipped.empty()) {
+            item["skipped"] = plan.skipped;
+            sources.push_back(std::move(item));
+            continue;
+        }
+        const ExtensionStats& stats = plan.total;
+
+        // 首次全量备份：单线程的读取+哈希+压缩耗时摊到工作线程上，批量通道另受 bulk_max_workers 限制，
+        // 并且不能快于备份目录的写入带宽
+        double cpu_seconds = stats.bytes * (inverse(read_rate) + inverse(hash_rate)) +
+                             stats.compressed_bytes * inverse(compress_rate);
+        double bulk_seconds = stats.bytes > 0 ? cpu_seconds * plan.bulk_bytes / stats.bytes : 0.0;
+        double write_seconds = plan.stored_bytes * inverse(write_rate);
+        double initial_seconds = std::max({cpu_seconds / workers, bulk_seconds / bulk_workers, write_seconds});
+        const char* bound = initial_seconds == write_seconds ? "write"
+                          : initial_seconds == bulk_seconds / bulk_workers ? "bulk" : "cpu";
+
+        // 稳定状态：每个工作集文件的编辑频率相同，同一文件 DEBOUNCE_SECONDS 内最多一次备份
+        uint64_t working_files = working_set_fallback ? stats.files : stats.working_files;
+        uint64_t working_bytes = working_set_fallback ? stats.bytes : stats.working_bytes;
+        uint64_t working_compressed = working_set_fallback ? stats.compressed_bytes : stats.working_compressed_bytes;
+        uint64_t working_stored = working_set_fallback ? plan.stored_bytes : plan.working_stored_bytes;
+        nlohmann::json steady = {{"working_set_files", working_files}, {"working_set_bytes", working_bytes}};
+        double bytes_per_day = 0;
+        double footprint = 0;
+        double day_cpu_seconds = 0;
+        if (working_files > 0 && planned_files > 0) {
+            double saves_per_hour = options_.saves_per_hour * working_files / planned_files;
+            double per_file = std::min(saves_per_hour / working_files, 3600.0 / SchedulePolicy::DEBOUNCE_SECONDS);
+            double versions_per_day = per_file * working_files * options_.active_hours_per_day;
+            double mean_size = static_cast<double>(working_bytes) / working_files;
+            double mean_compressed = static_cast<double>(working_compressed) / working_files;
+            double mean_stored = static_cast<double>(working_stored) / working_files;
+
+            // 与 VersionManager::cleanupOldVersions 相同：至多 max_versions_per_file 个，
+            // 超过保留天数的版本删除，但至少保留最近 3 个
+            double per_file_per_calendar_day = per_file * options_.active_hours_per_day *
+                                               options_.active_days_per_week / 7.0;
+            double within_retention = per_file_per_calendar_day * strategy.retention_days;
+            double retained = per_file_per_calendar_day > 0
+                ? std::min<double>(strategy.max_versions_per_file, std::max(3.0, within_retention)) : 0.0;
+
+            bytes_per_day = versions_per_day * mean_stored;
+            // 工作集之外的文件只有全量备份的一份，工作集文件各保留 retained 个版本
+            footprint = static_cast<double>(plan.stored_bytes - std::min(plan.stored_bytes, working_stored)) +
+                        retained * working_stored;
+            day_cpu_seconds = versions_per_day * (mean_size * (inverse(read_rate) + inverse(hash_rate)) +
+                                                  mean_compressed * inverse(compress_rate));
+            steady["saves_per_hour"] = saves_per_hour;
+            steady["versions_per_active_day"] = versions_per_day;
+            steady["read_bytes_per_active_day"] = versions_per_day * mean_size;
+            steady["written_bytes_per_active_day"] = bytes_per_day;
+            steady["cpu_seconds_per_active_day"] = day_cpu_seconds;
+            steady["retained_versions_per_file"] = retained;
+            steady["footprint_bytes"] = footprint;
+            steady["days_to_plateau"] = per_file_per_calendar_day > 0 ? retained / per_file_per_calendar_day : 0.0;
+        }
+
+        // 按字节数列出主要扩展名
+        std::vector<std::pair<std::string, const ExtensionStats*>> by_bytes;
+        for (const auto& [extension, ext_stats] : plan.extensions) {
+            by_bytes.emplace_back(extension, &ext_stats);
+        }
+        std::sort(by_bytes.begin(), by_bytes.end(),
+                  [](const auto& a, const auto& b) { return a.second->bytes > b.second->bytes; });
+        nlohmann::json extensions = nlohmann::json::object();
+        for (size_t i = 0; i < by_bytes.size() && i < REPORTED_EXTENSIONS; ++i) {
+            const ExtensionStats& ext_stats = *by_bytes[i].second;
+            nlohmann::json entry = {
+                {"files", ext_stats.files},
+                {"bytes", ext_stats.bytes},
+                {"compressed_bytes", ext_stats.compressed_bytes},
+                {"samples", ext_stats.samples}
+            };
+            if (ext_stats.samples > 0) {
+                entry["ratio"] = ext_stats.ratio(1.0);
+            }
+            extensions[by_bytes[i].first.empty() ? "(无扩展名)" : by_bytes[i].first] = std::move(entry);
+        }
+
+        item["scan"] = {
+            {"directories", plan.directories},
+            {"pruned_directories", plan.pruned_directories},
+            {"filtered_files", plan.filtered_files},
+            {"oversized_files", plan.oversized_files},
+            {"seconds", plan.scan_seconds}
+        };
+        item["initial"] = {
+            {"files", stats.files},
+            {"source_bytes", stats.bytes},
+            {"compressed_source_bytes", stats.compressed_bytes},
+            {"bulk_bytes", plan.bulk_bytes},
+            {"compress_ratio", plan.compress_ratio},
+            {"samples", stats.samples},
+            {"stored_bytes", plan.stored_bytes},
+            {"cpu_seconds", cpu_seconds},
+            {"seconds", initial_seconds},
+            {"bound", bound}
+        };
+        item["steady"] = std::move(steady);
+        item["extensions"] = std::move(extensions);
+        sources.push_back(std::move(item));
+
+        total["files"] = total["files"].get<uint64_t>() + stats.files;
+        total["source_bytes"] = total["source_bytes"].get<uint64_t>() + stats.bytes;
+        total["stored_bytes"] = total["stored_bytes"].get<uint64_t>() + plan.stored_bytes;
+        total["initial_seconds"] = total["initial_seconds"].get<double>() + initial_seconds;
+        total["cpu_seconds"] = total["cpu_seconds"].get<double>() + cpu_seconds;
+        total["bytes_per_active_day"] = total["bytes_per_active_day"].get<double>() + bytes_per_day;
+        total["footprint_bytes"] = total["footprint_bytes"].get<double>() + footprint;
+    }
+    total["working_set_fallback"] = working_set_fallback;
+
+    return {
+        {"context", {
+            {"saves_per_hour", options_.saves_per_hour},
+            {"active_hours_per_day", options_.active_hours_per_day},
+            {"active_days_per_week", options_.active_days_per_week},
+            {"working_set_days", options_.working_set_days},
+            {"sample_files", options_.sample_files},
+            {"sample_bytes", options_.sample_bytes},
+            {"bandwidth_mbps", options_.bandwidth_mbps},
+            {"workers", workers},
+            {"strategy", {
+                {"debounce_seconds", SchedulePolicy::DEBOUNCE_SECONDS},
+                {"retention_days", strategy.retention_days},
+                {"max_versions_per_file", strategy.max_versions_per_file},
+                {"enable_compression", strategy.enable_compression},
+                {"compression_level", strategy.compression_level},
+                {"compression_threshold", strategy.compression_threshold},
+                {"max_file_size", strategy.max_file_size},
+                {"bulk_file_threshold", strategy.bulk_file_threshold},
+                {"bulk_max_workers", strategy.bulk_max_workers}
+            }}
+        }},
+        {"throughput", {
+            {"sampled_bytes", throughput_.bytes},
+            {"read_mbps", read_rate / 1048576.0},
+            {"hash_mbps", hash_rate / 1048576.0},
+            {"compress_mbps", compress_rate / 1048576.0}
+        }},
+        {"sources", std::move(sources)},
+        {"total", std::move(total)}
+    };
+}
+
+std::string CapacityPlanner::summarize(const nlohmann::json& report) {
+    std::ostringstream out;
+    char line[512];
+    for (const auto& source : report["sources"]) {
+        std::string path = source["path"].get<std::string>();
+        if (source.contains("skipped")) {
+            out << path << ": 已跳过（" << source["skipped"].get<std::string>() << "）\n";
+            continue;
+        }
+        const auto& initial = source["initial"];
+        const auto& steady = source["steady"];
+        std::snprintf(line, sizeof(line),
+                      "%s: %llu 个文件 %.1f MB -> 备份 %.1f MB（压缩率 %.2f，%llu 个样本），首次全量约 %.1f 秒（瓶颈 %s）",
+                      path.c_str(),
+                      static_cast<unsigned long long>(initial["files"].get<uint64_t>()),
+                      megabytes(initial["source_bytes"].get<uint64_t>()),
+                      megabytes(initial["stored_bytes"].get<uint64_t>()),
+                      initial["compress_ratio"].get<double>(),
+                      static_cast<unsigned long long>(initial["samples"].get<uint64_t>()),
+                      initial["seconds"].get<double>(),
+                      initial["bound"].get<std::string>().c_str());
+        out << line;
+        if (steady.contains("footprint_bytes")) {
+            std::snprintf(line, sizeof(line),
+                          " | 工作集 %llu 个文件，每个工作日 %.0f 个版本 +%.1f MB，保留稳定后约 %.1f MB（%.1f 天后）",
+                          static_cast<unsigned long long>(steady["working_set_files"].get<uint64_t>()),
+                          steady["versions_per_active_day"].get<double>(),
+                          steady["written_bytes_per_active_day"].get<double>() / 1048576.0,
+                          steady["footprint_bytes"].get<double>() / 1048576.0,
+                          steady["days_to_plateau"].get<double>());
+            out << line;
+        }
+        out << "\n";
+    }
+
+    const auto& total = report["total"];
+    const auto& throughput = report["throughput"];
+    std::snprintf(line, sizeof(line),
+                  "合计: %llu 个文件 %.1f MB -> 首次备份 %.1f MB，约 %.1f 秒 | 每个工作日 +%.1f MB | 保留稳定后约 %.1f MB"
+                  " | 单线程吞吐 读取 %.0f MB/s，哈希 %.0f MB/s，压缩 %.0f MB/s%s",
+                  static_cast<unsigned long long>(total["files"].get<uint64_t>()),
+                  megabytes(total["source_bytes"].get<uint64_t>()),
+                  megabytes(total["stored_bytes"].get<uint64_t>()),
+                  total["initial_seconds"].get<double>(),
+                  total["bytes_per_active_day"].get<double>() / 1048576.0,
+                  total["footprint_bytes"].get<double>() / 1048576.0,
+                  throughput["read_mbps"].get<double>(),
+                  throughput["hash_mbps"].get<double>(),
+                  throughput["compress_mbps"].get<double>(),
+                  total["working_set_fallback"].get<bool>() ? "（没有近期修改的文件，工作集按全部文件估算）" : "");
+    out << line << "\n";
+    return out.str();
+}
@@ -0,0 +1,49 @@
+#include "clock.h"
+#include <thread>
+
+Clock& Clock::system() {
+    static SystemClock clock;
+    return clock;
+}
+
+std::chrono::steady_clock::time_point SystemClock::steadyNow() const {
+    return std::chrono::steady_clock::now();
+}
+
+std::chrono::system_clock::time_point SystemClock::systemNow() const {
+    return std::chrono::system_clock::now();
+}
+
+void SystemClock::sleepFor(std::chrono::milliseconds duration) {
+    std::this_thread::sleep_for(duration);
+}
+
+SimulatedClock::SimulatedClock(std::chrono::system_clock::time_point start)
+    : system_start_(start)
+    , steady_start_(std::chrono::hours(24)) {
+}
+
+std::chrono::steady_clock::time_point SimulatedClock::steadyNow() const {
+    return steady_start_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(elapsed());
+}
+
+std::chrono::system_clock::time_point SimulatedClock::systemNow() const {
+    return system_start_ + std::chrono::duration_cast<std::chrono::system_clock::duration>(elapsed());
+}
+
+void SimulatedClock::sleepFor(std::chrono::milliseconds duration) {
+    advance(duration);
+}
+
+void SimulatedClock::advance(std::chrono::nanoseconds duration) {
+    if (duration.count() > 0) {
+        elapsed_ns_ += duration.count();
+    }
+}
+
+void SimulatedClock::advanceTo(std::chrono::steady_clock::time_point target) {
+    auto target_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(target - steady_start_).count();
+    int64_t current = elapsed_ns_.load();
+    while (target_ns > current && !elapsed_ns_.compare_exchange_weak(current, target_ns)) {
+    }
+}
@@ -1,4 +1,5 @@
 #include "compression_utils.h"
+#include "platform.h"
 #include <fstream>
 #include <zlib.h>
 
@@ -7,16 +8,25 @@ std::optional<std::string> CompressionUtils::compressFile(
     const std::string& dest_path,
     int compression_level) {
     
-    // 读取源文件
-    std::ifstream input(source_path, std::ios::binary);
-    if (!input) {
+    // 读取源文件（按打开时的大小一次分配，顺序读取提示）
+    Platform::SequentialFile input;
+    if (!input.open(source_path)) {
         return std::nullopt;
     }
 
-    std::vector<uint8_t> input_data(
-        (std::istreambuf_iterator<char>(input)),
-        std::istreambuf_iterator<char>()
-    );
+    std::vector<uint8_t> input_data(static_cast<size_t>(input.size()));
+    size_t filled = 0;
+    while (filled < input_data.size()) {
+        int64_t read_bytes = input.read(input_data.data() + filled, input_data.size() - filled);
+        if (read_bytes < 0) {
+            return std::nullopt;
+        }
+        if (read_bytes == 0) {
+            break;  // 读取期间文件被截短
+        }
+        filled += static_cast<size_t>(read_bytes);
+    }
+    input_data.resize(filled);
     input.close();
 
     if (input_data.empty()) {
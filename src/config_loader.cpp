@@ -1,5 +1,6 @@
 #include "config_loader.h"
 #include <fstream>
+#include <filesystem>
 #include <iostream>
 #include <algorithm>
 
@@ -39,11 +40,65 @@ BackupStrategy ConfigLoader::loadStrategy(const nlohmann::json& json) {
         strategy.full_backup_interval = s.value("full_backup_interval", 10);
         strategy.delta_ratio_threshold = s.value("delta_ratio_threshold", 0.3f);
         strategy.max_file_size = s.value("max_file_size", 104857600);
+        strategy.small_file_threshold = s.value("small_file_threshold", 65536);
+        strategy.bulk_file_threshold = s.value("bulk_file_threshold", 10485760);
+        strategy.bulk_max_workers = s.value("bulk_max_workers", 1);
+        strategy.recent_edit_window_seconds = s.value("recent_edit_window_seconds", 60);
+        strategy.aging_seconds = s.value("aging_seconds", 10);
+        strategy.min_workers = s.value("min_workers", 1);
+        strategy.max_workers = s.value("max_workers", 0);
+        strategy.scale_up_wait_ms = s.value("scale_up_wait_ms", 500);
+        strategy.scale_down_idle_seconds = s.value("scale_down_idle_seconds", 30);
+        strategy.event_buffer_capacity = s.value("event_buffer_capacity", 65536);
+        strategy.storm_event_threshold = s.value("storm_event_threshold", 500);
+        strategy.storm_window_ms = s.value("storm_window_ms", 2000);
+        strategy.storm_settle_ms = s.value("storm_settle_ms", 3000);
+        strategy.storm_root_depth = s.value("storm_root_depth", 1);
+        strategy.watcher_backend = s.value("watcher_backend", std::string("efsw"));
+        strategy.reconcile_on_startup = s.value("reconcile_on_startup", true);
+        strategy.scan_threads = s.value("scan_threads", 0);
+        strategy.state_max_entries = s.value("state_max_entries", 0);
+        strategy.async_logging = s.value("async_logging", true);
+        strategy.log_queue_size = s.value("log_queue_size", 8192);
+        strategy.log_overflow_policy = s.value("log_overflow_policy", std::string("block"));
+        strategy.log_flush_interval_seconds = s.value("log_flush_interval_seconds", 1);
+        strategy.log_level = s.value("log_level", std::string("info"));
+        strategy.metrics_interval_seconds = s.value("metrics_interval_seconds", 10);
+        strategy.metrics_directory = s.value("metrics_directory", std::string());
+        strategy.trace_enabled = s.value("trace_enabled", false);
+        strategy.trace_buffer_events = s.value("trace_buffer_events", 16384);
+        strategy.capture_events = s.value("capture_events", false);
     }
     
     return strategy;
 }
 
+std::string ConfigLoader::diagnosticsDirectory(const Config& config) {
+    if (!config.strategy.metrics_directory.empty()) {
+        return config.strategy.metrics_directory;
+    }
+    return (std::filesystem::path(config.backup_destination_base) / ".catalog").string();
+}
+
+LogOptions ConfigLoader::logOptions(const BackupStrategy& strategy) {
+    LogOptions options;
+    options.async = strategy.async_logging;
+    options.queue_size = strategy.log_queue_size;
+    if (strategy.log_overflow_policy == "drop_oldest") {
+        options.overflow = LogOptions::Overflow::DropOldest;
+    } else if (strategy.log_overflow_policy == "drop_new") {
+        options.overflow = LogOptions::Overflow::DropNew;
+    } else {
+        options.overflow = LogOptions::Overflow::Block;
+    }
+    options.flush_interval = std::chrono::seconds(std::max(1, strategy.log_flush_interval_seconds));
+    
+    // 无法识别的级别名按 info 处理
+    auto level = spdlog::level::from_str(strategy.log_level);
+    options.level = level == spdlog::level::off && strategy.log_level != "off" ? spdlog::level::info : level;
+    return options;
+}
+
 std::optional<Config> ConfigLoader::loadConfig(const std::string& config_file) {
     auto json_opt = loadJsonFile(config_file, "主配置文件");
     if (!json_opt) {
@@ -88,6 +143,11 @@ std::optional<Config> ConfigLoader::loadConfig(const std::string& config_file) {
                         filter.blacklist_extensions = filter_json["blacklist"].get<std::vector<std::string>>();
                     }
                     
+                    // 排除规则（目录、路径通配符）
+                    if (filter_json.contains("exclude")) {
+                        filter.exclude_patterns = filter_json["exclude"].get<std::vector<std::string>>();
+                    }
+                    
                     // 兼容旧的单模式配置
                     if (!filter.useDualMode()) {
                         std::string mode_str = filter_json.value("mode", "none");
@@ -145,6 +205,9 @@ FilterConfig ConfigLoader::mergePresets(
         } else if (mode_str == "blacklist") {
             blacklisted_exts.insert(blacklisted_exts.end(), exts.begin(), exts.end());
         }
+        
+        auto excludes = preset.value("exclude", std::vector<std::string>());
+        result.exclude_patterns.insert(result.exclude_patterns.end(), excludes.begin(), excludes.end());
     }
 
     if (has_whitelist) {
@@ -187,6 +250,19 @@ FilterConfig ConfigLoader::mergeFilters(
         } else if (mode_str == "blacklist") {
             preset_blacklist.insert(preset_blacklist.end(), exts.begin(), exts.end());
         }
+        
+        auto excludes = preset.value("exclude", std::vector<std::string>());
+        result.exclude_patterns.insert(result.exclude_patterns.end(), excludes.begin(), excludes.end());
+    }
+    
+    // 排除规则总是合并（预设 + 自定义）
+    if (custom_filter) {
+        for (const auto& pattern : custom_filter->exclude_patterns) {
+            if (std::find(result.exclude_patterns.begin(), 
+                         result.exclude_patterns.end(), pattern) == result.exclude_patterns.end()) {
+                result.exclude_patterns.push_back(pattern);
+            }
+        }
     }
     
     // 2. 如果有自定义过滤器，合并规则
@@ -237,3 +313,11 @@ FilterConfig ConfigLoader::mergeFilters(
     
     return result;
 }
+
+std::shared_ptr<const FilterMatcher> ConfigLoader::compileFilters(
+    const std::vector<std::string>& preset_names,
+    const nlohmann::json& presets,
+    const std::optional<FilterConfig>& custom_filter) {
+    
+    return FilterMatcher::compile(mergeFilters(preset_names, presets, custom_filter));
+}
@@ -0,0 +1,76 @@
+#include "event_ring.h"
+#include <algorithm>
+
+EventRing::EventRing(size_t capacity)
+    : slots_(std::max<size_t>(capacity, 1)) {
+}
+
+void EventRing::push(const std::string& dir, const std::string& filename,
+                     efsw::Action action, const std::string& old_filename) {
+    bool was_empty = false;
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (count_ == slots_.size()) {
+            dropped_++;
+            return;
+        }
+        
+        auto& slot = slots_[(head_ + count_) % slots_.size()];
+        slot.dir.assign(dir);
+        slot.filename.assign(filename);
+        slot.old_filename.assign(old_filename);
+        slot.action = action;
+        
+        was_empty = (count_ == 0);
+        count_++;
+    }
+    
+    // 只在空 -> 非空时唤醒，突发事件不会逐条触发唤醒
+    if (was_empty) {
+        cv_.notify_one();
+    }
+}
+
+void EventRing::waitForEvents(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait_for(lock, timeout, [this] { return count_ > 0 || wake_; });
+    wake_ = false;
+}
+
+void EventRing::wakeAll() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        wake_ = true;
+    }
+    cv_.notify_all();
+}
+
+size_t EventRing::drain(std::vector<RawFileEvent>& batch, size_t max_events) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    
+    size_t n = std::min(count_, max_events);
+    if (batch.size() < n) {
+        batch.resize(n);
+    }
+    
+    for (size_t i = 0; i < n; ++i) {
+        auto& slot = slots_[(head_ + i) % slots_.size()];
+        auto& out = batch[i];
+        out.dir.swap(slot.dir);
+        out.filename.swap(slot.filename);
+        out.old_filename.swap(slot.old_filename);
+        out.action = slot.action;
+    }
+    
+    head_ = (head_ + n) % slots_.size();
+    count_ -= n;
+    return n;
+}
+
+size_t EventRing::takeDropped() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t dropped = dropped_;
+    dropped_ = 0;
+    return dropped;
+}
@@ -0,0 +1,340 @@
+#include "event_trace.h"
+#include "logger.h"
+#include "platform.h"
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr int FLUSH_INTERVAL_MS = 200;    // 写入线程批量编码的周期
+
+void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+void putString(std::string& out, const std::string& value) {
+    putVarint(out, value.size());
+    out.append(value);
+}
+
+} // namespace
+
+EventTraceWriter::~EventTraceWriter() {
+    close();
+}
+
+bool EventTraceWriter::open(const std::string& path) {
+    std::error_code ec;
+    fs::create_directories(fs::path(path).parent_path(), ec);
+    out_.open(path, std::ios::binary | std::ios::trunc);
+    if (!out_) {
+        auto logger = Logger::get();
+        if (logger) {
+            logger->warn("无法创建事件记录文件: {}", path);
+        }
+        return false;
+    }
+    path_ = path;
+
+    int64_t start_unix_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    buffer_.assign(EventTrace::MAGIC, sizeof(EventTrace::MAGIC));
+    putVarint(buffer_, EventTrace::VERSION);
+    putVarint(buffer_, static_cast<uint64_t>(start_unix_ms));
+    out_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    buffer_.clear();
+    last_time_ = Clock::now();
+
+    stopping_ = false;
+    writer_thread_ = std::thread([this] { writerLoop(); });
+    return true;
+}
+
+void EventTraceWriter::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (writer_thread_.joinable()) {
+        writer_thread_.join();
+    }
+    if (out_.is_open()) {
+        out_.close();
+    }
+}
+
+uint32_t EventTraceWriter::addSource(const std::string& source_path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t id = next_source_++;
+    pending_sources_.emplace_back(id, source_path);
+    return id;
+}
+
+void EventTraceWriter::record(uint32_t source, const std::string& dir, const std::string& filename,
+                              efsw::Action action, const std::string& old_filename) {
+    auto now = Clock::now();
+
+    // 大小在事件发生时读取，之后很快被移动或删除的文件也能记下；删除事件不读取
+    uint8_t flags = 0;
+    uint64_t size = 0;
+    if (action != efsw::Actions::Delete && !filename.empty()) {
+        std::string full_path = dir;
+        if (!full_path.empty() && full_path.back() != '/' && full_path.back() != '\\') {
+            full_path.push_back(static_cast<char>(fs::path::preferred_separator));
+        }
+        full_path.append(filename);
+        std::error_code ec;
+        auto status = fs::status(full_path, ec);
+        if (!ec && fs::is_directory(status)) {
+            flags |= EventTrace::FLAG_DIRECTORY;
+        } else if (!ec && fs::is_regular_file(status)) {
+            size = fs::file_size(full_path, ec);
+            if (!ec) {
+                flags |= EventTrace::FLAG_SIZE_KNOWN;
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+        return;
+    }
+    // 写入线程跟不上（磁盘过慢）时丢弃新事件，不让监控线程阻塞或内存无限增长
+    if (pending_.size() >= MAX_PENDING) {
+        pending_dropped_++;
+        dropped_++;
+        return;
+    }
+    PendingEvent& event = pending_.emplace_back();
+    event.time = now;
+    event.source = source;
+    event.action = action;
+    event.flags = flags;
+    event.size = size;
+    event.dir = dir;
+    event.filename = filename;
+    event.old_filename = old_filename;
+}
+
+void EventTraceWriter::writerLoop() {
+    std::vector<PendingEvent> batch;
+    std::vector<std::pair<uint32_t, std::string>> sources;
+    while (true) {
+        uint64_t dropped = 0;
+        bool stopping = false;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL_MS), [this] { return stopping_; });
+            batch.swap(pending_);
+            sources.swap(pending_sources_);
+            dropped = pending_dropped_;
+            pending_dropped_ = 0;
+            stopping = stopping_;
+        }
+
+        for (const auto& [id, path] : sources) {
+            buffer_.push_back('S');
+            putVarint(buffer_, id);
+            putString(buffer_, path);
+        }
+        for (const auto& event : batch) {
+            encode(event);
+        }
+        if (dropped > 0) {
+            buffer_.push_back('L');
+            putVarint(buffer_, dropped);
+        }
+        if (!buffer_.empty()) {
+            out_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+            out_.flush();
+            buffer_.clear();
+        }
+        recorded_ += batch.size();
+        batch.clear();
+        sources.clear();
+
+        if (stopping) {
+            break;
+        }
+    }
+
+    if (!out_) {
+        auto logger = Logger::get();
+        if (logger) {
+            logger->warn("事件记录文件写入失败: {}", path_);
+        }
+    }
+}
+
+void EventTraceWriter::encode(const PendingEvent& event) {
+    auto [it, inserted] = dir_ids_.try_emplace(event.dir, static_cast<uint32_t>(dir_ids_.size()));
+    if (inserted) {
+        buffer_.push_back('D');
+        putVarint(buffer_, it->second);
+        putString(buffer_, event.dir);
+    }
+
+    // 时间只增不减：多个监控线程入队的顺序与取时钟的顺序可能略有出入
+    auto delta = std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::microseconds>(
+        event.time - last_time_).count());
+    last_time_ = std::max(last_time_, event.time);
+
+    buffer_.push_back('E');
+    putVarint(buffer_, static_cast<uint64_t>(delta));
+    putVarint(buffer_, event.source);
+    putVarint(buffer_, it->second);
+    buffer_.push_back(static_cast<char>(event.action));
+    buffer_.push_back(static_cast<char>(event.flags));
+    if (event.flags & EventTrace::FLAG_SIZE_KNOWN) {
+        putVarint(buffer_, event.size);
+    }
+    putString(buffer_, event.filename);
+    if (event.action == efsw::Actions::Moved) {
+        putString(buffer_, event.old_filename);
+    }
+}
+
+std::string EventTraceWriter::captureFileName() {
+    auto time_t = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    std::tm tm;
+    Platform::localTime(time_t, tm);
+    char name[64];
+    std::strftime(name, sizeof(name), "events_%Y%m%d_%H%M%S.cbtrace", &tm);
+    return name;
+}
+
+bool EventTraceReader::open(const std::string& path) {
+    in_.open(path, std::ios::binary);
+    if (!in_) {
+        return fail("无法打开 " + path);
+    }
+    char magic[sizeof(EventTrace::MAGIC)];
+    if (!in_.read(magic, sizeof(magic)) || std::memcmp(magic, EventTrace::MAGIC, sizeof(magic)) != 0) {
+        return fail("不是事件记录文件: " + path);
+    }
+    uint64_t version = 0;
+    uint64_t start = 0;
+    if (!readVarint(version) || !readVarint(start)) {
+        return fail("文件头不完整");
+    }
+    if (version != EventTrace::VERSION) {
+        return fail("不支持的版本: " + std::to_string(version));
+    }
+    start_unix_ms_ = static_cast<int64_t>(start);
+    return true;
+}
+
+bool EventTraceReader::next(Event& event) {
+    while (true) {
+        int tag = in_.get();
+        if (tag == std::char_traits<char>::eof()) {
+            return false;
+        }
+        uint64_t id = 0;
+        switch (tag) {
+        case 'S': {
+            std::string path;
+            if (!readVarint(id) || !readString(path)) {
+                return fail("源定义不完整");
+            }
+            if (sources_.size() <= id) {
+                sources_.resize(id + 1);
+            }
+            sources_[id] = std::move(path);
+            break;
+        }
+        case 'D': {
+            std::string dir;
+            if (!readVarint(id) || !readString(dir)) {
+                return fail("目录定义不完整");
+            }
+            if (dirs_.size() <= id) {
+                dirs_.resize(id + 1);
+            }
+            dirs_[id] = std::move(dir);
+            break;
+        }
+        case 'L': {
+            uint64_t lost = 0;
+            if (!readVarint(lost)) {
+                return fail("丢弃计数不完整");
+            }
+            lost_events_ += lost;
+            break;
+        }
+        case 'E': {
+            uint64_t delta = 0;
+            uint64_t source = 0;
+            uint64_t dir_id = 0;
+            if (!readVarint(delta) || !readVarint(source) || !readVarint(dir_id)) {
+                return fail("事件不完整");
+            }
+            int action = in_.get();
+            int flags = in_.get();
+            if (flags == std::char_traits<char>::eof() || dir_id >= dirs_.size()) {
+                return fail("事件不完整");
+            }
+            time_us_ += static_cast<int64_t>(delta);
+            event.time_us = time_us_;
+            event.source = static_cast<uint32_t>(source);
+            event.action = static_cast<efsw::Action>(action);
+            event.is_directory = (flags & EventTrace::FLAG_DIRECTORY) != 0;
+            event.size.reset();
+            if (flags & EventTrace::FLAG_SIZE_KNOWN) {
+                uint64_t size = 0;
+                if (!readVarint(size)) {
+                    return fail("事件不完整");
+                }
+                event.size = size;
+            }
+            event.dir = dirs_[dir_id];
+            event.old_filename.clear();
+            if (!readString(event.filename) ||
+                (event.action == efsw::Actions::Moved && !readString(event.old_filename))) {
+                return fail("事件不完整");
+            }
+            return true;
+        }
+        default:
+            return fail("未知的记录类型");
+        }
+    }
+}
+
+bool EventTraceReader::readVarint(uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = in_.get();
+        if (byte == std::char_traits<char>::eof()) {
+            return false;
+        }
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool EventTraceReader::readString(std::string& value) {
+    uint64_t length = 0;
+    if (!readVarint(length) || length > (uint64_t(1) << 20)) {
+        return false;
+    }
+    value.resize(static_cast<size_t>(length));
+    return length == 0 || static_cast<bool>(in_.read(value.data(), static_cast<std::streamsize>(length)));
+}
+
+bool EventTraceReader::fail(const std::string& message) {
+    error_ = message;
+    return false;
+}
@@ -0,0 +1,575 @@
+#include "file_state_table.h"
+#include "logger.h"
+#include "path_buffer.h"
+#include "platform.h"
+#include <fstream>
+#include <vector>
+#include <algorithm>
+
+namespace fs = std::filesystem;
+
+bool readFileStamp(const std::string& path, FileStamp& stamp, bool* is_directory) {
+    Platform::FileInfo info;
+    if (!Platform::readFileInfo(path, info)) {
+        return false;
+    }
+    stamp.size = info.size;
+    stamp.mtime = info.mtime;
+    stamp.file_id = info.file_id;
+    if (is_directory) {
+        *is_directory = info.is_directory;
+    }
+    return true;
+}
+
+bool readFileStamp(const fs::directory_entry& entry, FileStamp& stamp) {
+#ifdef _WIN32
+    // 目录枚举已带回大小和修改时间（FILETIME 精度），打开文件取索引代价太高，留空
+    std::error_code ec;
+    stamp.size = entry.file_size(ec);
+    if (ec) {
+        return false;
+    }
+    stamp.mtime = static_cast<int64_t>(entry.last_write_time(ec).time_since_epoch().count());
+    stamp.file_id = 0;
+    return !ec;
+#else
+    return readFileStamp(entry.path().string(), stamp);
+#endif
+}
+
+namespace {
+
+using StampMap = std::unordered_map<std::string, FileStamp>;
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// 只有 64 位十六进制（SHA-256）才能压缩存放，其他格式的哈希不缓存
+bool hexToDigest(const std::string& hex, std::array<uint8_t, 32>& digest) {
+    if (hex.size() != digest.size() * 2) {
+        return false;
+    }
+    for (size_t i = 0; i < digest.size(); ++i) {
+        int high = hexValue(hex[2 * i]);
+        int low = hexValue(hex[2 * i + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        digest[i] = static_cast<uint8_t>((high << 4) | low);
+    }
+    return true;
+}
+
+std::string digestToHex(const std::array<uint8_t, 32>& digest) {
+    static const char digits[] = "0123456789abcdef";
+    std::string hex(digest.size() * 2, '0');
+    for (size_t i = 0; i < digest.size(); ++i) {
+        hex[2 * i] = digits[digest[i] >> 4];
+        hex[2 * i + 1] = digits[digest[i] & 0x0f];
+    }
+    return hex;
+}
+
+void appendBytes(std::string& buffer, const void* data, size_t len) {
+    buffer.append(static_cast<const char*>(data), len);
+}
+
+void writeRecord(std::string& buffer, std::string_view key, const FileRecord& record) {
+    uint32_t key_len = static_cast<uint32_t>(key.size());
+    // 1：只有摘要；2：摘要加哈希时刻
+    uint8_t has_digest = record.hasDigest() ? (record.hash_time != 0 ? 2 : 1) : 0;
+    appendBytes(buffer, &key_len, sizeof(key_len));
+    buffer.append(key);
+    appendBytes(buffer, &record.size, sizeof(record.size));
+    appendBytes(buffer, &record.mtime, sizeof(record.mtime));
+    appendBytes(buffer, &record.file_id, sizeof(record.file_id));
+    appendBytes(buffer, &has_digest, sizeof(has_digest));
+    if (has_digest) {
+        appendBytes(buffer, record.digest.data(), record.digest.size());
+    }
+    if (has_digest == 2) {
+        appendBytes(buffer, &record.hash_time, sizeof(record.hash_time));
+    }
+}
+
+bool readKey(std::istream& in, std::string& key) {
+    uint32_t key_len = 0;
+    in.read(reinterpret_cast<char*>(&key_len), sizeof(key_len));
+    if (!in || key_len > 32768) {
+        return false;
+    }
+    key.resize(key_len);
+    in.read(&key[0], key_len);
+    return static_cast<bool>(in);
+}
+
+// version 1 没有哈希，2 为十六进制哈希，3 为 32 字节摘要，4 起摘要可附带哈希时刻
+bool readStamp(std::istream& in, FileStamp& stamp, uint32_t version) {
+    in.read(reinterpret_cast<char*>(&stamp.size), sizeof(stamp.size));
+    in.read(reinterpret_cast<char*>(&stamp.mtime), sizeof(stamp.mtime));
+    in.read(reinterpret_cast<char*>(&stamp.file_id), sizeof(stamp.file_id));
+    stamp.hash.clear();
+    stamp.hash_time = 0;
+    if (version == 2) {
+        uint8_t hash_len = 0;
+        in.read(reinterpret_cast<char*>(&hash_len), sizeof(hash_len));
+        stamp.hash.resize(hash_len);
+        in.read(&stamp.hash[0], hash_len);
+    } else if (version >= 3) {
+        uint8_t has_digest = 0;
+        in.read(reinterpret_cast<char*>(&has_digest), sizeof(has_digest));
+        if (has_digest > (version >= 4 ? 2 : 1)) {
+            return false;
+        }
+        if (has_digest) {
+            std::array<uint8_t, 32> digest;
+            in.read(reinterpret_cast<char*>(digest.data()), digest.size());
+            stamp.hash = digestToHex(digest);
+        }
+        if (has_digest == 2) {
+            in.read(reinterpret_cast<char*>(&stamp.hash_time), sizeof(stamp.hash_time));
+        }
+    }
+    return static_cast<bool>(in);
+}
+
+bool loadSnapshot(const std::string& path, uint32_t magic_expected, uint32_t version_expected, StampMap& stamps) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint64_t count = 0;
+    file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    file.read(reinterpret_cast<char*>(&version), sizeof(version));
+    file.read(reinterpret_cast<char*>(&count), sizeof(count));
+    // 旧版本照常读取，下次压缩时升级
+    if (!file || magic != magic_expected || version == 0 || version > version_expected) {
+        return false;
+    }
+
+    StampMap loaded;
+    loaded.reserve(static_cast<size_t>(count));
+    std::string key;
+    for (uint64_t i = 0; i < count; ++i) {
+        FileStamp stamp;
+        if (!readKey(file, key) || !readStamp(file, stamp, version)) {
+            return false;
+        }
+        loaded.emplace(key, std::move(stamp));
+    }
+    stamps = std::move(loaded);
+    return true;
+}
+
+// 重放更新日志，不完整的尾部记录（写入时崩溃）置 torn 并停止
+size_t replayLog(const std::string& path, uint32_t version, StampMap& stamps, bool& torn) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return 0;
+    }
+
+    size_t replayed = 0;
+    std::string key;
+    while (file.peek() != std::char_traits<char>::eof()) {
+        uint8_t op = 0;
+        file.read(reinterpret_cast<char*>(&op), sizeof(op));
+        if (!file || !readKey(file, key)) {
+            torn = true;
+            break;
+        }
+        if (op == 1) {
+            FileStamp stamp;
+            if (!readStamp(file, stamp, version)) {
+                torn = true;
+                break;
+            }
+            stamps[key] = std::move(stamp);
+        } else if (op == 2) {
+            stamps.erase(key);
+        } else {
+            torn = true;
+            break;
+        }
+        replayed++;
+    }
+    return replayed;
+}
+
+void assignStamp(FileRecord& record, const FileStamp& stamp) {
+    record.size = stamp.size;
+    record.mtime = stamp.mtime;
+    record.file_id = stamp.file_id;
+    record.flags |= FileRecord::HAS_STAMP;
+    if (hexToDigest(stamp.hash, record.digest)) {
+        record.flags |= FileRecord::HAS_DIGEST;
+        record.hash_time = stamp.hash_time;
+    } else {
+        record.flags &= static_cast<uint8_t>(~FileRecord::HAS_DIGEST);
+        record.hash_time = 0;
+    }
+}
+
+FileStamp stampOf(const FileRecord& record) {
+    FileStamp stamp;
+    stamp.size = record.size;
+    stamp.mtime = record.mtime;
+    stamp.file_id = record.file_id;
+    if (record.hasDigest()) {
+        stamp.hash = digestToHex(record.digest);
+        stamp.hash_time = record.hash_time;
+    }
+    return stamp;
+}
+
+bool isUnder(const std::string& path, const std::string& relative_dir) {
+    return relative_dir.empty() ||
+           (path.size() > relative_dir.size() &&
+            path.compare(0, relative_dir.size(), relative_dir) == 0 &&
+            (path[relative_dir.size()] == '/' || path[relative_dir.size()] == '\\'));
+}
+
+} // namespace
+
+FileStateTable::FileStateTable(std::string persist_path, size_t max_entries)
+    : persist_path_(std::move(persist_path))
+    , log_path_(persist_path_ + ".log")
+    , max_entries_(max_entries)
+    , created_(std::chrono::steady_clock::now()) {
+}
+
+uint32_t FileStateTable::nowSeconds() const {
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now() - created_).count());
+}
+
+FileStateTable::Stripe& FileStateTable::stripeFor(std::string_view relative_path) const {
+    size_t hash = std::hash<std::string_view>()(relative_path);
+    return stripes_[hash & (NUM_STRIPES - 1)];
+}
+
+FileRecord* FileStateTable::findLocked(Stripe& stripe, std::string_view relative_path) const {
+    auto it = stripe.index.find(relative_path);
+    if (it == stripe.index.end()) {
+        return nullptr;
+    }
+    FileRecord& record = stripe.slots[it->second].record;
+    record.last_access = nowSeconds();
+    return &record;
+}
+
+FileRecord& FileStateTable::acquireLocked(Stripe& stripe, std::string_view relative_path) {
+    if (FileRecord* record = findLocked(stripe, relative_path)) {
+        return *record;
+    }
+
+    // 路径驻留：优先复用被淘汰的槽位
+    uint32_t slot_id;
+    if (!stripe.free_slots.empty()) {
+        slot_id = stripe.free_slots.back();
+        stripe.free_slots.pop_back();
+    } else {
+        slot_id = static_cast<uint32_t>(stripe.slots.size());
+        stripe.slots.emplace_back();
+    }
+    Slot& slot = stripe.slots[slot_id];
+    slot.path.assign(relative_path);
+    slot.record = FileRecord();
+    slot.record.last_access = nowSeconds();
+    slot.used = true;
+    stripe.index.emplace(std::string_view(slot.path), slot_id);
+    entries_++;
+    return slot.record;
+}
+
+void FileStateTable::releaseLocked(Stripe& stripe, uint32_t slot_id) {
+    Slot& slot = stripe.slots[slot_id];
+    stripe.index.erase(std::string_view(slot.path));
+    slot.path.clear();
+    slot.path.shrink_to_fit();
+    slot.used = false;
+    stripe.free_slots.push_back(slot_id);
+    entries_--;
+}
+
+bool FileStateTable::load() {
+    StampMap loaded;
+    bool has_snapshot = loadSnapshot(persist_path_, FILE_MAGIC, FILE_VERSION, loaded);
+
+    // 压缩中断时 .log.old 里是快照之前的更新，先于当前日志重放
+    bool torn = false;
+    std::string old_log = log_path_ + ".old";
+    size_t replayed = replayLog(old_log, FILE_VERSION, loaded, torn) +
+                      replayLog(log_path_, FILE_VERSION, loaded, torn);
+
+    // 运行中已记录的新戳优先
+    for (const auto& item : loaded) {
+        Stripe& stripe = stripeFor(item.first);
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        FileRecord& record = acquireLocked(stripe, item.first);
+        if (!record.hasStamp()) {
+            assignStamp(record, item.second);
+        }
+    }
+    if (replayed > 0 || torn) {
+        dirty_ = true;
+    }
+
+    auto logger = Logger::get();
+    if (logger && torn) {
+        logger->warn("文件状态表更新日志末尾不完整（上次可能异常退出）: {}", log_path_);
+    }
+
+    // 重放过的日志立即合并进快照，新的更新不会追加在损坏的尾部之后
+    if (replayed > 0 || torn) {
+        compact();
+    }
+    return has_snapshot || replayed > 0;
+}
+
+void FileStateTable::put(std::string_view relative_path, const FileStamp& stamp, bool journal) {
+    Stripe& stripe = stripeFor(relative_path);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    assignStamp(acquireLocked(stripe, relative_path), stamp);
+    if (journal) {
+        appendLog(OP_PUT, relative_path, &stamp);
+    } else {
+        dirty_ = true;
+    }
+}
+
+std::optional<FileStamp> FileStateTable::get(std::string_view relative_path) const {
+    Stripe& stripe = stripeFor(relative_path);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    FileRecord* record = findLocked(stripe, relative_path);
+    if (!record || !record->hasStamp()) {
+        return std::nullopt;
+    }
+    return stampOf(*record);
+}
+
+bool FileStateTable::matches(std::string_view relative_path, const FileStamp& stamp) const {
+    Stripe& stripe = stripeFor(relative_path);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    FileRecord* record = findLocked(stripe, relative_path);
+    return record && record->matches(stamp);
+}
+
+std::optional<std::string> FileStateTable::cachedHash(std::string_view relative_path,
+                                                      const FileStamp& stamp) const {
+    Stripe& stripe = stripeFor(relative_path);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    FileRecord* record = findLocked(stripe, relative_path);
+    if (!record || !record->hasSettledDigest(racy_window_.load()) || !record->matches(stamp)) {
+        return std::nullopt;
+    }
+    return digestToHex(record->digest);
+}
+
+bool FileStateTable::hasCachedHash(std::string_view relative_path, const FileStamp& stamp) const {
+    Stripe& stripe = stripeFor(relative_path);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    FileRecord* record = findLocked(stripe, relative_path);
+    return record && record->hasSettledDigest(racy_window_.load()) && record->matches(stamp);
+}
+
+bool FileStateTable::erase(std::string_view relative_path) {
+    Stripe& stripe = stripeFor(relative_path);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    auto it = stripe.index.find(relative_path);
+    if (it == stripe.index.end()) {
+        return false;
+    }
+    uint32_t slot_id = it->second;
+    FileRecord& record = stripe.slots[slot_id].record;
+    bool had_stamp = record.hasStamp();
+    if (had_stamp) {
+        appendLog(OP_ERASE, relative_path, nullptr);
+    }
+    if (record.pending != PendingState::NotPending) {
+        // 排队中的任务完成时还要读写排队状态
+        PendingState pending = record.pending;
+        record = FileRecord();
+        record.pending = pending;
+    } else {
+        releaseLocked(stripe, slot_id);
+    }
+    return true;
+}
+
+size_t FileStateTable::eraseUnder(const std::string& relative_dir) {
+    size_t erased = 0;
+    for (Stripe& stripe : stripes_) {
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        for (uint32_t slot_id = 0; slot_id < stripe.slots.size(); ++slot_id) {
+            Slot& slot = stripe.slots[slot_id];
+            if (!slot.used || relative_dir.empty() || !isUnder(slot.path, relative_dir)) {
+                continue;
+            }
+            if (slot.record.hasStamp()) {
+                appendLog(OP_ERASE, slot.path, nullptr);
+            }
+            if (slot.record.pending != PendingState::NotPending) {
+                PendingState pending = slot.record.pending;
+                slot.record = FileRecord();
+                slot.record.pending = pending;
+            } else {
+                releaseLocked(stripe, slot_id);
+            }
+            erased++;
+        }
+    }
+    return erased;
+}
+
+std::vector<std::string> FileStateTable::keysUnder(const std::string& relative_dir) const {
+    std::vector<std::string> keys;
+    for (const Stripe& stripe : stripes_) {
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        for (const Slot& slot : stripe.slots) {
+            if (slot.used && slot.record.hasStamp() && isUnder(slot.path, relative_dir)) {
+                keys.push_back(slot.path);
+            }
+        }
+    }
+    return keys;
+}
+
+size_t FileStateTable::evictCold(std::chrono::seconds idle) {
+    uint32_t now = nowSeconds();
+    uint32_t idle_seconds = static_cast<uint32_t>(idle.count());
+    if (now < idle_seconds) {
+        return 0;
+    }
+    uint32_t cutoff = now - idle_seconds;
+    bool over_limit = max_entries_ > 0 && entries_.load() > max_entries_;
+
+    size_t evicted = 0;
+    for (Stripe& stripe : stripes_) {
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        for (uint32_t slot_id = 0; slot_id < stripe.slots.size(); ++slot_id) {
+            Slot& slot = stripe.slots[slot_id];
+            if (!slot.used || slot.record.pending != PendingState::NotPending || slot.record.last_access > cutoff) {
+                continue;
+            }
+            // 持久记录只在超出上限时淘汰，代价是下次事件或启动对账时重新计算一次哈希
+            if (slot.record.hasStamp()) {
+                if (!over_limit || entries_.load() <= max_entries_) {
+                    continue;
+                }
+                dirty_ = true;
+            }
+            releaseLocked(stripe, slot_id);
+            evicted++;
+        }
+    }
+    return evicted;
+}
+
+void FileStateTable::appendLog(uint8_t op, std::string_view relative_path, const FileStamp* stamp) {
+    ScratchPath scratch;
+    std::string& record = scratch.str();
+    record.push_back(static_cast<char>(op));
+    if (stamp) {
+        FileRecord packed;
+        assignStamp(packed, *stamp);
+        writeRecord(record, relative_path, packed);
+    } else {
+        uint32_t key_len = static_cast<uint32_t>(relative_path.size());
+        appendBytes(record, &key_len, sizeof(key_len));
+        record.append(relative_path);
+    }
+
+    std::lock_guard<std::mutex> lock(log_mutex_);
+    if (!log_.is_open()) {
+        std::error_code ec;
+        fs::create_directories(fs::path(log_path_).parent_path(), ec);
+        log_.open(log_path_, std::ios::app | std::ios::binary);
+        if (!log_.is_open()) {
+            dirty_ = true;   // 写不了日志时改由下一次压缩保存
+            return;
+        }
+    }
+    log_.write(record.data(), static_cast<std::streamsize>(record.size()));
+    log_.flush();
+    log_records_++;
+}
+
+bool FileStateTable::compact() {
+    std::lock_guard<std::mutex> compact_lock(compact_mutex_);
+    std::string old_log = log_path_ + ".old";
+    std::error_code ec;
+
+    // 先切换日志：之后的更新都进入新日志，快照按分片逐个生成，不需要同时锁住整张表
+    // 切换后、序列化前的更新会同时出现在快照和新日志中，重放结果相同
+    {
+        std::lock_guard<std::mutex> lock(log_mutex_);
+        if (!dirty_ && log_records_ == 0 && fs::exists(persist_path_, ec)) {
+            return true;
+        }
+        if (log_.is_open()) {
+            log_.close();
+        }
+        fs::rename(log_path_, old_log, ec);
+        log_records_ = 0;
+        dirty_ = false;
+    }
+
+    std::string buffer;
+    uint64_t count = 0;
+    appendBytes(buffer, &FILE_MAGIC, sizeof(FILE_MAGIC));
+    appendBytes(buffer, &FILE_VERSION, sizeof(FILE_VERSION));
+    size_t count_offset = buffer.size();
+    appendBytes(buffer, &count, sizeof(count));
+    for (const Stripe& stripe : stripes_) {
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        for (const Slot& slot : stripe.slots) {
+            if (slot.used && slot.record.hasStamp()) {
+                writeRecord(buffer, slot.path, slot.record);
+                count++;
+            }
+        }
+    }
+    buffer.replace(count_offset, sizeof(count), reinterpret_cast<const char*>(&count), sizeof(count));
+
+    // 写临时文件后原子替换
+    fs::create_directories(fs::path(persist_path_).parent_path(), ec);
+    std::string temp_path = persist_path_ + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        file.flush();
+        if (!file) {
+            dirty_ = true;
+            return false;
+        }
+    }
+    fs::rename(temp_path, persist_path_, ec);
+    if (ec) {
+        dirty_ = true;
+        auto logger = Logger::get();
+        if (logger) {
+            logger->warn("无法保存文件状态表 {}: {}", persist_path_, ec.message());
+        }
+        return false;
+    }
+    fs::remove(old_log, ec);
+    return true;
+}
+
+bool FileStateTable::maybeCompact() {
+    {
+        std::lock_guard<std::mutex> lock(log_mutex_);
+        if (!dirty_ && log_records_ <= std::max(COMPACT_MIN_RECORDS, entries_.load() / 2)) {
+            return true;
+        }
+    }
+    return compact();
+}
@@ -0,0 +1,242 @@
+#include "file_system.h"
+
+namespace {
+
+class RealEntry : public FileSystemEntry {
+public:
+    explicit RealEntry(const fs::directory_entry& entry) : entry_(entry) {}
+
+    const fs::path& path() const override { return entry_.path(); }
+    bool isDirectory() const override {
+        std::error_code ec;
+        return entry_.is_directory(ec);
+    }
+    bool isRegularFile() const override {
+        std::error_code ec;
+        return entry_.is_regular_file(ec);
+    }
+    std::optional<uint64_t> fileSize() const override {
+        std::error_code ec;
+        uint64_t size = entry_.file_size(ec);
+        if (ec) {
+            return std::nullopt;
+        }
+        return size;
+    }
+
+private:
+    const fs::directory_entry& entry_;
+};
+
+class MemoryEntry : public FileSystemEntry {
+public:
+    MemoryEntry(fs::path path, bool is_directory, uint64_t size)
+        : path_(std::move(path)), is_directory_(is_directory), size_(size) {}
+
+    const fs::path& path() const override { return path_; }
+    bool isDirectory() const override { return is_directory_; }
+    bool isRegularFile() const override { return !is_directory_; }
+    std::optional<uint64_t> fileSize() const override {
+        if (is_directory_) {
+            return std::nullopt;
+        }
+        return size_;
+    }
+
+private:
+    fs::path path_;
+    bool is_directory_;
+    uint64_t size_;
+};
+
+std::string childPath(const std::string& dir, const std::string& name) {
+    if (dir.empty()) {
+        return name;
+    }
+    if (dir.back() == '/') {
+        return dir + name;
+    }
+    return dir + "/" + name;
+}
+
+} // namespace
+
+FileSystem& FileSystem::real() {
+    static RealFileSystem file_system;
+    return file_system;
+}
+
+bool RealFileSystem::listDirectory(const fs::path& dir, const Visitor& visit) const {
+    std::error_code ec;
+    fs::directory_iterator it(dir, ec);
+    if (ec) {
+        return false;
+    }
+    for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        visit(RealEntry(*it));
+    }
+    return true;
+}
+
+bool RealFileSystem::walk(const fs::path& root, const Visitor& visit) const {
+    std::error_code ec;
+    fs::recursive_directory_iterator it(root, ec);
+    if (ec) {
+        return false;
+    }
+    for (; !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        visit(RealEntry(*it));
+    }
+    return true;
+}
+
+std::optional<uint64_t> RealFileSystem::fileSize(const fs::path& path) const {
+    std::error_code ec;
+    uint64_t size = fs::file_size(path, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+    return size;
+}
+
+bool RealFileSystem::remove(const fs::path& path) {
+    std::error_code ec;
+    return fs::remove(path, ec) && !ec;
+}
+
+std::string MemoryFileSystem::normalize(const fs::path& path) {
+    std::string normalized = path.lexically_normal().generic_string();
+    while (normalized.size() > 1 && normalized.back() == '/') {
+        normalized.pop_back();
+    }
+    if (normalized == ".") {
+        normalized.clear();
+    }
+    return normalized;
+}
+
+std::pair<std::string, std::string> MemoryFileSystem::splitParent(const std::string& path) {
+    size_t pos = path.rfind('/');
+    if (pos == std::string::npos) {
+        return {std::string(), path};
+    }
+    return {path.substr(0, pos == 0 ? 1 : pos), path.substr(pos + 1)};
+}
+
+MemoryFileSystem::Directory& MemoryFileSystem::ensureDirectory(const std::string& path) {
+    auto it = dirs_.find(path);
+    if (it != dirs_.end()) {
+        return it->second;
+    }
+    if (!path.empty() && path != "/") {
+        auto [parent, name] = splitParent(path);
+        if (!name.empty()) {
+            ensureDirectory(parent).subdirs.insert(name);
+        }
+    }
+    return dirs_[path];
+}
+
+bool MemoryFileSystem::listDirectory(const fs::path& dir, const Visitor& visit) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string key = normalize(dir);
+    auto it = dirs_.find(key);
+    if (it == dirs_.end()) {
+        return false;
+    }
+    for (const auto& name : it->second.subdirs) {
+        visit(MemoryEntry(childPath(key, name), true, 0));
+    }
+    for (const auto& [name, size] : it->second.files) {
+        visit(MemoryEntry(childPath(key, name), false, size));
+    }
+    return true;
+}
+
+bool MemoryFileSystem::walk(const fs::path& root, const Visitor& visit) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return walkLocked(normalize(root), visit);
+}
+
+bool MemoryFileSystem::walkLocked(const std::string& dir, const Visitor& visit) const {
+    auto it = dirs_.find(dir);
+    if (it == dirs_.end()) {
+        return false;
+    }
+    for (const auto& name : it->second.subdirs) {
+        std::string sub = childPath(dir, name);
+        visit(MemoryEntry(sub, true, 0));
+        walkLocked(sub, visit);
+    }
+    for (const auto& [name, size] : it->second.files) {
+        visit(MemoryEntry(childPath(dir, name), false, size));
+    }
+    return true;
+}
+
+std::optional<uint64_t> MemoryFileSystem::fileSize(const fs::path& path) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto [parent, name] = splitParent(normalize(path));
+    auto it = dirs_.find(parent);
+    if (it == dirs_.end()) {
+        return std::nullopt;
+    }
+    auto file = it->second.files.find(name);
+    if (file == it->second.files.end()) {
+        return std::nullopt;
+    }
+    return file->second;
+}
+
+bool MemoryFileSystem::remove(const fs::path& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string key = normalize(path);
+    auto [parent, name] = splitParent(key);
+    auto it = dirs_.find(parent);
+    if (it == dirs_.end()) {
+        return false;
+    }
+    auto file = it->second.files.find(name);
+    if (file != it->second.files.end()) {
+        total_bytes_ -= file->second;
+        file_count_--;
+        it->second.files.erase(file);
+        return true;
+    }
+    // 与 fs::remove 一致：空目录也可删除
+    auto dir = dirs_.find(key);
+    if (dir == dirs_.end() || !dir->second.files.empty() || !dir->second.subdirs.empty()) {
+        return false;
+    }
+    dirs_.erase(dir);
+    it->second.subdirs.erase(name);
+    return true;
+}
+
+void MemoryFileSystem::writeFile(const fs::path& path, uint64_t size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto [parent, name] = splitParent(normalize(path));
+    auto [file, inserted] = ensureDirectory(parent).files.try_emplace(name, size);
+    if (inserted) {
+        file_count_++;
+    } else {
+        total_bytes_ -= file->second;
+        file->second = size;
+    }
+    total_bytes_ += size;
+}
+
+void MemoryFileSystem::createDirectories(const fs::path& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ensureDirectory(normalize(path));
+}
+
+size_t MemoryFileSystem::fileCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return file_count_;
+}
+
+uint64_t MemoryFileSystem::totalBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return total_bytes_;
+}
@@ -0,0 +1,396 @@
+#include "filter_matcher.h"
+#include "backup_handler.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+namespace {
+
+inline bool isSeparator(char c) {
+    return c == '/' || c == '\\';
+}
+
+inline char toLowerAscii(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+std::string normalizeRule(const std::string& raw) {
+    std::string rule;
+    rule.reserve(raw.size());
+    for (char c : raw) {
+        rule.push_back(c == '\\' ? '/' : toLowerAscii(c));
+    }
+    
+    auto first = rule.find_first_not_of(" \t");
+    auto last = rule.find_last_not_of(" \t");
+    if (first == std::string::npos) {
+        return std::string();
+    }
+    return rule.substr(first, last - first + 1);
+}
+
+// 在 [0, len) 中查找最后一个目录分隔符之后的位置
+size_t nameStart(const std::string& path) {
+    size_t pos = path.find_last_of("/\\");
+    return pos == std::string::npos ? 0 : pos + 1;
+}
+
+} // namespace
+
+std::shared_ptr<const FilterMatcher> FilterMatcher::compile(const FilterConfig& config) {
+    std::shared_ptr<FilterMatcher> matcher(new FilterMatcher());
+    
+    if (config.useDualMode()) {
+        matcher->mode_ = Mode::Dual;
+        matcher->has_whitelist_ = !config.whitelist_extensions.empty();
+        for (const auto& ext : config.whitelist_extensions) {
+            matcher->addName(ext, FLAG_WHITELIST);
+        }
+        for (const auto& ext : config.blacklist_extensions) {
+            matcher->addName(ext, FLAG_BLACKLIST);
+        }
+    } else if (config.mode == FilterConfig::Mode::Whitelist) {
+        matcher->mode_ = Mode::Whitelist;
+    } else if (config.mode == FilterConfig::Mode::Blacklist) {
+        matcher->mode_ = Mode::Blacklist;
+    }
+    
+    if (matcher->mode_ == Mode::Whitelist || matcher->mode_ == Mode::Blacklist) {
+        for (const auto& ext : config.extensions) {
+            matcher->addName(ext, FLAG_LEGACY);
+        }
+    }
+    
+    // 排除规则分类
+    for (const auto& raw : config.exclude_patterns) {
+        std::string rule = normalizeRule(raw);
+        if (rule.empty() || rule[0] == '#') {
+            continue;
+        }
+        
+        bool dir_only = rule.back() == '/';
+        while (!rule.empty() && rule.back() == '/') {
+            rule.pop_back();
+        }
+        bool anchored = !rule.empty() && rule.front() == '/';
+        rule.erase(0, rule.find_first_not_of('/'));
+        if (rule.empty()) {
+            continue;
+        }
+        
+        bool has_slash = rule.find('/') != std::string::npos;
+        bool has_wildcard = rule.find_first_of("*?") != std::string::npos;
+        
+        if (!anchored && !has_slash) {
+            // 单个名称：匹配任意层级的同名目录；不以 / 结尾时同时匹配文件名
+            if (has_wildcard) {
+                matcher->dir_name_globs_.push_back(rule);
+            } else {
+                matcher->dir_names_.push_back(rule);
+            }
+            if (!dir_only) {
+                matcher->file_name_globs_.push_back(rule);
+            }
+        } else {
+            // 带路径的规则：相对源路径匹配
+            matcher->dir_path_globs_.push_back(rule);
+            if (!dir_only) {
+                matcher->file_path_globs_.push_back(rule);
+            }
+        }
+    }
+    
+    matcher->buildTable();
+    return matcher;
+}
+
+void FilterMatcher::addName(const std::string& name, uint8_t flag) {
+    std::string key = normalizeRule(name);
+    if (key.empty() || key.size() > MAX_NAME_LEN) {
+        return;
+    }
+    
+    pending_names_.emplace_back(key, flag);
+    // 配置中的扩展名可以不带点
+    if (key[0] != '.') {
+        pending_names_.emplace_back("." + key, flag);
+    }
+}
+
+uint32_t FilterMatcher::hashKey(const char* data, size_t len, uint32_t seed) {
+    // FNV-1a，种子参与初始值
+    uint32_t hash = 2166136261u ^ (seed * 16777619u);
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash ^ (hash >> 15);
+}
+
+void FilterMatcher::buildTable() {
+    // 合并重复键的标志位
+    std::map<std::string, uint8_t> merged;
+    for (const auto& entry : pending_names_) {
+        merged[entry.first] |= entry.second;
+    }
+    pending_names_.clear();
+    pending_names_.shrink_to_fit();
+    
+    if (merged.empty()) {
+        return;
+    }
+    
+    size_t size = 8;
+    while (size < merged.size() * 2) {
+        size <<= 1;
+    }
+    
+    // 搜索无冲突的种子；多次失败则扩大表
+    for (;;) {
+        for (uint32_t seed = 1; seed <= 256; ++seed) {
+            std::vector<Slot> table(size);
+            bool ok = true;
+            
+            for (const auto& entry : merged) {
+                uint32_t idx = hashKey(entry.first.data(), entry.first.size(), seed) & (size - 1);
+                if (!table[idx].key.empty()) {
+                    ok = false;
+                    break;
+                }
+                table[idx].key = entry.first;
+                table[idx].flags = entry.second;
+            }
+            
+            if (ok) {
+                table_ = std::move(table);
+                seed_ = seed;
+                mask_ = static_cast<uint32_t>(size - 1);
+                return;
+            }
+        }
+        size <<= 1;
+    }
+}
+
+uint8_t FilterMatcher::lookup(const char* lower, size_t len) const {
+    if (table_.empty() || len == 0) {
+        return 0;
+    }
+    
+    const Slot& slot = table_[hashKey(lower, len, seed_) & mask_];
+    if (slot.key.size() == len && std::memcmp(slot.key.data(), lower, len) == 0) {
+        return slot.flags;
+    }
+    return 0;
+}
+
+bool FilterMatcher::allowsName(const std::string& file_name) const {
+    return matchesName(file_name.data(), file_name.size());
+}
+
+bool FilterMatcher::matchesName(const char* file_name, size_t len) const {
+    if (mode_ == Mode::None) {
+        return true;
+    }
+    
+    // 小写化到栈缓冲区，避免分配
+    char lower[MAX_NAME_LEN + 1];
+    uint8_t flags = 0;
+    
+    if (len <= MAX_NAME_LEN) {
+        for (size_t i = 0; i < len; ++i) {
+            lower[i] = toLowerAscii(file_name[i]);
+        }
+        
+        // 与 std::filesystem::path::extension 一致：以点开头的文件名没有扩展名
+        const char* dot = static_cast<const char*>(std::memchr(lower + 1, '.', len > 1 ? len - 1 : 0));
+        if (dot) {
+            const char* last_dot = lower + len;
+            while (last_dot > lower && *(last_dot - 1) != '.') {
+                --last_dot;
+            }
+            --last_dot;
+            flags |= lookup(last_dot, lower + len - last_dot);
+        }
+        
+        // 完整文件名（如 dockerfile、.gitignore、thumbs.db）
+        flags |= lookup(lower, len);
+    }
+    
+    switch (mode_) {
+        case Mode::Dual:
+            if (flags & FLAG_BLACKLIST) {
+                return false;
+            }
+            return has_whitelist_ ? (flags & FLAG_WHITELIST) != 0 : true;
+        case Mode::Whitelist:
+            return (flags & FLAG_LEGACY) != 0;
+        case Mode::Blacklist:
+            return (flags & FLAG_LEGACY) == 0;
+        default:
+            return true;
+    }
+}
+
+bool FilterMatcher::matchesDirectoryName(const char* name, size_t len) const {
+    for (const auto& dir_name : dir_names_) {
+        if (dir_name.size() != len) {
+            continue;
+        }
+        bool equal = true;
+        for (size_t i = 0; i < len; ++i) {
+            if (toLowerAscii(name[i]) != dir_name[i]) {
+                equal = false;
+                break;
+            }
+        }
+        if (equal) {
+            return true;
+        }
+    }
+    
+    for (const auto& glob : dir_name_globs_) {
+        if (globMatch(glob.data(), glob.size(), name, len)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool FilterMatcher::prunesDirectory(const std::string& relative_dir) const {
+    size_t end = relative_dir.size();
+    while (end > 0 && isSeparator(relative_dir[end - 1])) {
+        --end;
+    }
+    if (end == 0) {
+        return false;
+    }
+    
+    size_t start = end;
+    while (start > 0 && !isSeparator(relative_dir[start - 1])) {
+        --start;
+    }
+    
+    if (matchesDirectoryName(relative_dir.data() + start, end - start)) {
+        return true;
+    }
+    
+    for (const auto& glob : dir_path_globs_) {
+        if (globMatch(glob.data(), glob.size(), relative_dir.data(), end)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool FilterMatcher::isUnderPrunedDirectory(const std::string& relative_path) const {
+    if (!hasDirectoryRules()) {
+        return false;
+    }
+    
+    // 逐级检查每个上级目录，O(路径深度)
+    size_t start = 0;
+    for (size_t i = 0; i < relative_path.size(); ++i) {
+        if (!isSeparator(relative_path[i])) {
+            continue;
+        }
+        if (i > start) {
+            if (matchesDirectoryName(relative_path.data() + start, i - start)) {
+                return true;
+            }
+            for (const auto& glob : dir_path_globs_) {
+                if (globMatch(glob.data(), glob.size(), relative_path.data(), i)) {
+                    return true;
+                }
+            }
+        }
+        start = i + 1;
+    }
+    return false;
+}
+
+bool FilterMatcher::allowsFile(const std::string& path) const {
+    size_t name_pos = nameStart(path);
+    
+    // 扩展名查表最便宜，放在最前
+    if (!matchesName(path.data() + name_pos, path.size() - name_pos)) {
+        return false;
+    }
+    
+    if (isUnderPrunedDirectory(path)) {
+        return false;
+    }
+    
+    for (const auto& glob : file_name_globs_) {
+        if (globMatch(glob.data(), glob.size(), path.data() + name_pos, path.size() - name_pos)) {
+            return false;
+        }
+    }
+    for (const auto& glob : file_path_globs_) {
+        if (globMatch(glob.data(), glob.size(), path.data(), path.size())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FilterMatcher::hasDirectoryRules() const {
+    return !dir_names_.empty() || !dir_name_globs_.empty() || !dir_path_globs_.empty();
+}
+
+bool FilterMatcher::globMatch(const char* pattern, size_t pattern_len, const char* text, size_t text_len) {
+    size_t pi = 0;
+    size_t ti = 0;
+    size_t star_pi = std::string::npos;
+    size_t star_ti = 0;
+    
+    while (ti < text_len) {
+        if (pi < pattern_len && pattern[pi] == '*') {
+            if (pi + 1 < pattern_len && pattern[pi + 1] == '*') {
+                // **：可跨越目录；**/ 可匹配零级目录
+                size_t rest = pi + 2;
+                bool slash = rest < pattern_len && pattern[rest] == '/';
+                for (size_t k = ti; k <= text_len; ++k) {
+                    if (slash) {
+                        if ((k == ti || isSeparator(text[k - 1])) &&
+                            globMatch(pattern + rest + 1, pattern_len - rest - 1, text + k, text_len - k)) {
+                            return true;
+                        }
+                    } else if (globMatch(pattern + rest, pattern_len - rest, text + k, text_len - k)) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+            star_pi = pi++;
+            star_ti = ti;
+            continue;
+        }
+        
+        if (pi < pattern_len) {
+            char p = pattern[pi];
+            char t = text[ti];
+            bool matched = (p == '?') ? !isSeparator(t)
+                         : (p == '/') ? isSeparator(t)
+                         : (p == toLowerAscii(t));
+            if (matched) {
+                pi++;
+                ti++;
+                continue;
+            }
+        }
+        
+        // 回溯：让上一个 * 多吞一个字符（不能跨越分隔符）
+        if (star_pi != std::string::npos && !isSeparator(text[star_ti])) {
+            pi = star_pi + 1;
+            ti = ++star_ti;
+            continue;
+        }
+        return false;
+    }
+    
+    while (pi < pattern_len && pattern[pi] == '*') {
+        pi++;
+    }
+    return pi == pattern_len;
+}
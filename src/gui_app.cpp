@@ -1,6 +1,8 @@
 #include "gui_app.h"
 #include "logger.h" // 假设这些头文件存在
 #include "config_loader.h"
+#include "tracer.h"
+#include "profiler.h"
 #include <shellapi.h>
 #include <commctrl.h>
 #include <shlobj.h>
@@ -13,75 +15,8 @@ namespace fs = std::filesystem;
 
 namespace CodeBackup { // 添加命名空间
 
-// 辅助函数：检查文件是否被过滤器允许
-static bool isFileAllowed(const std::string& file_path, const FilterConfig& filter) {
-    // 获取文件扩展名
-    size_t dot_pos = file_path.find_last_of('.');
-    if (dot_pos == std::string::npos) {
-        // 没有扩展名的文件
-        if (filter.useDualMode()) {
-            // 双列表模式：如果有白名单，没有扩展名的文件不通过
-            return filter.whitelist_extensions.empty();
-        } else if (filter.mode == FilterConfig::Mode::Whitelist) {
-            return false; // 白名单模式下，没有扩展名的文件不通过
-        }
-        return true; // 黑名单或无模式下，没有扩展名的文件通过
-    }
-    
-    std::string ext = file_path.substr(dot_pos);
-    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-    
-    if (filter.useDualMode()) {
-        // 新的双列表模式
-        bool in_whitelist = filter.whitelist_extensions.empty();
-        bool in_blacklist = false;
-        
-        for (const auto& allowed_ext : filter.whitelist_extensions) {
-            std::string lower_ext = allowed_ext;
-            std::transform(lower_ext.begin(), lower_ext.end(), lower_ext.begin(), ::tolower);
-            if (ext == lower_ext) {
-                in_whitelist = true;
-                break;
-            }
-        }
-        
-        for (const auto& blocked_ext : filter.blacklist_extensions) {
-            std::string lower_ext = blocked_ext;
-            std::transform(lower_ext.begin(), lower_ext.end(), lower_ext.begin(), ::tolower);
-            if (ext == lower_ext) {
-                in_blacklist = true;
-                break;
-            }
-        }
-        
-        // 白名单优先：必须在白名单中且不在黑名单中
-        return in_whitelist && !in_blacklist;
-    } else {
-        // 旧的单模式
-        if (filter.mode == FilterConfig::Mode::None) {
-            return true;
-        }
-        
-        bool found = false;
-        for (const auto& allowed_ext : filter.extensions) {
-            std::string lower_ext = allowed_ext;
-            std::transform(lower_ext.begin(), lower_ext.end(), lower_ext.begin(), ::tolower);
-            if (ext == lower_ext) {
-                found = true;
-                break;
-            }
-        }
-        
-        if (filter.mode == FilterConfig::Mode::Whitelist) {
-            return found;
-        } else { // Blacklist
-            return !found;
-        }
-    }
-}
-
-// 辅助函数：递归扫描目录并分类文件
-static void scanDirectory(const std::string& path, const FilterConfig& filter, 
+// 辅助函数：递归扫描目录并分类文件，被排除的目录整体跳过、不再向下遍历
+static void scanDirectory(const std::string& path, const FilterMatcher& matcher, 
                           std::vector<std::string>& included, std::vector<std::string>& excluded,
                           int max_files = 1000) {
     if (included.size() + excluded.size() >= (size_t)max_files) {
@@ -89,16 +24,24 @@ static void scanDirectory(const std::string& path, const FilterConfig& filter,
     }
     
     try {
-        for (const auto& entry : fs::recursive_directory_iterator(path, 
-            fs::directory_options::skip_permission_denied)) {
-            
+        fs::path root(path);
+        fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied);
+        for (; it != fs::recursive_directory_iterator(); ++it) {
             if (included.size() + excluded.size() >= (size_t)max_files) {
                 break;
             }
             
-            if (entry.is_regular_file()) {
+            const auto& entry = *it;
+            std::string relative = entry.path().lexically_relative(root).string();
+            
+            if (entry.is_directory()) {
+                if (matcher.prunesDirectory(relative)) {
+                    excluded.push_back(entry.path().string() + "\\ (已排除目录)");
+                    it.disable_recursion_pending();
+                }
+            } else if (entry.is_regular_file()) {
                 std::string file_path = entry.path().string();
-                if (isFileAllowed(file_path, filter)) {
+                if (matcher.allowsFile(relative)) {
                     included.push_back(file_path);
                 } else {
                     excluded.push_back(file_path);
@@ -110,7 +53,6 @@ static void scanDirectory(const std::string& path, const FilterConfig& filter,
     }
 }
 
-// UTF-8 到 UTF-16 转换辅助函数
 inline std::wstring Utf8ToWide(const std::string& utf8str) {
     if (utf8str.empty()) return std::wstring();
     
@@ -428,8 +370,13 @@ LRESULT CALLBACK SourceConfigDialogProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPA
                         }
                     }
                     
-                    // 合并预设
-                    FilterConfig merged_filter = ConfigLoader::mergeFilters(
+                    // 排除规则目前只能在配置文件中编辑，沿用现有设置
+                    if (data->source->custom_filter) {
+                        temp_filter.exclude_patterns = data->source->custom_filter->exclude_patterns;
+                    }
+                    
+                    // 合并预设并编译
+                    auto matcher = ConfigLoader::compileFilters(
                         data->source->presets,
                         *data->presets,
                         temp_filter
@@ -438,13 +385,13 @@ LRESULT CALLBACK SourceConfigDialogProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPA
                     // 扫描文件
                     std::vector<std::string> included, excluded;
                     if (fs::is_regular_file(pathStr)) {
-                        if (isFileAllowed(pathStr, merged_filter)) {
+                        if (matcher->allowsFile(fs::path(pathStr).filename().string())) {
                             included.push_back(pathStr);
                         } else {
                             excluded.push_back(pathStr);
                         }
                     } else if (fs::is_directory(pathStr)) {
-                        scanDirectory(pathStr, merged_filter, included, excluded, 500);
+                        scanDirectory(pathStr, *matcher, included, excluded, 500);
                     }
                     
                     // 创建预览窗口
@@ -901,6 +848,9 @@ LRESULT CALLBACK GuiApp::WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM
                 case ID_TRAY_PREVIEW:
                     app->showPreviewDialog();
                     break;
+                case ID_TRAY_TRACE:
+                    app->exportTrace();
+                    break;
                 case ID_TRAY_EXIT:
                     PostQuitMessage(0);
                     break;
@@ -1000,6 +950,7 @@ void GuiApp::showContextMenu() {
         AppendMenuW(hMenu_, MF_STRING, ID_TRAY_FORMATS, L"备份格式");
         AppendMenuW(hMenu_, MF_STRING, ID_TRAY_SETTINGS, L"备份设置");
         AppendMenuW(hMenu_, MF_STRING, ID_TRAY_CONFIG, L"编辑配置文件");
+        AppendMenuW(hMenu_, MF_STRING, ID_TRAY_TRACE, L"导出性能跟踪");
         AppendMenuW(hMenu_, MF_SEPARATOR, 0, nullptr);
         AppendMenuW(hMenu_, MF_STRING, ID_TRAY_EXIT, L"退出");
     }
@@ -1007,6 +958,7 @@ void GuiApp::showContextMenu() {
     // 更新菜单状态
     EnableMenuItem(hMenu_, ID_TRAY_START, is_monitoring_ ? MF_GRAYED : MF_ENABLED);
     EnableMenuItem(hMenu_, ID_TRAY_STOP, is_monitoring_ ? MF_ENABLED : MF_GRAYED);
+    EnableMenuItem(hMenu_, ID_TRAY_TRACE, Tracer::enabled() ? MF_ENABLED : MF_GRAYED);
 
     SetForegroundWindow(hwnd_);
     TrackPopupMenu(hMenu_, TPM_BOTTOMALIGN | TPM_LEFTALIGN, pt.x, pt.y, 0, hwnd_, nullptr);
@@ -1030,6 +982,25 @@ void GuiApp::showStatusDialog() {
     MessageBoxW(hwnd_, ss.str().c_str(), L"状态信息", MB_ICONINFORMATION);
 }
 
+void GuiApp::exportTrace() {
+    if (!Tracer::enabled()) {
+        MessageBoxW(hwnd_, L"未启用性能跟踪（配置 strategy.trace_enabled）", L"CodeBackup", MB_ICONINFORMATION);
+        return;
+    }
+
+    std::string trace_path = (fs::path(ConfigLoader::diagnosticsDirectory(config_)) / Tracer::dumpFileName()).string();
+    size_t events = Tracer::dump(trace_path);
+    if (events == 0) {
+        MessageBoxW(hwnd_, L"没有可导出的跟踪事件，或无法写入跟踪文件", L"CodeBackup", MB_ICONWARNING);
+        return;
+    }
+
+    std::wstringstream ss;
+    ss << L"已导出 " << events << L" 个跟踪事件到:\n" << Utf8ToWide(trace_path)
+       << L"\n\n可在 chrome://tracing 或 ui.perfetto.dev 中打开";
+    MessageBoxW(hwnd_, ss.str().c_str(), L"CodeBackup", MB_ICONINFORMATION);
+}
+
 void GuiApp::showFormatsWindow() {
     // 注册对话框窗口类
     static const wchar_t* className = L"FormatsDialogClass";
@@ -1312,8 +1283,8 @@ void GuiApp::showPreviewDialog() {
             continue;
         }
 
-        // 合并过滤器配置
-        FilterConfig filter = ConfigLoader::mergeFilters(
+        // 合并并编译过滤器配置
+        auto matcher = ConfigLoader::compileFilters(
             source.presets, 
             presets_, 
             source.custom_filter
@@ -1321,14 +1292,14 @@ void GuiApp::showPreviewDialog() {
 
         // 如果是单个文件
         if (fs::is_regular_file(source.path)) {
-            if (isFileAllowed(source.path, filter)) {
+            if (matcher->allowsFile(fs::path(source.path).filename().string())) {
                 all_included.push_back(source.path);
             } else {
                 all_excluded.push_back(source.path);
             }
         } else if (fs::is_directory(source.path)) {
             // 扫描目录
-            scanDirectory(source.path, filter, all_included, all_excluded, 1000);
+            scanDirectory(source.path, *matcher, all_included, all_excluded, 1000);
         }
     }
 
@@ -1645,6 +1616,11 @@ void GuiApp::saveConfiguration() {
                     }
                 }
                 
+                if (!source.custom_filter->exclude_patterns.empty()) {
+                    filter_json["exclude"] = source.custom_filter->exclude_patterns;
+                    hasFilter = true;
+                }
+                
                 if (hasFilter) {
                     source_json["filter"] = filter_json;
                 }
@@ -1664,6 +1640,34 @@ void GuiApp::saveConfiguration() {
         config_json["strategy"]["full_backup_interval"] = config_.strategy.full_backup_interval;
         config_json["strategy"]["delta_ratio_threshold"] = config_.strategy.delta_ratio_threshold;
         config_json["strategy"]["max_file_size"] = config_.strategy.max_file_size;
+        config_json["strategy"]["small_file_threshold"] = config_.strategy.small_file_threshold;
+        config_json["strategy"]["bulk_file_threshold"] = config_.strategy.bulk_file_threshold;
+        config_json["strategy"]["bulk_max_workers"] = config_.strategy.bulk_max_workers;
+        config_json["strategy"]["recent_edit_window_seconds"] = config_.strategy.recent_edit_window_seconds;
+        config_json["strategy"]["aging_seconds"] = config_.strategy.aging_seconds;
+        config_json["strategy"]["min_workers"] = config_.strategy.min_workers;
+        config_json["strategy"]["max_workers"] = config_.strategy.max_workers;
+        config_json["strategy"]["scale_up_wait_ms"] = config_.strategy.scale_up_wait_ms;
+        config_json["strategy"]["scale_down_idle_seconds"] = config_.strategy.scale_down_idle_seconds;
+        config_json["strategy"]["event_buffer_capacity"] = config_.strategy.event_buffer_capacity;
+        config_json["strategy"]["storm_event_threshold"] = config_.strategy.storm_event_threshold;
+        config_json["strategy"]["storm_window_ms"] = config_.strategy.storm_window_ms;
+        config_json["strategy"]["storm_settle_ms"] = config_.strategy.storm_settle_ms;
+        config_json["strategy"]["storm_root_depth"] = config_.strategy.storm_root_depth;
+        config_json["strategy"]["watcher_backend"] = config_.strategy.watcher_backend;
+        config_json["strategy"]["reconcile_on_startup"] = config_.strategy.reconcile_on_startup;
+        config_json["strategy"]["scan_threads"] = config_.strategy.scan_threads;
+        config_json["strategy"]["state_max_entries"] = config_.strategy.state_max_entries;
+        config_json["strategy"]["async_logging"] = config_.strategy.async_logging;
+        config_json["strategy"]["log_queue_size"] = config_.strategy.log_queue_size;
+        config_json["strategy"]["log_overflow_policy"] = config_.strategy.log_overflow_policy;
+        config_json["strategy"]["log_flush_interval_seconds"] = config_.strategy.log_flush_interval_seconds;
+        config_json["strategy"]["log_level"] = config_.strategy.log_level;
+        config_json["strategy"]["metrics_interval_seconds"] = config_.strategy.metrics_interval_seconds;
+        config_json["strategy"]["metrics_directory"] = config_.strategy.metrics_directory;
+        config_json["strategy"]["trace_enabled"] = config_.strategy.trace_enabled;
+        config_json["strategy"]["trace_buffer_events"] = config_.strategy.trace_buffer_events;
+        config_json["strategy"]["capture_events"] = config_.strategy.capture_events;
         
         // 写入文件
         std::ofstream file("config.json");
@@ -1715,8 +1719,11 @@ void GuiApp::stopMonitoring() {
         monitor_thread_->join();
     }
     
+    // 导出线程持有处理器指针，先于处理器停止
+    metrics_exporter_.reset();
     handlers_.clear();
     file_watcher_.reset();
+    event_recorder_.reset();
     
     is_monitoring_ = false;
     updateTrayTooltip();
@@ -1726,13 +1733,35 @@ void GuiApp::stopMonitoring() {
 
 void GuiApp::monitoringThread() {
     // 设置日志
-    Logger::setup(config_.backup_destination_base, true);
+    Logger::setup(config_.backup_destination_base, true, ConfigLoader::logOptions(config_.strategy));
     auto logger = Logger::get();
+    
+    // 启用后在整个进程内保持开启（各线程的缓冲区会被后续线程复用）
+    if (config_.strategy.trace_enabled) {
+        Tracer::enable(config_.strategy.trace_buffer_events);
+        Tracer::nameThread("monitor");
+    }
 
     try {
         // 创建文件监控器
-        file_watcher_ = std::make_unique<efsw::FileWatcher>();
+        file_watcher_ = createWatchBackend(config_.strategy.watcher_backend);
         handlers_.clear();
+        
+        // 原始事件记录在注册监控之前打开
+        event_recorder_.reset();
+        if (config_.strategy.capture_events) {
+            event_recorder_ = std::make_unique<EventTraceWriter>();
+            std::string capture_path = (fs::path(ConfigLoader::diagnosticsDirectory(config_)) /
+                                        EventTraceWriter::captureFileName()).string();
+            if (event_recorder_->open(capture_path)) {
+                logger->info("原始事件记录 -> {}", capture_path);
+            } else {
+                event_recorder_.reset();
+            }
+        }
+
+        // 所有备份源共享工作线程配额：同时繁忙时合计不超过 max_workers（未配置时为 CPU 核心数）
+        WorkerBudget::shared().setCapacity(config_.strategy.max_workers);
 
         // 为每个启用的源路径创建监控
         for (const auto& source : config_.backup_sources) {
@@ -1742,7 +1771,7 @@ void GuiApp::monitoringThread() {
             }
 
             // 使用新的合并函数，支持预设和自定义过滤器同时使用
-            FilterConfig filter_config = ConfigLoader::mergeFilters(
+            auto filter_matcher = ConfigLoader::compileFilters(
                 source.presets, 
                 presets_, 
                 source.custom_filter
@@ -1751,22 +1780,20 @@ void GuiApp::monitoringThread() {
             auto handler = std::make_unique<BackupHandler>(
                 source.path, 
                 config_.backup_destination_base,
-                filter_config,
+                filter_matcher,
                 config_.strategy
             );
             
             // 启动异步备份队列
-            handler->startAsyncBackup(2); // 假设 2 个工作线程
-
-            efsw::WatchID watch_id = file_watcher_->addWatch(
-                source.path, 
-                handler.get(), 
-                true // 递归
-            );
+            handler->startAsyncBackup(config_.strategy.min_workers, config_.strategy.max_workers);
+            if (event_recorder_) {
+                handler->setEventRecorder(event_recorder_.get());
+            }
 
-            if (watch_id > 0) {
+            // 有目录排除规则时只监控未被排除的目录
+            if (handler->attachWatcher(*file_watcher_)) {
+                logger->info("正在监控 -> {} ({} 个监控)", source.path, handler->getWatchCount());
                 handlers_.push_back(std::move(handler));
-                logger->info("正在监控 -> {}", source.path);
             } else {
                 logger->error("无法监控 -> {}", source.path);
             }
@@ -1779,6 +1806,18 @@ void GuiApp::monitoringThread() {
             return;
         }
 
+        // 定期导出各阶段延迟和吞吐量
+        if (config_.strategy.metrics_interval_seconds > 0) {
+            metrics_exporter_ = std::make_unique<MetricsExporter>(
+                ConfigLoader::diagnosticsDirectory(config_),
+                std::chrono::seconds(config_.strategy.metrics_interval_seconds));
+            for (const auto& handler : handlers_) {
+                const BackupHandler* source = handler.get();
+                metrics_exporter_->addSource(source->getSourcePath(), [source]() { return source->getMetrics(); });
+            }
+            metrics_exporter_->start();
+        }
+
         file_watcher_->watch(); // 开始阻塞监控
         logger->info("--- 监控服务已启动 (GUI 版本 V3.0) ---");
         logger->info("备份策略: 保留{}天 | 最多{}版本 | 压缩:{} | 增量:{}", 
@@ -1795,10 +1834,30 @@ void GuiApp::monitoringThread() {
         // 停止 file_watcher_ (它会停止 watch() 循环)
         file_watcher_.reset();
         
+        if (event_recorder_) {
+            event_recorder_->close();
+            logger->info("已记录 {} 个原始事件 -> {}（丢弃 {} 个）", event_recorder_->recordedEvents(),
+                        event_recorder_->path(), event_recorder_->droppedEvents());
+        }
+        
         // 停止所有 handler 的异步队列
         for (auto& handler : handlers_) {
             handler->stopAsyncBackup();
         }
+        
+        // 队列排空后写出最后一次指标
+        if (metrics_exporter_) {
+            metrics_exporter_->stop();
+        }
+        
+        if (Tracer::enabled()) {
+            std::string trace_path = (fs::path(ConfigLoader::diagnosticsDirectory(config_)) / Tracer::dumpFileName()).string();
+            size_t events = Tracer::dump(trace_path);
+            logger->info("已导出 {} 个跟踪事件 -> {}", events, trace_path);
+        }
+        
+        // 以 CODEBACKUP_PROFILE 编译时输出各插桩点的耗时
+        Profiler::logReport();
 
         logger->info("--- 监控服务已停止 ---");
 
@@ -1,120 +1,70 @@
 #include "hash_utils.h"
-#include <fstream>
-#include <sstream>
-#include <iomanip>
-#include <filesystem>
-#include <windows.h>
-#include <wincrypt.h>
+#include "file_state_table.h"
+#include "platform.h"
+#include "profiler.h"
+#include <vector>
+
+namespace {
+
+// 转换为十六进制字符串（直接写入结果，不经过 stringstream）
+std::string toHex(const uint8_t (&digest)[Platform::Sha256::DIGEST_SIZE]) {
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+    std::string hex(Platform::Sha256::DIGEST_SIZE * 2, '0');
+    for (size_t i = 0; i < Platform::Sha256::DIGEST_SIZE; i++) {
+        hex[i * 2] = HEX_DIGITS[digest[i] >> 4];
+        hex[i * 2 + 1] = HEX_DIGITS[digest[i] & 0x0f];
+    }
+    return hex;
+}
 
-namespace fs = std::filesystem;
+} // namespace
 
 std::optional<std::string> HashUtils::calculateFileHash(const std::string& file_path) {
-    std::ifstream file(file_path, std::ios::binary);
-    if (!file) {
+    PROFILE_SCOPE("hash.file");
+    Platform::SequentialFile file;
+    if (!file.open(file_path)) {
         return std::nullopt;
     }
 
-    // 使用 Windows Crypto API 计算 SHA-256
-    HCRYPTPROV hProv = 0;
-    HCRYPTHASH hHash = 0;
-    
-    if (!CryptAcquireContext(&hProv, nullptr, nullptr, PROV_RSA_AES, CRYPT_VERIFYCONTEXT)) {
-        return std::nullopt;
-    }
-
-    if (!CryptCreateHash(hProv, CALG_SHA_256, 0, 0, &hHash)) {
-        CryptReleaseContext(hProv, 0);
-        return std::nullopt;
-    }
+    Platform::Sha256 sha;
 
-    // 分块读取文件
+    // 分块读取文件（读缓冲每个线程一份，反复哈希时不再分配）
     const size_t BUFFER_SIZE = 8192;
-    std::vector<char> buffer(BUFFER_SIZE);
-    
-    while (file.read(buffer.data(), BUFFER_SIZE) || file.gcount() > 0) {
-        if (!CryptHashData(hHash, reinterpret_cast<BYTE*>(buffer.data()), 
-                          static_cast<DWORD>(file.gcount()), 0)) {
-            CryptDestroyHash(hHash);
-            CryptReleaseContext(hProv, 0);
-            return std::nullopt;
-        }
-    }
+    thread_local std::vector<char> buffer(BUFFER_SIZE);
 
-    // 获取哈希值
-    BYTE hash[32];
-    DWORD hashLen = 32;
-    if (!CryptGetHashParam(hHash, HP_HASHVAL, hash, &hashLen, 0)) {
-        CryptDestroyHash(hHash);
-        CryptReleaseContext(hProv, 0);
+    int64_t read_bytes = 0;
+    while ((read_bytes = file.read(buffer.data(), BUFFER_SIZE)) > 0) {
+        PROFILE_SCOPE("hash.chunk");
+        PROFILE_COUNT("hash.bytes", read_bytes);
+        sha.update(buffer.data(), static_cast<size_t>(read_bytes));
+    }
+    if (read_bytes < 0) {
         return std::nullopt;
     }
 
-    // 转换为十六进制字符串
-    std::stringstream ss;
-    for (DWORD i = 0; i < hashLen; i++) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(hash[i]);
+    uint8_t digest[Platform::Sha256::DIGEST_SIZE];
+    if (!sha.finish(digest)) {
+        return std::nullopt;
     }
-
-    CryptDestroyHash(hHash);
-    CryptReleaseContext(hProv, 0);
-
-    return ss.str();
+    return toHex(digest);
 }
 
 std::string HashUtils::calculateDataHash(const uint8_t* data, size_t size) {
-    HCRYPTPROV hProv = 0;
-    HCRYPTHASH hHash = 0;
-    
-    if (!CryptAcquireContext(&hProv, nullptr, nullptr, PROV_RSA_AES, CRYPT_VERIFYCONTEXT)) {
+    Platform::Sha256 sha;
+    sha.update(data, size);
+    uint8_t digest[Platform::Sha256::DIGEST_SIZE];
+    if (!sha.finish(digest)) {
         return "";
     }
-
-    if (!CryptCreateHash(hProv, CALG_SHA_256, 0, 0, &hHash)) {
-        CryptReleaseContext(hProv, 0);
-        return "";
-    }
-
-    if (!CryptHashData(hHash, data, static_cast<DWORD>(size), 0)) {
-        CryptDestroyHash(hHash);
-        CryptReleaseContext(hProv, 0);
-        return "";
-    }
-
-    BYTE hash[32];
-    DWORD hashLen = 32;
-    if (!CryptGetHashParam(hHash, HP_HASHVAL, hash, &hashLen, 0)) {
-        CryptDestroyHash(hHash);
-        CryptReleaseContext(hProv, 0);
-        return "";
-    }
-
-    std::stringstream ss;
-    for (DWORD i = 0; i < hashLen; i++) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(hash[i]);
-    }
-
-    CryptDestroyHash(hHash);
-    CryptReleaseContext(hProv, 0);
-
-    return ss.str();
+    return toHex(digest);
 }
 
 bool HashUtils::quickCompare(const std::string& file1, const std::string& file2) {
-    std::error_code ec1, ec2;
-    
-    auto size1 = fs::file_size(file1, ec1);
-    auto size2 = fs::file_size(file2, ec2);
-    
-    if (ec1 || ec2 || size1 != size2) {
-        return false;
-    }
-    
-    auto time1 = fs::last_write_time(file1, ec1);
-    auto time2 = fs::last_write_time(file2, ec2);
-    
-    if (ec1 || ec2) {
+    // 每个文件只 stat 一次；两个不同路径的文件标识必然不同，不参与比较
+    FileStamp stamp1;
+    FileStamp stamp2;
+    if (!readFileStamp(file1, stamp1) || !readFileStamp(file2, stamp2)) {
         return false;
     }
-    
-    return time1 == time2;
+    return stamp1.size == stamp2.size && stamp1.mtime == stamp2.mtime;
 }
@@ -0,0 +1,225 @@
+#include "ignore_rules.h"
+#include "filter_matcher.h"
+#include "path_buffer.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <mutex>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+inline bool isSeparator(char c) {
+    return c == '/' || c == '\\';
+}
+
+inline char toLowerAscii(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+} // namespace
+
+std::shared_ptr<const IgnoreFile> IgnoreFile::load(const std::string& file_path, std::error_code& ec) {
+    ec.clear();
+    if (!fs::is_regular_file(file_path, ec)) {
+        // 不存在不算错误
+        if (ec == std::errc::no_such_file_or_directory) {
+            ec.clear();
+        }
+        return nullptr;
+    }
+
+    std::ifstream file(file_path, std::ios::binary);
+    if (!file.is_open()) {
+        ec = std::make_error_code(std::errc::permission_denied);
+        return nullptr;
+    }
+
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return parse(buffer.str());
+}
+
+std::shared_ptr<const IgnoreFile> IgnoreFile::parse(const std::string& content) {
+    std::shared_ptr<IgnoreFile> result(new IgnoreFile());
+
+    std::istringstream stream(content);
+    std::string line;
+    while (std::getline(stream, line)) {
+        // 去掉行尾的 \r 和空白
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t')) {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        Rule rule;
+        size_t pos = 0;
+        if (line[0] == '!') {
+            rule.negate = true;
+            pos = 1;
+        } else if (line[0] == '\\' && line.size() > 1 && (line[1] == '#' || line[1] == '!')) {
+            pos = 1;
+        }
+
+        for (size_t i = pos; i < line.size(); ++i) {
+            rule.pattern.push_back(line[i] == '\\' ? '/' : toLowerAscii(line[i]));
+        }
+
+        if (!rule.pattern.empty() && rule.pattern.back() == '/') {
+            rule.dir_only = true;
+            while (!rule.pattern.empty() && rule.pattern.back() == '/') {
+                rule.pattern.pop_back();
+            }
+        }
+        if (!rule.pattern.empty() && rule.pattern[0] == '/') {
+            rule.anchored = true;
+            rule.pattern.erase(0, rule.pattern.find_first_not_of('/'));
+        }
+        if (rule.pattern.find('/') != std::string::npos) {
+            rule.anchored = true;
+        }
+        if (rule.pattern.empty()) {
+            continue;
+        }
+
+        result->rules_.push_back(std::move(rule));
+    }
+
+    return result;
+}
+
+int IgnoreFile::match(const char* relative, size_t len, bool is_dir) const {
+    size_t name_pos = len;
+    while (name_pos > 0 && !isSeparator(relative[name_pos - 1])) {
+        --name_pos;
+    }
+
+    // 最后一条匹配的规则生效
+    for (auto it = rules_.rbegin(); it != rules_.rend(); ++it) {
+        if (it->dir_only && !is_dir) {
+            continue;
+        }
+        bool matched = it->anchored
+            ? FilterMatcher::globMatch(it->pattern.data(), it->pattern.size(), relative, len)
+            : FilterMatcher::globMatch(it->pattern.data(), it->pattern.size(),
+                                       relative + name_pos, len - name_pos);
+        if (matched) {
+            return it->negate ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+std::string IgnoreTree::normalizeKey(const std::string& relative_dir) {
+    std::string key;
+    normalizeKey(relative_dir, key);
+    return key;
+}
+
+void IgnoreTree::normalizeKey(const std::string& relative_dir, std::string& key) {
+    key.clear();
+    key.reserve(relative_dir.size());
+    for (char c : relative_dir) {
+        key.push_back(c == '\\' ? '/' : c);
+    }
+    while (!key.empty() && key.back() == '/') {
+        key.pop_back();
+    }
+}
+
+bool IgnoreTree::isIgnoreFileName(const std::string& file_name) {
+    size_t name_pos = file_name.size();
+    while (name_pos > 0 && !isSeparator(file_name[name_pos - 1])) {
+        --name_pos;
+    }
+    return file_name.compare(name_pos, std::string::npos, FILE_NAME) == 0;
+}
+
+bool IgnoreTree::reload(const std::string& relative_dir, const std::string& absolute_dir) {
+    std::error_code ec;
+    auto file = IgnoreFile::load((fs::path(absolute_dir) / FILE_NAME).string(), ec);
+    std::string key = normalizeKey(relative_dir);
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (file && file->ruleCount() > 0) {
+        files_[key] = std::move(file);
+    } else {
+        files_.erase(key);
+    }
+    count_.store(files_.size(), std::memory_order_relaxed);
+    return files_.count(key) > 0;
+}
+
+void IgnoreTree::removeSubtree(const std::string& relative_dir) {
+    std::string key = normalizeKey(relative_dir);
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    for (auto it = files_.begin(); it != files_.end();) {
+        const std::string& dir = it->first;
+        bool under = key.empty() ||
+                     (dir.compare(0, key.size(), key) == 0 &&
+                      (dir.size() == key.size() || dir[key.size()] == '/'));
+        it = under ? files_.erase(it) : std::next(it);
+    }
+    count_.store(files_.size(), std::memory_order_relaxed);
+}
+
+bool IgnoreTree::levelIgnored(const std::string& path, size_t end, bool is_dir,
+                              const std::vector<std::pair<size_t, const IgnoreFile*>>& files) const {
+    // 越深的忽略文件优先级越高
+    for (auto it = files.rbegin(); it != files.rend(); ++it) {
+        int verdict = it->second->match(path.data() + it->first, end - it->first, is_dir);
+        if (verdict != 0) {
+            return verdict > 0;
+        }
+    }
+    return false;
+}
+
+bool IgnoreTree::ignores(const std::string& relative_path, bool is_dir) const {
+    // 没有任何忽略文件时不加锁也不分配
+    if (count_.load(std::memory_order_relaxed) == 0) {
+        return false;
+    }
+
+    // 临时缓冲取自线程私有的池，稳定状态下判定不分配内存
+    ScratchPath normalized;
+    std::string& path = normalized.str();
+    normalizeKey(relative_path, path);
+    if (path.empty()) {
+        return false;
+    }
+
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+
+    // (规则相对路径的起始位置, 忽略文件)，由浅到深
+    thread_local std::vector<std::pair<size_t, const IgnoreFile*>> applicable;
+    applicable.clear();
+    ScratchPath prefix_buffer;
+    std::string& prefix = prefix_buffer.str();
+
+    auto root = files_.find(prefix);
+    if (root != files_.end()) {
+        applicable.emplace_back(0, root->second.get());
+    }
+
+    // 逐级判定：上级目录被忽略时其下所有内容都被忽略（与 git 一致，无法被子规则重新包含）
+    for (size_t i = 0; i < path.size(); ++i) {
+        if (path[i] != '/') {
+            continue;
+        }
+        if (!applicable.empty() && levelIgnored(path, i, true, applicable)) {
+            return true;
+        }
+        prefix.assign(path, 0, i);
+        auto it = files_.find(prefix);
+        if (it != files_.end()) {
+            applicable.emplace_back(i + 1, it->second.get());
+        }
+    }
+
+    return !applicable.empty() && levelIgnored(path, path.size(), is_dir, applicable);
+}
@@ -0,0 +1,613 @@
+#ifdef __linux__
+
+#include "linux_watcher.h"
+#include "logger.h"
+#include <filesystem>
+#include <map>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/fanotify.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr uint32_t INOTIFY_MASK = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE |
+                                  IN_MOVED_FROM | IN_MOVED_TO | IN_EXCL_UNLINK | IN_ONLYDIR;
+
+constexpr uint64_t FANOTIFY_MASK = FAN_CREATE | FAN_DELETE | FAN_MODIFY | FAN_CLOSE_WRITE |
+                                   FAN_MOVED_FROM | FAN_MOVED_TO | FAN_ONDIR;
+
+std::string trimTrailingSlash(const std::string& path) {
+    std::string result = path;
+    while (result.size() > 1 && result.back() == '/') {
+        result.pop_back();
+    }
+    return result;
+}
+
+bool isUnder(const std::string& path, const std::string& prefix) {
+    return path.compare(0, prefix.size(), prefix) == 0 &&
+           (path.size() == prefix.size() || path[prefix.size()] == '/');
+}
+
+// 两个目录最深的公共祖先
+std::string commonDirectory(const std::string& a, const std::string& b) {
+    size_t common = 0;
+    size_t i = 0;
+    while (i < a.size() && i < b.size() && a[i] == b[i]) {
+        ++i;
+        bool a_end = i == a.size() || a[i] == '/';
+        bool b_end = i == b.size() || b[i] == '/';
+        if (a_end && b_end) {
+            common = i;
+        }
+    }
+    return common == 0 ? std::string("/") : a.substr(0, common);
+}
+
+// dir/name 相对祖先目录 base 的路径（dir 在 base 之下）
+std::string relativeName(const std::string& base, const std::string& dir, const std::string& name) {
+    if (dir.size() <= base.size()) {
+        return name;
+    }
+    size_t skip = base.size() == 1 ? 1 : base.size() + 1;
+    return dir.substr(skip) + "/" + name;
+}
+
+} // namespace
+
+LinuxWatcher::LinuxWatcher(Mode mode) : mode_(mode) {
+    if (mode_ == Mode::Fanotify) {
+        // 目录句柄 + 文件名报告，无需对每个目录单独加 watch
+        fd_ = fanotify_init(FAN_CLASS_NOTIF | FAN_REPORT_DFID_NAME | FAN_CLOEXEC | FAN_NONBLOCK,
+                            O_RDONLY | O_LARGEFILE);
+    } else {
+        fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    }
+    if (fd_ >= 0) {
+        wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    }
+    buffer_.resize(READ_BUFFER_SIZE);
+}
+
+LinuxWatcher::~LinuxWatcher() {
+    running_ = false;
+    if (wake_fd_ >= 0) {
+        uint64_t one = 1;
+        ssize_t ignored = write(wake_fd_, &one, sizeof(one));
+        (void)ignored;
+    }
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+    for (const auto& mount : mount_fds_) {
+        close(mount.second);
+    }
+    if (wake_fd_ >= 0) {
+        close(wake_fd_);
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+const char* LinuxWatcher::name() const {
+    return mode_ == Mode::Fanotify ? "fanotify" : "inotify";
+}
+
+efsw::WatchID LinuxWatcher::addWatch(const std::string& directory, efsw::FileWatchListener* listener,
+                                     bool recursive) {
+    if (!valid() || !listener) {
+        return -1;
+    }
+    std::string path = trimTrailingSlash(directory);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto existing = root_paths_.find(path);
+    if (existing != root_paths_.end()) {
+        return existing->second;
+    }
+
+    efsw::WatchID id = next_id_++;
+    roots_[id] = Root{path, listener, recursive};
+
+    if (mode_ == Mode::Fanotify) {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) {
+            roots_.erase(id);
+            return -1;
+        }
+        // 每个文件系统只加一次标记
+        uint64_t dev = static_cast<uint64_t>(st.st_dev);
+        if (!mount_fds_.count(dev)) {
+            if (fanotify_mark(fd_, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, FANOTIFY_MASK, AT_FDCWD, path.c_str()) != 0) {
+                roots_.erase(id);
+                return -1;
+            }
+            int mount_fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (mount_fd >= 0) {
+                mount_fds_[dev] = mount_fd;
+            }
+        }
+    } else if (addDirectoryTree(path, id, false) == 0) {
+        roots_.erase(id);
+        return -1;
+    }
+
+    root_paths_[path] = id;
+    return id;
+}
+
+void LinuxWatcher::removeWatch(efsw::WatchID watch_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = roots_.find(watch_id);
+    if (it == roots_.end()) {
+        return;
+    }
+
+    if (mode_ == Mode::Inotify) {
+        for (size_t wd = 0; wd < dirs_.size(); ++wd) {
+            if (dirs_[wd].root == watch_id) {
+                inotify_rm_watch(fd_, static_cast<int>(wd));
+                dirs_[wd] = DirEntry{};
+            }
+        }
+    }
+
+    root_paths_.erase(it->second.path);
+    roots_.erase(it);
+}
+
+void LinuxWatcher::watch() {
+    if (!valid() || running_) {
+        return;
+    }
+    running_ = true;
+    thread_ = std::thread(&LinuxWatcher::run, this);
+}
+
+void LinuxWatcher::run() {
+    auto last_prune = std::chrono::steady_clock::now();
+    int poll_timeout_ms = 1000;
+
+    while (running_) {
+        pollfd fds[2] = {{fd_, POLLIN, 0}, {wake_fd_, POLLIN, 0}};
+        int ready = poll(fds, 2, poll_timeout_ms);
+        if (!running_) {
+            break;
+        }
+
+        if (ready > 0 && (fds[0].revents & POLLIN)) {
+            // 非阻塞读，一次读满大缓冲区，直到内核队列读空
+            for (;;) {
+                ssize_t n = read(fd_, buffer_.data(), buffer_.size());
+                if (n <= 0) {
+                    break;
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (mode_ == Mode::Fanotify) {
+                        processFanotify(buffer_.data(), static_cast<size_t>(n));
+                    } else {
+                        processInotify(buffer_.data(), static_cast<size_t>(n));
+                    }
+                }
+                flushPending();
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (mode_ == Mode::Inotify) {
+            // 有移出事件等待配对时缩短等待，超时后按删除分发
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                expireMoves(now);
+                poll_timeout_ms = unmatched_moves_.empty() ? 1000 : MOVE_PAIR_GRACE_MS;
+            }
+            flushPending();
+        }
+        if (now - last_prune >= std::chrono::seconds(1)) {
+            last_prune = now;
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto it = hot_dirs_.begin(); it != hot_dirs_.end();) {
+                it = (now - it->second.second > std::chrono::seconds(HOT_DIR_SECONDS))
+                    ? hot_dirs_.erase(it) : std::next(it);
+            }
+        }
+    }
+}
+
+size_t LinuxWatcher::addDirectoryTree(const std::string& path, efsw::WatchID root, bool synthesize) {
+    bool recursive = roots_[root].recursive;
+    size_t added = 0;
+    std::vector<std::string> pending{path};
+
+    while (!pending.empty()) {
+        std::string dir = std::move(pending.back());
+        pending.pop_back();
+
+        int wd = inotify_add_watch(fd_, dir.c_str(), INOTIFY_MASK);
+        if (wd < 0) {
+            continue;
+        }
+        if (static_cast<size_t>(wd) >= dirs_.size()) {
+            dirs_.resize(static_cast<size_t>(wd) + 1);
+        }
+        dirs_[wd] = DirEntry{dir, root};
+        added++;
+
+        if (!recursive && !synthesize) {
+            break;
+        }
+
+        // 新目录在加 watch 之前创建的内容不会产生事件，补发 Add
+        std::error_code ec;
+        for (const auto& entry : fs::directory_iterator(dir, fs::directory_options::skip_permission_denied, ec)) {
+            std::error_code entry_ec;
+            if (entry.is_symlink(entry_ec)) {
+                continue;
+            }
+            bool is_dir = entry.is_directory(entry_ec);
+            if (synthesize) {
+                queueEvent(root, dir, entry.path().filename().string(), efsw::Actions::Add);
+            }
+            if (is_dir && recursive) {
+                pending.push_back(entry.path().string());
+            }
+        }
+
+        if (!recursive) {
+            break;
+        }
+    }
+
+    return added;
+}
+
+void LinuxWatcher::removeDirectoryTree(const std::string& path) {
+    for (size_t wd = 0; wd < dirs_.size(); ++wd) {
+        if (dirs_[wd].root != 0 && isUnder(dirs_[wd].path, path)) {
+            inotify_rm_watch(fd_, static_cast<int>(wd));
+            dirs_[wd] = DirEntry{};
+        }
+    }
+}
+
+void LinuxWatcher::processInotify(const char* data, size_t len) {
+    auto now = std::chrono::steady_clock::now();
+
+    for (size_t offset = 0; offset + sizeof(inotify_event) <= len;) {
+        const auto* event = reinterpret_cast<const inotify_event*>(data + offset);
+        offset += sizeof(inotify_event) + event->len;
+
+        if (event->mask & IN_Q_OVERFLOW) {
+            handleOverflow();
+            continue;
+        }
+        if (event->wd < 0 || static_cast<size_t>(event->wd) >= dirs_.size() || dirs_[event->wd].root == 0) {
+            continue;
+        }
+        if (event->mask & IN_IGNORED) {
+            // 目录被删除或 watch 被移除，释放 wd 槽位
+            dirs_[event->wd] = DirEntry{};
+            continue;
+        }
+        if (event->len == 0) {
+            continue;
+        }
+
+        const DirEntry& entry = dirs_[event->wd];
+        efsw::WatchID root = entry.root;
+        std::string dir = entry.path;
+        std::string name = event->name;
+        bool is_dir = (event->mask & IN_ISDIR) != 0;
+        bool recursive = roots_[root].recursive;
+
+        if (event->mask & IN_CREATE) {
+            settleMove(dir, name);
+            queueEvent(root, dir, name, efsw::Actions::Add);
+            if (is_dir && recursive) {
+                addDirectoryTree(dir + "/" + name, root, true);
+            }
+        }
+        if ((event->mask & (IN_MODIFY | IN_CLOSE_WRITE)) && !is_dir) {
+            queueEvent(root, dir, name, efsw::Actions::Modified);
+        }
+        if (event->mask & IN_DELETE) {
+            queueEvent(root, dir, name, efsw::Actions::Delete);
+        }
+        if (event->mask & IN_MOVED_FROM) {
+            unmatched_moves_.push_back(MoveFrom{event->cookie, root, dir, name, is_dir,
+                                                now + std::chrono::milliseconds(MOVE_PAIR_GRACE_MS)});
+        }
+        if (event->mask & IN_MOVED_TO) {
+            auto from = unmatched_moves_.end();
+            for (auto it = unmatched_moves_.begin(); it != unmatched_moves_.end(); ++it) {
+                if (it->cookie == event->cookie) {
+                    from = it;
+                    break;
+                }
+            }
+
+            if (from == unmatched_moves_.end()) {
+                // 从监控范围外移入
+                settleMove(dir, name);
+                queueEvent(root, dir, name, efsw::Actions::Add);
+                if (is_dir && recursive) {
+                    addDirectoryTree(dir + "/" + name, root, true);
+                }
+                continue;
+            }
+            MoveFrom move = std::move(*from);
+            unmatched_moves_.erase(from);
+
+            if (move.root != root) {
+                // 跨监控根：两边的监听者不同，只能拆成删除和新建
+                queueEvent(move.root, move.dir, move.name, efsw::Actions::Delete);
+                queueEvent(root, dir, name, efsw::Actions::Add);
+            } else if (move.dir == dir) {
+                queueEvent(root, dir, name, efsw::Actions::Moved, move.name);
+            } else {
+                // 跨目录：以公共祖先目录为 dir，新旧文件名带上各自的子目录
+                std::string common = commonDirectory(move.dir, dir);
+                queueEvent(root, common, relativeName(common, dir, name), efsw::Actions::Moved,
+                           relativeName(common, move.dir, move.name));
+            }
+
+            // 目录改名后 wd 不变，只需更新表中的路径（和所属监控根）
+            if (is_dir) {
+                std::string old_path = move.dir + "/" + move.name;
+                std::string new_path = dir + "/" + name;
+                for (auto& moved : dirs_) {
+                    if (moved.root != 0 && isUnder(moved.path, old_path)) {
+                        moved.path = new_path + moved.path.substr(old_path.size());
+                        moved.root = root;
+                    }
+                }
+                for (auto& pending : unmatched_moves_) {
+                    if (isUnder(pending.dir, old_path)) {
+                        pending.dir = new_path + pending.dir.substr(old_path.size());
+                        pending.root = root;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void LinuxWatcher::expireMoves(std::chrono::steady_clock::time_point now) {
+    for (auto it = unmatched_moves_.begin(); it != unmatched_moves_.end();) {
+        if (it->expires > now) {
+            ++it;
+            continue;
+        }
+        queueMovedAway(*it);
+        it = unmatched_moves_.erase(it);
+    }
+}
+
+void LinuxWatcher::settleMove(const std::string& dir, const std::string& name) {
+    for (auto it = unmatched_moves_.begin(); it != unmatched_moves_.end(); ++it) {
+        if (it->name == name && it->dir == dir) {
+            queueMovedAway(*it);
+            unmatched_moves_.erase(it);
+            return;
+        }
+    }
+}
+
+void LinuxWatcher::queueMovedAway(const MoveFrom& move) {
+    // 没有配对的 IN_MOVED_FROM：移出了监控范围（监控根已移除时 queueEvent 直接丢弃）
+    queueEvent(move.root, move.dir, move.name, efsw::Actions::Delete);
+    if (move.is_dir) {
+        removeDirectoryTree(move.dir + "/" + move.name);
+    }
+}
+
+efsw::WatchID LinuxWatcher::findRoot(const std::string& dir) {
+    auto exact = root_paths_.find(dir);
+    if (exact != root_paths_.end()) {
+        return exact->second;
+    }
+
+    // 逐级向上查找递归监控根，O(路径深度)
+    std::string prefix = dir;
+    while (true) {
+        size_t sep = prefix.find_last_of('/');
+        if (sep == std::string::npos || sep == 0) {
+            break;
+        }
+        prefix.resize(sep);
+        auto it = root_paths_.find(prefix);
+        if (it != root_paths_.end()) {
+            return roots_[it->second].recursive ? it->second : 0;
+        }
+    }
+    return 0;
+}
+
+bool LinuxWatcher::resolveDirectory(const void* fsid, const void* handle, std::string& path) {
+    const auto* fh = static_cast<const file_handle*>(handle);
+    std::string key(static_cast<const char*>(fsid), sizeof(__kernel_fsid_t));
+    key.append(static_cast<const char*>(handle), sizeof(file_handle) + fh->handle_bytes);
+
+    auto cached = handle_paths_.find(key);
+    if (cached != handle_paths_.end()) {
+        path = cached->second;
+        return true;
+    }
+
+    for (const auto& mount : mount_fds_) {
+        int fd = open_by_handle_at(mount.second, const_cast<file_handle*>(fh), O_PATH | O_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        char link[64];
+        char target[4096];
+        snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+        ssize_t n = readlink(link, target, sizeof(target) - 1);
+        close(fd);
+        if (n <= 0) {
+            continue;
+        }
+
+        if (handle_paths_.size() >= MAX_HANDLE_CACHE) {
+            handle_paths_.clear();
+        }
+        path.assign(target, static_cast<size_t>(n));
+        handle_paths_.emplace(std::move(key), path);
+        return true;
+    }
+    return false;
+}
+
+void LinuxWatcher::processFanotify(const char* data, size_t len) {
+    auto* meta = reinterpret_cast<fanotify_event_metadata*>(const_cast<char*>(data));
+    ssize_t remaining = static_cast<ssize_t>(len);
+    std::string dir;
+
+    for (; FAN_EVENT_OK(meta, remaining); meta = FAN_EVENT_NEXT(meta, remaining)) {
+        if (meta->vers != FANOTIFY_METADATA_VERSION) {
+            break;
+        }
+        if (meta->fd >= 0) {
+            close(meta->fd);
+        }
+        if (meta->mask & FAN_Q_OVERFLOW) {
+            handleOverflow();
+            continue;
+        }
+
+        const char* info = reinterpret_cast<const char*>(meta) + meta->metadata_len;
+        const char* end = reinterpret_cast<const char*>(meta) + meta->event_len;
+        while (info + sizeof(fanotify_event_info_header) <= end) {
+            const auto* header = reinterpret_cast<const fanotify_event_info_header*>(info);
+            if (header->len == 0) {
+                break;
+            }
+            if (header->info_type == FAN_EVENT_INFO_TYPE_DFID_NAME) {
+                const auto* fid = reinterpret_cast<const fanotify_event_info_fid*>(info);
+                const auto* handle = reinterpret_cast<const file_handle*>(fid->handle);
+                const char* name = reinterpret_cast<const char*>(handle->f_handle + handle->handle_bytes);
+
+                efsw::WatchID root = 0;
+                if (resolveDirectory(&fid->fsid, handle, dir)) {
+                    root = findRoot(dir);
+                }
+                if (root != 0 && name[0] != '\0' && !(name[0] == '.' && name[1] == '\0')) {
+                    bool is_dir = (meta->mask & FAN_ONDIR) != 0;
+                    if (meta->mask & (FAN_CREATE | FAN_MOVED_TO)) {
+                        queueEvent(root, dir, name, efsw::Actions::Add);
+                    }
+                    if ((meta->mask & (FAN_MODIFY | FAN_CLOSE_WRITE)) && !is_dir) {
+                        queueEvent(root, dir, name, efsw::Actions::Modified);
+                    }
+                    if (meta->mask & (FAN_DELETE | FAN_MOVED_FROM)) {
+                        queueEvent(root, dir, name, efsw::Actions::Delete);
+                    }
+                }
+
+                // 目录改名/删除后缓存的句柄路径可能失效
+                if ((meta->mask & FAN_ONDIR) && (meta->mask & (FAN_MOVED_FROM | FAN_MOVED_TO | FAN_DELETE))) {
+                    handle_paths_.clear();
+                }
+            }
+            info += header->len;
+        }
+    }
+}
+
+void LinuxWatcher::queueEvent(efsw::WatchID root, const std::string& dir, const std::string& filename,
+                              efsw::Action action, const std::string& old_filename) {
+    auto it = roots_.find(root);
+    if (it == roots_.end()) {
+        return;
+    }
+
+    // 与上一条完全相同的修改事件直接合并（连续 write 产生的 IN_MODIFY）
+    if (pending_count_ > 0 && action == efsw::Actions::Modified) {
+        const Pending& last = pending_[pending_count_ - 1];
+        if (last.action == action && last.listener == it->second.listener &&
+            last.filename == filename && last.dir == dir) {
+            return;
+        }
+    }
+
+    if (pending_count_ == pending_.size()) {
+        pending_.emplace_back();
+    }
+    Pending& event = pending_[pending_count_++];
+    event.listener = it->second.listener;
+    event.watch_id = root;
+    event.dir = dir;
+    event.filename = filename;
+    event.old_filename = old_filename;
+    event.action = action;
+
+    auto& hot = hot_dirs_[dir];
+    hot.first = root;
+    hot.second = std::chrono::steady_clock::now();
+}
+
+void LinuxWatcher::handleOverflow() {
+    size_t overflows = ++overflow_count_;
+
+    // 按监听者汇总最近有活动的目录；没有或太多时退回扫描该监听者最上层的监控根
+    struct Target {
+        std::vector<std::string> dirs;
+        std::string top_root;
+    };
+    std::map<efsw::FileWatchListener*, Target> targets;
+    for (const auto& root : roots_) {
+        auto& target = targets[root.second.listener];
+        if (target.top_root.empty() || root.second.path.size() < target.top_root.size()) {
+            target.top_root = root.second.path;
+        }
+    }
+    for (const auto& hot : hot_dirs_) {
+        auto root = roots_.find(hot.second.first);
+        if (root != roots_.end()) {
+            targets[root->second.listener].dirs.push_back(hot.first);
+        }
+    }
+
+    for (auto& target : targets) {
+        auto* listener = dynamic_cast<RescanListener*>(target.first);
+        if (!listener) {
+            continue;
+        }
+        if (target.second.dirs.empty() || target.second.dirs.size() > MAX_TARGETED_RESCANS) {
+            rescans_.emplace_back(listener, target.second.top_root);
+        } else {
+            for (auto& dir : target.second.dirs) {
+                rescans_.emplace_back(listener, std::move(dir));
+            }
+        }
+    }
+
+    auto logger = Logger::get();
+    if (logger) {
+        logger->warn("{} 事件队列溢出（第 {} 次），已安排重新扫描 {} 个目录", name(), overflows, rescans_.size());
+    }
+}
+
+void LinuxWatcher::flushPending() {
+    for (size_t i = 0; i < pending_count_; ++i) {
+        const Pending& event = pending_[i];
+        event.listener->handleFileAction(event.watch_id, event.dir, event.filename, event.action, event.old_filename);
+    }
+    pending_count_ = 0;
+
+    for (const auto& rescan : rescans_) {
+        rescan.first->handleRescan(rescan.second);
+    }
+    rescans_.clear();
+}
+
+#endif // __linux__
@@ -1,20 +1,49 @@
 #include "logger.h"
+#include "platform.h"
 #include <filesystem>
+#include <algorithm>
+#include <spdlog/async.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/sinks/basic_file_sink.h>
 
 namespace fs = std::filesystem;
 
+namespace {
+
+const char* const LOGGER_NAME = "MultiSourceBackupLogger";
+
+spdlog::async_overflow_policy toSpdlogPolicy(LogOptions::Overflow overflow, bool& supported) {
+    supported = true;
+    switch (overflow) {
+        case LogOptions::Overflow::DropOldest:
+            return spdlog::async_overflow_policy::overrun_oldest;
+        case LogOptions::Overflow::DropNew:
+#if SPDLOG_VERSION >= 11300
+            return spdlog::async_overflow_policy::discard_new;
+#else
+            // 旧版 spdlog 没有丢弃新消息的策略，退化为覆盖最旧的消息
+            supported = false;
+            return spdlog::async_overflow_policy::overrun_oldest;
+#endif
+        case LogOptions::Overflow::Block:
+        default:
+            return spdlog::async_overflow_policy::block;
+    }
+}
+
+} // namespace
+
 std::shared_ptr<spdlog::logger> Logger::logger_ = nullptr;
+std::shared_ptr<spdlog::details::thread_pool> Logger::thread_pool_ = nullptr;
 
-void Logger::setup(const std::string& log_dir, bool use_daily_folder) {
+void Logger::setup(const std::string& log_dir, bool use_daily_folder, const LogOptions& options) {
     std::string actual_log_dir = log_dir;
     
     if (use_daily_folder) {
         auto now = std::chrono::system_clock::now();
         auto time_t = std::chrono::system_clock::to_time_t(now);
         std::tm tm;
-        localtime_s(&tm, &time_t);
+        Platform::localTime(time_t, tm);
         
         char date_buffer[32];
         std::strftime(date_buffer, sizeof(date_buffer), "%Y-%m-%d", &tm);
@@ -27,7 +56,7 @@ void Logger::setup(const std::string& log_dir, bool use_daily_folder) {
     auto now = std::chrono::system_clock::now();
     auto time_t = std::chrono::system_clock::to_time_t(now);
     std::tm tm;
-    localtime_s(&tm, &time_t);
+    Platform::localTime(time_t, tm);
     
     char filename_buffer[64];
     std::strftime(filename_buffer, sizeof(filename_buffer), "backup_log_%Y-%m-%d.log", &tm);
@@ -41,15 +70,63 @@ void Logger::setup(const std::string& log_dir, bool use_daily_folder) {
     console_sink->set_pattern("%Y-%m-%d %H:%M:%S - %^%l%$ - %v");
     file_sink->set_pattern("%Y-%m-%d %H:%M:%S - %l - %v");
 
+    // 重新启动监控时替换旧的 logger（旧的写入线程在最后一个引用释放后排空队列并退出）
+    spdlog::drop(LOGGER_NAME);
+
     // 创建 logger
     std::vector<spdlog::sink_ptr> sinks{console_sink, file_sink};
-    logger_ = std::make_shared<spdlog::logger>("MultiSourceBackupLogger", sinks.begin(), sinks.end());
-    logger_->set_level(spdlog::level::info);
-    logger_->flush_on(spdlog::level::info);
+    bool policy_supported = true;
+    if (options.async) {
+        // 单个写入线程：工作线程只把消息放进预分配的环形队列，控制台和文件写入都在写入线程上
+        thread_pool_ = std::make_shared<spdlog::details::thread_pool>(std::max<size_t>(options.queue_size, 1), 1);
+        logger_ = std::make_shared<spdlog::async_logger>(LOGGER_NAME, sinks.begin(), sinks.end(), thread_pool_,
+                                                         toSpdlogPolicy(options.overflow, policy_supported));
+        // 批量刷新：定时刷新一次，warning 及以上立即刷新
+        logger_->flush_on(spdlog::level::warn);
+        spdlog::flush_every(std::max(options.flush_interval, std::chrono::seconds(1)));
+    } else {
+        logger_ = std::make_shared<spdlog::logger>(LOGGER_NAME, sinks.begin(), sinks.end());
+        logger_->flush_on(spdlog::level::info);
+        thread_pool_.reset();
+    }
+    logger_->set_level(options.level);
 
     spdlog::register_logger(logger_);
+    
+    if (!policy_supported) {
+        logger_->warn("当前 spdlog 版本不支持 drop_new，日志队列溢出时改为丢弃最旧的消息");
+    }
 }
 
 std::shared_ptr<spdlog::logger> Logger::get() {
     return logger_;
 }
+
+bool Logger::shouldLog(spdlog::level::level_enum level) {
+    return logger_ && logger_->should_log(level);
+}
+
+size_t Logger::droppedMessages() {
+    if (!thread_pool_) {
+        return 0;
+    }
+#if SPDLOG_VERSION >= 11300
+    return thread_pool_->overrun_counter() + thread_pool_->discard_counter();
+#else
+    return thread_pool_->overrun_counter();
+#endif
+}
+
+void Logger::shutdown() {
+    if (logger_) {
+        size_t dropped = droppedMessages();
+        if (dropped > 0) {
+            logger_->warn("日志队列溢出，共丢弃 {} 条消息", dropped);
+        }
+        logger_->flush();
+    }
+    spdlog::drop(LOGGER_NAME);
+    logger_.reset();
+    // 最后一个引用释放时写入线程处理完队列中剩余的消息后退出
+    thread_pool_.reset();
+}
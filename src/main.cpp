@@ -2,54 +2,213 @@
 #include <filesystem>
 #include <thread>
 #include <chrono>
-#include <csignal>
-#include <mutex>
-#include <condition_variable>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include <cstdlib>
+#include <fstream>
 #include <efsw/efsw.hpp>
 #include "backup_handler.h"
 #include "config_loader.h"
 #include "logger.h"
+#include "tracer.h"
+#include "profiler.h"
+#include "event_trace.h"
+#include "platform.h"
+#include "capacity_planner.h"
 
 namespace fs = std::filesystem;
 
-// 使用条件变量替代轮询
-std::mutex g_mutex;
-std::condition_variable g_cv;
-bool g_should_exit = false;
+// 打印各备份源在指定时刻的文件树（只读版本目录，不扫描日期目录）
+int printTreeAt(const Config& config, const std::string& time_text) {
+    std::tm tm = {};
+    std::istringstream input(time_text);
+    input >> std::get_time(&tm, "%Y-%m-%d %H:%M:%S");
+    if (input.fail()) {
+        input.clear();
+        input.str(time_text);
+        input >> std::get_time(&tm, "%Y-%m-%d %H:%M");
+    }
+    if (input.fail()) {
+        std::cerr << "无法解析时间: " << time_text << "（格式: YYYY-MM-DD HH:MM[:SS]）" << std::endl;
+        return 1;
+    }
+    tm.tm_isdst = -1;
+    auto time_point = std::chrono::system_clock::from_time_t(std::mktime(&tm));
+    int64_t time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        time_point.time_since_epoch()).count();
+
+    for (const auto& source : config.backup_sources) {
+        VersionCatalog catalog(config.backup_destination_base, source.path);
+        auto tree = catalog.treeAt(time_ms, std::string(), true);
 
-void signal_handler(int signal) {
-    std::lock_guard<std::mutex> lock(g_mutex);
-    g_should_exit = true;
-    g_cv.notify_one();
+        size_t total_size = 0;
+        size_t missing = 0;
+        std::cout << "== " << source.path << " @ " << time_text << " (" << tree.size() << " 个文件) ==" << std::endl;
+        for (const auto& record : tree) {
+            if (record.missing) {
+                missing++;
+                std::cout << record.path << "\t" << record.size << "\t" << record.stored_file
+                          << "\t[备份文件已不存在，无法还原]" << std::endl;
+                continue;
+            }
+            total_size += record.size;
+            std::cout << record.path << "\t" << record.size << "\t" << record.stored_file << std::endl;
+        }
+        std::cout << "合计 " << total_size / 1024.0 / 1024.0 << " MB";
+        if (missing > 0) {
+            std::cout << "（另有 " << missing << " 个文件的备份已不存在）";
+        }
+        std::cout << std::endl;
+    }
+    return 0;
 }
 
-int main() {
-    // 设置信号处理
-    std::signal(SIGINT, signal_handler);
-    std::signal(SIGTERM, signal_handler);
+// 把时间线跟踪写到诊断目录；运行中收到导出请求和退出时都会调用
+void dumpTrace(const Config& config) {
+    auto logger = Logger::get();
+    if (!Tracer::enabled()) {
+        if (logger) {
+            logger->warn("收到跟踪导出请求，但未启用跟踪（trace_enabled），已忽略");
+        }
+        return;
+    }
+    std::string trace_path = (fs::path(ConfigLoader::diagnosticsDirectory(config)) / Tracer::dumpFileName()).string();
+    size_t events = Tracer::dump(trace_path);
+    if (logger) {
+        logger->info("已导出 {} 个跟踪事件 -> {}（覆盖丢弃 {} 个）", events, trace_path, Tracer::overwrittenEvents());
+    }
+}
+
+int main(int argc, char* argv[]) {
+    // 控制信号在创建任何线程之前设置（POSIX 上屏蔽后由主线程同步等待）
+    Platform::prepareControlSignals();
+
+    // codebackup [--config config.json] [--presets presets.json] [--tree-at "YYYY-MM-DD HH:MM"]
+    // codebackup --dump-trace <pid>：让正在运行的实例立即导出跟踪
+    // codebackup --dry-run [--saves-per-hour N] [--active-hours N] [--working-set-days N] [--samples N]
+    //            [--bandwidth MB/s] [--workers N] [--out 结果.json]
+    // 未指定 --presets 时使用配置文件同目录下的 presets.json
+    std::string config_path = "config.json";
+    std::string presets_path;
+    std::string tree_at;
+    bool dry_run = false;
+    CapacityPlanOptions plan_options;
+    std::string plan_out;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--config" && has_value) {
+            config_path = argv[++i];
+        } else if (arg == "--presets" && has_value) {
+            presets_path = argv[++i];
+        } else if (arg == "--tree-at" && has_value) {
+            tree_at = argv[++i];
+        } else if (arg == "--dump-trace" && has_value) {
+            long pid = std::atol(argv[++i]);
+            if (!Platform::requestTraceDump(pid)) {
+                std::cerr << "无法向进程 " << pid << " 发送跟踪导出请求。" << std::endl;
+                return 1;
+            }
+            return 0;
+        } else if (arg == "--dry-run") {
+            dry_run = true;
+        } else if (arg == "--saves-per-hour" && has_value) {
+            plan_options.saves_per_hour = std::atof(argv[++i]);
+        } else if (arg == "--active-hours" && has_value) {
+            plan_options.active_hours_per_day = std::atof(argv[++i]);
+        } else if (arg == "--working-set-days" && has_value) {
+            plan_options.working_set_days = std::atoi(argv[++i]);
+        } else if (arg == "--samples" && has_value) {
+            plan_options.sample_files = static_cast<size_t>(std::atoll(argv[++i]));
+        } else if (arg == "--bandwidth" && has_value) {
+            plan_options.bandwidth_mbps = std::atof(argv[++i]);
+        } else if (arg == "--workers" && has_value) {
+            plan_options.workers = std::atoi(argv[++i]);
+        } else if (arg == "--out" && has_value) {
+            plan_out = argv[++i];
+        } else {
+            std::cerr << "用法: codebackup [--config config.json] [--presets presets.json] "
+                      << "[--tree-at \"YYYY-MM-DD HH:MM[:SS]\"]\n"
+                      << "      codebackup --dump-trace <pid>\n"
+                      << "      codebackup --dry-run [--saves-per-hour N] [--active-hours N] [--working-set-days N] "
+                      << "[--samples N] [--bandwidth MB/s] [--workers N] [--out 结果.json]" << std::endl;
+            return 1;
+        }
+    }
+    // 编辑频率和时长为 0 时稳定状态无从估算
+    if (dry_run && (!(plan_options.saves_per_hour > 0) || !(plan_options.active_hours_per_day > 0) ||
+                    plan_options.active_hours_per_day > 24)) {
+        std::cerr << "--saves-per-hour 须大于 0，--active-hours 须在 0 到 24 之间（不含 0）。" << std::endl;
+        return 1;
+    }
+    if (presets_path.empty()) {
+        presets_path = (fs::path(config_path).parent_path() / "presets.json").string();
+    }
 
     // 加载配置
-    auto config_opt = ConfigLoader::loadConfig("config.json");
+    auto config_opt = ConfigLoader::loadConfig(config_path);
     if (!config_opt) {
         std::cerr << "无法加载配置文件，程序退出。" << std::endl;
         return 1;
     }
     auto config = *config_opt;
 
+    if (!tree_at.empty()) {
+        return printTreeAt(config, tree_at);
+    }
+
     // 加载预设
-    auto presets = ConfigLoader::loadPresets("presets.json");
+    auto presets = ConfigLoader::loadPresets(presets_path);
     if (!presets) {
         presets = nlohmann::json::object();
     }
 
+    // 容量规划演练：只读扫描和抽样，不设置日志（日志文件写在备份目录下）
+    if (dry_run) {
+        CapacityPlanner planner(config, *presets, plan_options);
+        nlohmann::json report = planner.run();
+        std::cout << CapacityPlanner::summarize(report);
+        if (!plan_out.empty()) {
+            std::ofstream out(plan_out, std::ios::trunc);
+            out << report.dump(2) << std::endl;
+            if (!out) {
+                std::cerr << "无法写入 " << plan_out << std::endl;
+                return 1;
+            }
+        }
+        return 0;
+    }
+
     // 设置日志
-    Logger::setup(config.backup_destination_base, true);
+    Logger::setup(config.backup_destination_base, true, ConfigLoader::logOptions(config.strategy));
     auto logger = Logger::get();
+    
+    // 时间线跟踪在创建工作线程之前启用，各线程首次记录时分配缓冲区
+    if (config.strategy.trace_enabled) {
+        Tracer::enable(config.strategy.trace_buffer_events);
+        Tracer::nameThread("main");
+    }
 
     // 创建文件监控器
-    efsw::FileWatcher file_watcher;
+    auto file_watcher = createWatchBackend(config.strategy.watcher_backend);
     std::vector<std::unique_ptr<BackupHandler>> handlers;
-    std::vector<efsw::WatchID> watch_ids;
+    
+    // 原始事件记录在注册监控之前打开
+    std::unique_ptr<EventTraceWriter> event_recorder;
+    if (config.strategy.capture_events) {
+        event_recorder = std::make_unique<EventTraceWriter>();
+        std::string capture_path = (fs::path(ConfigLoader::diagnosticsDirectory(config)) /
+                                    EventTraceWriter::captureFileName()).string();
+        if (event_recorder->open(capture_path)) {
+            logger->info("原始事件记录 -> {}", capture_path);
+        } else {
+            event_recorder.reset();
+        }
+    }
+
+    // 所有备份源共享工作线程配额：同时繁忙时合计不超过 max_workers（未配置时为 CPU 核心数）
+    WorkerBudget::shared().setCapacity(config.strategy.max_workers);
 
     // 为每个启用的源路径创建监控
     for (const auto& source : config.backup_sources) {
@@ -62,37 +221,31 @@ int main() {
             continue;
         }
 
-        // 确定过滤配置
-        FilterConfig filter_config;
-        if (source.custom_filter) {
-            filter_config = *source.custom_filter;
-            logger->info("为 {} 应用了自定义过滤器。", source.path);
-        } else if (!source.presets.empty()) {
-            filter_config = ConfigLoader::mergePresets(source.presets, *presets);
-            logger->info("为 {} 应用了合并预设。", source.path);
+        // 合并预设和自定义过滤器（与图形界面的预览规则相同）
+        auto filter_matcher = ConfigLoader::compileFilters(source.presets, *presets, source.custom_filter);
+        if (source.custom_filter || !source.presets.empty()) {
+            logger->info("为 {} 应用了过滤规则（预设 {} 个{}）。", source.path, source.presets.size(),
+                         source.custom_filter ? "，含自定义过滤器" : "");
         }
 
         // 创建处理器并添加监控
         auto handler = std::make_unique<BackupHandler>(
             source.path, 
             config.backup_destination_base,
-            filter_config,
+            filter_matcher,
             config.strategy  // 传递策略配置
         );
         
-        // 启动异步备份队列（每个处理器使用 2 个工作线程）
-        handler->startAsyncBackup(2);
-
-        efsw::WatchID watch_id = file_watcher.addWatch(
-            source.path, 
-            handler.get(), 
-            true  // recursive
-        );
+        // 启动异步备份队列（工作线程数在 min_workers ~ max_workers 之间自动伸缩）
+        handler->startAsyncBackup(config.strategy.min_workers, config.strategy.max_workers);
+        if (event_recorder) {
+            handler->setEventRecorder(event_recorder.get());
+        }
 
-        if (watch_id > 0) {
+        // 有目录排除规则时只监控未被排除的目录
+        if (handler->attachWatcher(*file_watcher)) {
+            logger->info("正在监控 -> {} ({} 个监控)", source.path, handler->getWatchCount());
             handlers.push_back(std::move(handler));
-            watch_ids.push_back(watch_id);
-            logger->info("正在监控 -> {}", source.path);
         } else {
             logger->error("无法监控路径: {}", source.path);
         }
@@ -103,8 +256,23 @@ int main() {
         return 1;
     }
 
+    // 定期导出各阶段延迟和吞吐量
+    std::unique_ptr<MetricsExporter> metrics_exporter;
+    if (config.strategy.metrics_interval_seconds > 0) {
+        metrics_exporter = std::make_unique<MetricsExporter>(
+            ConfigLoader::diagnosticsDirectory(config),
+            std::chrono::seconds(config.strategy.metrics_interval_seconds));
+        for (const auto& handler : handlers) {
+            const BackupHandler* source = handler.get();
+            metrics_exporter->addSource(source->getSourcePath(), [source]() { return source->getMetrics(); });
+        }
+        metrics_exporter->start();
+        logger->info("指标每 {} 秒写入 -> {}", config.strategy.metrics_interval_seconds,
+                    metrics_exporter->jsonPath());
+    }
+
     // 启动监控
-    file_watcher.watch();
+    file_watcher->watch();
     
     logger->info("--- 监控服务已启动 (V3.0 - 智能备份版) ---");
     logger->info("所有备份将存至 -> {}", config.backup_destination_base);
@@ -116,13 +284,37 @@ int main() {
     logger->info("性能优化: 异步队列 + 防抖动 + 指数退避 + 智能压缩");
     std::cout << "监控已在后台运行，详细信息请查看日志文件。按 Ctrl+C 停止。" << std::endl;
 
-    // 使用条件变量等待退出信号（替代轮询）
-    {
-        std::unique_lock<std::mutex> lock(g_mutex);
-        g_cv.wait(lock, [] { return g_should_exit; });
+    // 阻塞等待终止信号（Ctrl+C / SIGTERM / SIGHUP）；期间的导出请求（SIGUSR1 / --dump-trace）就地写出跟踪
+    Platform::ControlSignal control = Platform::waitForControlSignal();
+    while (control.dump_trace) {
+        dumpTrace(config);
+        control = Platform::waitForControlSignal();
     }
 
-    logger->info("--- 用户手动停止监控服务 ---");
+    logger->info("--- 收到信号 {}，停止监控服务 ---", control.signal);
+    
+    // 先停止监控后端，避免监控线程在处理器析构后继续回调
+    file_watcher.reset();
+    
+    // 再停止各处理器的工作、摄取、对账和伸缩线程：之后的统计、导出和 Logger::shutdown 不再与它们并发
+    for (const auto& handler : handlers) {
+        handler->stopAsyncBackup();
+    }
+    
+    if (event_recorder) {
+        event_recorder->close();
+        logger->info("已记录 {} 个原始事件 -> {}（丢弃 {} 个）", event_recorder->recordedEvents(),
+                    event_recorder->path(), event_recorder->droppedEvents());
+    }
+    
+    // 写出最后一次指标
+    if (metrics_exporter) {
+        metrics_exporter->stop();
+    }
+    
+    if (Tracer::enabled()) {
+        dumpTrace(config);
+    }
     
     // 打印统计信息
     logger->info("=== 备份统计信息 ===");
@@ -150,9 +342,58 @@ int main() {
     logger->info("备份大小: {:.2f} MB", total_bytes / 1024.0 / 1024.0);
     logger->info("压缩备份: {} 个文件", compressed_backups);
     logger->info("增量备份: {} 个文件", incremental_backups);
+    
+    size_t aliased_backups = 0;
+    for (const auto& handler : handlers) {
+        aliased_backups += handler->getAliasedBackups();
+    }
+    logger->info("路径别名: {} 个文件 (移动/重命名，未复制)", aliased_backups);
     logger->info("失败备份: {} 个文件", failed_backups);
     logger->info("跳过备份: {} 个文件 (防抖动/去重)", skipped_backups);
+    
+    // 各调度类别的延迟（入队到完成）
+    std::array<ClassLatencyStats, TaskScheduler::NUM_CLASSES> class_stats{};
+    for (const auto& handler : handlers) {
+        auto stats = handler->getSchedulerStats();
+        for (size_t i = 0; i < stats.size(); ++i) {
+            auto& total = class_stats[i];
+            double weighted = total.avg_ms * total.completed + stats[i].avg_ms * stats[i].completed;
+            total.completed += stats[i].completed;
+            total.avg_ms = total.completed > 0 ? weighted / total.completed : 0.0;
+            total.max_ms = std::max(total.max_ms, stats[i].max_ms);
+        }
+    }
+    for (size_t i = 0; i < class_stats.size(); ++i) {
+        if (class_stats[i].completed == 0) {
+            continue;
+        }
+        logger->info("调度延迟 [{}]: {} 个任务 | 平均 {:.1f} ms | 最大 {:.1f} ms",
+                    TaskScheduler::className(static_cast<TaskClass>(i)),
+                    class_stats[i].completed, class_stats[i].avg_ms, class_stats[i].max_ms);
+    }
+    
+    // 各阶段延迟分布与吞吐量
+    MetricsSnapshot metrics;
+    for (const auto& handler : handlers) {
+        metrics.merge(handler->getMetrics());
+    }
+    for (size_t i = 0; i < MetricsSnapshot::NUM_STAGES; ++i) {
+        const LatencyHistogram& histogram = metrics.stages[i];
+        if (histogram.count() == 0) {
+            continue;
+        }
+        logger->info("阶段耗时 [{}]: {} 次 | p50 {:.2f} ms | p90 {:.2f} ms | p99 {:.2f} ms | 最大 {:.2f} ms",
+                    BackupMetrics::stageName(static_cast<BackupStage>(i)), histogram.count(),
+                    histogram.percentile(0.50) / 1000.0, histogram.percentile(0.90) / 1000.0,
+                    histogram.percentile(0.99) / 1000.0, histogram.maxMicros() / 1000.0);
+    }
+    logger->info("吞吐量: {:.2f} 文件/秒 | {:.2f} MB/秒（运行期间平均）",
+                metrics.filesPerSecond(), metrics.bytesPerSecond() / 1024.0 / 1024.0);
+    
+    // 以 CODEBACKUP_PROFILE 编译时输出各插桩点的耗时
+    Profiler::logReport();
     logger->info("--- 监控服务已安全关闭 ---");
+    Logger::shutdown();
 
     return 0;
 }
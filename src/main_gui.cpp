@@ -1,4 +1,5 @@
 #include "gui_app.h"
+#include "logger.h"
 #include <windows.h>
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow) {
@@ -25,6 +26,9 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         result = app.run();
     }
     
+    // 写出异步日志队列中剩余的消息
+    Logger::shutdown();
+    
     // 释放互斥量
     if (hMutex) {
         ReleaseMutex(hMutex);
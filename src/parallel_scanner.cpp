@@ -0,0 +1,161 @@
+#include "parallel_scanner.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct WorkQueue {
+    std::mutex mutex;
+    std::deque<fs::path> dirs;
+};
+
+} // namespace
+
+ParallelScanner::ParallelScanner(size_t thread_count)
+    : thread_count_(thread_count) {
+    if (thread_count_ == 0) {
+        thread_count_ = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+}
+
+void ParallelScanner::setProgressCallback(ProgressCallback callback, std::chrono::milliseconds interval) {
+    progress_callback_ = std::move(callback);
+    progress_interval_ = interval;
+}
+
+ParallelScanner::Progress ParallelScanner::scan(const fs::path& root, const DirectoryFilter& filter,
+                                                const FileVisitor& visitor) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    for (size_t i = 0; i < thread_count_; ++i) {
+        queues.push_back(std::make_unique<WorkQueue>());
+    }
+    queues[0]->dirs.push_back(root);
+
+    // 已入队但尚未处理完的目录数，为 0 时所有工作线程退出
+    std::atomic<size_t> outstanding{1};
+    std::atomic<size_t> directories{0};
+    std::atomic<size_t> files{0};
+
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    size_t finished_workers = 0;
+
+    auto takeWork = [&](size_t worker, fs::path& dir) -> bool {
+        {
+            WorkQueue& own = *queues[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.dirs.empty()) {
+                dir = std::move(own.dirs.back());
+                own.dirs.pop_back();
+                return true;
+            }
+        }
+        for (size_t offset = 1; offset < queues.size(); ++offset) {
+            WorkQueue& victim = *queues[(worker + offset) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.dirs.empty()) {
+                dir = std::move(victim.dirs.front());
+                victim.dirs.pop_front();
+                return true;
+            }
+        }
+        return false;
+    };
+
+    auto processDirectory = [&](size_t worker, const fs::path& dir) {
+        std::error_code ec;
+        fs::directory_iterator it(dir, fs::directory_options::skip_permission_denied, ec);
+        std::vector<fs::path> subdirs;
+        size_t file_count = 0;
+        for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+            const fs::directory_entry& entry = *it;
+            std::error_code type_ec;
+            if (entry.is_symlink(type_ec)) {
+                if (entry.is_regular_file(type_ec)) {
+                    visitor(worker, entry);
+                    file_count++;
+                }
+                continue;
+            }
+            if (entry.is_directory(type_ec)) {
+                if (!filter || filter(worker, entry.path())) {
+                    subdirs.push_back(entry.path());
+                }
+            } else if (entry.is_regular_file(type_ec)) {
+                visitor(worker, entry);
+                file_count++;
+            }
+        }
+
+        if (!subdirs.empty()) {
+            outstanding += subdirs.size();
+            WorkQueue& own = *queues[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            for (auto& subdir : subdirs) {
+                own.dirs.push_back(std::move(subdir));
+            }
+        }
+        directories++;
+        files += file_count;
+    };
+
+    auto workerLoop = [&](size_t worker) {
+        fs::path dir;
+        while (outstanding.load() > 0 && !(cancel_ && cancel_->load())) {
+            if (!takeWork(worker, dir)) {
+                // 其他线程还在枚举，稍后再试窃取
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                continue;
+            }
+            processDirectory(worker, dir);
+            outstanding--;
+        }
+        std::lock_guard<std::mutex> lock(done_mutex);
+        finished_workers++;
+        done_cv.notify_all();
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(thread_count_);
+    for (size_t i = 0; i < thread_count_; ++i) {
+        workers.emplace_back(workerLoop, i);
+    }
+
+    auto snapshot = [&]() {
+        Progress progress;
+        progress.directories = directories.load();
+        progress.files = files.load();
+        progress.cancelled = cancel_ && cancel_->load();
+        progress.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start);
+        return progress;
+    };
+
+    {
+        std::unique_lock<std::mutex> lock(done_mutex);
+        while (finished_workers < thread_count_) {
+            bool all_done = done_cv.wait_for(lock, progress_interval_,
+                                             [&]() { return finished_workers >= thread_count_; });
+            if (!all_done && progress_callback_) {
+                lock.unlock();
+                progress_callback_(snapshot());
+                lock.lock();
+            }
+        }
+    }
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    return snapshot();
+}
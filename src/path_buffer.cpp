@@ -0,0 +1,112 @@
+#include "path_buffer.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+PathBufferPool::PathBufferPool(size_t max_buffers)
+    : max_buffers_(max_buffers) {
+    free_.reserve(max_buffers_);
+}
+
+std::string PathBufferPool::acquire() {
+    if (free_.empty()) {
+        std::string buffer;
+        buffer.reserve(PATH_BUFFER_CAPACITY);
+        return buffer;
+    }
+    std::string buffer = std::move(free_.back());
+    free_.pop_back();
+    return buffer;
+}
+
+void PathBufferPool::release(std::string&& buffer) {
+    if (free_.size() >= max_buffers_ || buffer.capacity() > MAX_RETAINED_CAPACITY ||
+        buffer.capacity() < PATH_BUFFER_CAPACITY) {
+        return;
+    }
+    buffer.clear();
+    free_.push_back(std::move(buffer));
+}
+
+PathBufferPool& PathBufferPool::local() {
+    thread_local PathBufferPool pool;
+    return pool;
+}
+
+ThreadArena::ThreadArena(size_t block_size)
+    : block_size_(block_size) {
+}
+
+void* ThreadArena::do_allocate(size_t bytes, size_t alignment) {
+    while (current_ < blocks_.size()) {
+        Block& block = blocks_[current_];
+        uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+        uintptr_t aligned = (base + offset_ + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+        if (aligned + bytes <= base + block.size) {
+            offset_ = aligned + bytes - base;
+            return reinterpret_cast<void*>(aligned);
+        }
+        // 当前块放不下：换到下一个保留的块
+        current_++;
+        offset_ = 0;
+    }
+
+    // 所有块都已用完才向系统申请（超大的单次分配按需放大）
+    Block block;
+    block.size = std::max(block_size_, bytes + alignment);
+    block.data = std::make_unique<std::byte[]>(block.size);
+    blocks_.push_back(std::move(block));
+    current_ = blocks_.size() - 1;
+    offset_ = 0;
+    return do_allocate(bytes, alignment);
+}
+
+std::string_view ThreadArena::copy(std::string_view text) {
+    char* data = static_cast<char*>(allocate(text.size() + 1, alignof(char)));
+    std::memcpy(data, text.data(), text.size());
+    data[text.size()] = '\0';
+    return std::string_view(data, text.size());
+}
+
+std::string_view ThreadArena::joinPath(std::string_view dir, std::string_view filename) {
+    bool need_separator = !dir.empty() && dir.back() != '/' && dir.back() != '\\';
+    size_t length = dir.size() + (need_separator ? 1 : 0) + filename.size();
+    char* data = static_cast<char*>(allocate(length + 1, alignof(char)));
+    std::memcpy(data, dir.data(), dir.size());
+    size_t pos = dir.size();
+    if (need_separator) {
+        data[pos++] = static_cast<char>(fs::path::preferred_separator);
+    }
+    std::memcpy(data + pos, filename.data(), filename.size());
+    data[length] = '\0';
+    return std::string_view(data, length);
+}
+
+void ThreadArena::reset() {
+    current_ = 0;
+    offset_ = 0;
+}
+
+size_t ThreadArena::bytesUsed() const {
+    size_t used = offset_;
+    for (size_t i = 0; i < current_ && i < blocks_.size(); ++i) {
+        used += blocks_[i].size;
+    }
+    return used;
+}
+
+size_t ThreadArena::capacity() const {
+    size_t total = 0;
+    for (const auto& block : blocks_) {
+        total += block.size;
+    }
+    return total;
+}
+
+ThreadArena& ThreadArena::local() {
+    thread_local ThreadArena arena;
+    return arena;
+}
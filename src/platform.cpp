@@ -0,0 +1,499 @@
+#include "platform.h"
+#include <cstring>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <wincrypt.h>
+#include <csignal>
+#include <string>
+#else
+#include <sys/stat.h>
+#ifdef __APPLE__
+#include <sys/param.h>
+#include <sys/mount.h>
+#else
+#include <sys/vfs.h>
+#endif
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <cerrno>
+#endif
+
+namespace Platform {
+
+// ---- 时间 ----
+
+bool localTime(std::time_t time, std::tm& out) {
+#ifdef _WIN32
+    return localtime_s(&out, &time) == 0;
+#else
+    return localtime_r(&time, &out) != nullptr;
+#endif
+}
+
+// ---- 文件标识 ----
+
+#ifdef _WIN32
+namespace {
+
+// 转换到线程私有的宽字符缓冲（与 fs::path 相同使用 ANSI 代码页），不为每次调用分配内存
+const wchar_t* widePath(const std::string& path) {
+    thread_local std::wstring wide_path;
+    int length = MultiByteToWideChar(CP_ACP, 0, path.data(), static_cast<int>(path.size()), nullptr, 0);
+    if (length <= 0) {
+        return nullptr;
+    }
+    wide_path.resize(static_cast<size_t>(length));
+    MultiByteToWideChar(CP_ACP, 0, path.data(), static_cast<int>(path.size()), wide_path.data(), length);
+    return wide_path.c_str();
+}
+
+} // namespace
+#endif
+
+bool readFileInfo(const std::string& path, FileInfo& info) {
+#ifdef _WIN32
+    const wchar_t* wide_path = widePath(path);
+    if (!wide_path) {
+        return false;
+    }
+    HANDLE handle = CreateFileW(wide_path, FILE_READ_ATTRIBUTES,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    BY_HANDLE_FILE_INFORMATION data;
+    bool ok = GetFileInformationByHandle(handle, &data) != 0;
+    CloseHandle(handle);
+    if (!ok) {
+        return false;
+    }
+    info.size = (static_cast<uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+    info.mtime = static_cast<int64_t>((static_cast<uint64_t>(data.ftLastWriteTime.dwHighDateTime) << 32) |
+                                      data.ftLastWriteTime.dwLowDateTime);
+    info.file_id = (static_cast<uint64_t>(data.nFileIndexHigh) << 32) | data.nFileIndexLow;
+    info.is_directory = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+    return true;
+#else
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0 || !(S_ISREG(st.st_mode) || S_ISDIR(st.st_mode))) {
+        return false;
+    }
+#ifdef __APPLE__
+    const struct timespec& mtime = st.st_mtimespec;
+#else
+    const struct timespec& mtime = st.st_mtim;
+#endif
+    info.size = static_cast<uint64_t>(st.st_size);
+    info.mtime = static_cast<int64_t>(mtime.tv_sec) * 1000000000LL + mtime.tv_nsec;
+    info.file_id = static_cast<uint64_t>(st.st_ino);
+    info.is_directory = S_ISDIR(st.st_mode);
+    return true;
+#endif
+}
+
+int64_t fileTimeNow() {
+#ifdef _WIN32
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    return static_cast<int64_t>((static_cast<uint64_t>(now.dwHighDateTime) << 32) | now.dwLowDateTime);
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+#endif
+}
+
+namespace {
+
+constexpr int64_t COARSE_TIMESTAMP_TICKS = 2 * FILE_TIME_TICKS_PER_SECOND;
+constexpr int64_t FINE_TIMESTAMP_TICKS = FILE_TIME_TICKS_PER_SECOND / 50;
+
+} // namespace
+
+int64_t timestampGranularity(const std::string& path) {
+#ifdef _WIN32
+    const wchar_t* wide_path = widePath(path);
+    wchar_t volume[MAX_PATH];
+    wchar_t fs_name[MAX_PATH];
+    if (!wide_path || !GetVolumePathNameW(wide_path, volume, MAX_PATH) ||
+        !GetVolumeInformationW(volume, nullptr, 0, nullptr, nullptr, nullptr, fs_name, MAX_PATH)) {
+        return COARSE_TIMESTAMP_TICKS;
+    }
+    // "FAT"、"FAT32"、"exFAT"
+    bool fat = _wcsnicmp(fs_name, L"FAT", 3) == 0 || _wcsicmp(fs_name, L"exFAT") == 0;
+    return fat ? COARSE_TIMESTAMP_TICKS : FINE_TIMESTAMP_TICKS;
+#elif defined(__APPLE__)
+    struct statfs info;
+    if (::statfs(path.c_str(), &info) != 0) {
+        return COARSE_TIMESTAMP_TICKS;
+    }
+    bool fat = std::strcmp(info.f_fstypename, "msdos") == 0 || std::strcmp(info.f_fstypename, "exfat") == 0;
+    return fat ? COARSE_TIMESTAMP_TICKS : FINE_TIMESTAMP_TICKS;
+#else
+    struct statfs info;
+    if (::statfs(path.c_str(), &info) != 0) {
+        return COARSE_TIMESTAMP_TICKS;
+    }
+    switch (static_cast<uint32_t>(info.f_type)) {
+    case 0x4d44:        // MSDOS_SUPER_MAGIC（vfat / msdos）
+    case 0x2011bab0:    // EXFAT_SUPER_MAGIC
+    case 0x65735546:    // FUSE_SUPER_MAGIC（exfat-fuse 等，底层类型未知）
+        return COARSE_TIMESTAMP_TICKS;
+    default:
+        return FINE_TIMESTAMP_TICKS;
+    }
+#endif
+}
+
+// ---- SHA-256 ----
+
+#ifdef _WIN32
+
+Sha256::Sha256() {
+    HCRYPTPROV provider = 0;
+    HCRYPTHASH hash = 0;
+    if (!CryptAcquireContext(&provider, nullptr, nullptr, PROV_RSA_AES, CRYPT_VERIFYCONTEXT)) {
+        ok_ = false;
+        return;
+    }
+    provider_ = provider;
+    if (!CryptCreateHash(provider, CALG_SHA_256, 0, 0, &hash)) {
+        ok_ = false;
+        return;
+    }
+    hash_ = hash;
+}
+
+Sha256::~Sha256() {
+    if (hash_) {
+        CryptDestroyHash(static_cast<HCRYPTHASH>(hash_));
+    }
+    if (provider_) {
+        CryptReleaseContext(static_cast<HCRYPTPROV>(provider_), 0);
+    }
+}
+
+void Sha256::update(const void* data, size_t size) {
+    const BYTE* bytes = static_cast<const BYTE*>(data);
+    // CryptHashData 的长度是 DWORD，超大块分段提交
+    while (ok_ && size > 0) {
+        DWORD chunk = static_cast<DWORD>(size > 0x40000000 ? 0x40000000 : size);
+        if (!CryptHashData(static_cast<HCRYPTHASH>(hash_), bytes, chunk, 0)) {
+            ok_ = false;
+        }
+        bytes += chunk;
+        size -= chunk;
+    }
+}
+
+bool Sha256::finish(uint8_t (&digest)[DIGEST_SIZE]) {
+    if (!ok_) {
+        return false;
+    }
+    DWORD length = DIGEST_SIZE;
+    ok_ = CryptGetHashParam(static_cast<HCRYPTHASH>(hash_), HP_HASHVAL, digest, &length, 0) != 0 &&
+          length == DIGEST_SIZE;
+    return ok_;
+}
+
+#else
+
+namespace {
+
+const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+inline uint32_t rotr(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+} // namespace
+
+Sha256::Sha256()
+    : state_{0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+             0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19} {
+}
+
+Sha256::~Sha256() = default;
+
+void Sha256::compress(const uint8_t* block) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; ++i) {
+        w[i] = (static_cast<uint32_t>(block[4 * i]) << 24) | (static_cast<uint32_t>(block[4 * i + 1]) << 16) |
+               (static_cast<uint32_t>(block[4 * i + 2]) << 8) | static_cast<uint32_t>(block[4 * i + 3]);
+    }
+    for (int i = 16; i < 64; ++i) {
+        uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+    uint32_t e = state_[4], f = state_[5], g = state_[6], h = state_[7];
+    for (int i = 0; i < 64; ++i) {
+        uint32_t s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+        uint32_t ch = (e & f) ^ (~e & g);
+        uint32_t t1 = h + s1 + ch + SHA256_K[i] + w[i];
+        uint32_t s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+        uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t t2 = s0 + maj;
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state_[0] += a; state_[1] += b; state_[2] += c; state_[3] += d;
+    state_[4] += e; state_[5] += f; state_[6] += g; state_[7] += h;
+}
+
+void Sha256::update(const void* data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    total_bytes_ += size;
+    // 先补齐上次剩下的半个块，然后整块直接从输入压缩，不经过缓冲
+    if (buffered_ > 0) {
+        size_t take = std::min(size, sizeof(buffer_) - buffered_);
+        std::memcpy(buffer_ + buffered_, bytes, take);
+        buffered_ += take;
+        bytes += take;
+        size -= take;
+        if (buffered_ < sizeof(buffer_)) {
+            return;
+        }
+        compress(buffer_);
+        buffered_ = 0;
+    }
+    while (size >= sizeof(buffer_)) {
+        compress(bytes);
+        bytes += sizeof(buffer_);
+        size -= sizeof(buffer_);
+    }
+    std::memcpy(buffer_, bytes, size);
+    buffered_ = size;
+}
+
+bool Sha256::finish(uint8_t (&digest)[DIGEST_SIZE]) {
+    // 补位：0x80，若干 0，最后 8 字节为消息位长（大端）
+    uint64_t bit_length = total_bytes_ * 8;
+    buffer_[buffered_++] = 0x80;
+    if (buffered_ > 56) {
+        std::memset(buffer_ + buffered_, 0, sizeof(buffer_) - buffered_);
+        compress(buffer_);
+        buffered_ = 0;
+    }
+    std::memset(buffer_ + buffered_, 0, 56 - buffered_);
+    for (int i = 0; i < 8; ++i) {
+        buffer_[63 - i] = static_cast<uint8_t>(bit_length >> (8 * i));
+    }
+    compress(buffer_);
+    buffered_ = 0;
+
+    for (int i = 0; i < 8; ++i) {
+        digest[4 * i] = static_cast<uint8_t>(state_[i] >> 24);
+        digest[4 * i + 1] = static_cast<uint8_t>(state_[i] >> 16);
+        digest[4 * i + 2] = static_cast<uint8_t>(state_[i] >> 8);
+        digest[4 * i + 3] = static_cast<uint8_t>(state_[i]);
+    }
+    return ok_;
+}
+
+#endif
+
+// ---- 文件读取提示 ----
+
+SequentialFile::~SequentialFile() {
+    close();
+}
+
+bool SequentialFile::open(const std::string& path) {
+    close();
+#ifdef _WIN32
+    const wchar_t* wide_path = widePath(path);
+    if (!wide_path) {
+        return false;
+    }
+    HANDLE handle = CreateFileW(wide_path, GENERIC_READ,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size)) {
+        CloseHandle(handle);
+        return false;
+    }
+    handle_ = handle;
+    size_ = static_cast<uint64_t>(size.QuadPart);
+    return true;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+#if defined(__APPLE__)
+    ::fcntl(fd, F_RDAHEAD, 1);
+#elif defined(POSIX_FADV_SEQUENTIAL)
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    fd_ = fd;
+    size_ = static_cast<uint64_t>(st.st_size);
+    return true;
+#endif
+}
+
+int64_t SequentialFile::read(void* buffer, size_t size) {
+#ifdef _WIN32
+    if (!handle_) {
+        return -1;
+    }
+    DWORD chunk = static_cast<DWORD>(size > 0x40000000 ? 0x40000000 : size);
+    DWORD read_bytes = 0;
+    if (!ReadFile(static_cast<HANDLE>(handle_), buffer, chunk, &read_bytes, nullptr)) {
+        return -1;
+    }
+    return static_cast<int64_t>(read_bytes);
+#else
+    if (fd_ < 0) {
+        return -1;
+    }
+    for (;;) {
+        ssize_t result = ::read(fd_, buffer, size);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        return static_cast<int64_t>(result);
+    }
+#endif
+}
+
+void SequentialFile::close() {
+#ifdef _WIN32
+    if (handle_) {
+        CloseHandle(static_cast<HANDLE>(handle_));
+        handle_ = nullptr;
+    }
+#else
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+#endif
+    size_ = 0;
+}
+
+// ---- 进程生命周期 ----
+
+#ifdef _WIN32
+namespace {
+
+// 控制台信号处理函数在单独的线程中运行，只记录信号编号并置位终止事件
+HANDLE g_terminate_event = nullptr;
+HANDLE g_dump_event = nullptr;
+volatile LONG g_received_signal = 0;
+
+void onTerminationSignal(int signal) {
+    InterlockedExchange(&g_received_signal, signal);
+    SetEvent(g_terminate_event);
+}
+
+// 导出请求事件按进程号命名，同一会话内的 codebackup --dump-trace <pid> 可以打开
+std::wstring dumpEventName(long pid) {
+    return L"Local\\codebackup_trace_dump_" + std::to_wstring(pid);
+}
+
+} // namespace
+
+void prepareControlSignals() {
+    g_terminate_event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    g_dump_event = CreateEventW(nullptr, FALSE, FALSE, dumpEventName(GetCurrentProcessId()).c_str());
+    std::signal(SIGINT, onTerminationSignal);
+    std::signal(SIGTERM, onTerminationSignal);
+}
+
+ControlSignal waitForControlSignal() {
+    ControlSignal result;
+    HANDLE events[2] = {g_terminate_event, g_dump_event};
+    DWORD count = g_dump_event ? 2 : 1;
+    DWORD waited = WaitForMultipleObjects(count, events, FALSE, INFINITE);
+    if (waited == WAIT_OBJECT_0 + 1) {
+        result.dump_trace = true;
+    } else {
+        result.signal = static_cast<int>(InterlockedCompareExchange(&g_received_signal, 0, 0));
+    }
+    return result;
+}
+
+bool requestTraceDump(long pid) {
+    HANDLE event = OpenEventW(EVENT_MODIFY_STATE, FALSE, dumpEventName(pid).c_str());
+    if (!event) {
+        return false;
+    }
+    bool ok = SetEvent(event) != 0;
+    CloseHandle(event);
+    return ok;
+}
+
+#else
+
+namespace {
+
+sigset_t controlSignals() {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    sigaddset(&signals, SIGUSR1);
+    return signals;
+}
+
+} // namespace
+
+void prepareControlSignals() {
+    // 之后创建的线程继承屏蔽字，信号只会由 sigwait 取走
+    sigset_t signals = controlSignals();
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+}
+
+ControlSignal waitForControlSignal() {
+    sigset_t signals = controlSignals();
+    int signal = 0;
+    while (sigwait(&signals, &signal) != 0) {
+    }
+    ControlSignal result;
+    result.dump_trace = signal == SIGUSR1;
+    result.signal = signal;
+    return result;
+}
+
+bool requestTraceDump(long pid) {
+    return pid > 0 && kill(static_cast<pid_t>(pid), SIGUSR1) == 0;
+}
+
+#endif
+
+} // namespace Platform
@@ -0,0 +1,169 @@
+#include "profiler.h"
+#include "logger.h"
+
+#ifdef CODEBACKUP_PROFILE
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+namespace Profiler {
+
+namespace {
+
+// 单个线程的累计值：只有所属线程写入（读改写不需要原子加），汇总时以 relaxed 读取
+struct ThreadCounters {
+    std::array<std::atomic<uint64_t>, MAX_POINTS> calls{};
+    std::array<std::atomic<uint64_t>, MAX_POINTS> cycles{};
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::array<const char*, MAX_POINTS> names{};
+    std::atomic<uint32_t> point_count{0};
+    std::vector<std::unique_ptr<ThreadCounters>> counters;
+    std::vector<ThreadCounters*> free_counters;    // 已退出线程的计数块，清零后复用
+    std::array<uint64_t, MAX_POINTS> retired_calls{};
+    std::array<uint64_t, MAX_POINTS> retired_cycles{};
+
+    // TSC 频率校准起点
+    uint64_t start_timestamp = readTimestamp();
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+// 线程退出时把累计值并入 retired，计数块留给新线程
+struct CountersHolder {
+    ThreadCounters* counters = nullptr;
+    ~CountersHolder() {
+        if (!counters) {
+            return;
+        }
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for (size_t i = 0; i < MAX_POINTS; ++i) {
+            reg.retired_calls[i] += counters->calls[i].load(std::memory_order_relaxed);
+            reg.retired_cycles[i] += counters->cycles[i].load(std::memory_order_relaxed);
+            counters->calls[i].store(0, std::memory_order_relaxed);
+            counters->cycles[i].store(0, std::memory_order_relaxed);
+        }
+        reg.free_counters.push_back(counters);
+    }
+};
+
+ThreadCounters& localCounters() {
+    thread_local CountersHolder holder;
+    if (!holder.counters) {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        if (!reg.free_counters.empty()) {
+            holder.counters = reg.free_counters.back();
+            reg.free_counters.pop_back();
+        } else {
+            reg.counters.push_back(std::make_unique<ThreadCounters>());
+            holder.counters = reg.counters.back().get();
+        }
+    }
+    return *holder.counters;
+}
+
+} // namespace
+
+uint32_t registerPoint(const char* name) {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    uint32_t count = reg.point_count.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (std::strcmp(reg.names[i], name) == 0) {
+            return i;
+        }
+    }
+    if (count == MAX_POINTS) {
+        return MAX_POINTS - 1;
+    }
+    reg.names[count] = name;
+    reg.point_count.store(count + 1, std::memory_order_release);
+    return count;
+}
+
+void add(uint32_t point, uint64_t calls, uint64_t cycles) {
+    ThreadCounters& counters = localCounters();
+    auto& call_slot = counters.calls[point];
+    auto& cycle_slot = counters.cycles[point];
+    call_slot.store(call_slot.load(std::memory_order_relaxed) + calls, std::memory_order_relaxed);
+    cycle_slot.store(cycle_slot.load(std::memory_order_relaxed) + cycles, std::memory_order_relaxed);
+}
+
+bool enabled() {
+    return true;
+}
+
+std::vector<Entry> report() {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    // 用整个运行期间的 TSC 增量与时钟增量换算频率
+    double elapsed_ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - reg.start_time).count());
+    uint64_t elapsed_ticks = readTimestamp() - reg.start_timestamp;
+    double ns_per_tick = elapsed_ticks > 0 ? elapsed_ns / elapsed_ticks : 1.0;
+
+    uint32_t count = reg.point_count.load(std::memory_order_acquire);
+    std::vector<Entry> entries(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        Entry& entry = entries[i];
+        entry.name = reg.names[i];
+        entry.calls = reg.retired_calls[i];
+        entry.cycles = reg.retired_cycles[i];
+        for (const auto& counters : reg.counters) {
+            entry.calls += counters->calls[i].load(std::memory_order_relaxed);
+            entry.cycles += counters->cycles[i].load(std::memory_order_relaxed);
+        }
+        double total_ns = entry.cycles * ns_per_tick;
+        entry.total_ms = total_ns / 1e6;
+        entry.avg_ns = entry.calls > 0 ? total_ns / entry.calls : 0.0;
+    }
+    return entries;
+}
+
+} // namespace Profiler
+
+#else
+
+namespace Profiler {
+
+bool enabled() {
+    return false;
+}
+
+std::vector<Entry> report() {
+    return {};
+}
+
+} // namespace Profiler
+
+#endif
+
+void Profiler::logReport() {
+    auto entries = report();
+    auto logger = Logger::get();
+    if (!logger || entries.empty()) {
+        return;
+    }
+    logger->info("=== 热路径插桩 ===");
+    for (const auto& entry : entries) {
+        if (entry.cycles == 0) {
+            logger->info("{}: {}", entry.name, entry.calls);
+        } else {
+            logger->info("{}: {} 次 | 合计 {:.2f} ms | 平均 {:.0f} ns",
+                        entry.name, entry.calls, entry.total_ms, entry.avg_ns);
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#include "storm_detector.h"
+#include <algorithm>
+
+StormDetector::StormDetector(const BackupStrategy& strategy)
+    : window_(std::max(1, strategy.storm_window_ms))
+    , settle_(std::max(1, strategy.storm_settle_ms))
+    , threshold_(std::max<size_t>(1, strategy.storm_event_threshold)) {
+}
+
+StormDetector::Verdict StormDetector::observe(const std::string& subtree_key,
+                                              std::chrono::steady_clock::time_point now) {
+    // 整个源处于风暴中时，所有事件都被吸收
+    if (active_storms_ > 0 && !subtree_key.empty()) {
+        auto root = subtrees_.find(std::string());
+        if (root != subtrees_.end() && root->second.storming) {
+            root->second.last_event = now;
+            root->second.absorbed++;
+            return Verdict::Absorbed;
+        }
+    }
+    
+    auto& state = subtrees_[subtree_key];
+    state.last_event = now;
+    
+    if (state.storming) {
+        state.absorbed++;
+        return Verdict::Absorbed;
+    }
+    
+    if (state.window_events == 0 || now - state.window_start > window_) {
+        state.window_start = now;
+        state.window_events = 0;
+    }
+    
+    if (++state.window_events >= threshold_) {
+        state.storming = true;
+        state.absorbed = 1;
+        active_storms_++;
+        return Verdict::StormStarted;
+    }
+    
+    return Verdict::Normal;
+}
+
+void StormDetector::forceStorm(const std::string& subtree_key,
+                               std::chrono::steady_clock::time_point now) {
+    auto& state = subtrees_[subtree_key];
+    state.last_event = now;
+    if (!state.storming) {
+        state.storming = true;
+        active_storms_++;
+    }
+}
+
+std::vector<std::pair<std::string, size_t>> StormDetector::takeSettled(
+    std::chrono::steady_clock::time_point now) {
+    
+    std::vector<std::pair<std::string, size_t>> settled;
+    
+    for (auto it = subtrees_.begin(); it != subtrees_.end();) {
+        const auto& state = it->second;
+        auto idle = now - state.last_event;
+        
+        if (state.storming && idle >= settle_) {
+            settled.emplace_back(it->first, state.absorbed);
+            active_storms_--;
+            it = subtrees_.erase(it);
+        } else if (!state.storming && idle > window_ * 4) {
+            // 长时间无事件的子树不再保留计数，避免表无限增长
+            it = subtrees_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    
+    return settled;
+}
+
+size_t StormDetector::activeStorms() const {
+    return active_storms_;
+}
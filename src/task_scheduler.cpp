@@ -0,0 +1,181 @@
+#include "task_scheduler.h"
+#include <algorithm>
+#include <limits>
+
+bool SchedulePolicy::debounceAccepts(int64_t last_backup_ms, int64_t now_ms, int recent_edit_window_seconds,
+                                     bool* recently_edited) {
+    if (last_backup_ms == 0) {
+        return true;
+    }
+    int64_t elapsed_ms = now_ms - last_backup_ms;
+    if (elapsed_ms < DEBOUNCE_SECONDS * 1000LL) {
+        return false;
+    }
+    if (recently_edited) {
+        *recently_edited = elapsed_ms < recent_edit_window_seconds * 1000LL;
+    }
+    return true;
+}
+
+SchedulePolicy::ModifyOutcome SchedulePolicy::admitModify(PendingState& pending, int64_t& last_backup_ms,
+                                                          int64_t now_ms, int recent_edit_window_seconds,
+                                                          bool* recently_edited) {
+    if (pending == PendingState::InFlight) {
+        pending = PendingState::InFlightDirty;
+    }
+    if (pending != PendingState::NotPending) {
+        return ModifyOutcome::Coalesced;
+    }
+    if (!debounceAccepts(last_backup_ms, now_ms, recent_edit_window_seconds, recently_edited)) {
+        return ModifyOutcome::Debounced;
+    }
+    last_backup_ms = now_ms;
+    pending = PendingState::Queued;
+    return ModifyOutcome::Enqueue;
+}
+
+bool SchedulePolicy::finishBackup(PendingState& pending) {
+    if (pending == PendingState::InFlightDirty) {
+        pending = PendingState::Queued;
+        return true;
+    }
+    pending = PendingState::NotPending;
+    return false;
+}
+
+TaskScheduler::TaskScheduler(const BackupStrategy& strategy)
+    : strategy_(strategy) {
+    strategy_.bulk_max_workers = std::max(1, strategy_.bulk_max_workers);
+    strategy_.aging_seconds = std::max(1, strategy_.aging_seconds);
+}
+
+TaskClass TaskScheduler::classify(size_t file_size, bool recently_edited) const {
+    // 大文件总是进入批量通道，避免阻塞小文件
+    if (file_size >= strategy_.bulk_file_threshold) {
+        return TaskClass::Bulk;
+    }
+    
+    if (recently_edited) {
+        return TaskClass::Recent;
+    }
+    
+    if (file_size <= strategy_.small_file_threshold) {
+        return TaskClass::Small;
+    }
+    
+    return TaskClass::Normal;
+}
+
+void TaskScheduler::push(const BackupTask& task) {
+    lanes_[static_cast<size_t>(task.task_class)].push_back(task);
+}
+
+void TaskScheduler::push(BackupTask&& task) {
+    lanes_[static_cast<size_t>(task.task_class)].push_back(std::move(task));
+}
+
+bool TaskScheduler::hasRunnable() const {
+    for (size_t i = 0; i < NUM_CLASSES; ++i) {
+        if (lanes_[i].empty()) {
+            continue;
+        }
+        if (static_cast<TaskClass>(i) == TaskClass::Bulk &&
+            bulk_in_flight_ >= strategy_.bulk_max_workers) {
+            continue;
+        }
+        return true;
+    }
+    return false;
+}
+
+std::optional<BackupTask> TaskScheduler::pop(std::chrono::steady_clock::time_point now) {
+    size_t best_lane = NUM_CLASSES;
+    long long best_priority = std::numeric_limits<long long>::max();
+    
+    for (size_t i = 0; i < NUM_CLASSES; ++i) {
+        if (lanes_[i].empty()) {
+            continue;
+        }
+        if (static_cast<TaskClass>(i) == TaskClass::Bulk &&
+            bulk_in_flight_ >= strategy_.bulk_max_workers) {
+            continue;
+        }
+        
+        // 老化：队首任务每等待 aging_seconds 秒，优先级提升一级，防止饿死
+        auto waited = std::chrono::duration_cast<std::chrono::seconds>(
+            now - lanes_[i].front().enqueue_time).count();
+        long long priority = static_cast<long long>(i) - waited / strategy_.aging_seconds;
+        
+        if (priority < best_priority) {
+            best_priority = priority;
+            best_lane = i;
+        }
+    }
+    
+    if (best_lane == NUM_CLASSES) {
+        return std::nullopt;
+    }
+    
+    BackupTask task = std::move(lanes_[best_lane].front());
+    lanes_[best_lane].pop_front();
+    
+    if (task.task_class == TaskClass::Bulk) {
+        bulk_in_flight_++;
+    }
+    return task;
+}
+
+void TaskScheduler::complete(const BackupTask& task, std::chrono::steady_clock::time_point now) {
+    if (task.task_class == TaskClass::Bulk && bulk_in_flight_ > 0) {
+        bulk_in_flight_--;
+    }
+    
+    double latency_ms = std::chrono::duration<double, std::milli>(now - task.enqueue_time).count();
+    auto& acc = latency_[static_cast<size_t>(task.task_class)];
+    acc.count++;
+    acc.total_ms += latency_ms;
+    acc.max_ms = std::max(acc.max_ms, latency_ms);
+}
+
+bool TaskScheduler::empty() const {
+    return size() == 0;
+}
+
+size_t TaskScheduler::size() const {
+    size_t total = 0;
+    for (const auto& lane : lanes_) {
+        total += lane.size();
+    }
+    return total;
+}
+
+std::optional<std::chrono::steady_clock::time_point> TaskScheduler::oldestEnqueueTime() const {
+    std::optional<std::chrono::steady_clock::time_point> oldest;
+    for (const auto& lane : lanes_) {
+        if (!lane.empty() && (!oldest || lane.front().enqueue_time < *oldest)) {
+            oldest = lane.front().enqueue_time;
+        }
+    }
+    return oldest;
+}
+
+std::array<ClassLatencyStats, TaskScheduler::NUM_CLASSES> TaskScheduler::getLatencyStats() const {
+    std::array<ClassLatencyStats, NUM_CLASSES> stats;
+    for (size_t i = 0; i < NUM_CLASSES; ++i) {
+        stats[i].task_class = static_cast<TaskClass>(i);
+        stats[i].completed = latency_[i].count;
+        stats[i].avg_ms = latency_[i].count > 0 ? latency_[i].total_ms / latency_[i].count : 0.0;
+        stats[i].max_ms = latency_[i].max_ms;
+    }
+    return stats;
+}
+
+const char* TaskScheduler::className(TaskClass task_class) {
+    switch (task_class) {
+        case TaskClass::Recent: return "recent";
+        case TaskClass::Small:  return "small";
+        case TaskClass::Normal: return "normal";
+        case TaskClass::Bulk:   return "bulk";
+    }
+    return "unknown";
+}
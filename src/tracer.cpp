@@ -0,0 +1,245 @@
+#include "tracer.h"
+#include "logger.h"
+#include "platform.h"
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+std::atomic<bool> Tracer::enabled_{false};
+
+namespace {
+
+// 一个槽位一个缓存行；seq 为 2 * 事件序号 + 2 时内容完整，奇数表示正在写入
+struct alignas(64) TraceSlot {
+    std::atomic<uint64_t> seq{0};
+    std::atomic<const char*> category{nullptr};
+    std::atomic<const char*> name{nullptr};
+    std::atomic<int64_t> start_ns{0};
+    std::atomic<int64_t> duration_ns{0};
+    std::atomic<uint64_t> id{0};
+    std::atomic<uint64_t> arg{0};
+    std::atomic<char> phase{'X'};
+};
+
+// 单个线程的环形缓冲区：只有所属线程写入
+struct ThreadBuffer {
+    explicit ThreadBuffer(size_t capacity, uint32_t thread_id)
+        : slots(new TraceSlot[capacity]), capacity(capacity), tid(thread_id) {}
+
+    std::unique_ptr<TraceSlot[]> slots;
+    size_t capacity;
+    uint32_t tid;
+    std::atomic<uint64_t> next{0};   // 已写入的事件总数
+    std::string thread_name;         // 受 registry 锁保护
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::vector<ThreadBuffer*> free_buffers;   // 已退出线程的缓冲区，留给新线程复用
+    size_t capacity = 0;
+    Tracer::Clock::time_point epoch = Tracer::Clock::now();
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+// 线程退出时把缓冲区交还注册表（其中的事件保留到被新线程覆盖），伸缩产生的线程不会无限占用内存
+struct BufferHolder {
+    ThreadBuffer* buffer = nullptr;
+    ~BufferHolder() {
+        if (buffer) {
+            Registry& reg = registry();
+            std::lock_guard<std::mutex> lock(reg.mutex);
+            reg.free_buffers.push_back(buffer);
+        }
+    }
+};
+
+ThreadBuffer* localBuffer() {
+    thread_local BufferHolder holder;
+    if (!holder.buffer) {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        if (!reg.free_buffers.empty()) {
+            holder.buffer = reg.free_buffers.back();
+            reg.free_buffers.pop_back();
+        } else {
+            auto owned = std::make_unique<ThreadBuffer>(reg.capacity, static_cast<uint32_t>(reg.buffers.size() + 1));
+            holder.buffer = owned.get();
+            reg.buffers.push_back(std::move(owned));
+        }
+    }
+    return holder.buffer;
+}
+
+int64_t sinceEpoch(Tracer::Clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time - registry().epoch).count();
+}
+
+void push(char phase, const char* category, const char* name, int64_t start_ns,
+          int64_t duration_ns, uint64_t id, uint64_t arg) {
+    ThreadBuffer* buffer = localBuffer();
+    uint64_t index = buffer->next.load(std::memory_order_relaxed);
+    TraceSlot& slot = buffer->slots[index % buffer->capacity];
+
+    slot.seq.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.phase.store(phase, std::memory_order_relaxed);
+    slot.category.store(category, std::memory_order_relaxed);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.start_ns.store(start_ns, std::memory_order_relaxed);
+    slot.duration_ns.store(duration_ns, std::memory_order_relaxed);
+    slot.id.store(id, std::memory_order_relaxed);
+    slot.arg.store(arg, std::memory_order_relaxed);
+    slot.seq.store(2 * index + 2, std::memory_order_release);
+
+    buffer->next.store(index + 1, std::memory_order_release);
+}
+
+// 微秒，保留到纳秒（启用跟踪之前的时间按 0 处理）
+void writeMicros(std::ostream& out, int64_t ns) {
+    ns = std::max<int64_t>(ns, 0);
+    out << ns / 1000 << '.';
+    int64_t frac = ns % 1000;
+    out << char('0' + frac / 100) << char('0' + frac / 10 % 10) << char('0' + frac % 10);
+}
+
+} // namespace
+
+void Tracer::enable(size_t events_per_thread) {
+    Registry& reg = registry();
+    {
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        // 已有线程注册过缓冲区时不再改变容量
+        if (reg.buffers.empty()) {
+            reg.capacity = std::max<size_t>(events_per_thread, 1024);
+            reg.epoch = Clock::now();
+        }
+    }
+    enabled_.store(true);
+}
+
+void Tracer::nameThread(const char* name) {
+    if (!enabled()) {
+        return;
+    }
+    ThreadBuffer* buffer = localBuffer();
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    buffer->thread_name = name;
+}
+
+void Tracer::complete(const char* category, const char* name,
+                      Clock::time_point start, Clock::time_point end, uint64_t arg) {
+    int64_t start_ns = sinceEpoch(start);
+    push('X', category, name, start_ns, sinceEpoch(end) - start_ns, 0, arg);
+}
+
+void Tracer::asyncSpan(const char* category, const char* name, uint64_t id,
+                       Clock::time_point start, Clock::time_point end) {
+    push('b', category, name, sinceEpoch(start), 0, id, 0);
+    push('e', category, name, sinceEpoch(end), 0, id, 0);
+}
+
+size_t Tracer::dump(const std::string& path) {
+    std::error_code ec;
+    fs::create_directories(fs::path(path).parent_path(), ec);
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        auto logger = Logger::get();
+        if (logger) {
+            logger->warn("无法写出跟踪文件: {}", path);
+        }
+        return 0;
+    }
+
+    size_t written = 0;
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << "{\"ph\":\"M\",\"pid\":1,\"tid\":0,\"name\":\"process_name\",\"args\":{\"name\":\"codebackup\"}}";
+
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (const auto& buffer : reg.buffers) {
+        if (!buffer->thread_name.empty()) {
+            out << ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+                << ",\"name\":\"thread_name\",\"args\":{\"name\":\"" << buffer->thread_name << "\"}}";
+        }
+
+        uint64_t end = buffer->next.load(std::memory_order_acquire);
+        uint64_t begin = end > buffer->capacity ? end - buffer->capacity : 0;
+        for (uint64_t index = begin; index < end; ++index) {
+            const TraceSlot& slot = buffer->slots[index % buffer->capacity];
+            uint64_t expected = 2 * index + 2;
+            if (slot.seq.load(std::memory_order_acquire) != expected) {
+                continue;   // 已被覆盖或正在写入
+            }
+            char phase = slot.phase.load(std::memory_order_relaxed);
+            const char* category = slot.category.load(std::memory_order_relaxed);
+            const char* name = slot.name.load(std::memory_order_relaxed);
+            int64_t start_ns = slot.start_ns.load(std::memory_order_relaxed);
+            int64_t duration_ns = slot.duration_ns.load(std::memory_order_relaxed);
+            uint64_t id = slot.id.load(std::memory_order_relaxed);
+            uint64_t arg = slot.arg.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) != expected) {
+                continue;
+            }
+
+            out << ",\n{\"ph\":\"" << phase << "\",\"cat\":\"" << category << "\",\"name\":\"" << name
+                << "\",\"pid\":1,\"tid\":" << buffer->tid << ",\"ts\":";
+            writeMicros(out, start_ns);
+            if (phase == 'X') {
+                out << ",\"dur\":";
+                writeMicros(out, duration_ns);
+                if (arg != 0) {
+                    out << ",\"args\":{\"value\":" << arg << "}";
+                }
+            } else {
+                out << ",\"id\":" << id;
+            }
+            out << "}";
+            written++;
+        }
+    }
+    out << "\n]}\n";
+    out.flush();
+    if (!out) {
+        return 0;
+    }
+    return written;
+}
+
+std::string Tracer::dumpFileName() {
+    auto time_t = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    std::tm tm;
+    Platform::localTime(time_t, tm);
+    char name[64];
+    std::strftime(name, sizeof(name), "trace_%Y%m%d_%H%M%S.json", &tm);
+    return name;
+}
+
+uint64_t Tracer::nextId() {
+    static std::atomic<uint64_t> next_id{1};
+    return next_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t Tracer::overwrittenEvents() {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    uint64_t overwritten = 0;
+    for (const auto& buffer : reg.buffers) {
+        uint64_t count = buffer->next.load(std::memory_order_relaxed);
+        if (count > buffer->capacity) {
+            overwritten += count - buffer->capacity;
+        }
+    }
+    return overwritten;
+}
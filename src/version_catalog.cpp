@@ -0,0 +1,433 @@
+#include "version_catalog.h"
+#include "logger.h"
+#include <filesystem>
+#include <cstdio>
+#include <algorithm>
+#include <limits>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// 不同源写入同一备份根目录时各用一个日志文件
+std::string journalName(const std::string& source_path) {
+    uint32_t hash = 2166136261u;
+    for (char c : source_path) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+    }
+    char name[32];
+    std::snprintf(name, sizeof(name), "journal-%08x.jsonl", hash);
+    return name;
+}
+
+} // namespace
+
+VersionCatalog::VersionCatalog(const std::string& backup_base_path, const std::string& source_path,
+                               Clock& clock)
+    : backup_base_path_(backup_base_path)
+    , journal_path_((fs::path(backup_base_path) / ".catalog" / journalName(source_path)).string())
+    , snapshot_path_(fs::path(journal_path_).replace_extension(".snapshot.jsonl").string())
+    , clock_(&clock) {
+    load();
+}
+
+size_t VersionCatalog::replay(const std::string& path, int64_t after_ms, size_t& corrupt) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return 0;
+    }
+
+    size_t applied = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        // 崩溃时最后一行可能不完整，跳过即可
+        auto entry = nlohmann::json::parse(line, nullptr, false);
+        if (entry.is_discarded() || !entry.is_object()) {
+            corrupt++;
+            continue;
+        }
+        int64_t time_ms = entry.value("t", static_cast<int64_t>(0));
+        if (entry.contains("snapshot")) {
+            // 快照首行：之后的日志只重放晚于此刻的记录
+            last_time_ms_ = std::max(last_time_ms_, time_ms);
+            continue;
+        }
+        if (time_ms <= after_ms) {
+            continue;
+        }
+        apply(entry);
+        applied++;
+    }
+    return applied;
+}
+
+void VersionCatalog::load() {
+    size_t corrupt = 0;
+    size_t snapshot_records = replay(snapshot_path_, std::numeric_limits<int64_t>::min(), corrupt);
+    int64_t snapshot_time = snapshot_records > 0 || fs::exists(snapshot_path_) 
+                            ? last_time_ms_ : std::numeric_limits<int64_t>::min();
+    log_records_ = replay(journal_path_, snapshot_time, corrupt);
+
+    auto logger = Logger::get();
+    if (logger) {
+        logger->debug("版本目录已加载: {} (快照 {} 条, 日志 {} 条, {} 条损坏)",
+                      journal_path_, snapshot_records, log_records_, corrupt);
+    }
+
+    // 日志末尾不完整时立即压缩，新记录不会接在残缺的行后面
+    if (corrupt > 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        compactLocked();
+    }
+}
+
+template <typename Fn>
+void VersionCatalog::forEachUnder(const std::string& relative_path, Fn&& fn) {
+    for (auto it = history_.lower_bound(relative_path); it != history_.end(); ++it) {
+        const std::string& path = it->first;
+        if (path.compare(0, relative_path.size(), relative_path) != 0) {
+            break;
+        }
+        if (path.size() == relative_path.size() || path[relative_path.size()] == '/' ||
+            path[relative_path.size()] == '\\') {
+            fn(path, it->second);
+        }
+    }
+}
+
+void VersionCatalog::apply(const nlohmann::json& entry) {
+    CatalogRecord record;
+    record.path = entry.value("path", "");
+    record.hash = entry.value("hash", "");
+    record.stored_file = entry.value("file", "");
+    record.size = entry.value("size", static_cast<size_t>(0));
+    record.time_ms = entry.value("t", static_cast<int64_t>(0));
+    if (record.path.empty()) {
+        return;
+    }
+    last_time_ms_ = std::max(last_time_ms_, record.time_ms);
+
+    std::string op = entry.value("op", "");
+    if (op == "backup" || op == "alias") {
+        record.op = op == "backup" ? CatalogOp::Backup : CatalogOp::Alias;
+        if (!record.hash.empty() && !record.stored_file.empty()) {
+            contents_[record.hash] = record;
+        }
+        history_[record.path].push_back(std::move(record));
+        record_count_++;
+    } else if (op == "prune") {
+        pruneLocked(record.path, record.stored_file);
+    } else if (op == "delete") {
+        // 目录删除展开为其下每个仍存在路径的墓碑
+        forEachUnder(record.path, [&](const std::string& path, std::vector<CatalogRecord>& versions) {
+            if (versions.empty() || versions.back().op == CatalogOp::Delete) {
+                return;
+            }
+            CatalogRecord tombstone;
+            tombstone.op = CatalogOp::Delete;
+            tombstone.path = path;
+            tombstone.time_ms = record.time_ms;
+            versions.push_back(std::move(tombstone));
+            record_count_++;
+        });
+    }
+}
+
+size_t VersionCatalog::pruneLocked(const std::string& relative_path, const std::string& stored_file) {
+    auto it = history_.find(relative_path);
+    if (it == history_.end() || stored_file.empty()) {
+        return 0;
+    }
+
+    auto& versions = it->second;
+    size_t before = versions.size();
+    versions.erase(std::remove_if(versions.begin(), versions.end(), [&](const CatalogRecord& record) {
+        if (record.op == CatalogOp::Delete || record.stored_file != stored_file) {
+            return false;
+        }
+        auto content = contents_.find(record.hash);
+        if (content != contents_.end() && content->second.stored_file == stored_file) {
+            contents_.erase(content);
+        }
+        return true;
+    }), versions.end());
+    if (versions.size() == before) {
+        return 0;
+    }
+
+    // 版本移除后，开头的墓碑和紧接在墓碑之后的墓碑不再有意义
+    bool previous_deleted = true;
+    versions.erase(std::remove_if(versions.begin(), versions.end(), [&](const CatalogRecord& record) {
+        bool deleted = record.op == CatalogOp::Delete;
+        bool redundant = deleted && previous_deleted;
+        previous_deleted = deleted;
+        return redundant;
+    }), versions.end());
+
+    size_t removed = before - versions.size();
+    record_count_ -= std::min(record_count_, removed);
+    if (versions.empty()) {
+        history_.erase(it);
+    }
+    return removed;
+}
+
+int64_t VersionCatalog::nextTimestamp() {
+    // 保证日志严格按时间递增（系统时间回拨或同一毫秒内多条记录时也不重复），快照据此跳过已包含的记录
+    last_time_ms_ = std::max(last_time_ms_ + 1, clock_->systemMillis());
+    return last_time_ms_;
+}
+
+void VersionCatalog::append(nlohmann::json& entry) {
+    entry["t"] = nextTimestamp();
+    if (!journal_.is_open()) {
+        std::error_code ec;
+        fs::create_directories(fs::path(journal_path_).parent_path(), ec);
+        journal_.open(journal_path_, std::ios::app | std::ios::binary);
+        if (!journal_.is_open()) {
+            auto logger = Logger::get();
+            if (logger) {
+                logger->warn("无法写入版本目录: {}", journal_path_);
+            }
+            return;
+        }
+    }
+    // 每条记录一行并立即刷新，崩溃最多丢失最后一条
+    journal_ << entry.dump() << '\n';
+    journal_.flush();
+    log_records_++;
+}
+
+void VersionCatalog::recordBackup(const std::string& relative_path, const std::string& hash,
+                                  const std::string& stored_file, size_t size) {
+    nlohmann::json entry = {
+        {"op", "backup"}, {"path", relative_path},
+        {"hash", hash}, {"file", stored_file}, {"size", size}
+    };
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    append(entry);
+    apply(entry);
+}
+
+void VersionCatalog::recordAlias(const std::string& relative_path, const std::string& from_path,
+                                 const std::string& hash, const std::string& stored_file, size_t size) {
+    nlohmann::json entry = {
+        {"op", "alias"}, {"path", relative_path}, {"from", from_path},
+        {"hash", hash}, {"file", stored_file}, {"size", size}
+    };
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    append(entry);
+    apply(entry);
+}
+
+size_t VersionCatalog::recordDelete(const std::string& relative_path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    size_t live = 0;
+    forEachUnder(relative_path, [&](const std::string&, std::vector<CatalogRecord>& versions) {
+        if (!versions.empty() && versions.back().op != CatalogOp::Delete) {
+            live++;
+        }
+    });
+    if (live == 0) {
+        return 0;   // 从未备份过的路径不需要墓碑
+    }
+
+    nlohmann::json entry = {{"op", "delete"}, {"path", relative_path}};
+    append(entry);
+    apply(entry);
+    return live;
+}
+
+std::optional<CatalogRecord> VersionCatalog::findPath(const std::string& relative_path) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = history_.find(relative_path);
+    if (it == history_.end() || it->second.empty() || it->second.back().op == CatalogOp::Delete) {
+        return std::nullopt;
+    }
+    return it->second.back();
+}
+
+std::optional<CatalogRecord> VersionCatalog::findLastVersion(const std::string& relative_path) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = history_.find(relative_path);
+    if (it == history_.end()) {
+        return std::nullopt;
+    }
+    for (auto version = it->second.rbegin(); version != it->second.rend(); ++version) {
+        if (version->op != CatalogOp::Delete) {
+            return *version;
+        }
+    }
+    return std::nullopt;
+}
+
+std::vector<CatalogRecord> VersionCatalog::treeAt(int64_t time_ms, const std::string& prefix, bool verify_files) {
+    std::vector<CatalogRecord> tree;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (auto it = history_.lower_bound(prefix); it != history_.end(); ++it) {
+        const std::string& path = it->first;
+        if (path.compare(0, prefix.size(), prefix) != 0) {
+            break;
+        }
+        // prefix 按目录匹配：docs 不匹配 docs2/a.txt
+        if (!prefix.empty() && path.size() > prefix.size() && path[prefix.size()] != '/' &&
+            path[prefix.size()] != '\\' && prefix.back() != '/' && prefix.back() != '\\') {
+            continue;
+        }
+
+        // 每个路径的历史按时间排序，二分查找该时刻之前的最后一条记录
+        const auto& versions = it->second;
+        auto after = std::upper_bound(versions.begin(), versions.end(), time_ms,
+            [](int64_t t, const CatalogRecord& record) { return t < record.time_ms; });
+        if (after == versions.begin()) {
+            continue;
+        }
+        const CatalogRecord& state = *std::prev(after);
+        if (state.op != CatalogOp::Delete) {
+            tree.push_back(state);
+        }
+    }
+    lock.unlock();
+
+    if (verify_files) {
+        // 文件检查不持锁，备份线程照常记录
+        std::error_code ec;
+        for (auto& record : tree) {
+            record.missing = !fs::is_regular_file(fs::path(backup_base_path_) / fs::path(record.stored_file), ec);
+        }
+        lock.lock();
+        for (const auto& record : tree) {
+            auto content = record.missing ? contents_.find(record.hash) : contents_.end();
+            if (content != contents_.end() && content->second.stored_file == record.stored_file) {
+                contents_.erase(content);
+            }
+        }
+    }
+    return tree;
+}
+
+std::optional<CatalogRecord> VersionCatalog::findContent(const std::string& hash) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = contents_.find(hash);
+    if (it == contents_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+void VersionCatalog::forgetContent(const std::string& hash) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    contents_.erase(hash);
+}
+
+size_t VersionCatalog::recordPruned(const std::vector<std::string>& stored_files,
+                                    const std::string& relative_path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // 未指定路径（整个备份目录的清理）时建立一次备份文件到路径的索引
+    std::unordered_map<std::string, std::string> owners;
+    if (relative_path.empty()) {
+        for (const auto& item : history_) {
+            for (const auto& record : item.second) {
+                if (!record.stored_file.empty()) {
+                    owners.emplace(record.stored_file, item.first);
+                }
+            }
+        }
+    }
+
+    size_t removed = 0;
+    for (const auto& stored_file : stored_files) {
+        std::string path = relative_path;
+        if (path.empty()) {
+            auto owner = owners.find(stored_file);
+            if (owner == owners.end()) {
+                continue;   // 其他备份源的文件
+            }
+            path = owner->second;
+        }
+        size_t count = pruneLocked(path, stored_file);
+        if (count == 0) {
+            continue;
+        }
+        nlohmann::json entry = {{"op", "prune"}, {"path", path}, {"file", stored_file}};
+        append(entry);
+        removed += count;
+    }
+    return removed;
+}
+
+bool VersionCatalog::compact() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return compactLocked();
+}
+
+bool VersionCatalog::maybeCompact() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (log_records_ <= std::max(COMPACT_MIN_RECORDS, record_count_ / 2)) {
+        return true;
+    }
+    return compactLocked();
+}
+
+bool VersionCatalog::compactLocked() {
+    std::error_code ec;
+    fs::create_directories(fs::path(snapshot_path_).parent_path(), ec);
+    std::string temp_path = snapshot_path_ + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::trunc | std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+        nlohmann::json header = {{"snapshot", 1}, {"t", last_time_ms_}};
+        file << header.dump() << '\n';
+        // 按路径顺序写出：目录墓碑重放时其下的路径尚未加载，只作用于自身
+        for (const auto& item : history_) {
+            for (const auto& record : item.second) {
+                nlohmann::json entry;
+                if (record.op == CatalogOp::Delete) {
+                    entry = {{"op", "delete"}, {"path", record.path}, {"t", record.time_ms}};
+                } else {
+                    entry = {
+                        {"op", record.op == CatalogOp::Backup ? "backup" : "alias"}, {"path", record.path},
+                        {"hash", record.hash}, {"file", record.stored_file}, {"size", record.size},
+                        {"t", record.time_ms}
+                    };
+                }
+                file << entry.dump() << '\n';
+            }
+        }
+        file.flush();
+        if (!file) {
+            file.close();
+            fs::remove(temp_path, ec);
+            return false;
+        }
+    }
+
+    fs::rename(temp_path, snapshot_path_, ec);
+    if (ec) {
+        fs::remove(temp_path, ec);
+        return false;
+    }
+
+    // 快照已包含日志中的全部记录；删除前中断时，重放会按快照时刻跳过它们
+    if (journal_.is_open()) {
+        journal_.close();
+    }
+    fs::remove(journal_path_, ec);
+    log_records_ = 0;
+
+    auto logger = Logger::get();
+    if (logger) {
+        logger->debug("版本目录已压缩: {} ({} 条记录)", snapshot_path_, record_count_);
+    }
+    return true;
+}
@@ -1,54 +1,127 @@
 #include "version_manager.h"
 #include "logger.h"
 #include <algorithm>
-#include <regex>
+#include <string_view>
+#include <ctime>
 
-VersionManager::VersionManager(const std::string& backup_base_path, const BackupStrategy& strategy)
-    : backup_base_path_(backup_base_path), strategy_(strategy) {
+VersionManager::VersionManager(const std::string& backup_base_path, const BackupStrategy& strategy,
+                               Clock& clock, FileSystem& file_system)
+    : backup_base_path_(backup_base_path), strategy_(strategy), clock_(&clock), file_system_(&file_system) {
 }
 
+namespace {
+
+using NativeView = std::basic_string_view<fs::path::value_type>;
+
+// 版本文件名中的时间戳段：.YYYYMMDD_HHMMSS（共 16 个字符）
+constexpr size_t TIMESTAMP_LEN = 16;
+
+bool isDigit(fs::path::value_type c) {
+    return c >= '0' && c <= '9';
+}
+
+int digitsValue(NativeView text, size_t pos, size_t count) {
+    int value = 0;
+    for (size_t i = 0; i < count; ++i) {
+        value = value * 10 + static_cast<int>(text[pos + i] - '0');
+    }
+    return value;
+}
+
+// pos 处是否为时间戳段，是则解析到 tm
+bool parseTimestampAt(NativeView name, size_t pos, std::tm& tm) {
+    if (pos + TIMESTAMP_LEN > name.size() || name[pos] != '.' || name[pos + 9] != '_') {
+        return false;
+    }
+    for (size_t i = 1; i < TIMESTAMP_LEN; ++i) {
+        if (i != 9 && !isDigit(name[pos + i])) {
+            return false;
+        }
+    }
+    tm = {};
+    tm.tm_year = digitsValue(name, pos + 1, 4) - 1900;
+    tm.tm_mon = digitsValue(name, pos + 5, 2) - 1;
+    tm.tm_mday = digitsValue(name, pos + 7, 2);
+    tm.tm_hour = digitsValue(name, pos + 10, 2);
+    tm.tm_min = digitsValue(name, pos + 12, 2);
+    tm.tm_sec = digitsValue(name, pos + 14, 2);
+    return true;
+}
+
+bool endsWith(NativeView text, NativeView suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+const fs::path::string_type& gzSuffix() {
+    static const fs::path::string_type suffix = fs::path(".gz").native();
+    return suffix;
+}
+
+NativeView fileNameOf(const fs::path& file_path) {
+    const auto& native = file_path.native();
+    size_t pos = native.size();
+    while (pos > 0 && native[pos - 1] != '/' && native[pos - 1] != fs::path::preferred_separator) {
+        --pos;
+    }
+    return NativeView(native).substr(pos);
+}
+
+// 文件名是否为 stem.YYYYMMDD_HHMMSS.ext[.gz]，stem 和 ext 必须与原文件完全一致
+// （只比较前缀会把 a_old.txt、a.md 的版本也当成 a.txt 的版本）
+bool matchVersionName(NativeView name, NativeView stem, NativeView ext, std::tm& tm) {
+    if (name.size() < stem.size() + TIMESTAMP_LEN + ext.size() ||
+        name.compare(0, stem.size(), stem) != 0 ||
+        !parseTimestampAt(name, stem.size(), tm)) {
+        return false;
+    }
+    NativeView rest = name.substr(stem.size() + TIMESTAMP_LEN);
+    if (rest.size() == ext.size() + gzSuffix().size() && endsWith(rest, gzSuffix())) {
+        rest.remove_suffix(gzSuffix().size());
+    }
+    return rest == ext;
+}
+
+// 文件名格式: filename.YYYYMMDD_HHMMSS.ext 或 filename.YYYYMMDD_HHMMSS.ext.gz
+// 取第一个时间戳段（逐字符扫描，不构造正则）
+bool parseVersionName(const fs::path& file_path, std::tm& tm) {
+    NativeView name = fileNameOf(file_path);
+    for (size_t pos = name.find('.'); pos != NativeView::npos; pos = name.find('.', pos + 1)) {
+        if (parseTimestampAt(name, pos, tm)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
 std::optional<VersionInfo> VersionManager::parseVersionFile(const fs::path& file_path) {
-    // 文件名格式: filename.YYYYMMDD_HHMMSS.ext 或 filename.YYYYMMDD_HHMMSS.ext.gz
-    std::string filename = file_path.filename().string();
-    
-    // 正则表达式匹配时间戳
-    std::regex pattern(R"(\.(\d{8})_(\d{6}))");
-    std::smatch match;
+    std::tm tm = {};
+    if (!parseVersionName(file_path, tm)) {
+        return std::nullopt;
+    }
     
-    if (!std::regex_search(filename, match, pattern)) {
+    auto file_size = file_system_->fileSize(file_path);
+    if (!file_size) {
         return std::nullopt;
     }
+    return makeVersionInfo(file_path, tm, static_cast<size_t>(*file_size));
+}
 
+VersionInfo VersionManager::makeVersionInfo(const fs::path& file_path, std::tm& tm, size_t file_size) {
+    NativeView name = fileNameOf(file_path);
+    
     VersionInfo info;
     info.file_path = file_path;
-    
-    // 解析时间戳
-    std::string date_str = match[1].str();
-    std::string time_str = match[2].str();
-    
-    std::tm tm = {};
-    tm.tm_year = std::stoi(date_str.substr(0, 4)) - 1900;
-    tm.tm_mon = std::stoi(date_str.substr(4, 2)) - 1;
-    tm.tm_mday = std::stoi(date_str.substr(6, 2));
-    tm.tm_hour = std::stoi(time_str.substr(0, 2));
-    tm.tm_min = std::stoi(time_str.substr(2, 2));
-    tm.tm_sec = std::stoi(time_str.substr(4, 2));
-    
     info.timestamp = std::chrono::system_clock::from_time_t(std::mktime(&tm));
-    
-    // 检查文件大小
-    std::error_code ec;
-    info.file_size = fs::file_size(file_path, ec);
-    if (ec) {
-        return std::nullopt;
-    }
+    info.file_size = file_size;
     
     // 检查是否压缩
-    info.is_compressed = (filename.length() >= 3 && 
-                         filename.substr(filename.length() - 3) == ".gz");
+    info.is_compressed = endsWith(name, gzSuffix());
     
     // 检查是否增量（简化：通过文件名中的 .delta 标记）
-    info.is_incremental = filename.find(".delta") != std::string::npos;
+    static const fs::path::string_type delta_mark = fs::path(".delta").native();
+    info.is_incremental = name.find(delta_mark) != NativeView::npos;
     
     // 版本号（使用时间戳的秒数，避免溢出）
     info.version_number = static_cast<int>(
@@ -61,7 +134,7 @@ std::optional<VersionInfo> VersionManager::parseVersionFile(const fs::path& file
 }
 
 bool VersionManager::isVersionExpired(const VersionInfo& version) {
-    auto now = std::chrono::system_clock::now();
+    auto now = clock_->systemNow();
     auto age = std::chrono::duration_cast<std::chrono::hours>(now - version.timestamp).count() / 24;
     
     return age > strategy_.retention_days;
@@ -70,34 +143,33 @@ bool VersionManager::isVersionExpired(const VersionInfo& version) {
 std::vector<VersionInfo> VersionManager::getFileVersions(const std::string& relative_path) {
     std::vector<VersionInfo> versions;
     
-    // 遍历所有日期目录
-    std::error_code ec;
-    for (const auto& date_entry : fs::directory_iterator(backup_base_path_, ec)) {
-        if (!date_entry.is_directory(ec)) {
-            continue;
-        }
-        
-        fs::path target_dir = date_entry.path() / fs::path(relative_path).parent_path();
-        if (!fs::exists(target_dir, ec)) {
-            continue;
+    // 文件名各部分只拆分一次，逐项比较时不再分配
+    fs::path relative(relative_path);
+    fs::path parent = relative.parent_path();
+    fs::path::string_type stem = relative.stem().native();
+    fs::path::string_type ext = relative.extension().native();
+    
+    // 遍历所有日期目录（先取出目录列表，枚举回调中不再访问文件系统）
+    std::vector<fs::path> date_dirs;
+    file_system_->listDirectory(backup_base_path_, [&](const FileSystemEntry& date_entry) {
+        if (date_entry.isDirectory()) {
+            date_dirs.push_back(date_entry.path());
         }
-        
-        // 查找匹配的版本文件
-        std::string base_name = fs::path(relative_path).stem().string();
-        
-        for (const auto& file_entry : fs::directory_iterator(target_dir, ec)) {
-            if (!file_entry.is_regular_file(ec)) {
-                continue;
+    });
+    
+    for (const auto& date_dir : date_dirs) {
+        // 该日期没有这个目录时打开失败，直接跳过；查找匹配的版本文件
+        file_system_->listDirectory(date_dir / parent, [&](const FileSystemEntry& file_entry) {
+            std::tm tm;
+            if (!matchVersionName(fileNameOf(file_entry.path()), stem, ext, tm) ||
+                !file_entry.isRegularFile()) {
+                return;
             }
-            
-            std::string filename = file_entry.path().filename().string();
-            if (filename.find(base_name) == 0) {
-                auto version_info = parseVersionFile(file_entry.path());
-                if (version_info) {
-                    versions.push_back(*version_info);
-                }
+            auto file_size = file_entry.fileSize();
+            if (file_size) {
+                versions.push_back(makeVersionInfo(file_entry.path(), tm, static_cast<size_t>(*file_size)));
             }
-        }
+        });
     }
     
     // 按时间戳排序（最新的在前）
@@ -125,7 +197,7 @@ int VersionManager::getNextVersionNumber(const std::string& relative_path) {
     return versions.size() + 1;
 }
 
-size_t VersionManager::cleanupOldVersions(const std::string& relative_path) {
+size_t VersionManager::cleanupOldVersions(const std::string& relative_path, std::vector<fs::path>* removed) {
     auto versions = getFileVersions(relative_path);
     size_t deleted_count = 0;
     
@@ -148,11 +220,12 @@ size_t VersionManager::cleanupOldVersions(const std::string& relative_path) {
         }
         
         if (should_delete) {
-            std::error_code ec;
-            fs::remove(versions[i].file_path, ec);
-            if (!ec) {
+            if (file_system_->remove(versions[i].file_path)) {
                 deleted_count++;
-                if (logger) {
+                if (removed) {
+                    removed->push_back(versions[i].file_path);
+                }
+                if (Logger::shouldLog(spdlog::level::debug)) {
                     logger->debug("已删除过期版本: {}", versions[i].file_path.string());
                 }
             }
@@ -162,7 +235,7 @@ size_t VersionManager::cleanupOldVersions(const std::string& relative_path) {
     return deleted_count;
 }
 
-size_t VersionManager::cleanupAllOldVersions() {
+size_t VersionManager::cleanupAllOldVersions(std::vector<fs::path>* removed) {
     size_t total_deleted = 0;
     auto logger = Logger::get();
     
@@ -170,21 +243,28 @@ size_t VersionManager::cleanupAllOldVersions() {
         logger->info("开始清理过期备份版本...");
     }
     
-    std::error_code ec;
-    for (const auto& date_entry : fs::recursive_directory_iterator(backup_base_path_, ec)) {
-        if (!date_entry.is_regular_file(ec)) {
-            continue;
+    // 先收集再删除：遍历过程中不修改目录
+    std::vector<fs::path> expired;
+    file_system_->walk(backup_base_path_, [&](const FileSystemEntry& entry) {
+        if (!entry.isRegularFile()) {
+            return;
         }
-        
-        auto version_info = parseVersionFile(date_entry.path());
-        if (!version_info) {
-            continue;
+        auto size = entry.fileSize();
+        if (!size) {
+            return;
         }
-        
-        if (isVersionExpired(*version_info)) {
-            fs::remove(date_entry.path(), ec);
-            if (!ec) {
-                total_deleted++;
+        std::tm tm;
+        if (parseVersionName(entry.path(), tm) &&
+            isVersionExpired(makeVersionInfo(entry.path(), tm, static_cast<size_t>(*size)))) {
+            expired.push_back(entry.path());
+        }
+    });
+    
+    for (const auto& file_path : expired) {
+        if (file_system_->remove(file_path)) {
+            total_deleted++;
+            if (removed) {
+                removed->push_back(file_path);
             }
         }
     }
@@ -198,13 +278,12 @@ size_t VersionManager::cleanupAllOldVersions() {
 
 size_t VersionManager::getTotalBackupSize() {
     size_t total_size = 0;
-    std::error_code ec;
     
-    for (const auto& entry : fs::recursive_directory_iterator(backup_base_path_, ec)) {
-        if (entry.is_regular_file(ec)) {
-            total_size += fs::file_size(entry.path(), ec);
+    file_system_->walk(backup_base_path_, [&](const FileSystemEntry& entry) {
+        if (entry.isRegularFile()) {
+            total_size += static_cast<size_t>(entry.fileSize().value_or(0));
         }
-    }
+    });
     
     return total_size;
 }
@@ -0,0 +1,50 @@
+#include "watch_backend.h"
+#include "linux_watcher.h"
+#include "logger.h"
+
+efsw::WatchID EfswWatchBackend::addWatch(const std::string& directory, efsw::FileWatchListener* listener,
+                                         bool recursive) {
+    return watcher_.addWatch(directory, listener, recursive);
+}
+
+void EfswWatchBackend::removeWatch(efsw::WatchID watch_id) {
+    watcher_.removeWatch(watch_id);
+}
+
+void EfswWatchBackend::watch() {
+    watcher_.watch();
+}
+
+std::unique_ptr<WatchBackend> createWatchBackend(const std::string& name) {
+    auto logger = Logger::get();
+
+#ifdef __linux__
+    if (name == "fanotify") {
+        auto watcher = std::make_unique<LinuxWatcher>(LinuxWatcher::Mode::Fanotify);
+        if (watcher->valid()) {
+            return watcher;
+        }
+        if (logger) {
+            logger->warn("fanotify 不可用（需要 CAP_SYS_ADMIN 和 Linux 5.9+），回退到 inotify");
+        }
+    }
+    if (name == "fanotify" || name == "inotify") {
+        auto watcher = std::make_unique<LinuxWatcher>(LinuxWatcher::Mode::Inotify);
+        if (watcher->valid()) {
+            return watcher;
+        }
+        if (logger) {
+            logger->warn("inotify 初始化失败，回退到 efsw");
+        }
+    }
+#else
+    if ((name == "inotify" || name == "fanotify") && logger) {
+        logger->warn("监控后端 {} 仅支持 Linux，使用 efsw", name);
+    }
+#endif
+
+    if (name != "efsw" && name != "inotify" && name != "fanotify" && logger) {
+        logger->warn("未知的监控后端: {}，使用 efsw", name);
+    }
+    return std::make_unique<EfswWatchBackend>();
+}
@@ -0,0 +1,52 @@
+#include "worker_budget.h"
+#include <algorithm>
+#include <thread>
+
+namespace {
+
+int defaultCapacity(int capacity) {
+    return capacity > 0 ? capacity : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+} // namespace
+
+WorkerBudget::WorkerBudget(int capacity)
+    : capacity_(defaultCapacity(capacity)) {
+}
+
+void WorkerBudget::reserve(int count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    in_use_ += std::max(0, count);
+}
+
+int WorkerBudget::tryAcquire(int count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int granted = std::max(0, std::min(count, capacity_ - in_use_));
+    in_use_ += granted;
+    return granted;
+}
+
+void WorkerBudget::release(int count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    in_use_ = std::max(0, in_use_ - std::max(0, count));
+}
+
+void WorkerBudget::setCapacity(int capacity) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    capacity_ = defaultCapacity(capacity);
+}
+
+int WorkerBudget::capacity() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return capacity_;
+}
+
+int WorkerBudget::inUse() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return in_use_;
+}
+
+WorkerBudget& WorkerBudget::shared() {
+    static WorkerBudget budget;
+    return budget;
+}
@@ -0,0 +1,251 @@
+// 原始事件记录（.cbtrace）：写入端与读取端往返、文件在任意位置截断、LEB128 变长整数解码
+// 用法: event_trace_test（由 ctest 运行，失败时返回非 0）
+#include "event_trace.h"
+#include "event_ring.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(cond)                                                              \
+    do {                                                                         \
+        if (!(cond)) {                                                           \
+            std::fprintf(stderr, "%s:%d: 检查失败: %s\n", __FILE__, __LINE__, #cond); \
+            g_failures++;                                                        \
+        }                                                                        \
+    } while (0)
+
+void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+void putString(std::string& out, const std::string& value) {
+    putVarint(out, value.size());
+    out += value;
+}
+
+std::string header(uint64_t version, uint64_t start_unix_ms) {
+    std::string out(EventTrace::MAGIC, sizeof(EventTrace::MAGIC));
+    putVarint(out, version);
+    putVarint(out, start_unix_ms);
+    return out;
+}
+
+void writeFile(const fs::path& path, const std::string& bytes) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+std::string readFile(const fs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+std::vector<EventTraceReader::Event> readAll(EventTraceReader& reader) {
+    std::vector<EventTraceReader::Event> events;
+    EventTraceReader::Event event;
+    while (reader.next(event)) {
+        events.push_back(event);
+    }
+    return events;
+}
+
+// 记录一组覆盖各字段的事件，返回写出的文件
+fs::path recordSample(const fs::path& root) {
+    fs::path source = root / "source";
+    fs::create_directories(source / "sub");
+    writeFile(source / "a.txt", "hello");
+
+    fs::path trace = root / "sample.cbtrace";
+    EventTraceWriter writer;
+    CHECK(writer.open(trace.string()));
+    uint32_t id = writer.addSource(source.string());
+    std::string dir = source.string() + "/";
+    writer.record(id, dir, "a.txt", efsw::Actions::Add, std::string());
+    writer.record(id, dir, "a.txt", efsw::Actions::Modified, std::string());
+    writer.record(id, dir, "sub", efsw::Actions::Add, std::string());
+    writer.record(id, dir + "sub/", "b.txt", efsw::Actions::Moved, "../a.txt");
+    writer.record(id, dir, "a.txt", efsw::Actions::Delete, std::string());
+    writer.record(id, dir, std::string(), RESCAN_ACTION, std::string());
+    writer.close();
+    CHECK(writer.recordedEvents() == 6);
+    CHECK(writer.droppedEvents() == 0);
+    return trace;
+}
+
+void testRoundTrip(const fs::path& root, const fs::path& trace) {
+    EventTraceReader reader;
+    CHECK(reader.open(trace.string()));
+    auto events = readAll(reader);
+    CHECK(reader.error().empty());
+    CHECK(reader.lostEvents() == 0);
+    CHECK(reader.sources().size() == 1);
+    CHECK(!reader.sources().empty() && reader.sources()[0] == (root / "source").string());
+    CHECK(reader.startUnixMs() > 0);
+
+    CHECK(events.size() == 6);
+    if (events.size() != 6) {
+        return;
+    }
+    std::string dir = (root / "source").string() + "/";
+    CHECK(events[0].action == efsw::Actions::Add && events[0].dir == dir && events[0].filename == "a.txt");
+    CHECK(events[0].size && *events[0].size == 5 && !events[0].is_directory);
+    CHECK(events[1].action == efsw::Actions::Modified && events[1].size && *events[1].size == 5);
+    CHECK(events[2].action == efsw::Actions::Add && events[2].is_directory && !events[2].size);
+    // 移动后的路径不存在，大小未知；目录定义按编号复用
+    CHECK(events[3].action == efsw::Actions::Moved && events[3].dir == dir + "sub/");
+    CHECK(events[3].filename == "b.txt" && events[3].old_filename == "../a.txt" && !events[3].size);
+    CHECK(events[4].action == efsw::Actions::Delete && events[4].dir == dir && !events[4].size);
+    CHECK(events[4].old_filename.empty());
+    CHECK(events[5].action == RESCAN_ACTION && events[5].filename.empty());
+    for (size_t i = 1; i < events.size(); ++i) {
+        CHECK(events[i].time_us >= events[i - 1].time_us);
+    }
+}
+
+// 写入时崩溃只会留下一个前缀：任意截断位置都不能多读、读错，截断在记录中间时报告损坏
+void testTruncated(const fs::path& root, const fs::path& trace) {
+    std::string bytes = readFile(trace);
+    EventTraceReader full_reader;
+    CHECK(full_reader.open(trace.string()));
+    auto full = readAll(full_reader);
+
+    fs::path cut_path = root / "cut.cbtrace";
+    size_t header_size = header(EventTrace::VERSION, static_cast<uint64_t>(full_reader.startUnixMs())).size();
+    for (size_t cut = 0; cut < bytes.size(); ++cut) {
+        writeFile(cut_path, bytes.substr(0, cut));
+        EventTraceReader reader;
+        if (cut < header_size) {
+            CHECK(!reader.open(cut_path.string()));
+            CHECK(!reader.error().empty());
+            continue;
+        }
+        CHECK(reader.open(cut_path.string()));
+        auto events = readAll(reader);
+        CHECK(events.size() <= full.size());
+        for (size_t i = 0; i < events.size() && i < full.size(); ++i) {
+            CHECK(events[i].filename == full[i].filename && events[i].dir == full[i].dir);
+            CHECK(events[i].action == full[i].action && events[i].time_us == full[i].time_us);
+        }
+    }
+
+    // 截掉最后一个字节：最后一个事件不完整
+    writeFile(cut_path, bytes.substr(0, bytes.size() - 1));
+    EventTraceReader reader;
+    CHECK(reader.open(cut_path.string()));
+    auto events = readAll(reader);
+    CHECK(events.size() + 1 == full.size());
+    CHECK(!reader.error().empty());
+}
+
+void testVarints(const fs::path& root) {
+    const uint64_t start_ms = (uint64_t(1) << 40) + 12345;
+    const uint64_t delta_us = (uint64_t(1) << 35) + 1;
+    const uint64_t max_size = std::numeric_limits<uint64_t>::max();   // 10 字节编码
+
+    std::string bytes = header(EventTrace::VERSION, start_ms);
+    bytes.push_back('S');
+    putVarint(bytes, 0);
+    putString(bytes, "src");
+    bytes.push_back('D');
+    putVarint(bytes, 300);   // 两字节编号 0xAC 0x02
+    putString(bytes, "dir/");
+    bytes.push_back('L');
+    putVarint(bytes, 129);
+    bytes.push_back('E');
+    putVarint(bytes, delta_us);
+    putVarint(bytes, 0);
+    putVarint(bytes, 300);
+    bytes.push_back(static_cast<char>(efsw::Actions::Modified));
+    bytes.push_back(static_cast<char>(EventTrace::FLAG_SIZE_KNOWN));
+    putVarint(bytes, max_size);
+    putString(bytes, std::string(200, 'x'));   // 长度本身也是两字节
+    CHECK(bytes.find("\xAC\x02") != std::string::npos);
+
+    fs::path path = root / "varint.cbtrace";
+    writeFile(path, bytes);
+    EventTraceReader reader;
+    CHECK(reader.open(path.string()));
+    CHECK(reader.startUnixMs() == static_cast<int64_t>(start_ms));
+    EventTraceReader::Event event;
+    CHECK(reader.next(event));
+    CHECK(event.time_us == static_cast<int64_t>(delta_us));
+    CHECK(event.dir == "dir/" && event.filename == std::string(200, 'x'));
+    CHECK(event.size && *event.size == max_size);
+    CHECK(reader.lostEvents() == 129);
+    CHECK(!reader.next(event) && reader.error().empty());
+
+    // 超过 64 位的变长整数（10 个字节仍带继续位）视为损坏
+    std::string overlong = header(EventTrace::VERSION, 1);
+    overlong.push_back('L');
+    overlong.append(10, static_cast<char>(0x80));
+    overlong.push_back(0x01);
+    writeFile(path, overlong);
+    EventTraceReader overlong_reader;
+    CHECK(overlong_reader.open(path.string()));
+    CHECK(!overlong_reader.next(event));
+    CHECK(!overlong_reader.error().empty());
+
+    // 不支持的版本和错误的魔数
+    writeFile(path, header(EventTrace::VERSION + 1, 1));
+    EventTraceReader version_reader;
+    CHECK(!version_reader.open(path.string()));
+    std::string bad_magic = header(EventTrace::VERSION, 1);
+    bad_magic[0] = 'X';
+    writeFile(path, bad_magic);
+    EventTraceReader magic_reader;
+    CHECK(!magic_reader.open(path.string()));
+
+    // 事件引用未定义的目录编号
+    std::string undefined_dir = header(EventTrace::VERSION, 1);
+    undefined_dir.push_back('E');
+    putVarint(undefined_dir, 0);
+    putVarint(undefined_dir, 0);
+    putVarint(undefined_dir, 5);
+    undefined_dir.push_back(static_cast<char>(efsw::Actions::Add));
+    undefined_dir.push_back(0);
+    putString(undefined_dir, "f");
+    writeFile(path, undefined_dir);
+    EventTraceReader undefined_reader;
+    CHECK(undefined_reader.open(path.string()));
+    CHECK(!undefined_reader.next(event));
+    CHECK(!undefined_reader.error().empty());
+}
+
+} // namespace
+
+int main() {
+    fs::path root = fs::temp_directory_path() /
+        ("codebackup_trace_test_" + std::to_string(
+            std::chrono::steady_clock::now().time_since_epoch().count()));
+    fs::create_directories(root);
+
+    fs::path trace = recordSample(root);
+    testRoundTrip(root, trace);
+    testTruncated(root, trace);
+    testVarints(root);
+
+    std::error_code ec;
+    fs::remove_all(root, ec);
+    if (g_failures > 0) {
+        std::fprintf(stderr, "%d 项检查失败\n", g_failures);
+        return 1;
+    }
+    std::printf("event_trace_test: 全部通过\n");
+    return 0;
+}
@@ -0,0 +1,234 @@
+// 文件状态表持久化：快照 + 更新日志的往返、日志尾部不完整、压缩中断（残留 .log.old）和旧版本快照
+// 用法: file_state_table_test（由 ctest 运行，失败时返回非 0）
+#include "file_state_table.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(cond)                                                              \
+    do {                                                                         \
+        if (!(cond)) {                                                           \
+            std::fprintf(stderr, "%s:%d: 检查失败: %s\n", __FILE__, __LINE__, #cond); \
+            g_failures++;                                                        \
+        }                                                                        \
+    } while (0)
+
+const std::string HASH_A(64, 'a');
+const std::string HASH_B = "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef";
+
+FileStamp makeStamp(uint64_t size, int64_t mtime, uint64_t file_id, const std::string& hash = std::string(),
+                    int64_t hash_time = 0) {
+    FileStamp stamp;
+    stamp.size = size;
+    stamp.mtime = mtime;
+    stamp.file_id = file_id;
+    stamp.hash = hash;
+    stamp.hash_time = hash_time;
+    return stamp;
+}
+
+bool sameStamp(const std::optional<FileStamp>& actual, const FileStamp& expected) {
+    return actual && actual->size == expected.size && actual->mtime == expected.mtime &&
+           actual->file_id == expected.file_id && actual->hash == expected.hash &&
+           actual->hash_time == expected.hash_time;
+}
+
+// 每个用例使用独立目录
+fs::path caseDir(const fs::path& root, const char* name) {
+    fs::path dir = root / name;
+    fs::create_directories(dir);
+    return dir;
+}
+
+void testRoundTrip(const fs::path& root) {
+    std::string path = (caseDir(root, "round_trip") / "table.state").string();
+    FileStamp plain = makeStamp(10, 1000, 7);
+    FileStamp hashed = makeStamp(20, 2000, 8, HASH_A, 2000 + 3 * Platform::FILE_TIME_TICKS_PER_SECOND);
+    FileStamp untimed = makeStamp(30, 3000, 0, HASH_B);
+    {
+        FileStateTable table(path);
+        table.put("a.txt", plain);
+        table.put("dir/b.txt", hashed);
+        CHECK(table.compact());
+        // 快照之后的更新只在日志中
+        table.put("dir/c.txt", untimed);
+        table.put("gone.txt", plain);
+        CHECK(table.erase("gone.txt"));
+    }
+    CHECK(fs::exists(path));
+    CHECK(fs::exists(path + ".log"));
+
+    FileStateTable loaded(path);
+    CHECK(loaded.load());
+    CHECK(sameStamp(loaded.get("a.txt"), plain));
+    CHECK(sameStamp(loaded.get("dir/b.txt"), hashed));
+    CHECK(sameStamp(loaded.get("dir/c.txt"), untimed));
+    CHECK(!loaded.get("gone.txt"));
+    CHECK(loaded.keysUnder("dir").size() == 2);
+
+    // 哈希时刻已过精度窗口的摘要可以复用，没有哈希时刻的不行
+    loaded.setTimestampGranularity(Platform::FILE_TIME_TICKS_PER_SECOND);
+    CHECK(loaded.cachedHash("dir/b.txt", hashed) == HASH_A);
+    CHECK(!loaded.cachedHash("dir/c.txt", untimed));
+
+    // 重放过的日志已合并进快照
+    CHECK(!fs::exists(path + ".log") || fs::file_size(path + ".log") == 0);
+    FileStateTable reloaded(path);
+    CHECK(reloaded.load());
+    CHECK(sameStamp(reloaded.get("dir/c.txt"), untimed));
+}
+
+void testTruncatedTail(const fs::path& root) {
+    std::string path = (caseDir(root, "truncated_tail") / "table.state").string();
+    FileStamp first = makeStamp(1, 100, 1, HASH_A, 500);
+    FileStamp second = makeStamp(2, 200, 2, HASH_B, 600);
+    {
+        FileStateTable table(path);
+        table.put("first.txt", first);
+        table.put("second.txt", second);
+    }
+
+    // 模拟写最后一条记录时崩溃：截掉末尾几个字节
+    std::string log_path = path + ".log";
+    auto log_size = fs::file_size(log_path);
+    fs::resize_file(log_path, log_size - 5);
+
+    FileStateTable loaded(path);
+    CHECK(loaded.load());
+    CHECK(sameStamp(loaded.get("first.txt"), first));
+    CHECK(!loaded.get("second.txt"));
+
+    // 加载时已压缩，之后的更新不会接在损坏的尾部之后
+    loaded.put("third.txt", second);
+    FileStateTable reloaded(path);
+    CHECK(reloaded.load());
+    CHECK(sameStamp(reloaded.get("first.txt"), first));
+    CHECK(sameStamp(reloaded.get("third.txt"), second));
+}
+
+void testInterruptedCompaction(const fs::path& root) {
+    std::string path = (caseDir(root, "interrupted_compaction") / "table.state").string();
+    FileStamp base = makeStamp(1, 100, 1);
+    FileStamp before = makeStamp(2, 200, 2, HASH_A, 900);
+    FileStamp after = makeStamp(3, 300, 3, HASH_B, 950);
+    {
+        FileStateTable table(path);
+        table.put("base.txt", base);
+        CHECK(table.compact());
+        table.put("moved.txt", before);
+        table.put("old_only.txt", before);
+    }
+
+    // 压缩切换日志之后、写出新快照之前中断：旧日志留在 .log.old，之后的更新在新日志中
+    std::string log_path = path + ".log";
+    fs::rename(log_path, log_path + ".old");
+    {
+        FileStateTable table(path);
+        table.put("moved.txt", after);
+        table.put("new_only.txt", after);
+    }
+
+    FileStateTable loaded(path);
+    CHECK(loaded.load());
+    CHECK(sameStamp(loaded.get("base.txt"), base));
+    CHECK(sameStamp(loaded.get("old_only.txt"), before));
+    CHECK(sameStamp(loaded.get("new_only.txt"), after));
+    // .log.old 先于当前日志重放，新值覆盖旧值
+    CHECK(sameStamp(loaded.get("moved.txt"), after));
+    CHECK(!fs::exists(log_path + ".old"));
+
+    // 快照替换之后、删除 .log.old 之前中断：.log.old 的内容已在快照中，重复重放结果相同
+    {
+        FileStateTable table(path);
+        CHECK(table.load());
+        table.put("moved.txt", before);
+        fs::copy_file(log_path, log_path + ".saved");
+        CHECK(table.compact());
+    }
+    fs::rename(log_path + ".saved", log_path + ".old");
+    FileStateTable replayed(path);
+    CHECK(replayed.load());
+    CHECK(sameStamp(replayed.get("moved.txt"), before));
+    CHECK(sameStamp(replayed.get("base.txt"), base));
+}
+
+void appendBytes(std::string& out, const void* data, size_t size) {
+    out.append(static_cast<const char*>(data), size);
+}
+
+void testVersion3Snapshot(const fs::path& root) {
+    std::string path = (caseDir(root, "version3") / "table.state").string();
+
+    // 版本 3：has_digest 只有 0 / 1，没有哈希时刻
+    std::string buffer;
+    uint32_t magic = 0x54534243;
+    uint32_t version = 3;
+    uint64_t count = 1;
+    appendBytes(buffer, &magic, sizeof(magic));
+    appendBytes(buffer, &version, sizeof(version));
+    appendBytes(buffer, &count, sizeof(count));
+    std::string key = "legacy.txt";
+    uint32_t key_len = static_cast<uint32_t>(key.size());
+    appendBytes(buffer, &key_len, sizeof(key_len));
+    buffer += key;
+    uint64_t size = 42;
+    int64_t mtime = 4200;
+    uint64_t file_id = 9;
+    uint8_t has_digest = 1;
+    appendBytes(buffer, &size, sizeof(size));
+    appendBytes(buffer, &mtime, sizeof(mtime));
+    appendBytes(buffer, &file_id, sizeof(file_id));
+    appendBytes(buffer, &has_digest, sizeof(has_digest));
+    buffer.append(32, static_cast<char>(0xaa));
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    }
+
+    FileStateTable loaded(path);
+    CHECK(loaded.load());
+    CHECK(sameStamp(loaded.get("legacy.txt"), makeStamp(42, 4200, 9, HASH_A)));
+
+    // 版本号超出当前支持范围的快照不读取
+    version = 99;
+    buffer.replace(sizeof(magic), sizeof(version), reinterpret_cast<const char*>(&version), sizeof(version));
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    }
+    FileStateTable rejected(path);
+    CHECK(!rejected.load());
+    CHECK(!rejected.get("legacy.txt"));
+}
+
+} // namespace
+
+int main() {
+    fs::path root = fs::temp_directory_path() /
+        ("codebackup_state_test_" + std::to_string(
+            std::chrono::steady_clock::now().time_since_epoch().count()));
+    fs::create_directories(root);
+
+    testRoundTrip(root);
+    testTruncatedTail(root);
+    testInterruptedCompaction(root);
+    testVersion3Snapshot(root);
+
+    std::error_code ec;
+    fs::remove_all(root, ec);
+    if (g_failures > 0) {
+        std::fprintf(stderr, "%d 项检查失败\n", g_failures);
+        return 1;
+    }
+    std::printf("file_state_table_test: 全部通过\n");
+    return 0;
+}